@@ -0,0 +1,387 @@
+#include <rabbit/rabbit.hpp>
+
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#if _WIN32
+#   include <Windows.h>
+#   include <psapi.h>
+#endif
+
+using namespace rb;
+
+// Scene and run parameters, every one can be overridden with --name=value argument.
+struct benchmark_config {
+    std::size_t entities{ 10000 };
+    std::size_t hierarchy_depth{ 1 }; // 1 means no parents
+    std::size_t mesh_variety{ 8 };
+    std::size_t material_variety{ 16 };
+    std::size_t point_lights{ 64 };
+    std::size_t directional_lights{ 1 }; // every one casts shadows
+    float static_fraction{ 0.0f }; // geometries marked static, their shadows are cached
+    std::size_t warmup_frames{ 30 };
+    std::size_t frames{ 300 };
+    std::uint32_t seed{ 1 };
+    std::string output{ "benchmark.json" };
+    std::string label;
+};
+
+static benchmark_config config;
+
+// Half of scene extent on X and Z axes, used to place camera path around whole scene.
+static float scene_extent{ 0.0f };
+
+static std::size_t peak_memory_usage() {
+#if _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+#else
+    std::ifstream status{ "/proc/self/status" };
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+#endif
+    return 0;
+}
+
+class synthetic_scene : public rb::system {
+public:
+    void initialize(registry& registry) override {
+        std::mt19937 random{ config.seed };
+        std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+        std::vector<std::shared_ptr<mesh>> meshes;
+        for (std::size_t index{ 0 }; index < std::max<std::size_t>(config.mesh_variety, 1); ++index) {
+            if (index % 2 == 0) {
+                const auto size = 0.25f + unit(random) * 0.5f;
+                meshes.push_back(mesh::make_box({ size, size, size }, { 1.0f, 1.0f }));
+            } else {
+                // Spheres of growing tessellation, so meshes differ in vertex count as well.
+                const auto segments = 8 + index * 4;
+                meshes.push_back(mesh::make_sphere(segments, segments, 0.5f));
+            }
+        }
+
+        std::vector<std::shared_ptr<material>> materials;
+        for (std::size_t index{ 0 }; index < std::max<std::size_t>(config.material_variety, 1); ++index) {
+            material_desc desc;
+            desc.base_color = { unit(random), unit(random), unit(random), 1.0f };
+            desc.roughness = unit(random);
+            desc.metallic = unit(random);
+            materials.push_back(graphics::make_material(desc));
+        }
+
+        // Roots of hierarchy chains are laid out on square grid, children are stacked on top of their parents.
+        const auto depth = std::max<std::size_t>(config.hierarchy_depth, 1);
+        const auto roots = (config.entities + depth - 1) / depth;
+        const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<float>(roots))));
+        const auto spacing = 3.0f;
+        scene_extent = std::max(side * spacing * 0.5f, 1.0f);
+
+        entity parent{ null };
+        for (std::size_t index{ 0 }; index < config.entities; ++index) {
+            const auto entity = registry.create();
+
+            transform transform;
+            if (index % depth == 0) {
+                const auto root = index / depth;
+                transform.position = { (root % side) * spacing - scene_extent, 0.0f, (root / side) * spacing - scene_extent };
+            } else {
+                transform.parent = parent;
+                transform.position = { 0.0f, 1.25f, 0.0f };
+                transform.rotation = { 0.0f, unit(random) * pi<float>(), 0.0f };
+            }
+            registry.emplace<rb::transform>(entity, transform);
+
+            geometry geometry;
+            geometry.mesh = meshes[index % meshes.size()];
+            geometry.material = materials[(index / meshes.size()) % materials.size()];
+            geometry.is_static = static_cast<float>(index % 100) < config.static_fraction * 100.0f;
+            registry.emplace<rb::geometry>(entity, geometry);
+
+            parent = entity;
+        }
+
+        for (std::size_t index{ 0 }; index < config.point_lights; ++index) {
+            const auto entity = registry.create();
+
+            transform transform;
+            transform.position = { (unit(random) * 2.0f - 1.0f) * scene_extent, 2.0f, (unit(random) * 2.0f - 1.0f) * scene_extent };
+            registry.emplace<rb::transform>(entity, transform);
+
+            light light;
+            light.color = { static_cast<unsigned char>(unit(random) * 255.0f), static_cast<unsigned char>(unit(random) * 255.0f), static_cast<unsigned char>(unit(random) * 255.0f), 255 };
+            registry.emplace<rb::light>(entity, light);
+
+            point_light point_light;
+            point_light.radius = 2.0f + unit(random) * 6.0f;
+            registry.emplace<rb::point_light>(entity, point_light);
+        }
+
+        for (std::size_t index{ 0 }; index < config.directional_lights; ++index) {
+            const auto entity = registry.create();
+
+            transform transform;
+            transform.rotation = { -0.8f, index * pi<float>() * 0.5f, 0.0f };
+            registry.emplace<rb::transform>(entity, transform);
+
+            registry.emplace<rb::light>(entity);
+
+            directional_light directional_light;
+            directional_light.shadow_enabled = true;
+            registry.emplace<rb::directional_light>(entity, directional_light);
+        }
+
+        const auto entity = registry.create();
+        registry.emplace<rb::transform>(entity);
+
+        camera camera;
+        camera.z_far = scene_extent * 4.0f;
+        registry.emplace<rb::camera>(entity, camera);
+    }
+};
+
+class camera_path : public rb::system {
+public:
+    void update(registry& registry, float elapsed_time) override {
+        // Path depends on frame number only, so every run renders exactly the same views.
+        const auto angle = 2.0f * pi<float>() * _frame++ / std::max<std::size_t>(config.warmup_frames + config.frames, 1);
+        const auto radius = scene_extent * 1.2f;
+
+        for (const auto& [entity, transform, camera] : registry.view<transform, camera>().each()) {
+            registry.patch<rb::transform>(entity, [angle, radius](rb::transform& transform) {
+                transform.position = { std::sin(angle) * radius, radius * 0.35f, std::cos(angle) * radius };
+                transform.rotation = { -0.3f, angle, 0.0f };
+            });
+        }
+    }
+
+private:
+    std::size_t _frame{ 0 };
+};
+
+class frame_statistics : public rb::system {
+public:
+    struct percentiles {
+        float min;
+        float p50;
+        float p90;
+        float p95;
+        float p99;
+        float max;
+        float avg;
+    };
+
+public:
+    void update(registry& registry, float elapsed_time) override {
+        const auto now = std::chrono::steady_clock::now();
+        if (_frame > config.warmup_frames) {
+            _frame_times.push_back(_milliseconds(_last_update, now));
+        }
+
+        _last_update = now;
+    }
+
+    void draw(registry& registry) override {
+        // Systems registered before this one, renderer included, have finished drawing.
+        const auto now = std::chrono::steady_clock::now();
+
+        if (_frame >= config.warmup_frames) {
+            _draw_times.push_back(_milliseconds(_last_update, now));
+
+            for (const auto& timing : graphics::gpu_timings()) {
+                if (timing.name == "frame") {
+                    _gpu_times.push_back(timing.last);
+                }
+            }
+        }
+
+        if (++_frame == config.warmup_frames + config.frames) {
+            _report(registry);
+        }
+    }
+
+private:
+    static float _milliseconds(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(to - from).count();
+    }
+
+    static percentiles _percentiles(std::vector<float> samples) {
+        if (samples.empty()) {
+            return {};
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        const auto at = [&samples](float percentile) {
+            return samples[static_cast<std::size_t>(percentile * (samples.size() - 1))];
+        };
+
+        percentiles result;
+        result.min = samples.front();
+        result.p50 = at(0.5f);
+        result.p90 = at(0.9f);
+        result.p95 = at(0.95f);
+        result.p99 = at(0.99f);
+        result.max = samples.back();
+        result.avg = 0.0f;
+        for (const auto sample : samples) {
+            result.avg += sample;
+        }
+        result.avg /= samples.size();
+        return result;
+    }
+
+    static json _to_json(const percentiles& percentiles) {
+        return {
+            { "min", percentiles.min },
+            { "p50", percentiles.p50 },
+            { "p90", percentiles.p90 },
+            { "p95", percentiles.p95 },
+            { "p99", percentiles.p99 },
+            { "max", percentiles.max },
+            { "avg", percentiles.avg }
+        };
+    }
+
+    void _report(registry& registry) {
+        const auto frame = _percentiles(_frame_times);
+        const auto draw = _percentiles(_draw_times);
+        const auto gpu = _percentiles(_gpu_times);
+
+        json report;
+        report["label"] = config.label;
+        report["backend"] = settings::graphics_backend == graphics_backend::null ? "null" : "vulkan";
+        report["resolution"] = { settings::window_size.x, settings::window_size.y };
+        report["scene"] = {
+            { "entities", config.entities },
+            { "hierarchy_depth", config.hierarchy_depth },
+            { "mesh_variety", config.mesh_variety },
+            { "material_variety", config.material_variety },
+            { "point_lights", config.point_lights },
+            { "directional_lights", config.directional_lights },
+            { "static_fraction", config.static_fraction },
+            { "seed", config.seed }
+        };
+        report["frames"] = config.frames;
+        report["cpu_frame_ms"] = _to_json(frame);
+        report["cpu_draw_ms"] = _to_json(draw);
+        report["gpu_frame_ms"] = _gpu_times.empty() ? json{} : _to_json(gpu);
+
+        for (const auto& timing : graphics::gpu_timings()) {
+            report["gpu_passes_ms"][timing.name] = { { "min", timing.min }, { "avg", timing.avg }, { "max", timing.max } };
+        }
+
+        for (const auto& pass_calls : graphics::pass_calls()) {
+            report["pass_calls"][pass_calls.name] = pass_calls.calls;
+        }
+
+        report["peak_memory_bytes"] = peak_memory_usage();
+        report["time_to_first_frame_ms"] = app::time_to_first_frame();
+
+        for (const auto& step : app::startup_timeline()) {
+            report["startup_ms"][step.name] = step.end - step.start;
+        }
+
+        std::ofstream stream{ config.output, std::ios::trunc };
+        stream << report.dump(4) << std::endl;
+
+        print("frame ms p50: {:.3f} p99: {:.3f}, draw ms p50: {:.3f} p99: {:.3f}, gpu ms p50: {:.3f} p99: {:.3f}, peak memory: {} MiB\n",
+            frame.p50, frame.p99, draw.p50, draw.p99, gpu.p50, gpu.p99, peak_memory_usage() / (1024 * 1024));
+    }
+
+private:
+    std::size_t _frame{ 0 };
+    std::chrono::steady_clock::time_point _last_update;
+    std::vector<float> _frame_times;
+    std::vector<float> _draw_times;
+    std::vector<float> _gpu_times;
+};
+
+static bool parse_argument(const std::string& argument) {
+    const auto separator = argument.find('=');
+    if (argument.rfind("--", 0) != 0 || separator == std::string::npos) {
+        return false;
+    }
+
+    const auto name = argument.substr(2, separator - 2);
+    const auto value = argument.substr(separator + 1);
+
+    if (name == "entities") {
+        config.entities = std::stoull(value);
+    } else if (name == "hierarchy-depth") {
+        config.hierarchy_depth = std::stoull(value);
+    } else if (name == "meshes") {
+        config.mesh_variety = std::stoull(value);
+    } else if (name == "materials") {
+        config.material_variety = std::stoull(value);
+    } else if (name == "point-lights") {
+        config.point_lights = std::stoull(value);
+    } else if (name == "directional-lights") {
+        config.directional_lights = std::stoull(value);
+    } else if (name == "static") {
+        config.static_fraction = std::stof(value);
+    } else if (name == "warmup") {
+        config.warmup_frames = std::stoull(value);
+    } else if (name == "frames") {
+        config.frames = std::stoull(value);
+    } else if (name == "seed") {
+        config.seed = static_cast<std::uint32_t>(std::stoul(value));
+    } else if (name == "output") {
+        config.output = value;
+    } else if (name == "label") {
+        config.label = value;
+    } else if (name == "backend") {
+        settings::graphics_backend = value == "null" ? graphics_backend::null : graphics_backend::vulkan;
+    } else if (name == "width") {
+        settings::window_size.x = static_cast<unsigned int>(std::stoul(value));
+    } else if (name == "height") {
+        settings::window_size.y = static_cast<unsigned int>(std::stoul(value));
+    } else if (name == "headless") {
+        settings::headless = value != "0";
+    } else if (name == "capture") {
+        settings::capture_directory = value;
+    } else if (name == "trace") {
+        settings::trace_file = value;
+    } else if (name == "startup") {
+        settings::startup_report = value;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Benchmark must not wait for display, so it runs offscreen unless asked otherwise.
+    settings::headless = true;
+    settings::vsync = present_mode::immediate;
+
+    for (int index{ 1 }; index < argc; ++index) {
+        if (!parse_argument(argv[index])) {
+            std::cerr << "Unknown argument: " << argv[index] << std::endl;
+            return 1;
+        }
+    }
+
+    settings::frame_count = config.warmup_frames + config.frames;
+
+    app::setup();
+
+    app::system<synthetic_scene>();
+    app::system<camera_path>();
+    app::system<frame_statistics>();
+
+    app::run("");
+}
@@ -2,7 +2,7 @@
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec2 in_texcoord;
-layout (location = 2) in vec3 in_normal;
+layout (location = 2) in vec2 in_normal; // octahedral
 
 layout (std140, set = 0, binding = 0) uniform camera {
     mat4 proj;
@@ -12,15 +12,33 @@ layout (std140, set = 0, binding = 0) uniform camera {
 	mat4 light_proj_views[4];
 } u_camera;
 
-layout (std140, push_constant) uniform local {
+struct instance {
     mat4 world;
-} u_local;
+    vec4 bsphere;
+    uint command_index;
+    uint lod_count;
+    uint material_index;
+    uint cluster_count;
+    vec3 position_offset; // mesh quantization
+    uint first_cluster;
+    vec3 position_scale;
+    uint cone_culling;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer instance_buffer {
+    instance data[];
+} u_instances;
+
+layout (std430, set = 1, binding = 1) readonly buffer visible_instance_buffer {
+    uint data[];
+} u_visible_instances;
 
 invariant gl_Position;
 
 void main() {
-    // TODO: Should be culled. 
-	gl_Position =  u_camera.proj * u_camera.view * u_local.world * vec4(in_position, 1.0);
+    instance instance = u_instances.data[u_visible_instances.data[gl_InstanceIndex]];
+    vec3 position = instance.position_offset + in_position * instance.position_scale;
+	gl_Position =  u_camera.proj * u_camera.view * instance.world * vec4(position, 1.0);
     
 #ifdef VULKAN
     gl_Position.y = -gl_Position.y;
@@ -2,7 +2,7 @@
 
 layout (location = 0) in vec3 i_position;
 layout (location = 1) in vec2 i_texcoord;
-layout (location = 2) in vec3 i_normal;
+layout (location = 2) in vec2 i_normal; // octahedral
 
 layout (std140, set = 0, binding = 0) uniform camera_data {
     mat4 u_proj;
@@ -13,10 +13,13 @@ layout (std140, set = 0, binding = 0) uniform camera_data {
 
 layout (std140, push_constant) uniform local_data {
     mat4 u_world;
+    vec4 u_position_offset; // mesh quantization
+    vec4 u_position_scale;
 };
 
 void main() {
-    gl_Position = u_proj * u_view * u_world * vec4(i_position, 1.0);
+    vec3 position = u_position_offset.xyz + i_position * u_position_scale.xyz;
+    gl_Position = u_proj * u_view * u_world * vec4(position, 1.0);
 
 #ifdef VULKAN
     gl_Position.y = -gl_Position.y;
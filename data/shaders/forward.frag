@@ -1,6 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 #define PI 3.14159265359
 #define PCSS_BLOCKER_SEARCH_NUM_SAMPLES 4
@@ -10,18 +11,31 @@
 #define MAX_SHADOW_MAP_CASCADES 4
 #endif
 
+// Material permutations are selected at pipeline creation time,
+// so single SPIR-V module serves every material flags combination.
+layout (constant_id = 0) const bool c_albedo_map = false;
+layout (constant_id = 1) const bool c_normal_map = false;
+layout (constant_id = 2) const bool c_roughness_map = false;
+layout (constant_id = 3) const bool c_metallic_map = false;
+layout (constant_id = 4) const bool c_emissive_map = false;
+layout (constant_id = 5) const bool c_ambient_map = false;
+layout (constant_id = 6) const bool c_translucent = false;
+layout (constant_id = 7) const bool c_shadow_map = false;
+
 struct light {
 	vec4 position_or_direction; // .a < 0.5 ? point_light : directional_light
 	vec4 color; // .a = radius 
 };
 
-struct visible_index {
-	int index;
+struct light_cluster {
+	uint offset;
+	uint count;
 };
 
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec2 v_texcoord;
 layout (location = 2) in vec3 v_normal;
+layout (location = 3) flat in uint v_material_index;
 
 layout (location = 0) out vec4 o_color;
 layout (location = 1) out vec4 o_bright;
@@ -36,40 +50,33 @@ layout (std140, set = 0, binding = 0) uniform camera_data {
 
 layout(set = 0, binding = 1) uniform sampler2D u_brdf_map;
 
-#ifdef SHADOW_MAP
 layout(set = 0, binding = 2) uniform sampler2DArray u_shadow_map;
-#endif
 
-layout (std140, set = 1, binding = 0) uniform material_data {
+// Materials are bindless: parameters of every material in one buffer, maps index global texture array.
+#define ALBEDO_MAP 0
+#define NORMAL_MAP 1
+#define ROUGHNESS_MAP 2
+#define METALLIC_MAP 3
+#define EMISSIVE_MAP 4
+#define AMBIENT_MAP 5
+
+struct material_data {
     vec4 base_color;
+    vec4 uv_transform;
     float roughness;
     float metallic;
     float occlusion_strength;
-} u_material;
-
-#ifdef ALBEDO_MAP 
-layout (set = 1, binding = 1) uniform sampler2D u_albedo_map;
-#endif 
-
-#ifdef NORMAL_MAP 
-layout (set = 1, binding = 2) uniform sampler2D u_normal_map;
-#endif
-
-#ifdef ROUGHNESS_MAP 
-layout (set = 1, binding = 3) uniform sampler2D u_roughness_map;
-#endif
+    uint maps[6];
+};
 
-#ifdef METALLIC_MAP 
-layout (set = 1, binding = 4) uniform sampler2D u_metallic_map;
-#endif
+layout (std430, set = 1, binding = 0) readonly buffer material_buffer {
+    material_data data[];
+} u_materials;
 
-#ifdef EMISSIVE_MAP 
-layout (set = 1, binding = 5) uniform sampler2D u_emissive_map;
-#endif
+layout (set = 1, binding = 1) uniform sampler2D u_textures[];
 
-#ifdef AMBIENT_MAP 
-layout (set = 1, binding = 6) uniform sampler2D u_ambient_map;
-#endif
+// Material index may differ between fragments of one draw, since batches merge materials.
+#define MATERIAL_MAP(map) u_textures[nonuniformEXT(material.maps[map])]
 
 layout(set = 2, binding = 0) uniform samplerCube u_radiance_map;
 layout(set = 2, binding = 1) uniform samplerCube u_irradiance_map;
@@ -80,15 +87,30 @@ layout(std430, set = 3, binding = 0) readonly buffer light_buffer {
 	light data[];
 } u_light_buffer;
 
-layout(std430, set = 3, binding = 1) readonly buffer visible_light_indices_buffer {
-	visible_index data[];
-} u_visible_light_indices_buffer;
+layout(std430, set = 3, binding = 1) readonly buffer light_index_buffer {
+	uint count;
+	uint data[];
+} u_light_index_buffer;
 
 layout(std140, set = 3, binding = 2) uniform culling_data {
 	uint light_count;
-    uint number_of_tiles_x;
+	uint max_light_indices;
+	uint tile_size;
+	uint cluster_count_x;
+	uint cluster_count_y;
+	uint cluster_count_z;
+	float viewport_width;
+	float viewport_height;
+	float z_near;
+	float z_far;
+	float slice_scale;
+	float slice_bias;
 } u_culling_data;
 
+layout(std430, set = 3, binding = 3) readonly buffer light_cluster_buffer {
+	light_cluster data[];
+} u_light_cluster_buffer;
+
 const vec2 poisson_disk[64] = {
 	vec2( -0.04117257, -0.1597612 ),
 	vec2( 0.06731031, -0.4353096 ),
@@ -170,7 +192,6 @@ float penumbra_size(float z_receiver, float z_blocker) {
 	return max((z_receiver - z_blocker) / z_blocker * 12.0, 0.0);
 }
 
-#ifdef SHADOW_MAP
 vec2 find_blocker(vec2 texcoord, float z_receiver, float cascade) {
 	ivec2 texture_size = textureSize(u_shadow_map, 0).xy;
 	vec2 texel = vec2(1.0 / texture_size.x, 1.0 / texture_size.y);
@@ -209,7 +230,6 @@ float pcss(vec3 texcoord, float cascade) {
 	vec2 blockers = find_blocker(texcoord.xy, texcoord.z, cascade);
 	return pcf(texcoord.xy, texcoord.z, 2.0 + penumbra_size(texcoord.z, blockers.x), cascade);
 }
-#endif
 
 float distribution_ggx(vec3 n, vec3 h, float roughness) {
     float a = roughness * roughness;
@@ -275,8 +295,17 @@ vec3 perturb(vec3 map, vec3 n, vec3 v, vec2 texcoord) {
   return normalize(tbn * map);
 }
 
+// Normal maps are stored as BC5 (XY only), so Z has to be reconstructed.
+vec3 decode_normal(vec2 map) {
+  vec2 xy = map * 2.0 - 1.0;
+  return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
 float compute_shadow() {
-#ifdef SHADOW_MAP
+	if (!c_shadow_map) {
+		return 1.0;
+	}
+
 	for (int i = 0; i < MAX_SHADOW_MAP_CASCADES; ++i) {
 		vec4 shadow_coord = u_camera.light_proj_views[i] * vec4(v_position, 1.0);
 		shadow_coord.xyz = shadow_coord.xyz / shadow_coord.w;
@@ -289,50 +318,54 @@ float compute_shadow() {
 			return pcf(shadow_coord.xy, shadow_coord.z - 0.002, 3.0, i);
 		} 
 	}
-#endif
 	return 1.0;
 }
 
 void main() {
-	ivec2 location = ivec2(gl_FragCoord.xy);
-	ivec2 tile_id = location / ivec2(16, 16);
-	uint index = tile_id.y * u_culling_data.number_of_tiles_x + tile_id.x;
-
-    vec4 albedo = u_material.base_color;
-#ifdef ALBEDO_MAP
-    albedo *= texture(u_albedo_map, v_texcoord);
-#ifndef TRANSLUCENT
-	// TODO: Customizable cutoff.
-	if (albedo.a < 0.5) {
-		discard;
-	}
-#endif
-#endif
+	uvec2 tile_id = uvec2(gl_FragCoord.xy) / u_culling_data.tile_size;
+	float view_depth = -(u_camera.view * vec4(v_position, 1.0)).z;
+	uint slice = uint(clamp(log(max(view_depth, u_culling_data.z_near)) * u_culling_data.slice_scale + u_culling_data.slice_bias, 0.0, float(u_culling_data.cluster_count_z - 1)));
+	uint cluster_index = (slice * u_culling_data.cluster_count_y + tile_id.y) * u_culling_data.cluster_count_x + tile_id.x;
+	light_cluster cluster = u_light_cluster_buffer.data[cluster_index];
+
+    material_data material = u_materials.data[v_material_index];
+
+    // Atlased maps sample only their region.
+    vec2 texcoord = v_texcoord * material.uv_transform.xy + material.uv_transform.zw;
+
+    vec4 albedo = material.base_color;
+    if (c_albedo_map) {
+        albedo *= texture(MATERIAL_MAP(ALBEDO_MAP), texcoord);
+        // TODO: Customizable cutoff.
+        if (!c_translucent && albedo.a < 0.5) {
+            discard;
+        }
+    }
 
     vec3 normal = v_normal;
-#ifdef NORMAL_MAP
-   normal = perturb(texture(u_normal_map, v_texcoord).rgb * 2.0 - 1.0, normalize(normal), normalize(u_camera.position - v_position), v_texcoord);
-#endif
-
-    float roughness = u_material.roughness;
-#ifdef ROUGHNESS_MAP
-    roughness *= texture(u_roughness_map, v_texcoord).g;
-#endif
+    if (c_normal_map) {
+        normal = perturb(decode_normal(texture(MATERIAL_MAP(NORMAL_MAP), texcoord).rg), normalize(normal), normalize(u_camera.position - v_position), texcoord);
+    }
+
+    float roughness = material.roughness;
+    if (c_roughness_map) {
+        roughness *= texture(MATERIAL_MAP(ROUGHNESS_MAP), texcoord).g;
+    }
    
-    float metallic = u_material.metallic;
-#ifdef METALLIC_MAP
-    metallic *= texture(u_metallic_map, v_texcoord).b;
-#endif
+    float metallic = material.metallic;
+    if (c_metallic_map) {
+        metallic *= texture(MATERIAL_MAP(METALLIC_MAP), texcoord).b;
+    }
     
     vec3 emissive = vec3(0.0);
-#ifdef EMISSIVE_MAP
-    emissive = texture(u_emissive_map, v_texcoord).rgb;
-#endif
+    if (c_emissive_map) {
+        emissive = texture(MATERIAL_MAP(EMISSIVE_MAP), texcoord).rgb;
+    }
 
     float ao = 1.0;
-#ifdef AMBIENT_MAP
-    ao = texture(u_ambient_map, v_texcoord).r;
-#endif
+    if (c_ambient_map) {
+        ao = texture(MATERIAL_MAP(AMBIENT_MAP), texcoord).r;
+    }
 
     vec3 v = normalize(u_camera.position - v_position);
     vec3 n = normalize(normal);
@@ -343,9 +376,8 @@ void main() {
 
     vec3 lo = vec3(0.0);
 
-	uint offset = index * 1024;
-	for (uint i = 0; i < 1024 && u_visible_light_indices_buffer.data[offset + i].index != -1; ++i) {
-		uint light_index = u_visible_light_indices_buffer.data[offset + i].index;
+	for (uint i = 0; i < cluster.count; ++i) {
+		uint light_index = u_light_index_buffer.data[cluster.offset + i];
 		light light = u_light_buffer.data[light_index];
 
         vec3 radiance = light.color.xyz;
@@ -355,11 +387,9 @@ void main() {
 
         if (light.position_or_direction.w > 0.5) {
             l = -normalize(light.position_or_direction.xyz);
-#ifdef SHADOW_MAP
-			if (light.color.w > 0.5) {
+			if (c_shadow_map && light.color.w > 0.5) {
 				shadow = compute_shadow();
 			}
-#endif
         } else {
 			vec3 diff = light.position_or_direction.xyz - v_position;
             float dist = length(diff);
@@ -395,15 +425,15 @@ void main() {
 
     vec3 reflected = reflect(-v, n);
 
-    vec3 prefilter_color = textureLod(u_prefilter_map, reflected, roughness * 6.0).rgb;
+    vec3 prefilter_color = textureLod(u_prefilter_map, reflected, roughness * 5.0).rgb;
     vec2 brdf = texture(u_brdf_map, vec2(n_dot_v, roughness)).rg;
     vec3 spec = prefilter_color * (ks * brdf.x + brdf.y);
 
     vec3 ambient = (kd * diff + spec);
 	
-#ifdef AMBIENT_MAP
-	ambient = mix(ambient, ambient * ao, u_material.occlusion_strength);
-#endif
+	if (c_ambient_map) {
+		ambient = mix(ambient, ambient * ao, material.occlusion_strength);
+	}
 
     o_color = vec4(ambient + lo + emissive, albedo.a);
 
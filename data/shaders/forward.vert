@@ -2,7 +2,7 @@
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec2 in_texcoord;
-layout (location = 2) in vec3 in_normal;
+layout (location = 2) in vec2 in_normal; // octahedral
 
 layout (std140, set = 0, binding = 0) uniform CameraData {
     mat4 proj;
@@ -24,8 +24,25 @@ struct Light {
 //};
 
 #ifdef VULKAN 
-layout (std140, push_constant) uniform LocalData {
+struct Instance {
     mat4 world;
+    vec4 bsphere;
+    uint command_index;
+    uint lod_count;
+    uint material_index;
+    uint cluster_count;
+    vec3 position_offset; // mesh quantization
+    uint first_cluster;
+    vec3 position_scale;
+    uint cone_culling;
+};
+
+layout (std430, set = 4, binding = 0) readonly buffer InstanceData {
+    Instance instances[];
+};
+
+layout (std430, set = 4, binding = 1) readonly buffer VisibleInstanceData {
+    uint visible_instances[];
 };
 #else
 layout (std140, binding = 1) uniform LocalData {
@@ -36,6 +53,9 @@ layout (std140, binding = 1) uniform LocalData {
 layout (location = 0) out vec3 v_position;
 layout (location = 1) out vec2 v_texcoord;
 layout (location = 2) out vec3 v_normal;
+#ifdef VULKAN
+layout (location = 3) flat out uint v_material_index;
+#endif
 
 const mat4 bias_mat = mat4( 
 	0.5, 0.0, 0.0, 0.0,
@@ -45,12 +65,31 @@ const mat4 bias_mat = mat4(
 
 invariant gl_Position;
 
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    v_position = (world * vec4(in_position, 1.0)).xyz;
+#ifdef VULKAN
+    Instance instance = instances[visible_instances[gl_InstanceIndex]];
+    mat4 world = instance.world;
+    v_material_index = instance.material_index;
+
+    // Positions are quantized in mesh bounds.
+    vec3 position = instance.position_offset + in_position * instance.position_scale;
+#else
+    vec3 position = in_position;
+#endif
+
+    v_position = (world * vec4(position, 1.0)).xyz;
     v_texcoord = in_texcoord;
-    v_normal = (world * vec4(normalize(in_normal), 0.0)).xyz;
-    // v_shadow_coord = (light_proj_view * world) * vec4(in_position, 1.0);	
-    gl_Position = proj * view * world * vec4(in_position, 1.0);
+    v_normal = (world * vec4(decode_octahedral(in_normal), 0.0)).xyz;
+    // v_shadow_coord = (light_proj_view * world) * vec4(position, 1.0);	
+    gl_Position = proj * view * world * vec4(position, 1.0);
 
 #ifdef VULKAN
     gl_Position.y = -gl_Position.y;
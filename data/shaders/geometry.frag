@@ -54,6 +54,12 @@ vec3 perturb(vec3 map, vec3 n, vec3 v, vec2 texcoord) {
     return normalize(tbn * map);
 }
 
+// Normal maps are stored as BC5 (XY only), so Z has to be reconstructed.
+vec3 decode_normal(vec2 map) {
+    vec2 xy = map * 2.0 - 1.0;
+    return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
+
 void main() {
     vec4 albedo = vec4(u_base_color, 1.0);
     if (ALBEDO_MAP > -1) {
@@ -65,7 +71,7 @@ void main() {
 
     vec3 normal = v_normal;
     if (NORMAL_MAP > -1) {
-        normal = perturb(texture(u_maps[NORMAL_MAP], v_texcoord).rgb * 2.0 - 1.0, normalize(normal), normalize(u_camera_position - v_position), v_texcoord);
+        normal = perturb(decode_normal(texture(u_maps[NORMAL_MAP], v_texcoord).rg), normalize(normal), normalize(u_camera_position - v_position), v_texcoord);
     }
 
     float roughness = u_roughness;
@@ -2,17 +2,39 @@
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec2 in_texcoord;
-layout (location = 2) in vec3 in_normal;
+layout (location = 2) in vec2 in_normal; // octahedral
+
+struct Instance {
+    mat4 world;
+    vec4 bsphere;
+    uint command_index;
+    uint lod_count;
+    uint material_index;
+    uint cluster_count;
+    vec3 position_offset; // mesh quantization
+    uint first_cluster;
+    vec3 position_scale;
+    uint cone_culling;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer InstanceData {
+    Instance instances[];
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer VisibleInstanceData {
+    uint visible_instances[];
+};
 
-// TODO: Use buffer instead.
 layout (std140, push_constant) uniform ShadowData {
-    mat4 proj_view_world;
+    mat4 proj_view;
 };
 
 invariant gl_Position;
 
 void main() {
-	gl_Position =  proj_view_world * vec4(in_position, 1.0);
+    Instance instance = instances[visible_instances[gl_InstanceIndex]];
+    vec3 position = instance.position_offset + in_position * instance.position_scale;
+	gl_Position =  proj_view * instance.world * vec4(position, 1.0);
 #ifdef VULKAN
     gl_Position.y = -gl_Position.y;
 #endif
@@ -50,7 +50,7 @@ namespace rb {
 			case frustum_plane_index::right:
 				plane.normal.x = mat[3] - mat[0];
 				plane.normal.y = mat[7] - mat[4];
-				plane.normal.z = mat[11] = mat[8];
+				plane.normal.z = mat[11] - mat[8];
 				plane.d = mat[15] - mat[12];
 				break;
 			case frustum_plane_index::left:
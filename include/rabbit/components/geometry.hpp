@@ -9,11 +9,13 @@ namespace rb {
 	struct geometry {
 		std::shared_ptr<mesh> mesh;
 		std::shared_ptr<material> material;
+		bool is_static{ false }; // never moves, so its shadow can be cached
 
 		template<typename Visitor>
 		static void visit(Visitor& visitor, geometry& geometry) {
 			visitor("mesh", geometry.mesh);
 			visitor("material", geometry.material);
+			visitor("is_static", geometry.is_static);
 		}
 	};
 
@@ -6,24 +6,46 @@
 #include "visitor.hpp"
 
 #include <list>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
 #include <typeinfo>
 #include <typeindex>
 #include <unordered_map>
 
 namespace rb {
+	struct startup_step {
+		std::string name;
+		float start; // milliseconds since app::run
+		float end; // milliseconds since app::run
+		bool async; // executed on worker, overlapping steps of main thread
+	};
+
 	class app {
 		using deserializer = void(*)(registry&, entity, json_read_visitor&);
 
 	public:
 		template<typename Submodule>
 		static void submodule() {
-			_preinits.push_back(&Submodule::init);
+			_preinits.push_back({ typeid(Submodule).name(), &Submodule::init });
 			_releases.push_front(&Submodule::release);
 		}
 
 		template<typename Func>
 		static void init(Func func) {
-			_inits.push_back(func);
+			init("init", func);
+		}
+
+		template<typename Func>
+		static void init(const char* name, Func func) {
+			_inits.push_back({ name, func });
+		}
+
+		// Started on worker once submodules registered before are initialized, finished before first init.
+		template<typename Func>
+		static void async_init(const char* name, Func func) {
+			_async_inits.push_back({ { name, func }, _preinits.size() });
 		}
 		
 		template<typename Component>
@@ -47,14 +69,41 @@ namespace rb {
 
 		static deserializer get_deserializer(const std::string& name);
 
+		// Steps executed before first frame, complete once first frame is presented.
+		static const std::vector<startup_step>& startup_timeline();
+
+		// Milliseconds from app::run to first presented frame.
+		static float time_to_first_frame();
+
 	private:
+		struct init_step {
+			const char* name;
+			void(*func)();
+		};
+
+		struct async_init_step {
+			init_step step;
+			std::size_t preinit_count;
+		};
+
 		static void _main_loop(const std::string& initial_scene);
 
+		static void _run_step(const init_step& step, bool async);
+
+		static float _startup_time();
+
+		static void _write_startup_report();
+
 	private:
-		static std::list<void(*)()> _preinits;
-		static std::list<void(*)()> _inits;
+		static std::list<init_step> _preinits;
+		static std::list<async_init_step> _async_inits;
+		static std::list<init_step> _inits;
 		static std::list<void(*)()> _releases;
 		static std::list<std::shared_ptr<rb::system>(*)()> _systems;
 		static std::unordered_map<std::string, deserializer> _deserializers;
+		static std::chrono::steady_clock::time_point _startup_epoch;
+		static std::mutex _startup_mutex;
+		static std::vector<startup_step> _startup_timeline;
+		static float _time_to_first_frame;
 	};
 }
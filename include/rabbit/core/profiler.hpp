@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Profiler is compiled out in production builds, unless explicitly requested.
+#ifndef RB_PROFILE
+#	if RB_PROD_BUILD
+#		define RB_PROFILE 0
+#	else
+#		define RB_PROFILE 1
+#	endif
+#endif
+
+namespace rb {
+	// Collects CPU zones, frame markers and counters into per-thread ring buffers.
+	// Names are stored by pointer, so they have to live as long as the capture (string literals or type names).
+	class profiler {
+	public:
+		static constexpr std::size_t thread_buffer_size{ 32768 };
+
+		static void set_thread_name(const char* name);
+
+		static void zone(const char* name, std::uint64_t start, std::uint64_t end);
+
+		static void frame_mark();
+
+		static void counter(const char* name, double value);
+
+		// Nanoseconds elapsed since profiler start.
+		static std::uint64_t now();
+
+		// Writes events of every thread in Chrome trace event format, readable by Perfetto.
+		// Can be called at any time, events recorded meanwhile are either included or skipped.
+		static bool dump(const std::string& filename);
+	};
+
+	class profiler_zone {
+	public:
+		explicit profiler_zone(const char* name)
+			: _name(name)
+			, _start(profiler::now()) {
+		}
+
+		profiler_zone(const profiler_zone&) = delete;
+
+		profiler_zone& operator=(const profiler_zone&) = delete;
+
+		~profiler_zone() {
+			profiler::zone(_name, _start, profiler::now());
+		}
+
+	private:
+		const char* _name;
+		std::uint64_t _start;
+	};
+}
+
+#define RB_PROFILE_CONCAT_IMPL(a, b) a##b
+#define RB_PROFILE_CONCAT(a, b) RB_PROFILE_CONCAT_IMPL(a, b)
+
+#if RB_PROFILE
+#	define RB_PROFILE_ZONE(name) rb::profiler_zone RB_PROFILE_CONCAT(rb_profile_zone_, __LINE__){ name }
+#	define RB_PROFILE_FRAME() rb::profiler::frame_mark()
+#	define RB_PROFILE_COUNTER(name, value) rb::profiler::counter(name, static_cast<double>(value))
+#	define RB_PROFILE_THREAD(name) rb::profiler::set_thread_name(name)
+#else
+#	define RB_PROFILE_ZONE(name) ((void)0)
+#	define RB_PROFILE_FRAME() ((void)0)
+#	define RB_PROFILE_COUNTER(name, value) ((void)0)
+#	define RB_PROFILE_THREAD(name) ((void)0)
+#endif
@@ -16,10 +16,12 @@ namespace rb {
         rect_packer(const vec2u& size);
 
         rect_packer(const rect_packer&) = delete;
-        rect_packer(rect_packer&&) = default;
+        rect_packer(rect_packer&&);
+
+        ~rect_packer();
 
         rect_packer& operator=(const rect_packer&) = delete;
-        rect_packer& operator=(rect_packer&&) = default;
+        rect_packer& operator=(rect_packer&&);
 
         std::optional<vec4u> pack(const vec2u& size);
 
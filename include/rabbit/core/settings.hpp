@@ -14,6 +14,22 @@ namespace rb {
 		static vec2u window_size;
 		static bool fullscreen;
 		static graphics_backend graphics_backend;
-		static bool vsync;
+		static present_mode vsync;
+		static std::string cache_directory;
+
+		// Renders into offscreen image of window size instead of window. Default on platforms without window driver.
+		static bool headless;
+
+		// Number of frames rendered before headless app quits, 0 means no limit.
+		static std::size_t frame_count;
+
+		// Headless frames are read back and written as PNG files into that directory when not empty.
+		static std::string capture_directory;
+
+		// Chrome trace written at exit when not empty, GPU pass timings go next to it as CSV.
+		static std::string trace_file;
+
+		// JSON with init steps and time to first frame, written once first frame is presented when not empty.
+		static std::string startup_report;
 	};
 }
@@ -12,6 +12,8 @@ namespace rb {
 	struct environment_desc {
 		const void* data{ nullptr };
 		vec2u size{ 0, 0 };
+		const void* irradiance_data{ nullptr }; // faces of irradiance_map_size, expanded from baked spherical harmonics
+		const void* prefilter_data{ nullptr }; // faces of every prefilter mip level, baked at import
 	};
 
 	class environment {
@@ -12,11 +12,21 @@
 namespace rb {
     /**
      * @brief GLSL helper class.
+     *        Engine shaders are precompiled to SPIR-V at build time,
+     *        runtime compilation is kept for application shaders.
      */
     class glsl {
     public:
         static std::vector<std::uint32_t> compile(shader_stage stage, const std::string& code);
 
+        /**
+         * @brief Compiles GLSL code with given macro definitions into SPIR-V.
+         *        Results are cached on disk under settings::cache_directory,
+         *        keyed by source, definitions, stage and compiler version.
+         */
         static std::vector<std::uint32_t> compile(shader_stage stage, const std::string& code, const span<const std::string> definitions);
+
+    private:
+        static std::vector<std::uint32_t> _compile(shader_stage stage, const std::string& code, const std::string& preamble);
     };
 }
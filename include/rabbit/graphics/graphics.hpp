@@ -11,20 +11,56 @@
 #include "../components/light.hpp"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace rb {
 	enum class graphics_backend {
-		vulkan
+		vulkan,
+		null // accepts every call without rendering, to measure CPU side of renderer
+	};
+
+	enum class present_mode {
+		fifo, // wait for vertical blank, never tears
+		mailbox, // replace queued frame, lowest latency without tearing
+		immediate // present without waiting, may tear
 	};
 
 	struct graphics_limits {
-		static constexpr std::size_t max_lights{ 1024 };
+		static constexpr std::size_t max_lights{ 4096 };
+		static constexpr std::size_t light_cluster_tile_size{ 64 };
+		static constexpr std::size_t light_cluster_slices{ 24 };
+		static constexpr std::size_t light_cluster_average_lights{ 32 };
 		static constexpr std::size_t brdf_map_size{ 512 };
 		static constexpr std::size_t irradiance_map_size{ 64 };
 		static constexpr std::size_t prefilter_map_size{ 128 };
+		static constexpr std::size_t prefilter_map_levels{ 6 };
 		static constexpr std::size_t shadow_map_size{ 1024 };
 		static constexpr std::size_t max_shadow_cascades{ 4 };
 		static constexpr std::size_t ssao_image_reduction{ 4 };
+		static constexpr std::size_t max_instances{ 262144 };
+		static constexpr std::size_t max_draw_commands{ 65536 };
+		static constexpr std::size_t max_mesh_lods{ 5 };
+		static constexpr std::size_t max_mesh_vertices{ 2097152 };
+		static constexpr std::size_t max_mesh_indices{ 8388608 };
+		static constexpr std::size_t max_mesh_clusters{ 65536 };
+		static constexpr std::size_t max_materials{ 16384 };
+		static constexpr std::size_t max_material_textures{ 4096 };
+		static constexpr std::size_t staging_buffer_size{ 67108864 };
+		static constexpr std::size_t max_frames_in_flight{ 3 };
+	};
+
+	struct gpu_pass_timing {
+		std::string name;
+		float min; // milliseconds
+		float avg; // milliseconds
+		float max; // milliseconds
+		float last; // milliseconds, most recent frame
+	};
+
+	struct graphics_pass_calls {
+		std::string name;
+		std::size_t calls; // begin, draw and end calls of last frame
 	};
 
 	class graphics_impl {
@@ -47,7 +83,7 @@ namespace rb {
 
 		virtual void begin_depth_pass(const std::shared_ptr<viewport>& viewport) = 0;
 
-		virtual void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, std::size_t mesh_lod_index) = 0;
+		virtual void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) = 0;
 
 		virtual void end_depth_pass(const std::shared_ptr<viewport>& viewport) = 0;
 
@@ -114,6 +150,12 @@ namespace rb {
 		virtual void swap_buffers() = 0;
 
 		virtual void flush() = 0;
+
+		virtual float frame_latency() = 0;
+
+		virtual std::vector<gpu_pass_timing> gpu_timings() = 0;
+
+		virtual std::vector<graphics_pass_calls> pass_calls() = 0;
 	};
 
 	class graphics {
@@ -138,7 +180,7 @@ namespace rb {
 
 		static void begin_depth_pass(const std::shared_ptr<viewport>& viewport);
 
-		static void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, std::size_t mesh_lod_index);
+		static void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index);
 
 		static void end_depth_pass(const std::shared_ptr<viewport>& viewport);
 
@@ -206,6 +248,18 @@ namespace rb {
 
 		static void flush();
 
+		// Average time in seconds between input refresh and presentation of the frame built from it.
+		static float frame_latency();
+
+		// Rolling GPU timings of every render pass recorded in recent frames.
+		static std::vector<gpu_pass_timing> gpu_timings();
+
+		// Writes GPU timings as CSV, so they can be compared with CPU captures.
+		static void export_gpu_timings(const std::string& path);
+
+		// Number of calls made into every pass during last frame. Only counted by null backend.
+		static std::vector<graphics_pass_calls> pass_calls();
+
 	private:
 		static std::shared_ptr<graphics_impl> _impl;
 	};
@@ -20,6 +20,8 @@ namespace rb {
 
         static image resize(const image& image, const vec2u& new_size);
 
+        static image from_pixels(const color* pixels, const vec2u& size);
+
         image() = default;
 
         image(const image&) = delete;
@@ -38,6 +40,9 @@ namespace rb {
 
         bool is_power_of_two() const;
 
+        // Writes image as PNG file.
+        bool save_to_file(const std::string& filename) const;
+
     private:
         image(const color* pixels, const vec2u& size);
 
@@ -29,6 +29,7 @@ namespace rb {
 		float roughness{ 0.8f };
 		float metallic{ 0.0f };
 		float occlusion_strength{ 1.0f }; // ambient = mix(ambient, ambient * ambient_map.r, occlusion_strength);
+		vec4f uv_transform{ 1.0f, 1.0f, 0.0f, 0.0f }; // texcoord = texcoord * uv_transform.xy + uv_transform.zw, used by atlased maps.
 		bool translucent{ false };
 		bool double_sided{ false };
 		bool wireframe{ false };
@@ -56,6 +57,8 @@ namespace rb {
 
 		float metallic() const;
 
+		const vec4f& uv_transform() const;
+
 		bool translucent() const;
 
 		bool double_sided() const;
@@ -83,6 +86,7 @@ namespace rb {
 		const vec4f _base_color;
 		const float _roughness;
 		const float _metallic;
+		const vec4f _uv_transform;
 		const bool _translucent;
 		const bool _double_sided;
 		const bool _wireframe;
@@ -16,15 +16,39 @@
 #include <optional>
 
 namespace rb {
+	// Vertices and indices are stored with meshoptimizer codecs, zlib is applied on top when it pays off.
+	enum class mesh_codec : std::uint8_t {
+		none,
+		meshopt,
+		meshopt_zlib
+	};
+
 	struct mesh_lod {
 		std::uint32_t offset;
 		std::uint32_t size;
 	};
 
+	// Group of base lod triangles with its bounding sphere and normal cone, in mesh local space.
+	// Layout matches std430, so clusters are uploaded to GPU as they are.
+	struct mesh_cluster {
+		vec3f center;
+		float radius;
+		vec3f cone_apex;
+		std::uint32_t first_index; // offset in mesh indices
+		vec3f cone_axis;
+		float cone_cutoff; // cosine of half cone angle
+		std::uint32_t index_count;
+		std::uint32_t padding[3];
+	};
+
+	// Either vertices or packed vertices with their quantization have to be provided.
 	struct mesh_desc {
 		span<const vertex> vertices;
+		span<const packed_vertex> packed_vertices;
+		std::optional<vertex_quantization> quantization;
 		span<const std::uint32_t> indices;
 		span<const mesh_lod> lods;
+		span<const mesh_cluster> clusters;
 		span<const trianglef> convex_hull;
 		std::optional<bspheref> bsphere;
 		std::optional<bboxf> bbox;
@@ -34,6 +58,11 @@ namespace rb {
 	public:
 		static constexpr auto magic_number{ fnv1a("mesh") };
 
+		// Smaller meshes are culled as a whole, unless metadata requests clusters.
+		static constexpr std::size_t min_clustered_triangles{ 8192 };
+		static constexpr std::size_t max_cluster_vertices{ 255 };
+		static constexpr std::size_t max_cluster_triangles{ 256 };
+
 		static std::shared_ptr<mesh> load(ibstream& stream);
 
 		static void import(ibstream& input, obstream& output, const json& metadata);
@@ -46,12 +75,20 @@ namespace rb {
 
 		virtual ~mesh() = default;
 
+		// Empty for imported meshes, which store only packed vertices.
 		span<const vertex> vertices() const;
 
+		span<const packed_vertex> packed_vertices() const;
+
+		const vertex_quantization& quantization() const;
+
 		span<const std::uint32_t> indices() const;
 
 		span<const mesh_lod> lods() const;
 
+		// Empty when base lod is drawn as a whole.
+		span<const mesh_cluster> clusters() const;
+
 		span<const trianglef> convex_hull() const;
 
 		const bspheref& bsphere() const;
@@ -65,8 +102,11 @@ namespace rb {
 		const std::vector<vertex> _vertices;
 		const std::vector<std::uint32_t> _indices;
 		const std::vector<mesh_lod> _lods;
+		const std::vector<mesh_cluster> _clusters;
 		const std::vector<trianglef> _convex_hull;
 		const bspheref _bsphere;
 		const bboxf _bbox;
+		const vertex_quantization _quantization;
+		const std::vector<packed_vertex> _packed_vertices;
 	};
 }
@@ -12,8 +12,18 @@ namespace rb {
 
         static void bc3(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels);
 
+        // Single channel (red) compression, used for masks.
+        static void bc4(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels);
+
+        // Two channels (red and green) compression, used for normal maps.
+        static void bc5(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels);
+
         static std::vector<std::uint8_t> bc1(const image& image);
 
         static std::vector<std::uint8_t> bc3(const image& image);
+
+        static std::vector<std::uint8_t> bc4(const image& image);
+
+        static std::vector<std::uint8_t> bc5(const image& image);
     };
 }
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace rb {
 	enum class texture_format {
@@ -16,7 +17,9 @@ namespace rb {
 		rg8,
 		rgba8,
 		bc1,
-		bc3
+		bc3,
+		bc4,
+		bc5
 	};
 
 	enum class texture_filter {
@@ -29,8 +32,21 @@ namespace rb {
 		repeat,
 	};
 
+	// Codec of single mipmap level stored in texture asset.
+	enum class texture_codec {
+		none,
+		zlib
+	};
+
+	// Location of mipmap level inside texture pixels.
+	struct texture_level {
+		std::uint32_t offset{ 0 };
+		std::uint32_t size{ 0 };
+	};
+
 	struct texture_desc {
 		const void* data{ nullptr };
+		const texture_level* levels{ nullptr }; // Optional, levels are tightly packed when null.
 		vec2u size{ 0, 0 };
 		texture_format format{ texture_format::rgba8 };
 		texture_filter filter{ texture_filter::linear };
@@ -62,6 +78,13 @@ namespace rb {
 
 		std::size_t bits_per_pixel() const;
 
+		span<const texture_level> levels() const;
+
+		static vec2u level_size(const vec2u& size, std::uint32_t level);
+
+		// Size of level in bytes, block compressed levels are padded to whole 4x4 blocks.
+		static std::uint32_t level_bytes(texture_format format, const vec2u& size);
+
 	protected:
 		texture(const texture_desc& desc);
 
@@ -72,5 +95,6 @@ namespace rb {
 		const texture_wrap _wrap;
 		const std::uint32_t _mipmaps;
 		const std::size_t _bits_per_pixel;
+		std::vector<texture_level> _levels;
 	};
 }
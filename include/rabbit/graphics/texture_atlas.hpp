@@ -0,0 +1,51 @@
+#pragma once 
+
+#include "image.hpp"
+#include "../math/vec2.hpp"
+#include "../math/vec4.hpp"
+#include "../core/rect_pack.hpp"
+
+#include <vector>
+#include <optional>
+
+namespace rb {
+	// Packs small images into shared pages at import time. Every page has several layers
+	// (e.g. albedo, normal), which share same layout, so single UV transform fits all maps of material.
+	class texture_atlas {
+	public:
+		// Edge pixels repeated around every region, keeps first mipmaps free of bleeding between regions.
+		static constexpr std::uint32_t gutter{ 8 };
+
+		// Regions are placed on grid, so 4x4 blocks of gutter-safe mipmaps never span two regions.
+		static constexpr std::uint32_t alignment{ 32 };
+
+		// Mipmaps below this one would sample neighbouring regions.
+		static constexpr std::uint32_t max_mipmaps{ 4 };
+
+		texture_atlas(const vec2u& size, std::size_t layer_count);
+
+		texture_atlas(const texture_atlas&) = delete;
+		texture_atlas(texture_atlas&&) = default;
+
+		texture_atlas& operator=(const texture_atlas&) = delete;
+		texture_atlas& operator=(texture_atlas&&) = default;
+
+		// Reserves region for image of given size. Returned region excludes gutters.
+		std::optional<vec4u> pack(const vec2u& size);
+
+		// Copies image into region of layer and fills gutters around it.
+		void copy(std::size_t layer, const vec4u& region, const image& image);
+
+		image layer(std::size_t layer) const;
+
+		// Scale (xy) and offset (zw) mapping [0, 1] texcoords into region.
+		vec4f uv_transform(const vec4u& region) const;
+
+		const vec2u& size() const;
+
+	private:
+		vec2u _size;
+		rect_packer _packer;
+		std::vector<std::vector<color>> _layers;
+	};
+}
@@ -3,10 +3,25 @@
 #include "../math/vec2.hpp"
 #include "../math/vec3.hpp"
 
+#include <cstdint>
+
 namespace rb {
 	struct vertex {
 		vec3f position;
 		vec2f texcoord;
 		vec3f normal;
 	};
+
+	// Vertex layout used by GPU, half the size of vertex.
+	struct packed_vertex {
+		std::uint16_t position[4]; // unorm in mesh bounds, .w unused
+		std::uint16_t texcoord[2]; // half float
+		std::int16_t normal[2]; // snorm octahedral encoding
+	};
+
+	// Maps unorm positions of packed vertices back to mesh local space.
+	struct vertex_quantization {
+		vec3f offset;
+		vec3f scale;
+	};
 }
@@ -3,6 +3,7 @@
 #include "../math/vec2.hpp"
 
 #include <memory>
+#include <chrono>
 
 namespace rb {
 	enum class keycode {
@@ -182,7 +183,11 @@ namespace rb {
 
 		static bool is_mouse_button_released(mouse_button button);
 
+		// Time of the last refresh, used as the start point of input-to-photon latency.
+		static std::chrono::steady_clock::time_point refresh_time();
+
 	private:
 		static std::shared_ptr<input_impl> _impl;
+		static std::chrono::steady_clock::time_point _refresh_time;
 	};
 }
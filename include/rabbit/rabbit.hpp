@@ -23,6 +23,7 @@
 #include "core/format.hpp"
 #include "core/json.hpp"
 #include "core/prefab.hpp"
+#include "core/profiler.hpp"
 #include "core/rect_pack.hpp"
 #include "core/reflection.hpp"
 #include "core/settings.hpp"
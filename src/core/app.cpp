@@ -1,26 +1,40 @@
 #include <rabbit/rabbit.hpp>
 
 #include <chrono>
+#include <future>
 #include <thread>
+#include <fstream>
+#include <typeinfo>
 
 using namespace rb;
 
-std::list<void(*)()> app::_preinits;
-std::list<void(*)()> app::_inits;
+std::list<app::init_step> app::_preinits;
+std::list<app::async_init_step> app::_async_inits;
+std::list<app::init_step> app::_inits;
 std::list<void(*)()> app::_releases;
 std::list<std::shared_ptr<rb::system>(*)()> app::_systems;
 std::unordered_map<std::string, void(*)(registry&, entity, json_read_visitor&)> app::_deserializers;
+std::chrono::steady_clock::time_point app::_startup_epoch;
+std::mutex app::_startup_mutex;
+std::vector<startup_step> app::_startup_timeline;
+float app::_time_to_first_frame{ 0.0f };
 
 void app::setup() {
 	app::submodule<window>();
 	app::submodule<input>();
-	app::submodule<graphics>();
-	app::submodule<assets>();
 
 #if !RB_PROD_BUILD
 	app::submodule<editor>();
+
+	// Importing only reads and writes files, so it overlaps with graphics device and pipeline creation.
+	app::async_init("editor scan", [] {
+		editor::scan();
+	});
 #endif
 
+	app::submodule<graphics>();
+	app::submodule<assets>();
+
 	app::component<identity>("identity");
 	app::component<transform>("transform");
 	app::component<camera>("camera");
@@ -29,13 +43,7 @@ void app::setup() {
 	app::component<directional_light>("directional_light");
 	app::component<point_light>("point_light");
 
-#if !RB_PROD_BUILD
-	app::init([] {
-		editor::scan();
-	});
-#endif
-
-	app::init([] {
+	app::init("load resources", [] {
 		assets::load_resources();
 		assets::add_loader<texture>(&texture::load);
 		assets::add_loader<environment>(&environment::load);
@@ -49,12 +57,35 @@ void app::setup() {
 }
 
 void app::run(std::string initial_scene) {
+	_startup_epoch = std::chrono::steady_clock::now();
+	_startup_timeline.clear();
+	_time_to_first_frame = 0.0f;
+
+	std::vector<std::future<void>> async_jobs;
+	const auto start_async_inits = [&async_jobs](std::size_t preinit_count) {
+		for (const auto& async_init : _async_inits) {
+			if (async_init.preinit_count == preinit_count) {
+				async_jobs.push_back(std::async(std::launch::async, [step = async_init.step]() {
+					_run_step(step, true);
+				}));
+			}
+		}
+	};
+
+	std::size_t preinit_count{ 0 };
+	start_async_inits(preinit_count);
+
 	for (auto& preinit : _preinits) {
-		preinit();
+		_run_step(preinit, false);
+		start_async_inits(++preinit_count);
+	}
+
+	for (auto& job : async_jobs) {
+		job.get();
 	}
 
 	for (auto& init : _inits) {
-		init();
+		_run_step(init, false);
 	}
 	
 	_main_loop(initial_scene);
@@ -71,44 +102,124 @@ void app::_main_loop(const std::string& initial_scene) {
 	});
 
 	registry registry;
-	for (auto& system : systems) {
-		system->initialize(registry);
+	{
+		const auto start = _startup_time();
+		for (auto& system : systems) {
+			system->initialize(registry);
+		}
+		_startup_timeline.push_back({ "initialize systems", start, _startup_time(), false });
 	}
 
 	if (!initial_scene.empty()) {
+		const auto start = _startup_time();
 		auto scene = assets::load<prefab>(initial_scene);
 		scene->apply(registry, null);
+		_startup_timeline.push_back({ "load scene", start, _startup_time(), false });
 	}
 
 	auto last_time = std::chrono::steady_clock::now();
 	auto accumulation_time = 0.0f;
 
+	RB_PROFILE_THREAD("main");
+
 	while (window::is_open()) {
-		window::poll_events();
-		input::refresh();
+		RB_PROFILE_FRAME();
+
+		{
+			RB_PROFILE_ZONE("poll events");
+			window::poll_events();
+			input::refresh();
+		}
 
 		const auto current_time = std::chrono::steady_clock::now();
-		const auto elapsed_time = std::chrono::duration_cast<std::chrono::duration<float>>(current_time - last_time).count();
+		const auto measured_time = std::chrono::duration_cast<std::chrono::duration<float>>(current_time - last_time).count();
 		last_time = current_time;
 
+		// Headless frames advance by fixed step, so captured images do not depend on machine speed.
+		const auto elapsed_time = settings::headless ? 1.0f / 60.0f : measured_time;
+
 		for (auto& system : systems) {
+			RB_PROFILE_ZONE(typeid(*system).name());
 			system->update(registry, elapsed_time);
 		}
 
 		if (!window::is_minimized()) {
 			for (auto& system : systems) {
+				RB_PROFILE_ZONE(typeid(*system).name());
 				system->draw(registry);
 			}
 
-			graphics::swap_buffers();
+			{
+				RB_PROFILE_ZONE("swap buffers");
+				graphics::swap_buffers();
+			}
+
+			if (_time_to_first_frame == 0.0f) {
+				_time_to_first_frame = _startup_time();
+				_write_startup_report();
+			}
+
+			RB_PROFILE_COUNTER("frame latency (ms)", graphics::frame_latency() * 1000.0f);
 		} else {
 			std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
 		}
 	}
 
 	graphics::flush();
+
+#if RB_PROFILE
+	if (!settings::trace_file.empty()) {
+		profiler::dump(settings::trace_file);
+		graphics::export_gpu_timings(settings::trace_file + ".gpu.csv");
+	}
+#endif
+}
+
+void app::_run_step(const init_step& step, bool async) {
+	RB_PROFILE_ZONE(step.name);
+
+	const auto start = _startup_time();
+	step.func();
+	const auto end = _startup_time();
+
+	std::lock_guard<std::mutex> lock{ _startup_mutex };
+	_startup_timeline.push_back({ step.name, start, end, async });
+}
+
+float app::_startup_time() {
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _startup_epoch).count();
+}
+
+void app::_write_startup_report() {
+	if (settings::startup_report.empty()) {
+		return;
+	}
+
+	json report;
+	report["time_to_first_frame_ms"] = _time_to_first_frame;
+	report["steps"] = json::array();
+
+	for (const auto& step : _startup_timeline) {
+		report["steps"].push_back({
+			{ "name", step.name },
+			{ "start_ms", step.start },
+			{ "end_ms", step.end },
+			{ "async", step.async }
+		});
+	}
+
+	std::ofstream stream{ settings::startup_report, std::ios::trunc };
+	stream << report.dump(4) << std::endl;
 }
 
 app::deserializer app::get_deserializer(const std::string& name) {
 	return _deserializers.at(name);
 }
+
+const std::vector<startup_step>& app::startup_timeline() {
+	return _startup_timeline;
+}
+
+float app::time_to_first_frame() {
+	return _time_to_first_frame;
+}
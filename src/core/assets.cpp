@@ -1,5 +1,6 @@
 #include <rabbit/core/assets.hpp>
 #include <rabbit/core/config.hpp>
+#include <rabbit/core/profiler.hpp>
 
 #include <filesystem>
 
@@ -40,6 +41,8 @@ void assets::load_resources() {
 }
 
 std::shared_ptr<void> assets::_load(std::type_index type_index, const uuid& uuid, fnv1a_result_t magic_number) {
+    RB_PROFILE_ZONE("assets::_load");
+
     auto& asset = _assets[uuid];
     if (!asset.expired()) {
         return asset.lock();
@@ -1,6 +1,7 @@
 #include <rabbit/core/prefab.hpp>
 #include <rabbit/core/config.hpp>
 #include <rabbit/core/app.hpp>
+#include <rabbit/core/profiler.hpp>
 #include <rabbit/components/transform.hpp>
 
 #include <fstream>
@@ -8,6 +9,8 @@
 using namespace rb;
 
 void prefab::import(ibstream& input, obstream& output, const json& metadata) {
+    RB_PROFILE_ZONE("prefab::import");
+
     json json;
     input.read(json);
 
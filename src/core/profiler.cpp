@@ -0,0 +1,166 @@
+#include <rabbit/core/profiler.hpp>
+#include <rabbit/core/format.hpp>
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
+using namespace rb;
+
+namespace {
+	enum class event_type : std::uint8_t {
+		zone,
+		frame,
+		counter
+	};
+
+	struct event {
+		const char* name;
+		std::uint64_t start;
+		std::uint64_t end;
+		double value;
+		event_type type;
+	};
+
+	// Written only by owning thread. Reader copies events and drops those overwritten during copy.
+	struct thread_buffer {
+		std::uint32_t thread_id{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<std::uint64_t> head{ 0 };
+		std::unique_ptr<event[]> events{ std::make_unique<event[]>(profiler::thread_buffer_size) };
+	};
+
+	std::mutex& buffers_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	// Buffers are shared, so events of finished threads are still dumped.
+	std::vector<std::shared_ptr<thread_buffer>>& buffers() {
+		static std::vector<std::shared_ptr<thread_buffer>> buffers;
+		return buffers;
+	}
+
+	thread_buffer& local_buffer() {
+		// Mutex is taken only once per thread, recording itself is lock-free.
+		thread_local const auto buffer = [] {
+			auto buffer = std::make_shared<thread_buffer>();
+
+			std::lock_guard<std::mutex> lock{ buffers_mutex() };
+			buffer->thread_id = static_cast<std::uint32_t>(buffers().size());
+			buffers().push_back(buffer);
+			return buffer;
+		}();
+
+		return *buffer;
+	}
+
+	void push(const event& event) {
+		auto& buffer = local_buffer();
+
+		const auto head = buffer.head.load(std::memory_order_relaxed);
+		buffer.events[head % profiler::thread_buffer_size] = event;
+		buffer.head.store(head + 1, std::memory_order_release);
+	}
+
+	std::string escape(const char* name) {
+		std::string escaped;
+		for (; *name; ++name) {
+			if (*name == '"' || *name == '\\') {
+				escaped += '\\';
+			}
+			escaped += *name;
+		}
+		return escaped;
+	}
+}
+
+void profiler::set_thread_name(const char* name) {
+	local_buffer().name.store(name, std::memory_order_release);
+}
+
+void profiler::zone(const char* name, std::uint64_t start, std::uint64_t end) {
+	push({ name, start, end, 0.0, event_type::zone });
+}
+
+void profiler::frame_mark() {
+	const auto time = now();
+	push({ "frame", time, time, 0.0, event_type::frame });
+}
+
+void profiler::counter(const char* name, double value) {
+	const auto time = now();
+	push({ name, time, time, value, event_type::counter });
+}
+
+std::uint64_t profiler::now() {
+	static const auto epoch = std::chrono::steady_clock::now();
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+bool profiler::dump(const std::string& filename) {
+	std::vector<std::shared_ptr<thread_buffer>> snapshot;
+	{
+		std::lock_guard<std::mutex> lock{ buffers_mutex() };
+		snapshot = buffers();
+	}
+
+	std::ofstream stream{ filename, std::ios::trunc };
+	if (!stream.is_open()) {
+		return false;
+	}
+
+	const char* separator = "";
+	stream << "{\"traceEvents\":[";
+
+	std::vector<event> events;
+	for (const auto& buffer : snapshot) {
+		if (const auto name = buffer->name.load(std::memory_order_acquire); name) {
+			stream << separator << format("\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+				buffer->thread_id, escape(name));
+			separator = ",";
+		}
+
+		const auto head = buffer->head.load(std::memory_order_acquire);
+		const auto first = head > thread_buffer_size ? head - thread_buffer_size : 0;
+
+		events.clear();
+		for (auto index = first; index < head; ++index) {
+			events.push_back(buffer->events[index % thread_buffer_size]);
+		}
+
+		// Oldest events could be overwritten by owning thread while copying.
+		// Slot of next event may be half written already, once buffer wrapped it holds the oldest event.
+		const auto new_head = buffer->head.load(std::memory_order_acquire);
+		const auto valid_first = new_head >= thread_buffer_size ? new_head - thread_buffer_size + 1 : 0;
+		const auto skip = valid_first > first ? static_cast<std::size_t>(valid_first - first) : 0;
+
+		for (auto index = skip; index < events.size(); ++index) {
+			const auto& event = events[index];
+			const auto timestamp = static_cast<double>(event.start) / 1000.0;
+
+			switch (event.type) {
+				case event_type::zone:
+					stream << separator << format("\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+						escape(event.name), buffer->thread_id, timestamp, static_cast<double>(event.end - event.start) / 1000.0);
+					break;
+				case event_type::frame:
+					stream << separator << format("\n{{\"name\":\"{}\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":{},\"ts\":{:.3f}}}",
+						escape(event.name), buffer->thread_id, timestamp);
+					break;
+				case event_type::counter:
+					stream << separator << format("\n{{\"name\":\"{}\",\"ph\":\"C\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"args\":{{\"value\":{}}}}}",
+						escape(event.name), buffer->thread_id, timestamp, event.value);
+					break;
+			}
+
+			separator = ",";
+		}
+	}
+
+	stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return true;
+}
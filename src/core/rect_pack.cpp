@@ -12,6 +12,13 @@ rect_packer::rect_packer(const vec2u& size)
     stbrp_setup_allow_out_of_mem(_context.get(), 0);
 }
 
+// Defined here, where stbrp types are complete.
+rect_packer::rect_packer(rect_packer&&) = default;
+
+rect_packer::~rect_packer() = default;
+
+rect_packer& rect_packer::operator=(rect_packer&&) = default;
+
 std::optional<vec4u> rect_packer::pack(const vec2u& size) {
     stbrp_rect rect;
     rect.id = 0;
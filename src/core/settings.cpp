@@ -7,4 +7,10 @@ std::string settings::window_title{ "RabBit" };
 vec2u settings::window_size{ 1280, 720 };
 bool settings::fullscreen{ false };
 graphics_backend settings::graphics_backend{ graphics_backend::vulkan };
-bool settings::vsync{ true };
+present_mode settings::vsync{ present_mode::fifo };
+std::string settings::cache_directory{ "cache" };
+bool settings::headless{ !RB_WINDOWS };
+std::size_t settings::frame_count{ 0 };
+std::string settings::capture_directory;
+std::string settings::trace_file;
+std::string settings::startup_report;
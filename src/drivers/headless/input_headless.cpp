@@ -0,0 +1,46 @@
+#include "input_headless.hpp"
+
+using namespace rb;
+
+void input_headless::refresh() {
+}
+
+bool input_headless::is_key_down(keycode) {
+	return false;
+}
+
+bool input_headless::is_key_up(keycode) {
+	return true;
+}
+
+bool input_headless::is_key_pressed(keycode) {
+	return false;
+}
+
+bool input_headless::is_key_released(keycode) {
+	return false;
+}
+
+vec2i input_headless::mouse_position() {
+	return { 0, 0 };
+}
+
+float input_headless::mouse_wheel() {
+	return 0.0f;
+}
+
+bool input_headless::is_mouse_button_down(mouse_button) {
+	return false;
+}
+
+bool input_headless::is_mouse_button_up(mouse_button) {
+	return true;
+}
+
+bool input_headless::is_mouse_button_pressed(mouse_button) {
+	return false;
+}
+
+bool input_headless::is_mouse_button_released(mouse_button) {
+	return false;
+}
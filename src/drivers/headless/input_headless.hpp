@@ -0,0 +1,31 @@
+#pragma once 
+
+#include <rabbit/platform/input.hpp>
+
+namespace rb {
+	// Input without any device, every key and button stays released.
+	class input_headless : public input_impl {
+	public:
+		void refresh() override;
+
+		bool is_key_down(keycode key) override;
+
+		bool is_key_up(keycode key) override;
+
+		bool is_key_pressed(keycode key) override;
+
+		bool is_key_released(keycode key) override;
+
+		vec2i mouse_position() override;
+
+		float mouse_wheel() override;
+
+		bool is_mouse_button_down(mouse_button button) override;
+
+		bool is_mouse_button_up(mouse_button button) override;
+
+		bool is_mouse_button_pressed(mouse_button button) override;
+
+		bool is_mouse_button_released(mouse_button button) override;
+	};
+}
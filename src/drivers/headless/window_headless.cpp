@@ -0,0 +1,36 @@
+#include "window_headless.hpp"
+
+using namespace rb;
+
+window_headless::window_headless()
+	: _title(settings::window_title) {
+}
+
+bool window_headless::is_open() const {
+	return settings::frame_count == 0 || _frame < settings::frame_count;
+}
+
+bool window_headless::is_minimized() const {
+	return false;
+}
+
+window_handle window_headless::native_handle() const {
+	return nullptr;
+}
+
+void window_headless::poll_events() {
+	// Every poll starts new frame, so window closes after requested frame count.
+	++_frame;
+}
+
+vec2u window_headless::size() const {
+	return settings::window_size;
+}
+
+void window_headless::set_title(const std::string& title) {
+	_title = title;
+}
+
+std::string window_headless::title() const {
+	return _title;
+}
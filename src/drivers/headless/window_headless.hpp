@@ -0,0 +1,32 @@
+#pragma once 
+
+#include <rabbit/platform/window.hpp>
+#include <rabbit/core/settings.hpp>
+
+#include <cstddef>
+
+namespace rb {
+	// Window without native counterpart, used to render offscreen on machines without display.
+	class window_headless : public window_impl {
+	public:
+		window_headless();
+
+		bool is_open() const override;
+
+		bool is_minimized() const override;
+
+		window_handle native_handle() const override;
+
+		void poll_events() override;
+
+		vec2u size() const override;
+
+		void set_title(const std::string& title) override;
+
+		std::string title() const override;
+
+	private:
+		std::string _title;
+		std::size_t _frame{ 0 };
+	};
+}
@@ -0,0 +1,7 @@
+#include "environment_null.hpp"
+
+using namespace rb;
+
+environment_null::environment_null(const environment_desc& desc)
+    : environment(desc) {
+}
@@ -0,0 +1,11 @@
+#pragma once 
+
+#include <rabbit/graphics/environment.hpp>
+
+namespace rb {
+	// Environment size only, cubemap is neither uploaded nor baked.
+	class environment_null : public environment {
+	public:
+		environment_null(const environment_desc& desc);
+	};
+}
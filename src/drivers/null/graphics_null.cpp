@@ -0,0 +1,214 @@
+#include "graphics_null.hpp"
+#include "texture_null.hpp"
+#include "environment_null.hpp"
+#include "material_null.hpp"
+#include "mesh_null.hpp"
+#include "viewport_null.hpp"
+
+#include <algorithm>
+
+using namespace rb;
+
+namespace {
+    const char* pass_names[] = {
+        "frame",
+        "depth",
+        "shadow",
+        "light",
+        "forward",
+        "fill",
+        "postprocess",
+        "immediate",
+        "present"
+    };
+}
+
+std::shared_ptr<viewport> graphics_null::make_viewport(const viewport_desc& desc) {
+    return std::make_shared<viewport_null>(desc);
+}
+
+std::shared_ptr<texture> graphics_null::make_texture(const texture_desc& desc) {
+    return std::make_shared<texture_null>(desc);
+}
+
+std::shared_ptr<environment> graphics_null::make_environment(const environment_desc& desc) {
+    return std::make_shared<environment_null>(desc);
+}
+
+std::shared_ptr<material> graphics_null::make_material(const material_desc& desc) {
+    return std::make_shared<material_null>(desc);
+}
+
+std::shared_ptr<mesh> graphics_null::make_mesh(const mesh_desc& desc) {
+    return std::make_shared<mesh_null>(desc);
+}
+
+void graphics_null::begin() {
+    std::fill(std::begin(_calls), std::end(_calls), 0);
+    _count(pass::frame);
+}
+
+void graphics_null::set_camera(const mat4f&, const mat4f&, const mat4f&, const std::shared_ptr<environment>&) {
+    _count(pass::frame);
+}
+
+void graphics_null::begin_depth_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::depth);
+}
+
+void graphics_null::draw_depth(const std::shared_ptr<viewport>&, const mat4f&, const std::shared_ptr<mesh>&, const std::shared_ptr<material>&, std::size_t) {
+    _count(pass::depth);
+}
+
+void graphics_null::end_depth_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::depth);
+}
+
+void graphics_null::begin_shadow_pass(const transform&, const light&, const directional_light&, std::size_t) {
+    _count(pass::shadow);
+}
+
+void graphics_null::draw_shadow(const mat4f&, const geometry&, std::size_t) {
+    _count(pass::shadow);
+}
+
+void graphics_null::end_shadow_pass() {
+    _count(pass::shadow);
+}
+
+void graphics_null::begin_light_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::light);
+}
+
+void graphics_null::add_point_light(const std::shared_ptr<viewport>&, const transform&, const light&, const point_light&) {
+    _count(pass::light);
+}
+
+void graphics_null::add_directional_light(const std::shared_ptr<viewport>&, const transform&, const light&, const directional_light&, bool) {
+    _count(pass::light);
+}
+
+void graphics_null::end_light_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::light);
+}
+
+void graphics_null::begin_forward_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::forward);
+}
+
+void graphics_null::draw_skybox(const std::shared_ptr<viewport>&) {
+    _count(pass::forward);
+}
+
+void graphics_null::draw_forward(const std::shared_ptr<viewport>&, const mat4f&, const std::shared_ptr<mesh>&, const std::shared_ptr<material>&, std::size_t) {
+    _count(pass::forward);
+}
+
+void graphics_null::end_forward_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::forward);
+}
+
+void graphics_null::pre_draw_ssao(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::begin_fill_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::fill);
+}
+
+void graphics_null::draw_fill(const std::shared_ptr<viewport>&, const transform&, const geometry&) {
+    _count(pass::fill);
+}
+
+void graphics_null::end_fill_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::fill);
+}
+
+void graphics_null::begin_postprocess_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::next_postprocess_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_ssao(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_fxaa(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_blur(const std::shared_ptr<viewport>&, int) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_sharpen(const std::shared_ptr<viewport>&, float) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_motion_blur(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::draw_outline(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::end_postprocess_pass(const std::shared_ptr<viewport>&) {
+    _count(pass::postprocess);
+}
+
+void graphics_null::begin_immediate_pass() {
+    _count(pass::immediate);
+}
+
+void graphics_null::draw_immediate_color(const span<const vertex>&, const color&) {
+    _count(pass::immediate);
+}
+
+void graphics_null::draw_immediate_textured(const span<const vertex>&, const std::shared_ptr<texture>&) {
+    _count(pass::immediate);
+}
+
+void graphics_null::end_immediate_pass() {
+    _count(pass::immediate);
+}
+
+void graphics_null::present(const std::shared_ptr<viewport>&) {
+    _count(pass::present);
+}
+
+void graphics_null::end() {
+    _count(pass::frame);
+
+    // Counts are kept until next frame ends, so they can be read after swap.
+    std::copy(std::begin(_calls), std::end(_calls), std::begin(_last_calls));
+}
+
+void graphics_null::swap_buffers() {
+}
+
+void graphics_null::flush() {
+}
+
+float graphics_null::frame_latency() {
+    return 0.0f;
+}
+
+std::vector<gpu_pass_timing> graphics_null::gpu_timings() {
+    return {};
+}
+
+std::vector<graphics_pass_calls> graphics_null::pass_calls() {
+    std::vector<graphics_pass_calls> pass_calls;
+    for (std::size_t index{ 0 }; index < static_cast<std::size_t>(pass::count); ++index) {
+        pass_calls.push_back({ pass_names[index], _last_calls[index] });
+    }
+    return pass_calls;
+}
+
+void graphics_null::_count(pass counted_pass) {
+    ++_calls[static_cast<std::size_t>(counted_pass)];
+}
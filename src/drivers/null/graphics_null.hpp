@@ -0,0 +1,121 @@
+#pragma once 
+
+#include <rabbit/graphics/graphics.hpp>
+
+#include <vector>
+
+namespace rb {
+	// Accepts every call without any graphics API, so CPU side of rendering can be measured on its own.
+	class graphics_null : public graphics_impl {
+	public:
+		enum class pass {
+			frame,
+			depth,
+			shadow,
+			light,
+			forward,
+			fill,
+			postprocess,
+			immediate,
+			present,
+			count
+		};
+
+		std::shared_ptr<viewport> make_viewport(const viewport_desc& desc) override;
+
+		std::shared_ptr<texture> make_texture(const texture_desc& desc) override;
+
+		std::shared_ptr<environment> make_environment(const environment_desc& desc) override;
+
+		std::shared_ptr<material> make_material(const material_desc& desc) override;
+
+		std::shared_ptr<mesh> make_mesh(const mesh_desc& desc) override;
+
+		void begin() override;
+
+		void set_camera(const mat4f& projection, const mat4f& view, const mat4f& world, const std::shared_ptr<environment>& environment) override;
+
+		void begin_depth_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) override;
+
+		void end_depth_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void begin_shadow_pass(const transform& transform, const light& light, const directional_light& directional_light, std::size_t cascade) override;
+
+		void draw_shadow(const mat4f& world, const geometry& geometry, std::size_t cascade) override;
+
+		void end_shadow_pass() override;
+
+		void begin_light_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void add_point_light(const std::shared_ptr<viewport>& viewport, const transform& transform, const light& light, const point_light& point_light) override;
+
+		void add_directional_light(const std::shared_ptr<viewport>& viewport, const transform& transform, const light& light, const directional_light& directional_light, bool use_shadow) override;
+
+		void end_light_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void begin_forward_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_skybox(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_forward(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) override;
+
+		void end_forward_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void pre_draw_ssao(const std::shared_ptr<viewport>& viewport) override;
+
+		void begin_fill_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_fill(const std::shared_ptr<viewport>& viewport, const transform& transform, const geometry& geometry) override;
+
+		void end_fill_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void begin_postprocess_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void next_postprocess_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_ssao(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_fxaa(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_blur(const std::shared_ptr<viewport>& viewport, int strength) override;
+
+		void draw_sharpen(const std::shared_ptr<viewport>& viewport, float strength) override;
+
+		void draw_motion_blur(const std::shared_ptr<viewport>& viewport) override;
+
+		void draw_outline(const std::shared_ptr<viewport>& viewport) override;
+
+		void end_postprocess_pass(const std::shared_ptr<viewport>& viewport) override;
+
+		void begin_immediate_pass() override;
+
+		void draw_immediate_color(const span<const vertex>& vertices, const color& color) override;
+
+		void draw_immediate_textured(const span<const vertex>& vertices, const std::shared_ptr<texture>& texture) override;
+
+		void end_immediate_pass() override;
+
+		void present(const std::shared_ptr<viewport>& viewport) override;
+
+		void end() override;
+
+		void swap_buffers() override;
+
+		void flush() override;
+
+		float frame_latency() override;
+
+		std::vector<gpu_pass_timing> gpu_timings() override;
+
+		std::vector<graphics_pass_calls> pass_calls() override;
+
+	private:
+		void _count(pass counted_pass);
+
+	private:
+		std::size_t _calls[static_cast<std::size_t>(pass::count)]{};
+		std::size_t _last_calls[static_cast<std::size_t>(pass::count)]{};
+	};
+}
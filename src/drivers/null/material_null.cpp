@@ -0,0 +1,7 @@
+#include "material_null.hpp"
+
+using namespace rb;
+
+material_null::material_null(const material_desc& desc)
+    : material(desc) {
+}
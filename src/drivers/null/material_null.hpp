@@ -0,0 +1,11 @@
+#pragma once 
+
+#include <rabbit/graphics/material.hpp>
+
+namespace rb {
+	// Material parameters without descriptor set.
+	class material_null : public material {
+	public:
+		material_null(const material_desc& desc);
+	};
+}
@@ -0,0 +1,7 @@
+#include "mesh_null.hpp"
+
+using namespace rb;
+
+mesh_null::mesh_null(const mesh_desc& desc)
+    : mesh(desc) {
+}
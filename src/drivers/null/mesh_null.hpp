@@ -0,0 +1,11 @@
+#pragma once 
+
+#include <rabbit/graphics/mesh.hpp>
+
+namespace rb {
+	// Mesh data stays on CPU for culling and LOD selection, nothing is uploaded.
+	class mesh_null : public mesh {
+	public:
+		mesh_null(const mesh_desc& desc);
+	};
+}
@@ -0,0 +1,7 @@
+#include "texture_null.hpp"
+
+using namespace rb;
+
+texture_null::texture_null(const texture_desc& desc)
+    : texture(desc) {
+}
@@ -0,0 +1,11 @@
+#pragma once 
+
+#include <rabbit/graphics/texture.hpp>
+
+namespace rb {
+	// Texture metadata only, pixels are dropped.
+	class texture_null : public texture {
+	public:
+		texture_null(const texture_desc& desc);
+	};
+}
@@ -0,0 +1,7 @@
+#include "viewport_null.hpp"
+
+using namespace rb;
+
+viewport_null::viewport_null(const viewport_desc& desc)
+    : viewport(desc) {
+}
@@ -0,0 +1,11 @@
+#pragma once 
+
+#include <rabbit/graphics/viewport.hpp>
+
+namespace rb {
+	// Viewport without render targets.
+	class viewport_null : public viewport {
+	public:
+		viewport_null(const viewport_desc& desc);
+	};
+}
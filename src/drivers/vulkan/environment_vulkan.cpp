@@ -6,8 +6,7 @@
 using namespace rb;
 
 environment_vulkan::environment_vulkan(VkDevice device,
-	VkQueue graphics_queue,
-	VkCommandPool command_pool,
+	transfer_vulkan& transfer,
 	VmaAllocator allocator,
     VkDescriptorSetLayout descriptor_set_layout,
 	const environment_desc& desc)
@@ -15,12 +14,14 @@ environment_vulkan::environment_vulkan(VkDevice device,
 	, _device(device)
 	, _allocator(allocator)
     , _descriptor_set_layout(descriptor_set_layout) {
-	_create_image(desc);
-	_update_image(graphics_queue, command_pool, desc);
+	_create_image(transfer, desc);
+	_update_image(transfer, desc);
 	_create_image_view(desc);
 	_create_sampler(desc);
-    _create_irradiance_image();
-    _create_prefilter_image();
+    _create_irradiance_image(transfer);
+    _update_irradiance_image(transfer, desc);
+    _create_prefilter_image(transfer);
+    _update_prefilter_image(transfer, desc);
     _create_descriptor_set();
 }
 
@@ -80,7 +81,7 @@ VkDescriptorSet environment_vulkan::descriptor_set() const {
     return _descriptor_set;
 }
 
-void environment_vulkan::_create_image(const environment_desc& desc) {
+void environment_vulkan::_create_image(transfer_vulkan& transfer, const environment_desc& desc) {
     VkImageCreateInfo image_info;
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.pNext = nullptr;
@@ -93,9 +94,9 @@ void environment_vulkan::_create_image(const environment_desc& desc) {
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.sharingMode = transfer.sharing_mode();
+    image_info.queueFamilyIndexCount = transfer.queue_family_count();
+    image_info.pQueueFamilyIndices = transfer.queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info = {};
@@ -104,90 +105,68 @@ void environment_vulkan::_create_image(const environment_desc& desc) {
         "Failed to create Vulkan image.");
 }
 
-void environment_vulkan::_update_image(VkQueue graphics_queue, VkCommandPool command_pool, const environment_desc& desc) {
-    // Create staging buffer.
-    VkBufferCreateInfo buffer_info;
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.pNext = nullptr;
-    buffer_info.flags = 0;
-    buffer_info.size = desc.size.x * desc.size.y * 4 * 6;
-    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    buffer_info.queueFamilyIndexCount = 0;
-    buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo allocation_info = {};
-    allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    VkBuffer staging_buffer;
-    VmaAllocation staging_buffer_allocation;
-
-    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &staging_buffer, &staging_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer");
-
-    // Transfer pixels into buffer.
-    void* data;
-    RB_VK(vmaMapMemory(_allocator, staging_buffer_allocation, &data), "Failed to map staging buffer memory");
-
-    std::memcpy(data, desc.data, buffer_info.size);
-
-    vmaUnmapMemory(_allocator, staging_buffer_allocation);
-
-    auto command_buffer = utils_vulkan::begin_single_time_commands(_device, command_pool);
-
-    for (std::size_t layer{ 0 }; layer < 6; ++layer) {
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = _image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = static_cast<std::uint32_t>(layer);
-        barrier.subresourceRange.layerCount = 1;
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+void environment_vulkan::_update_image(transfer_vulkan& transfer, const environment_desc& desc) {
+    _upload_cube(transfer, _image, desc.data, desc.size.x, 1);
+}
 
-        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+void environment_vulkan::_upload_cube(transfer_vulkan& transfer, VkImage image, const void* data, std::uint32_t size, std::uint32_t mip_levels) {
+    VkDeviceSize data_size{ 0 };
+    for (std::uint32_t mip_level{ 0 }; mip_level < mip_levels; ++mip_level) {
+        data_size += (size >> mip_level) * (size >> mip_level) * 4 * 6;
+    }
 
-        VkBufferImageCopy region{};
-        region.bufferOffset = desc.size.x * desc.size.y * 4 * layer;
+    // Copy pixels into staging ring before recording, because staging may submit pending uploads.
+    const auto staging = transfer.stage(data, data_size);
+
+    auto command_buffer = transfer.transfer_commands();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mip_levels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 6;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // Mip levels are stored one after another, with all faces inside level.
+    VkBufferImageCopy regions[16];
+    VkDeviceSize offset{ staging.offset };
+    for (std::uint32_t mip_level{ 0 }; mip_level < mip_levels; ++mip_level) {
+        const auto mip_size = size >> mip_level;
+
+        auto& region = regions[mip_level];
+        region.bufferOffset = offset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = static_cast<std::uint32_t>(layer);
-        region.imageSubresource.layerCount = 1;
+        region.imageSubresource.mipLevel = mip_level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 6;
         region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = { desc.size.x, desc.size.y, 1 };
-
-        vkCmdCopyBufferToImage(command_buffer, staging_buffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = _image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = static_cast<std::uint32_t>(layer);
-        barrier.subresourceRange.layerCount = 1;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        region.imageExtent = { mip_size, mip_size, 1 };
+
+        offset += mip_size * mip_size * 4 * 6;
     }
 
-    utils_vulkan::end_single_time_commands(_device, graphics_queue, command_pool, command_buffer);
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mip_levels, regions);
 
-    vmaDestroyBuffer(_allocator, staging_buffer, staging_buffer_allocation);
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = transfer.release_access(VK_ACCESS_SHADER_READ_BIT);
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        transfer.release_stage(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT), 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 void environment_vulkan::_create_image_view(const environment_desc& desc) {
@@ -234,7 +213,7 @@ void environment_vulkan::_create_sampler(const environment_desc& desc) {
     RB_VK(vkCreateSampler(_device, &sampler_info, nullptr, &_sampler), "Failed to create Vulkan sampler");
 }
 
-void environment_vulkan::_create_irradiance_image() {
+void environment_vulkan::_create_irradiance_image(transfer_vulkan& transfer) {
     VkImageCreateInfo image_info;
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.pNext = nullptr;
@@ -246,11 +225,10 @@ void environment_vulkan::_create_irradiance_image() {
     image_info.arrayLayers = 6;
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
-        | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = transfer.sharing_mode();
+    image_info.queueFamilyIndexCount = transfer.queue_family_count();
+    image_info.pQueueFamilyIndices = transfer.queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info{};
@@ -300,7 +278,11 @@ void environment_vulkan::_create_irradiance_image() {
         "Failed to create Vulkan sampler");
 }
 
-void environment_vulkan::_create_prefilter_image() {
+void environment_vulkan::_update_irradiance_image(transfer_vulkan& transfer, const environment_desc& desc) {
+    _upload_cube(transfer, _irradiance_image, desc.irradiance_data, graphics_limits::irradiance_map_size, 1);
+}
+
+void environment_vulkan::_create_prefilter_image(transfer_vulkan& transfer) {
     VkImageCreateInfo image_info;
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.pNext = nullptr;
@@ -308,15 +290,14 @@ void environment_vulkan::_create_prefilter_image() {
     image_info.imageType = VK_IMAGE_TYPE_2D;
     image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
     image_info.extent = { graphics_limits::prefilter_map_size, graphics_limits::prefilter_map_size, 1 };
-    image_info.mipLevels = 6;
+    image_info.mipLevels = graphics_limits::prefilter_map_levels;
     image_info.arrayLayers = 6;
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
-        | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = transfer.sharing_mode();
+    image_info.queueFamilyIndexCount = transfer.queue_family_count();
+    image_info.pQueueFamilyIndices = transfer.queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info{};
@@ -337,7 +318,7 @@ void environment_vulkan::_create_prefilter_image() {
     image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
     image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     image_view_info.subresourceRange.baseMipLevel = 0;
-    image_view_info.subresourceRange.levelCount = 6;
+    image_view_info.subresourceRange.levelCount = graphics_limits::prefilter_map_levels;
     image_view_info.subresourceRange.baseArrayLayer = 0;
     image_view_info.subresourceRange.layerCount = 6;
     RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &_prefilter_image_view),
@@ -359,13 +340,17 @@ void environment_vulkan::_create_prefilter_image() {
     sampler_info.compareEnable = VK_FALSE;
     sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
     sampler_info.minLod = 0.0f;
-    sampler_info.maxLod = 1.0f;
+    sampler_info.maxLod = static_cast<float>(graphics_limits::prefilter_map_levels - 1);
     sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     sampler_info.unnormalizedCoordinates = VK_FALSE;
     RB_VK(vkCreateSampler(_device, &sampler_info, nullptr, &_prefilter_sampler),
         "Failed to create Vulkan sampler");
 }
 
+void environment_vulkan::_update_prefilter_image(transfer_vulkan& transfer, const environment_desc& desc) {
+    _upload_cube(transfer, _prefilter_image, desc.prefilter_data, graphics_limits::prefilter_map_size, graphics_limits::prefilter_map_levels);
+}
+
 void environment_vulkan::_create_descriptor_set() {
     VkDescriptorPoolSize pool_sizes[1]{
         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 }
@@ -2,6 +2,8 @@
 
 #include <rabbit/graphics/environment.hpp>
 
+#include "transfer_vulkan.hpp"
+
 #include <volk.h>
 #include <vk_mem_alloc.h>
 
@@ -9,8 +11,7 @@ namespace rb {
 	class environment_vulkan : public environment {
 	public:
 		environment_vulkan(VkDevice device,
-			VkQueue graphics_queue,
-			VkCommandPool command_pool,
+			transfer_vulkan& transfer,
 			VmaAllocator allocator,
 			VkDescriptorSetLayout descriptor_set_layout,
 			const environment_desc& desc);
@@ -38,17 +39,24 @@ namespace rb {
 		VkDescriptorSet descriptor_set() const;
 
 	private:
-		void _create_image(const environment_desc& desc);
+		void _create_image(transfer_vulkan& transfer, const environment_desc& desc);
+
+		void _update_image(transfer_vulkan& transfer, const environment_desc& desc);
 
-		void _update_image(VkQueue graphics_queue, VkCommandPool command_pool, const environment_desc& desc);
+		// Uploads tightly packed mip levels of all 6 faces and releases image to graphics queue.
+		void _upload_cube(transfer_vulkan& transfer, VkImage image, const void* data, std::uint32_t size, std::uint32_t mip_levels);
 
 		void _create_image_view(const environment_desc& desc);
 
 		void _create_sampler(const environment_desc& desc);
 
-		void _create_irradiance_image();
+		void _create_irradiance_image(transfer_vulkan& transfer);
+
+		void _update_irradiance_image(transfer_vulkan& transfer, const environment_desc& desc);
+
+		void _create_prefilter_image(transfer_vulkan& transfer);
 
-		void _create_prefilter_image();
+		void _update_prefilter_image(transfer_vulkan& transfer, const environment_desc& desc);
 
 		void _create_descriptor_set();
 
@@ -7,10 +7,24 @@
 #include "shaders_vulkan.hpp"
 #include "utils_vulkan.hpp"
 
+#include <rabbit/collision/plane.hpp>
+#include <rabbit/core/settings.hpp>
+#include <rabbit/core/profiler.hpp>
+#include <rabbit/core/format.hpp>
+#include <rabbit/graphics/image.hpp>
+#include <rabbit/platform/input.hpp>
+
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
 #include <random>
+#include <thread>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
 
 using namespace rb;
 
@@ -33,44 +47,217 @@ namespace {
         std::fprintf(stderr, "%s\n", pCallbackData->pMessage);
         return VK_FALSE;
     }
+
+    // Material flags affecting forward pipeline state other than specialization constants.
+    constexpr std::uint64_t forward_fixed_function_bits{
+        material_flags::translucent_bit | material_flags::double_sided_bit | material_flags::wireframe_bit
+    };
+
+    // Draws are batched by pipeline state, shadow passes draw without material.
+    std::uint64_t material_sort_flags(const material* material) {
+        return material ? static_cast<std::uint64_t>(material->flags()) : 0;
+    }
+
+    std::uint32_t material_index(const material* material) {
+        return material ? static_cast<const material_vulkan*>(material)->index() : material_arena_vulkan::default_material;
+    }
+
+    // Materials are bindless: one texture array indexed per fragment and filled while bound.
+    bool supports_descriptor_indexing(VkPhysicalDevice physical_device) {
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features{};
+        descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+        VkPhysicalDeviceFeatures2 supported_features{};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext = &descriptor_indexing_features;
+        vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+        return descriptor_indexing_features.runtimeDescriptorArray &&
+            descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing &&
+            descriptor_indexing_features.descriptorBindingPartiallyBound &&
+            descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind;
+    }
+
+    // Changing sample count invalidates cached BRDF lookup table.
+    constexpr std::uint32_t brdf_sample_count{ 1024 };
+
+    // GPU timings are keyed by pass name, so every cascade needs its own stable name.
+    const char* shadow_pass_names[graphics_limits::max_shadow_cascades] = {
+        "shadow cascade 0",
+        "shadow cascade 1",
+        "shadow cascade 2",
+        "shadow cascade 3"
+    };
+
+    // 64-bit FNV-1a, used to detect changes of static shadow casters.
+    std::uint64_t hash_bytes(std::uint64_t hash, const void* data, std::size_t size) {
+        const auto bytes = static_cast<const std::uint8_t*>(data);
+        for (std::size_t i{ 0 }; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211llu;
+        }
+        return hash;
+    }
+
+    float radical_inverse(std::uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return static_cast<float>(bits) * 2.3283064365386963e-10f;
+    }
+
+    // Split sum scale and bias of environment specular, NdotV along x and roughness along y.
+    vec2f integrate_brdf(float n_dot_v, float roughness) {
+        const vec3f v{ std::sqrt(1.0f - n_dot_v * n_dot_v), 0.0f, n_dot_v };
+        const auto a = roughness * roughness;
+        const auto k = a / 2.0f;
+        const auto g_v = n_dot_v / (n_dot_v * (1.0f - k) + k);
+
+        vec2f result{ 0.0f, 0.0f };
+        for (std::uint32_t index{ 0 }; index < brdf_sample_count; ++index) {
+            const auto phi = 2.0f * pi<float>() * index / brdf_sample_count;
+            const auto xi = radical_inverse(index);
+            const auto cos_theta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+            const auto sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+            const vec3f h{ std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta };
+            const auto v_dot_h = dot(v, h);
+            const auto n_dot_l = 2.0f * v_dot_h * h.z - v.z;
+
+            if (n_dot_l > 0.0f) {
+                const auto g_l = n_dot_l / (n_dot_l * (1.0f - k) + k);
+                const auto g_vis = (g_v * g_l * std::max(v_dot_h, 0.0f)) / (h.z * n_dot_v);
+                const auto fc = std::pow(1.0f - std::max(v_dot_h, 0.0f), 5.0f);
+
+                result.x += (1.0f - fc) * g_vis;
+                result.y += fc * g_vis;
+            }
+        }
+
+        return { result.x / brdf_sample_count, result.y / brdf_sample_count };
+    }
+
+    // Lookup table depends on nothing but constants, so it is integrated once and cached on disk.
+    std::vector<std::uint8_t> load_brdf_lut() {
+        RB_PROFILE_ZONE("load brdf lut");
+
+        const auto size = graphics_limits::brdf_map_size;
+        const std::uint32_t header[2]{ static_cast<std::uint32_t>(size), brdf_sample_count };
+        const auto path = std::filesystem::path{ settings::cache_directory } / "brdf_lut.bin";
+
+        std::vector<std::uint8_t> pixels(size * size * 2);
+        if (std::ifstream stream{ path, std::ios::binary }) {
+            std::uint32_t cached_header[2]{ 0, 0 };
+            stream.read(reinterpret_cast<char*>(cached_header), sizeof(cached_header));
+            stream.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+
+            if (stream && std::memcmp(header, cached_header, sizeof(header)) == 0) {
+                return pixels;
+            }
+        }
+
+        const auto worker_count = std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<std::future<void>> jobs;
+        for (std::size_t worker{ 0 }; worker < worker_count; ++worker) {
+            jobs.push_back(std::async(std::launch::async, [&pixels, size, worker, worker_count]() {
+                for (auto y = worker; y < size; y += worker_count) {
+                    for (std::size_t x{ 0 }; x < size; ++x) {
+                        const auto value = integrate_brdf((x + 0.5f) / size, (y + 0.5f) / size);
+                        pixels[(y * size + x) * 2 + 0] = static_cast<std::uint8_t>(std::clamp(value.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+                        pixels[(y * size + x) * 2 + 1] = static_cast<std::uint8_t>(std::clamp(value.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+                    }
+                }
+            }));
+        }
+
+        for (auto& job : jobs) {
+            job.get();
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(settings::cache_directory, error);
+
+        // Write to temporary file first, so crash during write never leaves truncated table behind.
+        const auto temporary_path = std::filesystem::path{ path }.concat(".tmp");
+        if (std::ofstream stream{ temporary_path, std::ios::binary | std::ios::trunc }) {
+            stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+            stream.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+            if (!stream) {
+                return pixels;
+            }
+        } else {
+            return pixels;
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+        return pixels;
+    }
 }
 
 
 graphics_vulkan::graphics_vulkan() {
+    RB_PROFILE_ZONE("graphics_vulkan::graphics_vulkan");
+
+    // Lookup table does not need device, so it is loaded or integrated while device is created.
+    auto brdf_job = std::async(std::launch::async, &load_brdf_lut);
+
     _initialize_volk();
     _create_instance();
     _choose_physical_device();
     _create_surface();
     _create_device();
     _create_allocator();
+    _create_transfer();
+    _create_pipeline_cache();
     _query_surface();
-    _create_swapchain();
+    if (settings::headless) {
+        _create_offscreen_images();
+    } else {
+        _create_swapchain();
+    }
+    _create_framebuffers();
     _create_command_pool();
+    _create_mesh_arena();
     _create_synchronization_objects();
+    _create_timestamp_queries();
+    _create_readback();
     _create_quad();
-    _generate_brdf_image();
+    _create_brdf_image(brdf_job.get());
     _create_skybox();
-    _create_irradiance_pipeline();
-    _create_prefilter_pipeline();
+    _create_instancing();
     _create_shadow_map();
+    _create_shadow_cache();
     _create_camera();
     _create_main();
     _create_material();
     _create_environment();
     _create_depth();
     _create_light();
+    _create_instance_culling();
     _create_forward();
     _create_postprocess();
     //_create_ssao_pipeline();
-    _create_fxaa_pipeline();
-    _create_blur_pipeline();
-    _create_sharpen_pipeline();
-    _create_motion_blur_pipeline();
-    _create_fill_pipeline();
-    _create_outline_pipeline();
-    _create_skybox_pipeline();
-    _create_present_pipeline();
+
+    // Pipelines below only read layouts and render passes created above and write their own handles,
+    // so they are compiled on workers. Pipeline cache is synchronized by driver.
+    std::future<void> pipeline_jobs[]{
+        std::async(std::launch::async, [this]() { _create_fxaa_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_blur_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_sharpen_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_motion_blur_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_fill_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_outline_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_skybox_pipeline(); }),
+        std::async(std::launch::async, [this]() { _create_present_pipeline(); })
+    };
+
     _create_command_buffers();
+
+    for (auto& job : pipeline_jobs) {
+        job.get();
+    }
 }
 
 graphics_vulkan::~graphics_vulkan() {
@@ -78,6 +265,17 @@ graphics_vulkan::~graphics_vulkan() {
     vkQueueWaitIdle(_present_queue);
     vkDeviceWaitIdle(_device);
 
+    // Run deferred destruction of finished uploads and bakes.
+    _transfer->collect();
+
+    // Pipelines still created by workers reference layout and render pass destroyed below.
+    for (auto& [flags, job] : _forward_pipeline_jobs) {
+        vkDestroyPipeline(_device, job.get(), nullptr);
+    }
+    for (const auto& [flags, pipeline] : _forward_fallback_pipelines) {
+        vkDestroyPipeline(_device, pipeline, nullptr);
+    }
+
     vkDestroyPipeline(_device, _forward_copy_pipeline, nullptr);
     vkDestroyPipelineLayout(_device, _forward_copy_pipeline_layout, nullptr);
     vkDestroyPipeline(_device, _light_copy_pipeline, nullptr);
@@ -131,12 +329,15 @@ graphics_vulkan::~graphics_vulkan() {
     for (const auto& [flags, pipeline] : _forward_pipelines) {
         vkDestroyPipeline(_device, pipeline, nullptr);
     }
-    for (const auto& [flags, pipeline_layout] : _forward_pipeline_layouts) {
-        vkDestroyPipelineLayout(_device, pipeline_layout, nullptr);
-    }
+    vkDestroyPipelineLayout(_device, _forward_pipeline_layout, nullptr);
+    vkDestroyShaderModule(_device, _forward_shader_modules[1], nullptr);
+    vkDestroyShaderModule(_device, _forward_shader_modules[0], nullptr);
     vkDestroyDescriptorSetLayout(_device, _forward_descriptor_set_layout, nullptr);
     vkDestroyRenderPass(_device, _forward_render_pass, nullptr);
 
+    vkDestroyPipelineLayout(_device, _cull_pipeline_layout, nullptr);
+    vkDestroyPipeline(_device, _cull_pipeline, nullptr);
+
     vkDestroyDescriptorSetLayout(_device, _light_descriptor_set_layout, nullptr);
     vkDestroyPipelineLayout(_device, _light_pipeline_layout, nullptr);
     vkDestroyPipeline(_device, _light_pipeline, nullptr);
@@ -148,12 +349,23 @@ graphics_vulkan::~graphics_vulkan() {
 
     vkDestroyDescriptorSetLayout(_device, _environment_descriptor_set_layout, nullptr);
 
-    vkDestroyDescriptorSetLayout(_device, _material_descriptor_set_layout, nullptr);
+    _default_texture.reset();
 
     vkDestroyDescriptorSetLayout(_device, _main_descriptor_set_layout, nullptr);
     vkDestroyDescriptorPool(_device, _main_descriptor_pool, nullptr);
 
-    vmaDestroyBuffer(_allocator, _camera_buffer, _camera_allocation);
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        vmaUnmapMemory(_allocator, _camera_allocations[i]);
+        vmaDestroyBuffer(_allocator, _camera_buffers[i], _camera_allocations[i]);
+    }
+
+    for (auto i = 0u; i < cached_shadow_cascades; ++i) {
+        vkDestroyFramebuffer(_device, _shadow_cache_framebuffers[i], nullptr);
+        vkDestroyImageView(_device, _shadow_cache_image_views[i], nullptr);
+    }
+    vkDestroyRenderPass(_device, _shadow_composite_render_pass, nullptr);
+    vkDestroyRenderPass(_device, _shadow_cache_render_pass, nullptr);
+    vmaDestroyImage(_allocator, _shadow_cache_image, _shadow_cache_allocation);
 
     vkDestroyPipeline(_device, _shadow_pipeline, nullptr);
     vkDestroyShaderModule(_device, _shadow_shader_module, nullptr);
@@ -169,21 +381,15 @@ graphics_vulkan::~graphics_vulkan() {
     }
     vmaDestroyImage(_allocator, _shadow_image, _shadow_allocation);
 
-    vkDestroyPipeline(_device, _prefilter_pipeline, nullptr);
-    vkDestroyRenderPass(_device, _prefilter_render_pass, nullptr);
-    vkDestroyShaderModule(_device, _prefilter_shader_modules[1], nullptr);
-    vkDestroyShaderModule(_device, _prefilter_shader_modules[0], nullptr);
-    vkDestroyPipelineLayout(_device, _prefilter_pipeline_layout, nullptr);
-    vkDestroyDescriptorSetLayout(_device, _prefilter_descriptor_set_layout, nullptr);
-    vkDestroyDescriptorPool(_device, _prefilter_descriptor_pool, nullptr);
-
-    vkDestroyPipeline(_device, _irradiance_pipeline, nullptr);
-    vkDestroyRenderPass(_device, _irradiance_render_pass, nullptr);
-    vkDestroyShaderModule(_device, _irradiance_shader_modules[1], nullptr);
-    vkDestroyShaderModule(_device, _irradiance_shader_modules[0], nullptr);
-    vkDestroyPipelineLayout(_device, _irradiance_pipeline_layout, nullptr);
-    vkDestroyDescriptorSetLayout(_device, _irradiance_descriptor_set_layout, nullptr);
-    vkDestroyDescriptorPool(_device, _irradiance_descriptor_pool, nullptr);
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        vmaUnmapMemory(_allocator, _draw_command_allocations[i]);
+        vmaDestroyBuffer(_allocator, _draw_command_buffers[i], _draw_command_allocations[i]);
+        vmaDestroyBuffer(_allocator, _visible_instance_buffers[i], _visible_instance_allocations[i]);
+        vmaUnmapMemory(_allocator, _instance_allocations[i]);
+        vmaDestroyBuffer(_allocator, _instance_buffers[i], _instance_allocations[i]);
+    }
+    vkDestroyDescriptorPool(_device, _instance_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _instance_descriptor_set_layout, nullptr);
 
     vmaDestroyBuffer(_allocator, _skybox_vertex_buffer, _skybox_vertex_allocation);
     vmaDestroyBuffer(_allocator, _skybox_index_buffer, _skybox_index_allocation);
@@ -195,8 +401,26 @@ graphics_vulkan::~graphics_vulkan() {
     vmaDestroyBuffer(_allocator, _quad_vertex_buffer, _quad_vertex_allocation);
     vmaDestroyBuffer(_allocator, _quad_index_buffer, _quad_index_allocation);
 
-    vkDestroySemaphore(_device, _present_semaphore, nullptr);
-    vkDestroySemaphore(_device, _render_semaphore, nullptr);
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        if (_readback_buffers[i]) {
+            vmaUnmapMemory(_allocator, _readback_allocations[i]);
+            vmaDestroyBuffer(_allocator, _readback_buffers[i], _readback_allocations[i]);
+        }
+    }
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        vkDestroyQueryPool(_device, _timestamp_query_pools[i], nullptr);
+    }
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        vkDestroySemaphore(_device, _render_finished_semaphores[i], nullptr);
+        vkDestroySemaphore(_device, _image_available_semaphores[i], nullptr);
+    }
+
+    _material_arena.reset();
+    _mesh_arena.reset();
+    _transfer.reset();
+
     vkDestroyCommandPool(_device, _command_pool, nullptr);
     vkDestroyRenderPass(_device, _render_pass, nullptr);
 
@@ -208,14 +432,25 @@ graphics_vulkan::~graphics_vulkan() {
         vkDestroyImageView(_device, image_view, nullptr);
     }
 
+    for (std::size_t index{ 0 }; index < _image_allocations.size(); ++index) {
+        vmaDestroyImage(_allocator, _images[index], _image_allocations[index]);
+    }
+
     vkDestroyImageView(_device, _depth_image_view, nullptr);
     vmaDestroyImage(_allocator, _depth_image, _depth_image_allocation);
 
-    vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+    if (!settings::headless) {
+        vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+    }
+
+    _save_pipeline_cache();
+    vkDestroyPipelineCache(_device, _pipeline_cache, nullptr);
 
     vmaDestroyAllocator(_allocator);
     vkDestroyDevice(_device, nullptr);
-    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    if (!settings::headless) {
+        vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    }
     vkDestroyInstance(_instance, nullptr);
 }
 
@@ -236,32 +471,52 @@ std::shared_ptr<rb::viewport> graphics_vulkan::make_viewport(const viewport_desc
 }
 
 std::shared_ptr<texture> graphics_vulkan::make_texture(const texture_desc& desc) {
-    return std::make_shared<texture_vulkan>(_device, _physical_device_properties, _graphics_queue, _command_pool, _allocator, desc);
+    return std::make_shared<texture_vulkan>(_device, _physical_device_properties, *_transfer, _allocator, desc);
 }
 
 std::shared_ptr<environment> graphics_vulkan::make_environment(const environment_desc& desc) {
-    const auto environment = std::make_shared<environment_vulkan>(_device, _graphics_queue, _command_pool, _allocator, _environment_descriptor_set_layout, desc);
-    _bake_irradiance(environment);
-    _bake_prefilter(environment);
-    return environment;
+    return std::make_shared<environment_vulkan>(_device, *_transfer, _allocator, _environment_descriptor_set_layout, desc);
 }
 
 std::shared_ptr<material> graphics_vulkan::make_material(const material_desc& desc) {
-	return std::make_shared<material_vulkan>(_device, _allocator, desc);
+	const auto material = std::make_shared<material_vulkan>(_material_arena, _default_texture, desc);
+	_prewarm_forward_pipelines(static_cast<std::uint64_t>(material->flags()));
+	return material;
 }
 
 std::shared_ptr<mesh> graphics_vulkan::make_mesh(const mesh_desc& desc) {
-    return std::make_shared<mesh_vulkan>(_device, _allocator, desc);
+    return std::make_shared<mesh_vulkan>(_mesh_arena, desc);
 }
 
 void graphics_vulkan::begin() {
+    RB_PROFILE_ZONE("graphics_vulkan::begin");
+
     _command_begin();
+
+    // Acquire as late as possible, but before recording, so frame waits only for its own image.
+    _acquire_next_image();
+
+    // Latency is measured from input sampled for this frame until its fence is observed signaled.
+    _frame_input_times[_command_index] = input::refresh_time();
+
+    // Timestamps of this slot were written max_command_buffers frames ago, so reading them never stalls.
+    _read_timestamp_queries();
+    _begin_gpu_pass("frame");
+
+    // Release staging memory and resources of finished uploads.
+    _transfer->collect();
+
+    // Fence of current command buffer is signaled, so GPU no longer reads its instance buffers.
+    _instance_count = 0;
+    _visible_instance_count = 0;
+    _draw_command_count = 0;
+    _dropped_instance_draws = 0;
+    ++_instance_batch_frame;
 }
 
 void graphics_vulkan::set_camera(const mat4f& projection, const mat4f& view, const mat4f& world, const std::shared_ptr<environment>& environment) {
     _environment = std::static_pointer_cast<environment_vulkan>(environment);
 
-    const auto aspect = static_cast<float>(_swapchain_extent.width) / _swapchain_extent.height;
     if (_camera_data.last_proj_view != mat4f::identity()) {
         _camera_data.last_proj_view = _camera_data.projection * _camera_data.view;
     }
@@ -273,60 +528,250 @@ void graphics_vulkan::set_camera(const mat4f& projection, const mat4f& view, con
     _camera_data.inv_proj_view = invert(_camera_data.projection * _camera_data.view);
     _camera_data.camera_position = { world[12], world[13], world[14] };
 
-    vkCmdUpdateBuffer(_command_buffers[_command_index], _camera_buffer, 0, sizeof(camera_data), &_camera_data);
+    // Culling shader selects lods using the same clip distances as renderer.
+    _camera_z_near = projection[14] / (projection[10] - 1.0f);
+    _camera_z_far = projection[14] / (projection[10] + 1.0f);
 }
 
 void graphics_vulkan::begin_depth_pass(const std::shared_ptr<viewport>& viewport) {
-    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
+    // Render pass begins in end_depth_pass, once culling dispatch is recorded.
+}
+
+void graphics_vulkan::draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) {
+    // Lod is selected by culling shader, using the same distance metric as renderer.
+    // Material is recorded, so clusters culled by normal cone are the same as in forward pass.
+    _instance_draws.push_back({ mesh.get(), material.get(), 0, world });
+}
+
+void graphics_vulkan::end_depth_pass(const std::shared_ptr<viewport>& viewport) {
+    RB_PROFILE_ZONE("graphics_vulkan::end_depth_pass");
+
+    _begin_gpu_pass("depth");
 
+    _cull_instance_draws(_camera_data.projection * _camera_data.view, false, _indirect_batches);
+
+    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
     native_viewport->begin_depth_pass(_command_buffers[_command_index]);
 
     VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set
+        _main_descriptor_sets[_command_index],
+        _instance_descriptor_sets[_command_index]
     };
 
     vkCmdBindDescriptorSets(_command_buffers[_command_index],
-        VK_PIPELINE_BIND_POINT_GRAPHICS, _depth_pipeline_layout, 0, 1, descriptor_sets,
+        VK_PIPELINE_BIND_POINT_GRAPHICS, _depth_pipeline_layout, 0, 2, descriptor_sets,
         0, nullptr);
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _depth_pipeline);
-}
-
-void graphics_vulkan::draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, std::size_t mesh_lod_index) {
-    const auto native_mesh = std::static_pointer_cast<mesh_vulkan>(mesh);
-
-    VkDeviceSize offset{ 0 };
-    VkBuffer buffer{ native_mesh->vertex_buffer() };
-    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &buffer, &offset);
-    vkCmdBindIndexBuffer(_command_buffers[_command_index], native_mesh->index_buffer(), 0, VK_INDEX_TYPE_UINT32);
 
-    vkCmdPushConstants(_command_buffers[_command_index], _depth_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4f), &world);
-    
-    const auto& lod = native_mesh->lods()[mesh_lod_index];
-    vkCmdDrawIndexed(_command_buffers[_command_index], lod.size, 1, lod.offset, 0, 0);
-}
+    _draw_depth_batches(_indirect_batches);
 
-void graphics_vulkan::end_depth_pass(const std::shared_ptr<viewport>& viewport) {
-    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
     native_viewport->end_depth_pass(_command_buffers[_command_index]);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::begin_shadow_pass(const transform& transform, const light& light, const directional_light& directional_light, std::size_t cascade) {
-    const auto factor = static_cast<float>(1 << cascade);
+    // Splits blend logarithmic and uniform distribution, so nearest cascades get most of resolution.
+    const auto shadow_near = _camera_z_near;
+    const auto shadow_far = std::max(std::min(_camera_z_far, max_shadow_distance), shadow_near * 2.0f);
+    const auto split = [&](std::size_t index) {
+        const auto ratio = static_cast<float>(index) / graphics_limits::max_shadow_cascades;
+        const auto log_split = shadow_near * std::pow(shadow_far / shadow_near, ratio);
+        const auto uniform_split = shadow_near + (shadow_far - shadow_near) * ratio;
+        return shadow_split_lambda * log_split + (1.0f - shadow_split_lambda) * uniform_split;
+    };
+
+    const auto split_near = split(cascade);
+    const auto split_far = split(cascade + 1);
+
+    // Bounding sphere of camera frustum slice. Its size does not depend on camera rotation, so cascade texels stay stable.
+    const auto inv_view = invert(_camera_data.view);
+    const auto tan_x = 1.0f / _camera_data.projection[0];
+    const auto tan_y = 1.0f / _camera_data.projection[5];
+
+    vec3f corners[8];
+    vec3f center{ vec3f::zero() };
+    for (auto i = 0u; i < 8u; ++i) {
+        const auto depth = (i & 4) ? split_far : split_near;
+        const auto x = (i & 1) ? tan_x * depth : -tan_x * depth;
+        const auto y = (i & 2) ? tan_y * depth : -tan_y * depth;
+        corners[i] = inv_view * vec3f{ x, y, -depth };
+        center = center + corners[i] / 8.0f;
+    }
+
+    auto radius = 0.0f;
+    for (const auto& corner : corners) {
+        radius = std::max(radius, length(corner - center));
+    }
 
     const auto dir = normalize(transform_normal(mat4f::rotation(transform.rotation), vec3f::z_axis()));
-    const auto depth_projection = mat4f::orthographic(-10.0f * factor, 10.0f * factor, -10.0f * factor, 10.0f * factor, -20.0f * factor, 20.0f * factor);
-    const auto depth_view = mat4f::look_at(_camera_data.camera_position - dir * 10.0f * factor, _camera_data.camera_position, vec3f::up());
+    const auto up = std::abs(dot(dir, vec3f::up())) > 0.99f ? vec3f::z_axis() : vec3f::up();
+
+    // Render pass begins in end_shadow_pass, once culling dispatch is recorded.
+    _shadow_cascade = cascade;
+    _static_shadow_hash = 14695981039346656037llu;
+
+    // Cached cascade keeps its placement while frustum slice stays inside and light barely rotates.
+    shadow_cache* cache{ nullptr };
+    if (cascade >= first_cached_shadow_cascade) {
+        cache = &_shadow_caches[cascade - first_cached_shadow_cascade];
+        if (cache->valid && dot(dir, cache->direction) >= shadow_cache_min_direction_dot && length(center - cache->center) + radius <= cache->radius) {
+            _camera_data.light_proj_view[cascade] = cache->proj_view;
+            for (auto i = 0u; i < 6u; ++i) {
+                _shadow_planes[i] = frustum_plane(cache->proj_view, static_cast<frustum_plane_index>(i));
+            }
+            return;
+        }
+
+        radius *= shadow_cache_margin;
+    }
+
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    // Eye is moved back towards the light, so casters outside of cascade sphere still land in depth range.
+    // Vulkan clips normalized depth below zero, so symmetric range maps [0, depth_range] in front of eye.
+    const auto depth_range = radius * 2.0f + shadow_caster_distance;
+    const auto depth_view = mat4f::look_at(center - dir * (radius + shadow_caster_distance), center, up);
+    auto depth_projection = mat4f::orthographic(-radius, radius, -radius, radius, -depth_range, depth_range);
+
+    // Snap cascade origin to whole texels, so shadow edges do not shimmer when camera moves.
+    const auto half_size = graphics_limits::shadow_map_size / 2.0f;
+    const auto origin = (depth_projection * depth_view) * vec3f::zero();
+    depth_projection[12] += (std::round(origin.x * half_size) - origin.x * half_size) / half_size;
+    depth_projection[13] += (std::round(origin.y * half_size) - origin.y * half_size) / half_size;
+
     _camera_data.light_proj_view[cascade] = depth_projection * depth_view;
 
+    for (auto i = 0u; i < 6u; ++i) {
+        _shadow_planes[i] = frustum_plane(_camera_data.light_proj_view[cascade], static_cast<frustum_plane_index>(i));
+    }
+
+    // Moved cascade has to render its static casters again.
+    if (cache) {
+        cache->proj_view = _camera_data.light_proj_view[cascade];
+        cache->center = center;
+        cache->radius = radius;
+        cache->direction = dir;
+        cache->valid = false;
+    }
+}
+
+void graphics_vulkan::draw_shadow(const mat4f& world, const geometry& geometry, std::size_t cascade) {
+    // Casters outside of cascade volume are rejected before they take instance slots.
+    const auto& bsphere = geometry.mesh->bsphere();
+    const auto position = world * bsphere.position;
+    const auto scale = std::max({
+        length(vec3f{ world[0], world[1], world[2] }),
+        length(vec3f{ world[4], world[5], world[6] }),
+        length(vec3f{ world[8], world[9], world[10] })
+    });
+
+    for (const auto& plane : _shadow_planes) {
+        if (dot(plane.normal, position) + plane.d < -bsphere.radius * scale) {
+            return;
+        }
+    }
+
+    const auto lod_index = static_cast<std::uint32_t>(geometry.mesh->lods().size() - 1);
+
+    // Static casters of cached cascade are only hashed, they are drawn again when hash changes.
+    if (geometry.is_static && cascade >= first_cached_shadow_cascade) {
+        const auto mesh = geometry.mesh.get();
+        _static_shadow_hash = hash_bytes(_static_shadow_hash, &mesh, sizeof(mesh));
+        _static_shadow_hash = hash_bytes(_static_shadow_hash, &world, sizeof(world));
+        _static_shadow_draws.push_back({ mesh, nullptr, lod_index, world });
+        return;
+    }
+
+    _instance_draws.push_back({ geometry.mesh.get(), nullptr, lod_index, world });
+}
+
+void graphics_vulkan::end_shadow_pass() {
+    _begin_gpu_pass(shadow_pass_names[_shadow_cascade]);
+
+    if (_shadow_cascade >= first_cached_shadow_cascade) {
+        _end_cached_shadow_pass();
+    } else {
+        // Shadows always use last lod, so culling shader does not need to select one.
+        _cull_instance_draws(_camera_data.light_proj_view[_shadow_cascade], true, _indirect_batches);
+        _draw_shadow_batches(_shadow_render_pass, _shadow_framebuffers[_shadow_cascade], _indirect_batches);
+    }
+
+    _end_gpu_pass();
+}
+
+void graphics_vulkan::_end_cached_shadow_pass() {
+    const auto cache_index = _shadow_cascade - first_cached_shadow_cascade;
+    auto& cache = _shadow_caches[cache_index];
+    const auto& proj_view = _camera_data.light_proj_view[_shadow_cascade];
+
+    // Both culling dispatches are recorded before any render pass begins.
+    const auto rebuild = !cache.valid || cache.static_hash != _static_shadow_hash;
+    if (rebuild) {
+        std::swap(_instance_draws, _static_shadow_draws);
+        _cull_instance_draws(proj_view, true, _static_shadow_batches);
+        std::swap(_instance_draws, _static_shadow_draws);
+    }
+    _static_shadow_draws.clear();
+
+    _cull_instance_draws(proj_view, true, _indirect_batches);
+
+    if (rebuild) {
+        _draw_shadow_batches(_shadow_cache_render_pass, _shadow_cache_framebuffers[cache_index], _static_shadow_batches);
+        cache.static_hash = _static_shadow_hash;
+        cache.valid = true;
+    }
+
+    // Previous frame may still sample cascade, its content is replaced by copy of cached depth.
+    VkImageMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _shadow_image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = static_cast<std::uint32_t>(_shadow_cascade);
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(_command_buffers[_command_index],
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageCopy region;
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = static_cast<std::uint32_t>(cache_index);
+    region.srcSubresource.layerCount = 1;
+    region.srcOffset = { 0, 0, 0 };
+    region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.dstSubresource.mipLevel = 0;
+    region.dstSubresource.baseArrayLayer = static_cast<std::uint32_t>(_shadow_cascade);
+    region.dstSubresource.layerCount = 1;
+    region.dstOffset = { 0, 0, 0 };
+    region.extent = { graphics_limits::shadow_map_size, graphics_limits::shadow_map_size, 1 };
+    vkCmdCopyImage(_command_buffers[_command_index],
+        _shadow_cache_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        _shadow_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region);
+
+    _draw_shadow_batches(_shadow_composite_render_pass, _shadow_framebuffers[_shadow_cascade], _indirect_batches);
+}
+
+void graphics_vulkan::_draw_shadow_batches(VkRenderPass render_pass, VkFramebuffer framebuffer, const std::vector<indirect_batch>& batches) {
     VkClearValue clear_values[1];
     clear_values[0].depthStencil = { 1.0f, 0 };
 
     VkRenderPassBeginInfo render_pass_begin_info;
     render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_begin_info.pNext = nullptr;
-    render_pass_begin_info.renderPass = _shadow_render_pass;
-    render_pass_begin_info.framebuffer = _shadow_framebuffers[cascade];
+    render_pass_begin_info.renderPass = render_pass;
+    render_pass_begin_info.framebuffer = framebuffer;
     render_pass_begin_info.renderArea.offset = { 0, 0 };
     render_pass_begin_info.renderArea.extent = { graphics_limits::shadow_map_size, graphics_limits::shadow_map_size };
     render_pass_begin_info.clearValueCount = sizeof(clear_values) / sizeof(*clear_values);
@@ -334,32 +779,23 @@ void graphics_vulkan::begin_shadow_pass(const transform& transform, const light&
 
     vkCmdBeginRenderPass(_command_buffers[_command_index], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _shadow_pipeline);
-}
-
-void graphics_vulkan::draw_shadow(const mat4f& world, const geometry& geometry, std::size_t cascade) {
-    const auto native_material = std::static_pointer_cast<material_vulkan>(geometry.material);
-    const auto native_mesh = std::static_pointer_cast<mesh_vulkan>(geometry.mesh);
 
-    VkDeviceSize offset{ 0 };
-    VkBuffer buffer{ native_mesh->vertex_buffer() };
-    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &buffer, &offset);
-    vkCmdBindIndexBuffer(_command_buffers[_command_index], native_mesh->index_buffer(), 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindDescriptorSets(_command_buffers[_command_index],
+        VK_PIPELINE_BIND_POINT_GRAPHICS, _shadow_pipeline_layout, 0, 1, &_instance_descriptor_sets[_command_index],
+        0, nullptr);
 
     shadow_data shadow_data;
-    shadow_data.proj_view_world = _camera_data.light_proj_view[cascade] * world;
+    shadow_data.proj_view = _camera_data.light_proj_view[_shadow_cascade];
     vkCmdPushConstants(_command_buffers[_command_index], _shadow_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(shadow_data), &shadow_data);
 
-    const auto& lod = native_mesh->lods().back();
-    vkCmdDrawIndexed(_command_buffers[_command_index], lod.size, 1, lod.offset, 0, 0);
-}
+    _draw_depth_batches(batches);
 
-void graphics_vulkan::end_shadow_pass() {
     vkCmdEndRenderPass(_command_buffers[_command_index]);
 }
 
 void graphics_vulkan::begin_light_pass(const std::shared_ptr<viewport>& viewport) {
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
-    native_viewport->begin_light_pass(_command_buffers[_command_index]);
+    native_viewport->begin_light_pass(_command_buffers[_command_index], _command_index);
 }
 
 void graphics_vulkan::add_point_light(const std::shared_ptr<viewport>& viewport, const transform& transform, const light& light, const point_light& point_light) {
@@ -378,130 +814,113 @@ void graphics_vulkan::add_directional_light(const std::shared_ptr<viewport>& vie
 
 void graphics_vulkan::end_light_pass(const std::shared_ptr<viewport>& viewport) {
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
-    native_viewport->end_light_pass(_command_buffers[_command_index]);
+    native_viewport->end_light_pass(_command_buffers[_command_index], _camera_z_near, _camera_z_far);
+
+    _begin_gpu_pass("light culling");
+
+    // Previous frame forward pass have to finish reading clusters before they are rebuilt.
+    VkBufferMemoryBarrier barriers[2];
+    barriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barriers[0].pNext = nullptr;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[0].srcQueueFamilyIndex = _graphics_family;
+    barriers[0].dstQueueFamilyIndex = _graphics_family;
+    barriers[0].buffer = native_viewport->light_index_buffer();
+    barriers[0].offset = 0;
+    barriers[0].size = VK_WHOLE_SIZE;
+
+    barriers[1] = barriers[0];
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].buffer = native_viewport->light_cluster_buffer();
+
+    vkCmdPipelineBarrier(_command_buffers[_command_index],
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 2, barriers, 0, nullptr);
+
+    // Reset counter of light index list.
+    vkCmdFillBuffer(_command_buffers[_command_index], native_viewport->light_index_buffer(), 0, sizeof(std::uint32_t), 0);
+
+    barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[0].size = sizeof(std::uint32_t);
+    vkCmdPipelineBarrier(_command_buffers[_command_index],
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 1, barriers, 0, nullptr);
 
     VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set,
-        native_viewport->depth_descriptor_set(),
+        _main_descriptor_sets[_command_index],
         native_viewport->light_descriptor_set()
     };
 
     vkCmdBindDescriptorSets(_command_buffers[_command_index],
-        VK_PIPELINE_BIND_POINT_COMPUTE, _light_pipeline_layout, 0, 3, descriptor_sets,
+        VK_PIPELINE_BIND_POINT_COMPUTE, _light_pipeline_layout, 0, 2, descriptor_sets,
         0, nullptr);
 
-    const auto work_groups_x = (viewport->size().x + (viewport->size().x % 16)) / 16;
-    const auto work_groups_y = (viewport->size().y + (viewport->size().y % 16)) / 16;
-    const auto number_of_tiles = work_groups_x * work_groups_y;
-
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_COMPUTE, _light_pipeline);
 
-    VkBufferMemoryBarrier barrier;
-    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    barrier.pNext = nullptr;
-    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    barrier.srcQueueFamilyIndex = _graphics_family;
-    barrier.dstQueueFamilyIndex = _graphics_family;
-    barrier.buffer = native_viewport->visible_light_indices_buffer();
-    barrier.offset = 0;
-    barrier.size = number_of_tiles * sizeof(int) * graphics_limits::max_lights;
-    vkCmdPipelineBarrier(_command_buffers[_command_index],
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        0, 0, nullptr, 1, &barrier, 0, nullptr);
-
-    vkCmdDispatch(_command_buffers[_command_index], work_groups_x, work_groups_y, 1);
+    // Every thread builds single cluster, workgroup size is defined by light culling shader.
+    const auto work_groups = (native_viewport->light_cluster_count() + 63) / 64;
+    vkCmdDispatch(_command_buffers[_command_index], work_groups, 1, 1);
 
-    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    barrier.pNext = nullptr;
-    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier.srcQueueFamilyIndex = _graphics_family;
-    barrier.dstQueueFamilyIndex = _graphics_family;
-    barrier.buffer = native_viewport->visible_light_indices_buffer();
-    barrier.offset = 0;
-    barrier.size = number_of_tiles * sizeof(int) * graphics_limits::max_lights;
+    for (auto& barrier : barriers) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+    }
     vkCmdPipelineBarrier(_command_buffers[_command_index],
         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-        0, 0, nullptr, 1, &barrier, 0, nullptr);
+        0, 0, nullptr, 2, barriers, 0, nullptr);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::begin_forward_pass(const std::shared_ptr<viewport>& viewport) {
-    vkCmdUpdateBuffer(_command_buffers[_command_index], _camera_buffer,
-        offsetof(camera_data, light_proj_view),
-        sizeof(_camera_data.light_proj_view),
-        &_camera_data.light_proj_view);
-
-    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
-    native_viewport->begin_forward_pass(_command_buffers[_command_index]);
+    // Render pass begins in end_forward_pass, once culling dispatches are recorded.
+    _opaque_batches.clear();
+    _skybox_requested = false;
 }
 
 void graphics_vulkan::draw_skybox(const std::shared_ptr<viewport>& viewport) {
-    if (!_environment) {
-        return;
-    }
-
-    vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _skybox_pipeline);
-
-    VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set,
-        _environment->descriptor_set()
-    };
-
-    vkCmdBindDescriptorSets(_command_buffers[_command_index],
-        VK_PIPELINE_BIND_POINT_GRAPHICS, _skybox_pipeline_layout, 0, 2, descriptor_sets,
-        0, nullptr);
-
-    VkDeviceSize offset{ 0 };
-    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &_skybox_vertex_buffer, &offset);
-    vkCmdBindIndexBuffer(_command_buffers[_command_index], _skybox_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-
-    vkCmdDrawIndexed(_command_buffers[_command_index], 36, 1, 0, 0, 0);
+    // Skybox is drawn between opaque and translucent geometries.
+    _cull_instance_draws(_camera_data.projection * _camera_data.view, false, _opaque_batches);
+    _skybox_requested = true;
 }
 
 void graphics_vulkan::draw_forward(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) {
-    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
-    const auto native_material = std::static_pointer_cast<material_vulkan>(material);
-    const auto native_mesh = std::static_pointer_cast<mesh_vulkan>(mesh);
-
-    VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set,
-        native_material->descriptor_set(),
-        _environment->descriptor_set(),
-        native_viewport->light_descriptor_set()
-    };
+    // Lod is selected by culling shader, using the same distance metric as renderer.
+    _instance_draws.push_back({ mesh.get(), material.get(), 0, world });
+}
 
-    std::uint64_t internal_flags = 0;
-    if (native_viewport->has_shadows()) {
-        internal_flags |= graphics_vulkan_flags::shadow_map_bit;
-    }
+void graphics_vulkan::end_forward_pass(const std::shared_ptr<viewport>& viewport) {
+    RB_PROFILE_ZONE("graphics_vulkan::end_forward_pass");
 
-    const auto pipeline_layout = _get_forward_pipeline_layout(native_material);
-    const auto pipeline = _get_forward_pipeline(native_material, internal_flags);
+    _begin_gpu_pass("forward");
 
-    vkCmdBindDescriptorSets(_command_buffers[_command_index],
-        VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 4, descriptor_sets,
-        0, nullptr);
+    _cull_instance_draws(_camera_data.projection * _camera_data.view, false, _indirect_batches);
 
-    VkDeviceSize offset{ 0 };
-    VkBuffer buffer{ native_mesh->vertex_buffer() };
-    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &buffer, &offset);
-    vkCmdBindIndexBuffer(_command_buffers[_command_index], native_mesh->index_buffer(), 0, VK_INDEX_TYPE_UINT32);
+    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
+    native_viewport->begin_forward_pass(_command_buffers[_command_index]);
 
-    vkCmdPushConstants(_command_buffers[_command_index], pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4f), &world);
+    _draw_forward_batches(viewport, _opaque_batches);
 
-    vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    if (_skybox_requested) {
+        _begin_gpu_pass("skybox");
+        _draw_skybox();
+        _end_gpu_pass();
+    }
 
-    const auto& lod = native_mesh->lods()[mesh_lod_index];
-    vkCmdDrawIndexed(_command_buffers[_command_index], lod.size, 1, lod.offset, 0, 0);
-}
+    _draw_forward_batches(viewport, _indirect_batches);
 
-void graphics_vulkan::end_forward_pass(const std::shared_ptr<viewport>& viewport) {
-    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
     native_viewport->end_forward_pass(_command_buffers[_command_index]);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::pre_draw_ssao(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("ssao");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkClearValue clear_values[1];
@@ -520,7 +939,7 @@ void graphics_vulkan::pre_draw_ssao(const std::shared_ptr<viewport>& viewport) {
     vkCmdBeginRenderPass(_command_buffers[_command_index], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
     VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set,
+        _main_descriptor_sets[_command_index],
         native_viewport->depth_descriptor_set(),
         _ssao_descriptor_set
     };
@@ -537,9 +956,13 @@ void graphics_vulkan::pre_draw_ssao(const std::shared_ptr<viewport>& viewport) {
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
 
     vkCmdEndRenderPass(_command_buffers[_command_index]);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::begin_fill_pass(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("fill");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkClearValue clear_values[1];
@@ -559,37 +982,48 @@ void graphics_vulkan::begin_fill_pass(const std::shared_ptr<viewport>& viewport)
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _fill_pipeline);
 
     VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set
+        _main_descriptor_sets[_command_index]
     };
 
     vkCmdBindDescriptorSets(_command_buffers[_command_index],
         VK_PIPELINE_BIND_POINT_GRAPHICS, _fill_pipeline_layout, 0, 1, descriptor_sets,
         0, nullptr);
+
+    _bind_mesh_arena();
 }
 
 void graphics_vulkan::draw_fill(const std::shared_ptr<viewport>& viewport, const transform& transform, const geometry& geometry) {
     const auto native_mesh = std::static_pointer_cast<mesh_vulkan>(geometry.mesh);
-
-    VkDeviceSize offset{ 0 };
-    VkBuffer buffer{ native_mesh->vertex_buffer() };
-    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &buffer, &offset);
-    vkCmdBindIndexBuffer(_command_buffers[_command_index], native_mesh->index_buffer(), 0, VK_INDEX_TYPE_UINT32);
+    if (!native_mesh->resident()) {
+        return;
+    }
 
     local_data local_data;
     local_data.world = mat4f::translation(transform.position) *
         mat4f::rotation(transform.rotation) *
         mat4f::scaling(transform.scaling);
 
+    const auto& quantization = native_mesh->quantization();
+    local_data.position_offset = { quantization.offset.x, quantization.offset.y, quantization.offset.z, 0.0f };
+    local_data.position_scale = { quantization.scale.x, quantization.scale.y, quantization.scale.z, 0.0f };
+
+    _bind_mesh_indices(native_mesh->index_type());
+
     vkCmdPushConstants(_command_buffers[_command_index], _fill_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(local_data), &local_data);
 
-    vkCmdDrawIndexed(_command_buffers[_command_index], static_cast<std::uint32_t>(native_mesh->indices().size()), 1, 0, 0, 0);
+    vkCmdDrawIndexed(_command_buffers[_command_index], static_cast<std::uint32_t>(native_mesh->indices().size()), 1,
+        native_mesh->index_offset(), static_cast<std::int32_t>(native_mesh->vertex_offset()), 0);
 }
 
 void graphics_vulkan::end_fill_pass(const std::shared_ptr<viewport>& viewport) {
     vkCmdEndRenderPass(_command_buffers[_command_index]);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::begin_postprocess_pass(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("postprocess copy");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
     native_viewport->begin_postprocess_pass(_command_buffers[_command_index]);
 
@@ -607,6 +1041,8 @@ void graphics_vulkan::begin_postprocess_pass(const std::shared_ptr<viewport>& vi
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _forward_copy_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::next_postprocess_pass(const std::shared_ptr<viewport>& viewport) {
@@ -616,6 +1052,8 @@ void graphics_vulkan::next_postprocess_pass(const std::shared_ptr<viewport>& vie
 }
 
 void graphics_vulkan::draw_ssao(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("ssao blur");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
@@ -637,9 +1075,13 @@ void graphics_vulkan::draw_ssao(const std::shared_ptr<viewport>& viewport) {
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _ssao_blur_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::draw_fxaa(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("fxaa");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
@@ -656,9 +1098,13 @@ void graphics_vulkan::draw_fxaa(const std::shared_ptr<viewport>& viewport) {
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _fxaa_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::draw_blur(const std::shared_ptr<viewport>& viewport, int strength) {
+    _begin_gpu_pass("blur");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
@@ -690,9 +1136,13 @@ void graphics_vulkan::draw_blur(const std::shared_ptr<viewport>& viewport, int s
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _blur_pipelines[1]);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::draw_sharpen(const std::shared_ptr<viewport>& viewport, float strength) {
+    _begin_gpu_pass("sharpen");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
@@ -713,13 +1163,17 @@ void graphics_vulkan::draw_sharpen(const std::shared_ptr<viewport>& viewport, fl
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _sharpen_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::draw_motion_blur(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("motion blur");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
-        _main_descriptor_set,
+        _main_descriptor_sets[_command_index],
         native_viewport->depth_descriptor_set(),
         native_viewport->postprocess_descriptor_set(),
     };
@@ -734,9 +1188,13 @@ void graphics_vulkan::draw_motion_blur(const std::shared_ptr<viewport>& viewport
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _motion_blur_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::draw_outline(const std::shared_ptr<viewport>& viewport) {
+    _begin_gpu_pass("outline");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     VkDescriptorSet descriptor_sets[]{
@@ -754,6 +1212,8 @@ void graphics_vulkan::draw_outline(const std::shared_ptr<viewport>& viewport) {
 
     vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _outline_pipeline);
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
+
+    _end_gpu_pass();
 }
 
 void graphics_vulkan::end_postprocess_pass(const std::shared_ptr<viewport>& viewport) {
@@ -778,10 +1238,37 @@ void graphics_vulkan::end_immediate_pass() {
 }
 
 void graphics_vulkan::end() {
+    RB_PROFILE_ZONE("graphics_vulkan::end");
+
+    _end_gpu_pass();
+
+    // Overflow is printed only when dropped count changes, so full buffers do not flood log every frame.
+    RB_PROFILE_COUNTER("dropped instance draws", _dropped_instance_draws);
+    if (_dropped_instance_draws != _reported_dropped_instance_draws) {
+        if (_dropped_instance_draws > 0) {
+            print("graphics: instance buffers are full, {} draws dropped this frame (instances {}/{}, commands {}/{})\n",
+                _dropped_instance_draws,
+                _instance_count, graphics_limits::max_instances,
+                _draw_command_count, graphics_limits::max_draw_commands);
+        }
+        _reported_dropped_instance_draws = _dropped_instance_draws;
+    }
+
+    // Fence of this frame was waited in begin, so its camera buffer can take final camera and cascade matrices.
+    std::memcpy(_mapped_camera_data[_command_index], &_camera_data, sizeof(camera_data));
+
+    vmaFlushAllocation(_allocator, _camera_allocations[_command_index], 0, VK_WHOLE_SIZE);
+    vmaFlushAllocation(_allocator, _instance_allocations[_command_index], 0, VK_WHOLE_SIZE);
+    vmaFlushAllocation(_allocator, _draw_command_allocations[_command_index], 0, VK_WHOLE_SIZE);
+
     _command_end();
 }
 
 void graphics_vulkan::present(const std::shared_ptr<viewport>& viewport) {
+    RB_PROFILE_ZONE("graphics_vulkan::present");
+
+    _begin_gpu_pass("present");
+
     const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
 
     // No need to clear depth buffer because we will resue it from gbuffer
@@ -827,23 +1314,57 @@ void graphics_vulkan::present(const std::shared_ptr<viewport>& viewport) {
     vkCmdDrawIndexed(_command_buffers[_command_index], 6, 1, 0, 0, 0);
 
     vkCmdEndRenderPass(_command_buffers[_command_index]);
-}
+
+    if (_readback_buffers[_command_index]) {
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { _swapchain_extent.width, _swapchain_extent.height, 1 };
+
+        vkCmdCopyImageToBuffer(_command_buffers[_command_index], _images[_image_index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            _readback_buffers[_command_index], 1, &region);
+
+        // Host reads pixels after frame fence, so copy has to be made visible to host.
+        VkBufferMemoryBarrier readback_barrier;
+        readback_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        readback_barrier.pNext = nullptr;
+        readback_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        readback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        readback_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        readback_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        readback_barrier.buffer = _readback_buffers[_command_index];
+        readback_barrier.offset = 0;
+        readback_barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(_command_buffers[_command_index],
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            0, nullptr, 1, &readback_barrier, 0, nullptr);
+
+        _readback_pending[_command_index] = true;
+        _readback_frames[_command_index] = _frame_number;
+    }
+
+    ++_frame_number;
+
+    _end_gpu_pass();
+}
 
 void graphics_vulkan::swap_buffers() {
-    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    RB_PROFILE_ZONE("graphics_vulkan::swap_buffers");
 
-    VkSubmitInfo submit_info;
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = nullptr;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &_present_semaphore;
-    submit_info.pWaitDstStageMask = &wait_stage;
-    submit_info.commandBufferCount = 0;
-    submit_info.pCommandBuffers = nullptr;
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &_render_semaphore;
+    // Nothing was rendered since last swap, e.g. renderer had no camera.
+    if (!_frame_submitted) {
+        return;
+    }
 
-    RB_VK(vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE), "Failed to queue submit");
+    _frame_submitted = false;
+
+    // Headless frames are read back instead of presented.
+    if (settings::headless) {
+        return;
+    }
 
     VkPresentInfoKHR present_info;
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -851,7 +1372,7 @@ void graphics_vulkan::swap_buffers() {
 
     // We should wait for rendering execution.
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &_render_semaphore;
+    present_info.pWaitSemaphores = &_render_finished_semaphores[_command_index];
 
     present_info.swapchainCount = 1;
     present_info.pSwapchains = &_swapchain;
@@ -860,8 +1381,41 @@ void graphics_vulkan::swap_buffers() {
 
     present_info.pResults = nullptr;
 
-    RB_VK(vkQueuePresentKHR(_graphics_queue, &present_info), "Failed to queue present");
-    RB_VK(vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, _present_semaphore, VK_NULL_HANDLE, &_image_index), "Failed to reset acquire next swapchain image");
+    RB_VK(vkQueuePresentKHR(_present_queue, &present_info), "Failed to queue present");
+}
+
+float graphics_vulkan::frame_latency() {
+    return _frame_latency;
+}
+
+std::vector<gpu_pass_timing> graphics_vulkan::gpu_timings() {
+    std::vector<gpu_pass_timing> timings;
+    timings.reserve(_gpu_pass_samples.size());
+
+    for (const auto& samples : _gpu_pass_samples) {
+        gpu_pass_timing timing;
+        timing.name = samples.name;
+        timing.min = std::numeric_limits<float>::max();
+        timing.avg = 0.0f;
+        timing.max = 0.0f;
+
+        for (std::size_t index{ 0 }; index < samples.count; ++index) {
+            timing.min = std::min(timing.min, samples.samples[index]);
+            timing.max = std::max(timing.max, samples.samples[index]);
+            timing.avg += samples.samples[index];
+        }
+
+        timing.avg /= static_cast<float>(samples.count);
+        timing.last = samples.samples[(samples.next + gpu_timing_history - 1) % gpu_timing_history];
+        timings.push_back(timing);
+    }
+
+    return timings;
+}
+
+std::vector<graphics_pass_calls> graphics_vulkan::pass_calls() {
+    // GPU cost of passes is measured with timestamp queries instead.
+    return {};
 }
 
 void graphics_vulkan::flush() {
@@ -869,6 +1423,16 @@ void graphics_vulkan::flush() {
         vkWaitForFences(_device, 1, &fence, VK_TRUE, 1000000000);
         vkDestroyFence(_device, fence, nullptr);
     }
+
+    // Last frames are read back only when every fence is signaled.
+    for (std::size_t index{ 0 }; index < max_command_buffers; ++index) {
+        _collect_readback(index);
+    }
+
+    for (auto& job : _readback_jobs) {
+        job.wait();
+    }
+    _readback_jobs.clear();
     vkFreeCommandBuffers(_device, _command_pool, max_command_buffers, _command_buffers);
 
     _environment.reset();
@@ -888,16 +1452,16 @@ void graphics_vulkan::_create_instance() {
     app_info.applicationVersion = VK_MAKE_VERSION(major, minor, patch);
     app_info.pEngineName = "RabBit";
     app_info.engineVersion = VK_MAKE_VERSION(RB_VERSION_MAJOR, RB_VERSION_MINOR, RB_VERSION_PATCH);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    app_info.apiVersion = VK_API_VERSION_1_2; // Descriptor indexing is core since 1.2.
 
-    const char* enabled_extensions[] = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
+    // Headless mode needs no window system integration, so it runs on software implementations like lavapipe.
+    std::vector<const char*> enabled_extensions;
+    if (!settings::headless) {
+        enabled_extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if RB_WINDOWS
-        VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-#else
-        VK_KHR_XCB_SURFACE_EXTENSION_NAME,
+        enabled_extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
-    };
+    }
 
 #ifdef _DEBUG
     VkDebugUtilsMessengerCreateInfoEXT debug_info;
@@ -930,8 +1494,8 @@ void graphics_vulkan::_create_instance() {
     instance_info.enabledLayerCount = 0;
     instance_info.ppEnabledLayerNames = nullptr;
 #endif
-    instance_info.enabledExtensionCount = sizeof(enabled_extensions) / sizeof(*enabled_extensions);
-    instance_info.ppEnabledExtensionNames = enabled_extensions;
+    instance_info.enabledExtensionCount = static_cast<std::uint32_t>(enabled_extensions.size());
+    instance_info.ppEnabledExtensionNames = enabled_extensions.data();
 
     RB_VK(vkCreateInstance(&instance_info, nullptr, &_instance), "Cannot create Vulkan instance.");
 
@@ -952,10 +1516,24 @@ void graphics_vulkan::_choose_physical_device() {
     RB_VK(vkEnumeratePhysicalDevices(_instance, &physical_device_count, physical_devices.get()),
         "Failed to enumarate physical devices");
 
-    // TODO: We should find best device.
-    _physical_device = physical_devices[0];
+    // TODO: We should find best device, first one with required features is taken for now.
+    _physical_device = VK_NULL_HANDLE;
+    for (std::uint32_t index{ 0 }; index < physical_device_count; ++index) {
+        vkGetPhysicalDeviceProperties(physical_devices[index], &_physical_device_properties);
 
-    vkGetPhysicalDeviceProperties(_physical_device, &_physical_device_properties);
+        if (!supports_descriptor_indexing(physical_devices[index])) {
+            print("graphics: skipping {}, descriptor indexing is not supported\n", _physical_device_properties.deviceName);
+            continue;
+        }
+
+        _physical_device = physical_devices[index];
+        break;
+    }
+
+    if (_physical_device == VK_NULL_HANDLE) {
+        print("graphics: no Vulkan device supports descriptor indexing required by bindless materials\n");
+        std::abort();
+    }
 
     const auto counts = _physical_device_properties.limits.framebufferColorSampleCounts &
         _physical_device_properties.limits.framebufferDepthSampleCounts;
@@ -969,6 +1547,11 @@ void graphics_vulkan::_choose_physical_device() {
 }
 
 void graphics_vulkan::_create_surface() {
+    if (settings::headless) {
+        _surface = VK_NULL_HANDLE;
+        return;
+    }
+
 #if RB_WINDOWS
     // Fill Win32 surface create informations.
     VkWin32SurfaceCreateInfoKHR surface_info;
@@ -997,6 +1580,10 @@ void graphics_vulkan::_create_device() {
             _graphics_family = index;
         }
 
+        if (settings::headless) {
+            continue;
+        }
+
         VkBool32 present_support{ VK_FALSE };
         vkGetPhysicalDeviceSurfaceSupportKHR(_physical_device, index, _surface, &present_support);
 
@@ -1010,6 +1597,22 @@ void graphics_vulkan::_create_device() {
         }
     }
 
+    // Without surface graphics queue takes over present queue role.
+    if (settings::headless) {
+        _present_family = _graphics_family;
+    }
+
+    // Prefer transfer-only family (DMA engine), then any family without graphics support.
+    _transfer_family = _graphics_family;
+    for (std::uint32_t index{ 0 }; index < queue_family_count; ++index) {
+        const auto flags = queue_families[index].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            if (_transfer_family == _graphics_family || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+                _transfer_family = index;
+            }
+        }
+    }
+
     // Fill queue priorities array.
     float queue_prorities[] = { 1.0f };
 
@@ -1031,10 +1634,25 @@ void graphics_vulkan::_create_device() {
     device_present_queue_info.queueCount = 1;
     device_present_queue_info.pQueuePriorities = queue_prorities;
 
-    VkDeviceQueueCreateInfo device_queue_infos[] = {
-        device_graphics_queue_info,
-        device_present_queue_info
-    };
+    // Fill transfer queue create informations.
+    VkDeviceQueueCreateInfo device_transfer_queue_info;
+    device_transfer_queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    device_transfer_queue_info.pNext = nullptr;
+    device_transfer_queue_info.flags = 0;
+    device_transfer_queue_info.queueFamilyIndex = _transfer_family;
+    device_transfer_queue_info.queueCount = 1;
+    device_transfer_queue_info.pQueuePriorities = queue_prorities;
+
+    // Every queue family can be requested only once.
+    std::uint32_t device_queue_info_count{ 0 };
+    VkDeviceQueueCreateInfo device_queue_infos[3];
+    device_queue_infos[device_queue_info_count++] = device_graphics_queue_info;
+    if (_present_family != _graphics_family) {
+        device_queue_infos[device_queue_info_count++] = device_present_queue_info;
+    }
+    if (_transfer_family != _graphics_family && _transfer_family != _present_family) {
+        device_queue_infos[device_queue_info_count++] = device_transfer_queue_info;
+    }
 
     // Fill logical device extensions array.
     const char* device_extensions[] = {
@@ -1044,10 +1662,21 @@ void graphics_vulkan::_create_device() {
     VkPhysicalDeviceFeatures supported_features;
     vkGetPhysicalDeviceFeatures(_physical_device, &supported_features);
 
+    // Without multi draw indirect every lod command of a batch is issued separately.
+    _multi_draw_indirect = supported_features.multiDrawIndirect == VK_TRUE;
+
+    // Support was checked when physical device was chosen.
+    VkPhysicalDeviceDescriptorIndexingFeatures enabled_descriptor_indexing_features{};
+    enabled_descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    enabled_descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+    enabled_descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    enabled_descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+    enabled_descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
     // Fill device create informations.
     VkDeviceCreateInfo device_info;
     device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    device_info.pNext = nullptr;
+    device_info.pNext = &enabled_descriptor_indexing_features;
     device_info.flags = 0;
 #ifdef _DEBUG
     device_info.enabledLayerCount = sizeof(validation_layers) / sizeof(*validation_layers);
@@ -1056,10 +1685,10 @@ void graphics_vulkan::_create_device() {
     device_info.enabledLayerCount = 0;
     device_info.ppEnabledLayerNames = nullptr;
 #endif
-    device_info.enabledExtensionCount = sizeof(device_extensions) / sizeof(*device_extensions);
+    device_info.enabledExtensionCount = settings::headless ? 0 : sizeof(device_extensions) / sizeof(*device_extensions);
     device_info.ppEnabledExtensionNames = device_extensions;
     device_info.pEnabledFeatures = &supported_features;
-    device_info.queueCreateInfoCount = sizeof(device_queue_infos) / sizeof(*device_queue_infos);
+    device_info.queueCreateInfoCount = device_queue_info_count;
     device_info.pQueueCreateInfos = device_queue_infos;
 
     // Create new Vulkan logical device using physical one.
@@ -1068,6 +1697,7 @@ void graphics_vulkan::_create_device() {
     // Gets logical device queues.
     vkGetDeviceQueue(_device, _graphics_family, 0, &_graphics_queue);
     vkGetDeviceQueue(_device, _present_family, 0, &_present_queue);
+    vkGetDeviceQueue(_device, _transfer_family, 0, &_transfer_queue);
 }
 
 void graphics_vulkan::_create_allocator() {
@@ -1080,7 +1710,85 @@ void graphics_vulkan::_create_allocator() {
     RB_VK(vmaCreateAllocator(&allocator_info, &_allocator), "Failed to create Vulkan memory allocator");
 }
 
+void graphics_vulkan::_create_transfer() {
+    // Uploads go through persistent staging ring instead of per-resource staging buffers.
+    _transfer = std::make_shared<transfer_vulkan>(_device, _allocator,
+        _graphics_family, _graphics_queue, _transfer_family, _transfer_queue,
+        static_cast<VkDeviceSize>(graphics_limits::staging_buffer_size));
+}
+
+void graphics_vulkan::_create_pipeline_cache() {
+    const auto path = std::filesystem::path{ settings::cache_directory } / "pipeline_cache.bin";
+
+    std::vector<char> data;
+    if (std::ifstream stream{ path, std::ios::binary }) {
+        data.assign(std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{});
+    }
+
+    // Driver ignores data of another device or driver version, but header is checked anyway to not rely on that.
+    const auto header_size = 4 * sizeof(std::uint32_t) + VK_UUID_SIZE;
+    if (data.size() >= header_size) {
+        std::uint32_t header[4];
+        std::memcpy(header, data.data(), sizeof(header));
+
+        if (header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            header[2] != _physical_device_properties.vendorID ||
+            header[3] != _physical_device_properties.deviceID ||
+            std::memcmp(data.data() + sizeof(header), _physical_device_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            data.clear();
+        }
+    } else {
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo pipeline_cache_info;
+    pipeline_cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_info.pNext = nullptr;
+    pipeline_cache_info.flags = 0;
+    pipeline_cache_info.initialDataSize = data.size();
+    pipeline_cache_info.pInitialData = data.empty() ? nullptr : data.data();
+    RB_VK(vkCreatePipelineCache(_device, &pipeline_cache_info, nullptr, &_pipeline_cache),
+        "Failed to create Vulkan pipeline cache");
+}
+
+void graphics_vulkan::_save_pipeline_cache() {
+    std::size_t size{ 0 };
+    if (vkGetPipelineCacheData(_device, _pipeline_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(_device, _pipeline_cache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(settings::cache_directory, error);
+
+    // Write to temporary file first, so crash during write never leaves truncated cache behind.
+    const auto path = std::filesystem::path{ settings::cache_directory } / "pipeline_cache.bin";
+    const auto temporary_path = std::filesystem::path{ path }.concat(".tmp");
+    if (std::ofstream stream{ temporary_path, std::ios::binary | std::ios::trunc }) {
+        stream.write(data.data(), size);
+        if (!stream) {
+            return;
+        }
+    } else {
+        return;
+    }
+
+    std::filesystem::rename(temporary_path, path, error);
+}
+
 void graphics_vulkan::_query_surface() {
+    if (settings::headless) {
+        // Byte order of offscreen image matches PNG, so readback needs no swizzle.
+        _surface_format.format = VK_FORMAT_R8G8B8A8_UNORM;
+        _surface_format.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        _swapchain_extent = { settings::window_size.x, settings::window_size.y };
+        return;
+    }
+
     // Query surface format count of picked physical device.
     std::uint32_t surface_format_count{ 0 };
     RB_VK(vkGetPhysicalDeviceSurfaceFormatsKHR(_physical_device, _surface, &surface_format_count, nullptr),
@@ -1127,18 +1835,28 @@ void graphics_vulkan::_create_swapchain() {
     RB_VK(vkGetPhysicalDeviceSurfacePresentModesKHR(_physical_device, _surface, &present_mode_count, present_modes.get()),
         "Failed to enumerate present mode count");
 
-    _present_mode = VK_PRESENT_MODE_FIFO_KHR;
-
-    if (!settings::vsync) {
-        _present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-
-        // Search for better solution.
+    const auto is_present_mode_supported = [&](VkPresentModeKHR present_mode) {
         for (std::uint32_t index{ 0 }; index < present_mode_count; ++index) {
-            if (present_modes[index] == VK_PRESENT_MODE_MAILBOX_KHR) {
-                _present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
-                break;
+            if (present_modes[index] == present_mode) {
+                return true;
             }
         }
+        return false;
+    };
+
+    // FIFO is the only mode guaranteed by specification, so every request falls back to it.
+    _present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+    if (settings::vsync == present_mode::mailbox) {
+        if (is_present_mode_supported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+            _present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    } else if (settings::vsync == present_mode::immediate) {
+        if (is_present_mode_supported(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+            _present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        } else if (is_present_mode_supported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+            _present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
     }
 
     auto image_count = surface_capabilities.minImageCount + 1;
@@ -1204,6 +1922,59 @@ void graphics_vulkan::_create_swapchain() {
         image_view_info.subresourceRange.layerCount = 1;
         RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &_image_views[index]), "Failed to create image view");
     }
+}
+
+void graphics_vulkan::_create_offscreen_images() {
+    const auto window_size = window::size();
+
+    // Every frame in flight renders into its own image, so readback of older frames never races with rendering.
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent.width = window_size.x;
+    image_info.extent.height = window_size.y;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.format = _surface_format.format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    _images.resize(max_command_buffers);
+    _image_allocations.resize(max_command_buffers);
+    _image_views.resize(max_command_buffers);
+    for (std::size_t index{ 0 }; index < max_command_buffers; ++index) {
+        RB_VK(vmaCreateImage(_allocator, &image_info, &allocation_info, &_images[index], &_image_allocations[index], nullptr),
+            "Failed to create Vulkan offscreen image");
+
+        VkImageViewCreateInfo image_view_info;
+        image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_info.pNext = nullptr;
+        image_view_info.flags = 0;
+        image_view_info.image = _images[index];
+        image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_info.format = _surface_format.format;
+        image_view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        image_view_info.subresourceRange.baseMipLevel = 0;
+        image_view_info.subresourceRange.levelCount = 1;
+        image_view_info.subresourceRange.baseArrayLayer = 0;
+        image_view_info.subresourceRange.layerCount = 1;
+        RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &_image_views[index]), "Failed to create image view");
+    }
+}
+
+void graphics_vulkan::_create_framebuffers() {
+    const auto window_size = window::size();
 
     const auto depth_format = _get_supported_depth_format();
 
@@ -1253,7 +2024,8 @@ void graphics_vulkan::_create_swapchain() {
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Headless image is copied into readback buffer right after final pass.
+    color_attachment.finalLayout = settings::headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentDescription depth_attachment{};
     depth_attachment.format = depth_format;
@@ -1303,7 +2075,8 @@ void graphics_vulkan::_create_swapchain() {
 
     subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     subpass_dependencies[0].dstSubpass = 0;
-    subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+    // Color attachment output stage chains layout transition after acquire semaphore wait.
+    subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT; // Both stages might have access the depth-buffer, so need both in src/dstStageMask;;
     subpass_dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     subpass_dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -1314,9 +2087,9 @@ void graphics_vulkan::_create_swapchain() {
     subpass_dependencies[1].srcSubpass = 0;
     subpass_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
     subpass_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpass_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    subpass_dependencies[1].dstStageMask = settings::headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
     subpass_dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    subpass_dependencies[1].dstAccessMask = settings::headless ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_MEMORY_READ_BIT;
     subpass_dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     VkAttachmentDescription attachments[] = { color_attachment, depth_attachment };
@@ -1357,15 +2130,23 @@ void graphics_vulkan::_create_camera() {
     camera_buffer_info.pNext = nullptr;
     camera_buffer_info.flags = 0;
     camera_buffer_info.size = sizeof(camera_data);
-    camera_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    camera_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     camera_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     camera_buffer_info.queueFamilyIndexCount = 0;
     camera_buffer_info.pQueueFamilyIndices = nullptr;
 
+    // Every frame in flight owns its camera buffer, so CPU never writes memory that GPU still reads.
     VmaAllocationCreateInfo camera_allocation_info{};
-    camera_allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-    RB_VK(vmaCreateBuffer(_allocator, &camera_buffer_info, &camera_allocation_info, &_camera_buffer, &_camera_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
+    camera_allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        RB_VK(vmaCreateBuffer(_allocator, &camera_buffer_info, &camera_allocation_info, &_camera_buffers[i], &_camera_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        void* mapped_data;
+        RB_VK(vmaMapMemory(_allocator, _camera_allocations[i], &mapped_data), "Failed to map camera buffer");
+        _mapped_camera_data[i] = static_cast<camera_data*>(mapped_data);
+    }
 }
 
 void graphics_vulkan::_create_main() {
@@ -1385,66 +2166,68 @@ void graphics_vulkan::_create_main() {
         "Failed to create Vulkan descriptor set layout");
 
     VkDescriptorPoolSize pool_sizes[2]{
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 }
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, max_command_buffers },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * max_command_buffers }
     };
 
     VkDescriptorPoolCreateInfo descriptor_pool_info;
     descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptor_pool_info.pNext = nullptr;
     descriptor_pool_info.flags = 0;
-    descriptor_pool_info.maxSets = 1;
+    descriptor_pool_info.maxSets = max_command_buffers;
     descriptor_pool_info.poolSizeCount = 2;
     descriptor_pool_info.pPoolSizes = pool_sizes;
     RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_main_descriptor_pool),
         "Failed to create descriptor pool");
 
-    VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
-    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptor_set_allocate_info.pNext = nullptr;
-    descriptor_set_allocate_info.descriptorPool = _main_descriptor_pool;
-    descriptor_set_allocate_info.descriptorSetCount = 1;
-    descriptor_set_allocate_info.pSetLayouts = &_main_descriptor_set_layout;
-    RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_main_descriptor_set),
-        "Failed to allocatore desctiptor set");
-
-    VkDescriptorBufferInfo buffer_infos[1]{
-        { _camera_buffer, 0, sizeof(camera_data) },
-    };
-
     VkDescriptorImageInfo image_infos[2]{
         { _brdf_sampler, _brdf_image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
         { _shadow_sampler, _shadow_image_view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
     };
 
-    VkWriteDescriptorSet write_infos[3]{
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_set, 0, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, nullptr, &buffer_infos[0], nullptr },
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_set, 1, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &image_infos[0], nullptr, nullptr },
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_set, 2, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &image_infos[1], nullptr, nullptr },
-    };
+    // Sets differ only by camera buffer of their frame.
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
+        descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptor_set_allocate_info.pNext = nullptr;
+        descriptor_set_allocate_info.descriptorPool = _main_descriptor_pool;
+        descriptor_set_allocate_info.descriptorSetCount = 1;
+        descriptor_set_allocate_info.pSetLayouts = &_main_descriptor_set_layout;
+        RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_main_descriptor_sets[i]),
+            "Failed to allocatore desctiptor set");
+
+        VkDescriptorBufferInfo buffer_infos[1]{
+            { _camera_buffers[i], 0, sizeof(camera_data) },
+        };
 
-    vkUpdateDescriptorSets(_device, 3, write_infos, 0, nullptr);
+        VkWriteDescriptorSet write_infos[3]{
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_sets[i], 0, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, nullptr, &buffer_infos[0], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_sets[i], 1, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &image_infos[0], nullptr, nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _main_descriptor_sets[i], 2, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &image_infos[1], nullptr, nullptr },
+        };
+
+        vkUpdateDescriptorSets(_device, 3, write_infos, 0, nullptr);
+    }
 }
 
 void graphics_vulkan::_create_material() {
-    VkDescriptorSetLayoutBinding material_bindings[7]{
-        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-        { 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
-    };
-
-    VkDescriptorSetLayoutCreateInfo material_descriptor_set_layout_info;
-    material_descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    material_descriptor_set_layout_info.pNext = nullptr;
-    material_descriptor_set_layout_info.flags = 0;
-    material_descriptor_set_layout_info.bindingCount = 7;
-    material_descriptor_set_layout_info.pBindings = material_bindings;
-    RB_VK(vkCreateDescriptorSetLayout(_device, &material_descriptor_set_layout_info, nullptr, &_material_descriptor_set_layout),
-        "Failed to create Vulkan descriptor set layout");
+    // Bound in place of maps that material does not use.
+    const std::uint8_t default_pixel[]{ 255, 255, 255, 255 };
+
+    texture_desc default_texture_desc;
+    default_texture_desc.data = default_pixel;
+    default_texture_desc.size = { 1, 1 };
+    default_texture_desc.format = texture_format::rgba8;
+    default_texture_desc.filter = texture_filter::nearest;
+    default_texture_desc.mipmaps = 1;
+    _default_texture = make_texture(default_texture_desc);
+
+    _material_arena = std::make_shared<material_arena_vulkan>(_transfer,
+        _device,
+        _allocator,
+        _default_texture,
+        static_cast<std::uint32_t>(graphics_limits::max_material_textures),
+        static_cast<std::uint32_t>(graphics_limits::max_materials));
 }
 
 void graphics_vulkan::_create_environment() {
@@ -1517,22 +2300,18 @@ void graphics_vulkan::_create_depth() {
         "Failed to create render pass.");
 
     VkDescriptorSetLayout layouts[]{
-        _main_descriptor_set_layout
+        _main_descriptor_set_layout,
+        _instance_descriptor_set_layout
     };
 
-    VkPushConstantRange push_constant_range;
-    push_constant_range.offset = 0;
-    push_constant_range.size = sizeof(local_data);
-    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
     VkPipelineLayoutCreateInfo pipeline_layout_info;
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipeline_layout_info.pNext = nullptr;
     pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.setLayoutCount = 2;
     pipeline_layout_info.pSetLayouts = layouts;
-    pipeline_layout_info.pushConstantRangeCount = 1;
-    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+    pipeline_layout_info.pushConstantRangeCount = 0;
+    pipeline_layout_info.pPushConstantRanges = nullptr;
     RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_depth_pipeline_layout),
         "Failed to create Vulkan pipeline layout");
 
@@ -1547,21 +2326,15 @@ void graphics_vulkan::_create_depth() {
     RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &depth_shader_module),
         "Failed to create shader module");
 
-    struct forward_vertex {
-        vec3f position;
-        vec2f texcoord;
-        vec3f normal;
-    };
-
     VkVertexInputBindingDescription vertex_input_binding_desc;
     vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(forward_vertex);
+    vertex_input_binding_desc.stride = sizeof(packed_vertex);
     vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     VkVertexInputAttributeDescription vertex_attributes[3]{
-        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, position) },
-        { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(forward_vertex, texcoord) },
-        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, normal) }
+        { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(packed_vertex, position) },
+        { 1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(packed_vertex, texcoord) },
+        { 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(packed_vertex, normal) }
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -1686,7 +2459,7 @@ void graphics_vulkan::_create_depth() {
     pipeline_info.renderPass = _depth_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_depth_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_depth_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, depth_shader_module, nullptr);
@@ -1706,24 +2479,26 @@ void graphics_vulkan::_create_depth() {
 }
 
 void graphics_vulkan::_create_light() {
-    VkDescriptorSetLayoutBinding light_bindings[3]{
+    // Lights, light index list, culling data and light clusters.
+    VkDescriptorSetLayoutBinding light_bindings[4]{
         { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
         { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
         { 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
     };
 
     VkDescriptorSetLayoutCreateInfo light_descriptor_set_layout_info;
     light_descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     light_descriptor_set_layout_info.pNext = nullptr;
     light_descriptor_set_layout_info.flags = 0;
-    light_descriptor_set_layout_info.bindingCount = 3;
+    light_descriptor_set_layout_info.bindingCount = 4;
     light_descriptor_set_layout_info.pBindings = light_bindings;
     RB_VK(vkCreateDescriptorSetLayout(_device, &light_descriptor_set_layout_info, nullptr, &_light_descriptor_set_layout),
         "Failed to create Vulkan descriptor set layout");
 
-    VkDescriptorSetLayout layouts[3]{
+    // Clusters are built from camera frustum only, so depth buffer is not needed.
+    VkDescriptorSetLayout layouts[2]{
         _main_descriptor_set_layout,
-        _depth_descriptor_set_layout,
         _light_descriptor_set_layout
     };
 
@@ -1731,7 +2506,7 @@ void graphics_vulkan::_create_light() {
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipeline_layout_info.pNext = nullptr;
     pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 3;
+    pipeline_layout_info.setLayoutCount = 2;
     pipeline_layout_info.pSetLayouts = layouts;
     pipeline_layout_info.pushConstantRangeCount = 0;
     pipeline_layout_info.pPushConstantRanges = nullptr;
@@ -1765,115 +2540,101 @@ void graphics_vulkan::_create_light() {
     compute_pipeline_create_info.layout = _light_pipeline_layout;
     compute_pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
     compute_pipeline_create_info.basePipelineIndex = 0;
-    RB_VK(vkCreateComputePipelines(_device, nullptr, 1, &compute_pipeline_create_info, nullptr, &_light_pipeline),
+    RB_VK(vkCreateComputePipelines(_device, _pipeline_cache, 1, &compute_pipeline_create_info, nullptr, &_light_pipeline),
         "Failed to create Vulkan compute pipeline");
 
     vkDestroyShaderModule(_device, shader_module, nullptr);
 }
 
-VkPipelineLayout graphics_vulkan::_create_forward_pipeline_layout(const std::shared_ptr<material>& material) {
-    const auto native_material = std::static_pointer_cast<material_vulkan>(material);
-
-    VkPushConstantRange push_constant_range;
-    push_constant_range.offset = 0;
-    push_constant_range.size = sizeof(local_data);
-    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayout layouts[4]{
-        _main_descriptor_set_layout, // main
-        native_material->descriptor_set_layout(), // material
-        _environment_descriptor_set_layout,
-        _light_descriptor_set_layout
+void graphics_vulkan::_create_instance_culling() {
+    VkDescriptorSetLayout layouts[2]{
+        _main_descriptor_set_layout,
+        _instance_descriptor_set_layout
     };
 
+    VkPushConstantRange push_constant;
+    push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant.offset = 0;
+    push_constant.size = sizeof(cull_data);
+
     VkPipelineLayoutCreateInfo pipeline_layout_info;
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipeline_layout_info.pNext = nullptr;
     pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 4;
+    pipeline_layout_info.setLayoutCount = 2;
     pipeline_layout_info.pSetLayouts = layouts;
     pipeline_layout_info.pushConstantRangeCount = 1;
-    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
-
-    VkPipelineLayout pipeline_layout;
-    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &pipeline_layout),
+    pipeline_layout_info.pPushConstantRanges = &push_constant;
+    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_cull_pipeline_layout),
         "Failed to create Vulkan pipeline layout");
 
-    return pipeline_layout;
-}
+    VkShaderModuleCreateInfo shader_module_create_info;
+    shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_create_info.flags = 0;
+    shader_module_create_info.pNext = nullptr;
+    shader_module_create_info.pCode = shaders_vulkan::instance_cull_comp().data();
+    shader_module_create_info.codeSize = shaders_vulkan::instance_cull_comp().size_bytes();
 
-VkPipelineLayout graphics_vulkan::_get_forward_pipeline_layout(const std::shared_ptr<material>& material) {
-    const auto flags = material ? material->flags() : 0;
-    auto& pipeline_layout = _forward_pipeline_layouts[flags];
-    if (pipeline_layout) {
-        return pipeline_layout;
-    }
-    return pipeline_layout = _create_forward_pipeline_layout(material);
-}
+    VkShaderModule shader_module;
+    RB_VK(vkCreateShaderModule(_device, &shader_module_create_info, nullptr, &shader_module),
+        "Failed to create Vulkan shader module");
 
-VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<material>& material, std::uint64_t internal_flags) {
-    const auto native_material = std::static_pointer_cast<material_vulkan>(material);
+    VkComputePipelineCreateInfo compute_pipeline_create_info;
+    compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_pipeline_create_info.pNext = nullptr;
+    compute_pipeline_create_info.flags = 0;
+    compute_pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compute_pipeline_create_info.stage.pNext = nullptr;
+    compute_pipeline_create_info.stage.flags = 0;
+    compute_pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compute_pipeline_create_info.stage.module = shader_module;
+    compute_pipeline_create_info.stage.pName = "main";
+    compute_pipeline_create_info.stage.pSpecializationInfo = nullptr;
+    compute_pipeline_create_info.layout = _cull_pipeline_layout;
+    compute_pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    compute_pipeline_create_info.basePipelineIndex = 0;
+    RB_VK(vkCreateComputePipelines(_device, _pipeline_cache, 1, &compute_pipeline_create_info, nullptr, &_cull_pipeline),
+        "Failed to create Vulkan compute pipeline");
 
-    const auto pipeline_layout = _get_forward_pipeline_layout(material);
+    vkDestroyShaderModule(_device, shader_module, nullptr);
+}
 
-    auto flags = static_cast<std::uint64_t>(material->flags()) | internal_flags;
+VkPipeline graphics_vulkan::_create_forward_pipeline(std::uint64_t flags) {
+    // Order matches constant_id of forward fragment shader.
+    const VkBool32 specialization_data[]{
+        (flags & material_flags::albedo_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::normal_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::roughness_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::metallic_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::emissive_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::ambient_map_bit) ? VK_TRUE : VK_FALSE,
+        (flags & material_flags::translucent_bit) ? VK_TRUE : VK_FALSE,
+        (flags & graphics_vulkan_flags::shadow_map_bit) ? VK_TRUE : VK_FALSE
+    };
 
-    std::vector<std::string> definitions;
-    if (flags & material_flags::albedo_map_bit) {
-        definitions.push_back("ALBEDO_MAP 1");
-    }
-    if (flags & material_flags::normal_map_bit) {
-        definitions.push_back("NORMAL_MAP 1");
-    }
-    if (flags & material_flags::roughness_map_bit) {
-        definitions.push_back("ROUGHNESS_MAP 1");
-    }
-    if (flags & material_flags::metallic_map_bit) {
-        definitions.push_back("METALLIC_MAP 1");
-    }
-    if (flags & material_flags::emissive_map_bit) {
-        definitions.push_back("EMISSIVE_MAP 1");
-    }
-    if (flags & material_flags::ambient_map_bit) {
-        definitions.push_back("AMBIENT_MAP 1");
-    }
-    if (flags & material_flags::translucent_bit) {
-        definitions.push_back("TRANSLUCENT 1");
+    VkSpecializationMapEntry specialization_entries[sizeof(specialization_data) / sizeof(*specialization_data)];
+    for (auto i = 0u; i < sizeof(specialization_data) / sizeof(*specialization_data); ++i) {
+        specialization_entries[i].constantID = i;
+        specialization_entries[i].offset = i * sizeof(VkBool32);
+        specialization_entries[i].size = sizeof(VkBool32);
     }
-    if (flags & graphics_vulkan_flags::shadow_map_bit) {
-        definitions.push_back("SHADOW_MAP 1");
-    }
-    auto forward_frag = shaders_vulkan::forward_frag(definitions);
-
-    VkShaderModule forward_shader_modules[2];
-
-    VkShaderModuleCreateInfo vertex_shader_module_info;
-    vertex_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vertex_shader_module_info.pNext = nullptr;
-    vertex_shader_module_info.flags = 0;
-    vertex_shader_module_info.codeSize = shaders_vulkan::forward_vert().size_bytes();
-    vertex_shader_module_info.pCode = shaders_vulkan::forward_vert().data();
-    RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &forward_shader_modules[0]),
-        "Failed to create shader module");
 
-    VkShaderModuleCreateInfo fragment_shader_module_info;
-    fragment_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fragment_shader_module_info.pNext = nullptr;
-    fragment_shader_module_info.flags = 0;
-    fragment_shader_module_info.codeSize = forward_frag.size() * sizeof(std::uint32_t);
-    fragment_shader_module_info.pCode = forward_frag.data();
-    RB_VK(vkCreateShaderModule(_device, &fragment_shader_module_info, nullptr, &forward_shader_modules[1]),
-        "Failed to create shader module");
+    VkSpecializationInfo specialization_info;
+    specialization_info.mapEntryCount = sizeof(specialization_entries) / sizeof(*specialization_entries);
+    specialization_info.pMapEntries = specialization_entries;
+    specialization_info.dataSize = sizeof(specialization_data);
+    specialization_info.pData = specialization_data;
 
     VkVertexInputBindingDescription vertex_input_binding_desc;
     vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(vertex);
+    // Meshes are quantized: positions in mesh bounds, half float texcoords and octahedral normals.
+    vertex_input_binding_desc.stride = sizeof(packed_vertex);
     vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     VkVertexInputAttributeDescription vertex_attributes[3]{
-        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vertex, position) },
-        { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(vertex, texcoord) },
-        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vertex, normal) }
+        { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(packed_vertex, position) },
+        { 1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(packed_vertex, texcoord) },
+        { 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(packed_vertex, normal) }
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -1892,26 +2653,15 @@ VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<mater
     input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     input_assembly_info.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(_swapchain_extent.width);
-    viewport.height = static_cast<float>(_swapchain_extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset = { 0, 0 };
-    scissor.extent = _swapchain_extent;
-
+    // Viewport and scissor are dynamic, so worker thread never reads swapchain extent changed by resize.
     VkPipelineViewportStateCreateInfo viewport_state_info;
     viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state_info.pNext = nullptr;
     viewport_state_info.flags = 0;
     viewport_state_info.viewportCount = 1;
-    viewport_state_info.pViewports = &viewport;
+    viewport_state_info.pViewports = nullptr;
     viewport_state_info.scissorCount = 1;
-    viewport_state_info.pScissors = &scissor;
+    viewport_state_info.pScissors = nullptr;
 
     VkPipelineRasterizationStateCreateInfo rasterizer_state_info{};
     rasterizer_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -1919,8 +2669,8 @@ VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<mater
     rasterizer_state_info.flags = 0;
     rasterizer_state_info.depthClampEnable = VK_FALSE;
     rasterizer_state_info.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer_state_info.polygonMode = material->wireframe() ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
-    rasterizer_state_info.cullMode = material->double_sided() ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+    rasterizer_state_info.polygonMode = (flags & material_flags::wireframe_bit) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+    rasterizer_state_info.cullMode = (flags & material_flags::double_sided_bit) ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
     rasterizer_state_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
     rasterizer_state_info.depthBiasEnable = VK_FALSE;
     rasterizer_state_info.depthBiasConstantFactor = 0.0f;
@@ -1944,15 +2694,15 @@ VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<mater
     depth_stencil_state_info.pNext = nullptr;
     depth_stencil_state_info.flags = 0;
     depth_stencil_state_info.depthTestEnable = VK_TRUE;
-    depth_stencil_state_info.depthWriteEnable = material->translucent() ? VK_FALSE : VK_TRUE;
-    depth_stencil_state_info.depthCompareOp = (material->wireframe() || material->translucent()) ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_EQUAL;
+    depth_stencil_state_info.depthWriteEnable = (flags & material_flags::translucent_bit) ? VK_FALSE : VK_TRUE;
+    depth_stencil_state_info.depthCompareOp = (flags & (material_flags::wireframe_bit | material_flags::translucent_bit)) ? VK_COMPARE_OP_LESS : VK_COMPARE_OP_EQUAL;
     depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
     depth_stencil_state_info.stencilTestEnable = VK_FALSE;
 
     VkPipelineColorBlendAttachmentState color_blend_attachment_state_info{};
     color_blend_attachment_state_info.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    if (material->translucent()) {
+    if (flags & material_flags::translucent_bit) {
         color_blend_attachment_state_info.blendEnable = VK_TRUE;
         color_blend_attachment_state_info.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
         color_blend_attachment_state_info.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
@@ -1983,14 +2733,15 @@ VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<mater
     VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
     vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = forward_shader_modules[0];
+    vertex_shader_stage_info.module = _forward_shader_modules[0];
     vertex_shader_stage_info.pName = "main";
 
     VkPipelineShaderStageCreateInfo fragment_shader_stage_info{};
     fragment_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragment_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_shader_stage_info.module = forward_shader_modules[1];
+    fragment_shader_stage_info.module = _forward_shader_modules[1];
     fragment_shader_stage_info.pName = "main";
+    fragment_shader_stage_info.pSpecializationInfo = &specialization_info;
 
     VkPipelineShaderStageCreateInfo shader_stages[] = {
         vertex_shader_stage_info,
@@ -2020,29 +2771,62 @@ VkPipeline graphics_vulkan::_create_forward_pipeline(const std::shared_ptr<mater
     pipeline_info.pMultisampleState = &multisampling_state_info;
     pipeline_info.pColorBlendState = &color_blend_state_info;
     pipeline_info.pDepthStencilState = &depth_stencil_state_info;
-    pipeline_info.layout = pipeline_layout;
+    pipeline_info.layout = _forward_pipeline_layout;
     pipeline_info.renderPass = _forward_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
 
     VkPipeline pipeline;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &pipeline),
         "Failed to create Vulkan graphics pipeline");
 
-    vkDestroyShaderModule(_device, forward_shader_modules[1], nullptr);
-    vkDestroyShaderModule(_device, forward_shader_modules[0], nullptr);
-
     return pipeline;
 }
 
-VkPipeline graphics_vulkan::_get_forward_pipeline(const std::shared_ptr<material>& material, std::uint64_t internal_flags) {
-    const std::uint64_t material_flags = material ? material->flags() : 0;
+void graphics_vulkan::_prewarm_forward_pipelines(std::uint64_t material_flags) {
+    for (const auto internal_flags : { std::uint64_t{ 0 }, graphics_vulkan_flags::shadow_map_bit }) {
+        const auto flags = material_flags | internal_flags;
+        if (_forward_pipeline_jobs.find(flags) != _forward_pipeline_jobs.end() ||
+            _forward_pipelines.find(flags) != _forward_pipelines.end()) {
+            continue;
+        }
+
+        // Fallback differs only by specialization, so it is shared by all materials with the same fixed function state.
+        const auto fallback_flags = flags & forward_fixed_function_bits;
+        if (_forward_fallback_pipelines.find(fallback_flags) == _forward_fallback_pipelines.end()) {
+            _forward_fallback_pipelines.emplace(fallback_flags, _create_forward_pipeline(fallback_flags));
+        }
+
+        // Pipeline creation only reads immutable state, so it can run on worker thread.
+        _forward_pipeline_jobs.emplace(flags, std::async(std::launch::async, [this, flags]() {
+            RB_PROFILE_THREAD("pipeline compiler");
+            RB_PROFILE_ZONE("graphics_vulkan::_create_forward_pipeline");
+            return _create_forward_pipeline(flags);
+        }));
+    }
+}
+
+VkPipeline graphics_vulkan::_get_forward_pipeline(const material* material, std::uint64_t internal_flags) {
+    const auto material_flags = material ? static_cast<std::uint64_t>(material->flags()) : 0;
     const auto flags = material_flags | internal_flags;
-    auto& pipeline = _forward_pipelines[flags];
-    if (pipeline) {
-        return pipeline;
+    if (const auto it = _forward_pipelines.find(flags); it != _forward_pipelines.end()) {
+        return it->second;
+    }
+
+    auto job = _forward_pipeline_jobs.find(flags);
+    if (job == _forward_pipeline_jobs.end()) {
+        _prewarm_forward_pipelines(material_flags);
+        job = _forward_pipeline_jobs.find(flags);
     }
-    return pipeline = _create_forward_pipeline(material, internal_flags);
+
+    // Draw with fallback until worker finishes real pipeline.
+    if (job->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return _forward_fallback_pipelines.at(flags & forward_fixed_function_bits);
+    }
+
+    const auto pipeline = job->second.get();
+    _forward_pipeline_jobs.erase(job);
+    return _forward_pipelines[flags] = pipeline;
 }
 
 void graphics_vulkan::_create_forward() {
@@ -2170,6 +2954,40 @@ void graphics_vulkan::_create_forward() {
 
     RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_forward_render_pass),
         "Failed to create render pass.");
+
+    // Every material shares one layout, so permutations differ only by specialization constants.
+    VkDescriptorSetLayout layouts[5]{
+        _main_descriptor_set_layout,
+        _material_arena->descriptor_set_layout(),
+        _environment_descriptor_set_layout,
+        _light_descriptor_set_layout,
+        _instance_descriptor_set_layout
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info;
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.pNext = nullptr;
+    pipeline_layout_info.flags = 0;
+    pipeline_layout_info.setLayoutCount = 5;
+    pipeline_layout_info.pSetLayouts = layouts;
+    pipeline_layout_info.pushConstantRangeCount = 0;
+    pipeline_layout_info.pPushConstantRanges = nullptr;
+    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_forward_pipeline_layout),
+        "Failed to create Vulkan pipeline layout");
+
+    VkShaderModuleCreateInfo shader_module_info;
+    shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_info.pNext = nullptr;
+    shader_module_info.flags = 0;
+    shader_module_info.codeSize = shaders_vulkan::forward_vert().size_bytes();
+    shader_module_info.pCode = shaders_vulkan::forward_vert().data();
+    RB_VK(vkCreateShaderModule(_device, &shader_module_info, nullptr, &_forward_shader_modules[0]),
+        "Failed to create shader module");
+
+    shader_module_info.codeSize = shaders_vulkan::forward_frag().size_bytes();
+    shader_module_info.pCode = shaders_vulkan::forward_frag().data();
+    RB_VK(vkCreateShaderModule(_device, &shader_module_info, nullptr, &_forward_shader_modules[1]),
+        "Failed to create shader module");
 }
 
 void graphics_vulkan::_create_postprocess() {
@@ -2301,9 +3119,9 @@ void graphics_vulkan::_create_ssao_pipeline() {
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
         | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.sharingMode = _transfer->sharing_mode();
+    image_info.queueFamilyIndexCount = _transfer->queue_family_count();
+    image_info.pQueueFamilyIndices = _transfer->queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info{};
@@ -2319,32 +3137,10 @@ void graphics_vulkan::_create_ssao_pipeline() {
         };
     }
 
-    // Create staging buffer.
-    VkBufferCreateInfo buffer_info;
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.pNext = nullptr;
-    buffer_info.flags = 0;
-    buffer_info.size = sizeof(ssao_noise);
-    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    buffer_info.queueFamilyIndexCount = 0;
-    buffer_info.pQueueFamilyIndices = nullptr;
+    // Copy noise into staging ring before recording, because staging may submit pending uploads.
+    const auto staging = _transfer->stage(ssao_noise, sizeof(ssao_noise));
 
-    VmaAllocationCreateInfo staging_allocation_info{};
-    staging_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    VkBuffer staging_buffer;
-    VmaAllocation staging_buffer_allocation;
-
-    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &staging_allocation_info, &staging_buffer, &staging_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer");
-
-    // Transfer pixels into buffer.
-    RB_VK(vmaMapMemory(_allocator, staging_buffer_allocation, &ptr), "Failed to map staging buffer memory");
-    std::memcpy(ptr, ssao_noise, buffer_info.size);
-    vmaUnmapMemory(_allocator, staging_buffer_allocation);
-
-    auto command_buffer = utils_vulkan::begin_single_time_commands(_device, _command_pool);
+    auto command_buffer = _transfer->transfer_commands();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -2365,7 +3161,7 @@ void graphics_vulkan::_create_ssao_pipeline() {
         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = staging.offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -2375,7 +3171,7 @@ void graphics_vulkan::_create_ssao_pipeline() {
     region.imageOffset = { 0, 0, 0 };
     region.imageExtent = { 4, 4, 1 };
 
-    vkCmdCopyBufferToImage(command_buffer, staging_buffer, _ssao_noise_map, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, _ssao_noise_map, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -2389,14 +3185,10 @@ void graphics_vulkan::_create_ssao_pipeline() {
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = _transfer->release_access(VK_ACCESS_SHADER_READ_BIT);
 
     vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    utils_vulkan::end_single_time_commands(_device, _graphics_queue, _command_pool, command_buffer);
-
-    vmaDestroyBuffer(_allocator, staging_buffer, staging_buffer_allocation);
+        _transfer->release_stage(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT), 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
     VkImageViewCreateInfo image_view_info;
     image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -2818,7 +3610,7 @@ void graphics_vulkan::_create_ssao_pipeline() {
     pipeline_info.renderPass = _ssao_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = nullptr;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_ssao_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_ssao_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, ssao_shader_modules[1], nullptr);
@@ -2882,7 +3674,7 @@ void graphics_vulkan::_create_ssao_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_ssao_blur_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_ssao_blur_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, ssao_blur_shader_modules[1], nullptr);
@@ -3084,7 +3876,7 @@ void graphics_vulkan::_create_fxaa_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_fxaa_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_fxaa_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, fxaa_shader_modules[1], nullptr);
@@ -3305,12 +4097,12 @@ void graphics_vulkan::_create_blur_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_blur_pipelines[0]),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_blur_pipelines[0]),
         "Failed to create Vulkan graphics pipeline");
 
     orientation = 1;
 
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_blur_pipelines[1]),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_blur_pipelines[1]),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, blur_shader_modules[1], nullptr);
@@ -3518,7 +4310,7 @@ void graphics_vulkan::_create_sharpen_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_sharpen_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_sharpen_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, sharpen_shader_modules[1], nullptr);
@@ -3722,7 +4514,7 @@ void graphics_vulkan::_create_motion_blur_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_motion_blur_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_motion_blur_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, motion_blur_shader_modules[1], nullptr);
@@ -3828,21 +4620,15 @@ void graphics_vulkan::_create_fill_pipeline() {
     RB_VK(vkCreateShaderModule(_device, &fill_frag_shader_module_info, nullptr, &fill_shader_modules[1]),
         "Failed to create shader module");
 
-    struct forward_vertex {
-        vec3f position;
-        vec2f texcoord;
-        vec3f normal;
-    };
-
     VkVertexInputBindingDescription vertex_input_binding_desc;
     vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(forward_vertex);
+    vertex_input_binding_desc.stride = sizeof(packed_vertex);
     vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     VkVertexInputAttributeDescription vertex_attributes[3]{
-        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, position) },
-        { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(forward_vertex, texcoord) },
-        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, normal) }
+        { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(packed_vertex, position) },
+        { 1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(packed_vertex, texcoord) },
+        { 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(packed_vertex, normal) }
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -3991,7 +4777,7 @@ void graphics_vulkan::_create_fill_pipeline() {
     pipeline_info.renderPass = _fill_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_fill_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_fill_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, fill_shader_modules[1], nullptr);
@@ -4207,7 +4993,7 @@ void graphics_vulkan::_create_outline_pipeline() {
     pipeline_info.renderPass = _postprocess_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_outline_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_outline_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, outline_shader_modules[1], nullptr);
@@ -4222,16 +5008,88 @@ void graphics_vulkan::_create_command_pool() {
     RB_VK(vkCreateCommandPool(_device, &pool_info, nullptr, &_command_pool), "Failed to create command pool.");
 }
 
+void graphics_vulkan::_create_mesh_arena() {
+    // All meshes share single device-local vertex and index buffer, so passes bind geometry only once.
+    _mesh_arena = std::make_shared<mesh_arena_vulkan>(_transfer, _allocator,
+        static_cast<std::uint32_t>(graphics_limits::max_mesh_vertices),
+        static_cast<std::uint32_t>(graphics_limits::max_mesh_indices),
+        static_cast<std::uint32_t>(graphics_limits::max_mesh_clusters));
+}
+
 void graphics_vulkan::_create_synchronization_objects() {
     VkSemaphoreCreateInfo semaphore_info;
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphore_info.pNext = nullptr;
     semaphore_info.flags = 0;
 
-    RB_VK(vkCreateSemaphore(_device, &semaphore_info, VK_NULL_HANDLE, &_render_semaphore), "Failed to create render semaphore");
-    RB_VK(vkCreateSemaphore(_device, &semaphore_info, VK_NULL_HANDLE, &_present_semaphore), "Failed to create present semaphore");
-    RB_VK(vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, _present_semaphore, VK_NULL_HANDLE, &_image_index),
-        "Failed to reset acquire next swapchain image");
+    // Semaphores are reused by frame slot only after fence of that slot is waited.
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        RB_VK(vkCreateSemaphore(_device, &semaphore_info, VK_NULL_HANDLE, &_image_available_semaphores[i]), "Failed to create image available semaphore");
+        RB_VK(vkCreateSemaphore(_device, &semaphore_info, VK_NULL_HANDLE, &_render_finished_semaphores[i]), "Failed to create render finished semaphore");
+    }
+}
+
+void graphics_vulkan::_create_timestamp_queries() {
+    // Bits above timestampValidBits of graphics queue are undefined, zero valid bits means no timestamp support.
+    std::uint32_t queue_family_count{ 0 };
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &queue_family_count, nullptr);
+
+    auto queue_families = std::make_unique<VkQueueFamilyProperties[]>(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(_physical_device, &queue_family_count, queue_families.get());
+
+    const auto valid_bits = queue_families[_graphics_family].timestampValidBits;
+    _timestamp_mask = valid_bits >= 64 ? ~0llu : (1llu << valid_bits) - 1;
+
+    // Without timestamp support passes are still recorded, but no queries are written.
+    if (_physical_device_properties.limits.timestampComputeAndGraphics && valid_bits > 0) {
+        _timestamp_period = _physical_device_properties.limits.timestampPeriod;
+    }
+
+    VkQueryPoolCreateInfo query_pool_info;
+    query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_info.pNext = nullptr;
+    query_pool_info.flags = 0;
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = static_cast<std::uint32_t>(max_gpu_passes * 2);
+    query_pool_info.pipelineStatistics = 0;
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        RB_VK(vkCreateQueryPool(_device, &query_pool_info, nullptr, &_timestamp_query_pools[i]),
+            "Failed to create timestamp query pool");
+
+        _gpu_pass_names[i].reserve(max_gpu_passes);
+    }
+}
+
+void graphics_vulkan::_create_readback() {
+    // Readback is only needed to capture headless frames.
+    if (!settings::headless || settings::capture_directory.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(settings::capture_directory, error);
+
+    VkBufferCreateInfo readback_buffer_info;
+    readback_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    readback_buffer_info.pNext = nullptr;
+    readback_buffer_info.flags = 0;
+    readback_buffer_info.size = static_cast<VkDeviceSize>(_swapchain_extent.width) * _swapchain_extent.height * sizeof(color);
+    readback_buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    readback_buffer_info.queueFamilyIndexCount = 0;
+    readback_buffer_info.pQueueFamilyIndices = nullptr;
+
+    // Every frame in flight owns its buffer, so pixels are read only after its fence, without stalling rendering.
+    VmaAllocationCreateInfo readback_allocation_info{};
+    readback_allocation_info.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        RB_VK(vmaCreateBuffer(_allocator, &readback_buffer_info, &readback_allocation_info, &_readback_buffers[i], &_readback_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        RB_VK(vmaMapMemory(_allocator, _readback_allocations[i], &_readback_data[i]), "Failed to map readback buffer");
+    }
 }
 
 void graphics_vulkan::_create_quad() {
@@ -4288,7 +5146,7 @@ void graphics_vulkan::_create_quad() {
 }
 
 
-void graphics_vulkan::_generate_brdf_image() {
+void graphics_vulkan::_create_brdf_image(const std::vector<std::uint8_t>& pixels) {
     VkImageCreateInfo image_info;
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.pNext = nullptr;
@@ -4300,11 +5158,10 @@ void graphics_vulkan::_generate_brdf_image() {
     image_info.arrayLayers = 1;
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
-        | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.sharingMode = _transfer->sharing_mode();
+    image_info.queueFamilyIndexCount = _transfer->queue_family_count();
+    image_info.pQueueFamilyIndices = _transfer->queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info{};
@@ -4352,1316 +5209,240 @@ void graphics_vulkan::_generate_brdf_image() {
     sampler_info.unnormalizedCoordinates = VK_FALSE;
     RB_VK(vkCreateSampler(_device, &sampler_info, nullptr, &_brdf_sampler), "Failed to create Vulkan sampler");
 
-    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info;
-    descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptor_set_layout_info.pNext = nullptr;
-    descriptor_set_layout_info.flags = 0;
-    descriptor_set_layout_info.bindingCount = 0;
-    descriptor_set_layout_info.pBindings = nullptr;
-
-    VkDescriptorSetLayout descriptor_set_layout;
-    RB_VK(vkCreateDescriptorSetLayout(_device, &descriptor_set_layout_info, nullptr, &descriptor_set_layout),
-        "Failed to create Vulkan descriptor set layout");
+    // Copy pixels into staging ring before recording, because staging may submit pending uploads.
+    const auto staging = _transfer->stage(pixels.data(), pixels.size());
 
-    VkPipelineLayoutCreateInfo pipeline_layout_info;
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.pNext = nullptr;
-    pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
-    pipeline_layout_info.pushConstantRangeCount = 0;
-    pipeline_layout_info.pPushConstantRanges = nullptr;
+    auto command_buffer = _transfer->transfer_commands();
 
-    VkPipelineLayout pipeline_layout;
-    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &pipeline_layout),
-        "Failed to create Vulkan pipeline layout");
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _brdf_image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-    VkShaderModuleCreateInfo vertex_shader_module_info;
-    vertex_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vertex_shader_module_info.pNext = nullptr;
-    vertex_shader_module_info.flags = 0;
-    vertex_shader_module_info.codeSize = shaders_vulkan::quad_vert().size_bytes();
-    vertex_shader_module_info.pCode = shaders_vulkan::quad_vert().data();
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-    VkShaderModule vertex_shader_module;
-    RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &vertex_shader_module),
-        "Failed to create shader module");
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging.offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { graphics_limits::brdf_map_size, graphics_limits::brdf_map_size, 1 };
 
-    VkShaderModuleCreateInfo fragment_shader_module_info;
-    fragment_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fragment_shader_module_info.pNext = nullptr;
-    fragment_shader_module_info.flags = 0;
-    fragment_shader_module_info.codeSize = shaders_vulkan::brdf_frag().size_bytes();
-    fragment_shader_module_info.pCode = shaders_vulkan::brdf_frag().data();
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, _brdf_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
-    VkShaderModule fragment_shader_module;
-    RB_VK(vkCreateShaderModule(_device, &fragment_shader_module_info, nullptr, &fragment_shader_module),
-        "Failed to create shader module");
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = _transfer->release_access(VK_ACCESS_SHADER_READ_BIT);
 
-    VkAttachmentDescription color_attachment;
-    color_attachment.flags = 0;
-    color_attachment.format = VK_FORMAT_R8G8_UNORM;
-    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        _transfer->release_stage(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT), 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
-    VkAttachmentReference color_attachment_reference;
-    color_attachment_reference.attachment = 0;
-    color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+void graphics_vulkan::_create_skybox() {
+    const vec3f vertices[24] = {
+        { -1.0f, 1.0f, 1.0f },
+        { 1.0f, 1.0f, 1.0f },
+        { 1.0f, -1.0f, 1.0f },
+        { -1.0f, -1.0f, 1.0f },
 
-    VkSubpassDescription subpass_desc;
-    subpass_desc.flags = 0;
-    subpass_desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass_desc.inputAttachmentCount = 0;
-    subpass_desc.pInputAttachments = nullptr;
-    subpass_desc.colorAttachmentCount = 1;
-    subpass_desc.pColorAttachments = &color_attachment_reference;
-    subpass_desc.pResolveAttachments = nullptr;
-    subpass_desc.pDepthStencilAttachment = nullptr;
-    subpass_desc.preserveAttachmentCount = 0;
-    subpass_desc.pPreserveAttachments = nullptr;
+        { -1.0f, 1.0f, -1.0f },
+        { -1.0f, 1.0f, 1.0f },
+        { -1.0f, -1.0f, 1.0f },
+        { -1.0f, -1.0f, -1.0f },
 
-    VkSubpassDependency subpass_dependency;
-    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpass_dependency.dstSubpass = 0;
-    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.srcAccessMask = 0;
-    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dependencyFlags = 0;
+        { 1.0f, 1.0f, -1.0f },
+        { -1.0f, 1.0f, -1.0f },
+        { -1.0f, -1.0f, -1.0f },
+        { 1.0f, -1.0f, -1.0f },
 
-    VkRenderPassCreateInfo render_pass_info;
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.pNext = nullptr;
-    render_pass_info.flags = 0;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &color_attachment;
-    render_pass_info.subpassCount = 1;
-    render_pass_info.pSubpasses = &subpass_desc;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &subpass_dependency;
+        { 1.0f, 1.0f, 1.0f },
+        { 1.0f, 1.0f, -1.0f },
+        { 1.0f, -1.0f, -1.0f },
+        { 1.0f, -1.0f, 1.0f },
 
-    VkRenderPass render_pass;
-    RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &render_pass),
-        "Failed to create Vulkan render pass.");
+        { -1.0f, 1.0f, -1.0f },
+        { 1.0f, 1.0f, -1.0f },
+        { 1.0f, 1.0f, 1.0f },
+        { -1.0f, 1.0f, 1.0f },
 
-    struct brdf_vertex {
-        vec2f position;
+        { -1.0f, -1.0f, 1.0f },
+        { 1.0f, -1.0f, 1.0f },
+        { 1.0f, -1.0f, -1.0f },
+        { -1.0f, -1.0f, -1.0f },
     };
 
-    VkVertexInputBindingDescription vertex_input_binding_desc;
-    vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(brdf_vertex);
-    vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    const std::uint16_t indices[36] = {
+        0, 1, 2,
+        2, 3, 0,
 
-    VkVertexInputAttributeDescription vertex_attribute;
-    vertex_attribute.binding = 0;
-    vertex_attribute.location = 0;
-    vertex_attribute.format = VK_FORMAT_R32G32_SFLOAT;
-    vertex_attribute.offset = 0;
+        4, 5, 6,
+        6, 7, 4,
 
-    VkPipelineVertexInputStateCreateInfo vertex_input_info;
-    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.pNext = nullptr;
-    vertex_input_info.flags = 0;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &vertex_input_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount = 1;
-    vertex_input_info.pVertexAttributeDescriptions = &vertex_attribute;
+        8, 9, 10,
+        10, 11, 8,
 
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info;
-    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_info.pNext = nullptr;
-    input_assembly_info.flags = 0;
-    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly_info.primitiveRestartEnable = VK_FALSE;
+        12, 13, 14,
+        14, 15, 12,
 
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = graphics_limits::brdf_map_size;
-    viewport.height = graphics_limits::brdf_map_size;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+        16, 17, 18,
+        18, 19, 16,
 
-    VkRect2D scissor;
-    scissor.offset = { 0, 0 };
-    scissor.extent = { graphics_limits::brdf_map_size, graphics_limits::brdf_map_size };
+        20, 21, 22,
+        22, 23, 20
+    };
 
-    VkPipelineViewportStateCreateInfo viewport_state_info;
-    viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewport_state_info.pNext = nullptr;
-    viewport_state_info.flags = 0;
-    viewport_state_info.viewportCount = 1;
-    viewport_state_info.pViewports = &viewport;
-    viewport_state_info.scissorCount = 1;
-    viewport_state_info.pScissors = &scissor;
+    VkBufferCreateInfo vertex_buffer_info;
+    vertex_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    vertex_buffer_info.pNext = nullptr;
+    vertex_buffer_info.flags = 0;
+    vertex_buffer_info.size = sizeof(vertices);
+    vertex_buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    vertex_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    vertex_buffer_info.queueFamilyIndexCount = 0;
+    vertex_buffer_info.pQueueFamilyIndices = nullptr;
 
-    VkPipelineRasterizationStateCreateInfo rasterizer_state_info{};
-    rasterizer_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer_state_info.pNext = nullptr;
-    rasterizer_state_info.flags = 0;
-    rasterizer_state_info.depthClampEnable = VK_FALSE;
-    rasterizer_state_info.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer_state_info.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer_state_info.cullMode = VK_CULL_MODE_NONE;
-    rasterizer_state_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer_state_info.depthBiasEnable = VK_FALSE;
-    rasterizer_state_info.depthBiasConstantFactor = 0.0f;
-    rasterizer_state_info.depthBiasClamp = 0.0f;
-    rasterizer_state_info.depthBiasSlopeFactor = 0.0f;
-    rasterizer_state_info.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampling_state_info;
-    multisampling_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling_state_info.pNext = nullptr;
-    multisampling_state_info.flags = 0;
-    multisampling_state_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling_state_info.sampleShadingEnable = VK_FALSE;
-    multisampling_state_info.minSampleShading = 0.0f;
-    multisampling_state_info.pSampleMask = nullptr;
-    multisampling_state_info.alphaToCoverageEnable = VK_FALSE;
-    multisampling_state_info.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_info{};
-    depth_stencil_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_state_info.pNext = nullptr;
-    depth_stencil_state_info.flags = 0;
-    depth_stencil_state_info.depthTestEnable = VK_FALSE;
-    depth_stencil_state_info.depthWriteEnable = VK_FALSE;
-    depth_stencil_state_info.depthCompareOp = VK_COMPARE_OP_LESS;
-    depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
-    depth_stencil_state_info.stencilTestEnable = VK_FALSE;
-
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state_info{};
-    color_blend_attachment_state_info.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment_state_info.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info{};
-    color_blend_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blend_state_info.logicOpEnable = VK_FALSE;
-    color_blend_state_info.logicOp = VK_LOGIC_OP_COPY;
-    color_blend_state_info.attachmentCount = 1;
-    color_blend_state_info.pAttachments = &color_blend_attachment_state_info;
-    color_blend_state_info.blendConstants[0] = 0.0f;
-    color_blend_state_info.blendConstants[1] = 0.0f;
-    color_blend_state_info.blendConstants[2] = 0.0f;
-    color_blend_state_info.blendConstants[3] = 0.0f;
-
-    VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
-    vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = vertex_shader_module;
-    vertex_shader_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragment_shader_stage_info{};
-    fragment_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragment_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_shader_stage_info.module = fragment_shader_module;
-    fragment_shader_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shader_stages[] = {
-        vertex_shader_stage_info,
-        fragment_shader_stage_info
-    };
-
-    VkGraphicsPipelineCreateInfo pipeline_info{};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = shader_stages;
-    pipeline_info.pVertexInputState = &vertex_input_info;
-    pipeline_info.pInputAssemblyState = &input_assembly_info;
-    pipeline_info.pViewportState = &viewport_state_info;
-    pipeline_info.pRasterizationState = &rasterizer_state_info;
-    pipeline_info.pMultisampleState = &multisampling_state_info;
-    pipeline_info.pColorBlendState = &color_blend_state_info;
-    pipeline_info.pDepthStencilState = &depth_stencil_state_info;
-    pipeline_info.layout = pipeline_layout;
-    pipeline_info.renderPass = render_pass;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_info.pDynamicState = nullptr;
-
-    VkPipeline pipeline;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline),
-        "Failed to create Vulkan graphics pipeline");
-
-    VkFramebufferCreateInfo framebuffer_info;
-    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebuffer_info.pNext = nullptr;
-    framebuffer_info.flags = 0;
-    framebuffer_info.renderPass = render_pass;
-    framebuffer_info.attachmentCount = 1;
-    framebuffer_info.pAttachments = &_brdf_image_view;
-    framebuffer_info.width = graphics_limits::brdf_map_size;
-    framebuffer_info.height = graphics_limits::brdf_map_size;
-    framebuffer_info.layers = 1;
-
-    VkFramebuffer framebuffer;
-    RB_VK(vkCreateFramebuffer(_device, &framebuffer_info, nullptr, &framebuffer),
-        "Failed to create Vulkan framebuffer");
-
-    VkCommandBufferAllocateInfo allocate_info{};
-    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocate_info.commandPool = _command_pool;
-    allocate_info.commandBufferCount = 1;
-
-    VkCommandBuffer command_buffer;
-    vkAllocateCommandBuffers(_device, &allocate_info, &command_buffer);
-
-    VkCommandBufferBeginInfo begin_info;
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.pNext = nullptr;
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    begin_info.pInheritanceInfo = nullptr;
-
-    vkBeginCommandBuffer(command_buffer, &begin_info);
-
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-    VkClearValue clear_values[1]{
-        { 0.0f, 0.0f, 0.0f, 1.0f }
-    };
-
-    VkRenderPassBeginInfo render_pass_begin_info;
-    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_begin_info.pNext = nullptr;
-    render_pass_begin_info.renderPass = render_pass;
-    render_pass_begin_info.framebuffer = framebuffer;
-    render_pass_begin_info.renderArea.offset = { 0, 0 };
-    render_pass_begin_info.renderArea.extent = { graphics_limits::brdf_map_size, graphics_limits::brdf_map_size };
-    render_pass_begin_info.clearValueCount = sizeof(clear_values) / sizeof(*clear_values);
-    render_pass_begin_info.pClearValues = clear_values;
-
-    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-    const VkDeviceSize offset{ 0 };
-    vkCmdBindVertexBuffers(command_buffer, 0, 1, &_quad_vertex_buffer, &offset);
-    vkCmdBindIndexBuffer(command_buffer, _quad_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-
-    vkCmdDrawIndexed(command_buffer, 6, 1, 0, 0, 0);
-
-    vkCmdEndRenderPass(command_buffer);
-
-    vkEndCommandBuffer(command_buffer);
-
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
-
-    vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(_graphics_queue);
-
-    vkFreeCommandBuffers(_device, _command_pool, 1, &command_buffer);
-
-    vkDestroyFramebuffer(_device, framebuffer, nullptr);
-    vkDestroyPipeline(_device, pipeline, nullptr);
-    vkDestroyRenderPass(_device, render_pass, nullptr);
-    vkDestroyShaderModule(_device, vertex_shader_module, nullptr);
-    vkDestroyShaderModule(_device, fragment_shader_module, nullptr);
-    vkDestroyPipelineLayout(_device, pipeline_layout, nullptr);
-    vkDestroyDescriptorSetLayout(_device, descriptor_set_layout, nullptr);
-}
-
-void graphics_vulkan::_create_skybox() {
-    const vec3f vertices[24] = {
-        { -1.0f, 1.0f, 1.0f },
-        { 1.0f, 1.0f, 1.0f },
-        { 1.0f, -1.0f, 1.0f },
-        { -1.0f, -1.0f, 1.0f },
-
-        { -1.0f, 1.0f, -1.0f },
-        { -1.0f, 1.0f, 1.0f },
-        { -1.0f, -1.0f, 1.0f },
-        { -1.0f, -1.0f, -1.0f },
-
-        { 1.0f, 1.0f, -1.0f },
-        { -1.0f, 1.0f, -1.0f },
-        { -1.0f, -1.0f, -1.0f },
-        { 1.0f, -1.0f, -1.0f },
-
-        { 1.0f, 1.0f, 1.0f },
-        { 1.0f, 1.0f, -1.0f },
-        { 1.0f, -1.0f, -1.0f },
-        { 1.0f, -1.0f, 1.0f },
-
-        { -1.0f, 1.0f, -1.0f },
-        { 1.0f, 1.0f, -1.0f },
-        { 1.0f, 1.0f, 1.0f },
-        { -1.0f, 1.0f, 1.0f },
-
-        { -1.0f, -1.0f, 1.0f },
-        { 1.0f, -1.0f, 1.0f },
-        { 1.0f, -1.0f, -1.0f },
-        { -1.0f, -1.0f, -1.0f },
-    };
-
-    const std::uint16_t indices[36] = {
-        0, 1, 2,
-        2, 3, 0,
-
-        4, 5, 6,
-        6, 7, 4,
-
-        8, 9, 10,
-        10, 11, 8,
-
-        12, 13, 14,
-        14, 15, 12,
-
-        16, 17, 18,
-        18, 19, 16,
-
-        20, 21, 22,
-        22, 23, 20
-    };
-
-    VkBufferCreateInfo vertex_buffer_info;
-    vertex_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    vertex_buffer_info.pNext = nullptr;
-    vertex_buffer_info.flags = 0;
-    vertex_buffer_info.size = sizeof(vertices);
-    vertex_buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    vertex_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    vertex_buffer_info.queueFamilyIndexCount = 0;
-    vertex_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo vertex_allocation_info{};
-    vertex_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-    RB_VK(vmaCreateBuffer(_allocator, &vertex_buffer_info, &vertex_allocation_info, &_skybox_vertex_buffer, &_skybox_vertex_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    void* ptr;
-    RB_VK(vmaMapMemory(_allocator, _skybox_vertex_allocation, &ptr), "Failed to map memory");
-    std::memcpy(ptr, vertices, sizeof(vertices));
-    vmaUnmapMemory(_allocator, _skybox_vertex_allocation);
-
-    VkBufferCreateInfo index_buffer_info;
-    index_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    index_buffer_info.pNext = nullptr;
-    index_buffer_info.flags = 0;
-    index_buffer_info.size = sizeof(indices);
-    index_buffer_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    index_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    index_buffer_info.queueFamilyIndexCount = 0;
-    index_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo index_allocation_info{};
-    index_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-    RB_VK(vmaCreateBuffer(_allocator, &index_buffer_info, &index_allocation_info, &_skybox_index_buffer, &_skybox_index_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    RB_VK(vmaMapMemory(_allocator, _skybox_index_allocation, &ptr), "Failed to map memory");
-    std::memcpy(ptr, indices, sizeof(indices));
-    vmaUnmapMemory(_allocator, _skybox_index_allocation);
-}
-
-void graphics_vulkan::_create_irradiance_pipeline() {
-    VkDescriptorSetLayoutBinding bindings[2];
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[0].pImmutableSamplers = nullptr;
-
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[1].pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info;
-    descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptor_set_layout_info.pNext = nullptr;
-    descriptor_set_layout_info.flags = 0;
-    descriptor_set_layout_info.bindingCount = 2;
-    descriptor_set_layout_info.pBindings = bindings;
-    RB_VK(vkCreateDescriptorSetLayout(_device, &descriptor_set_layout_info, nullptr, &_irradiance_descriptor_set_layout),
-        "Failed to create Vulkan descriptor set layout");
-
-    VkDescriptorPoolSize pool_sizes[2]{
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
-    };
-
-    VkDescriptorPoolCreateInfo descriptor_pool_info;
-    descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptor_pool_info.pNext = nullptr;
-    descriptor_pool_info.flags = 0;
-    descriptor_pool_info.maxSets = 1;
-    descriptor_pool_info.poolSizeCount = 2;
-    descriptor_pool_info.pPoolSizes = pool_sizes;
-    RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_irradiance_descriptor_pool),
-        "Failed to create descriptor pool");
-
-    VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
-    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptor_set_allocate_info.pNext = nullptr;
-    descriptor_set_allocate_info.descriptorPool = _irradiance_descriptor_pool;
-    descriptor_set_allocate_info.descriptorSetCount = 1;
-    descriptor_set_allocate_info.pSetLayouts = &_irradiance_descriptor_set_layout;
-    RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_irradiance_descriptor_set),
-        "Failed to allocatore desctiptor set");
-
-    VkPipelineLayoutCreateInfo pipeline_layout_info;
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.pNext = nullptr;
-    pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &_irradiance_descriptor_set_layout;
-    pipeline_layout_info.pushConstantRangeCount = 0;
-    pipeline_layout_info.pPushConstantRanges = nullptr;
-    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_irradiance_pipeline_layout),
-        "Failed to create Vulkan pipeline layout");
-
-    VkShaderModuleCreateInfo vertex_shader_module_info;
-    vertex_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vertex_shader_module_info.pNext = nullptr;
-    vertex_shader_module_info.flags = 0;
-    vertex_shader_module_info.codeSize = shaders_vulkan::irradiance_vert().size_bytes();
-    vertex_shader_module_info.pCode = shaders_vulkan::irradiance_vert().data();
-    RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &_irradiance_shader_modules[0]),
-        "Failed to create shader module");
-
-    VkShaderModuleCreateInfo fragment_shader_module_info;
-    fragment_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fragment_shader_module_info.pNext = nullptr;
-    fragment_shader_module_info.flags = 0;
-    fragment_shader_module_info.codeSize = shaders_vulkan::irradiance_frag().size_bytes();
-    fragment_shader_module_info.pCode = shaders_vulkan::irradiance_frag().data();
-    RB_VK(vkCreateShaderModule(_device, &fragment_shader_module_info, nullptr, &_irradiance_shader_modules[1]),
-        "Failed to create shader module");
-
-    VkAttachmentDescription color_attachment;
-    color_attachment.flags = 0;
-    color_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
-    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference color_attachment_reference;
-    color_attachment_reference.attachment = 0;
-    color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass_desc;
-    subpass_desc.flags = 0;
-    subpass_desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass_desc.inputAttachmentCount = 0;
-    subpass_desc.pInputAttachments = nullptr;
-    subpass_desc.colorAttachmentCount = 1;
-    subpass_desc.pColorAttachments = &color_attachment_reference;
-    subpass_desc.pResolveAttachments = nullptr;
-    subpass_desc.pDepthStencilAttachment = nullptr;
-    subpass_desc.preserveAttachmentCount = 0;
-    subpass_desc.pPreserveAttachments = nullptr;
-
-    VkSubpassDependency subpass_dependency;
-    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpass_dependency.dstSubpass = 0;
-    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.srcAccessMask = 0;
-    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dependencyFlags = 0;
-
-    VkRenderPassCreateInfo render_pass_info;
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.pNext = nullptr;
-    render_pass_info.flags = 0;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &color_attachment;
-    render_pass_info.subpassCount = 1;
-    render_pass_info.pSubpasses = &subpass_desc;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &subpass_dependency;
-    RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_irradiance_render_pass),
-        "Failed to create Vulkan render pass.");
-
-    struct irradiance_vertex {
-        vec2f position;
-    };
-
-    VkVertexInputBindingDescription vertex_input_binding_desc;
-    vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(irradiance_vertex);
-    vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription vertex_attribute;
-    vertex_attribute.binding = 0;
-    vertex_attribute.location = 0;
-    vertex_attribute.format = VK_FORMAT_R32G32_SFLOAT;
-    vertex_attribute.offset = 0;
-
-    VkPipelineVertexInputStateCreateInfo vertex_input_info;
-    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.pNext = nullptr;
-    vertex_input_info.flags = 0;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &vertex_input_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount = 1;
-    vertex_input_info.pVertexAttributeDescriptions = &vertex_attribute;
-
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info;
-    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_info.pNext = nullptr;
-    input_assembly_info.flags = 0;
-    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly_info.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = graphics_limits::irradiance_map_size;
-    viewport.height = graphics_limits::irradiance_map_size;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset = { 0, 0 };
-    scissor.extent = { graphics_limits::irradiance_map_size, graphics_limits::irradiance_map_size };
-
-    VkPipelineViewportStateCreateInfo viewport_state_info;
-    viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewport_state_info.pNext = nullptr;
-    viewport_state_info.flags = 0;
-    viewport_state_info.viewportCount = 1;
-    viewport_state_info.pViewports = &viewport;
-    viewport_state_info.scissorCount = 1;
-    viewport_state_info.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer_state_info{};
-    rasterizer_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer_state_info.pNext = nullptr;
-    rasterizer_state_info.flags = 0;
-    rasterizer_state_info.depthClampEnable = VK_FALSE;
-    rasterizer_state_info.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer_state_info.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer_state_info.cullMode = VK_CULL_MODE_NONE;
-    rasterizer_state_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer_state_info.depthBiasEnable = VK_FALSE;
-    rasterizer_state_info.depthBiasConstantFactor = 0.0f;
-    rasterizer_state_info.depthBiasClamp = 0.0f;
-    rasterizer_state_info.depthBiasSlopeFactor = 0.0f;
-    rasterizer_state_info.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampling_state_info;
-    multisampling_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling_state_info.pNext = nullptr;
-    multisampling_state_info.flags = 0;
-    multisampling_state_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling_state_info.sampleShadingEnable = VK_FALSE;
-    multisampling_state_info.minSampleShading = 0.0f;
-    multisampling_state_info.pSampleMask = nullptr;
-    multisampling_state_info.alphaToCoverageEnable = VK_FALSE;
-    multisampling_state_info.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_info{};
-    depth_stencil_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_state_info.pNext = nullptr;
-    depth_stencil_state_info.flags = 0;
-    depth_stencil_state_info.depthTestEnable = VK_FALSE;
-    depth_stencil_state_info.depthWriteEnable = VK_FALSE;
-    depth_stencil_state_info.depthCompareOp = VK_COMPARE_OP_LESS;
-    depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
-    depth_stencil_state_info.stencilTestEnable = VK_FALSE;
-
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state_info{};
-    color_blend_attachment_state_info.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment_state_info.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info{};
-    color_blend_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blend_state_info.logicOpEnable = VK_FALSE;
-    color_blend_state_info.logicOp = VK_LOGIC_OP_COPY;
-    color_blend_state_info.attachmentCount = 1;
-    color_blend_state_info.pAttachments = &color_blend_attachment_state_info;
-    color_blend_state_info.blendConstants[0] = 0.0f;
-    color_blend_state_info.blendConstants[1] = 0.0f;
-    color_blend_state_info.blendConstants[2] = 0.0f;
-    color_blend_state_info.blendConstants[3] = 0.0f;
-
-    VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
-    vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = _irradiance_shader_modules[0];
-    vertex_shader_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragment_shader_stage_info{};
-    fragment_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragment_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_shader_stage_info.module = _irradiance_shader_modules[1];
-    fragment_shader_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shader_stages[] = {
-        vertex_shader_stage_info,
-        fragment_shader_stage_info
-    };
-
-    VkGraphicsPipelineCreateInfo pipeline_info{};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = shader_stages;
-    pipeline_info.pVertexInputState = &vertex_input_info;
-    pipeline_info.pInputAssemblyState = &input_assembly_info;
-    pipeline_info.pViewportState = &viewport_state_info;
-    pipeline_info.pRasterizationState = &rasterizer_state_info;
-    pipeline_info.pMultisampleState = &multisampling_state_info;
-    pipeline_info.pColorBlendState = &color_blend_state_info;
-    pipeline_info.pDepthStencilState = &depth_stencil_state_info;
-    pipeline_info.layout = _irradiance_pipeline_layout;
-    pipeline_info.renderPass = _irradiance_render_pass;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_info.pDynamicState = nullptr;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_irradiance_pipeline),
-        "Failed to create Vulkan graphics pipeline");
-}
-
-void graphics_vulkan::_bake_irradiance(const std::shared_ptr<environment>& environment) {
-    const auto native_environment = std::static_pointer_cast<environment_vulkan>(environment);
-
-    VkImageView irradiance_framebuffer_image_views[6];
-    VkFramebuffer irradiance_framebuffers[6];
-
-    for (auto i = 0; i < 6; ++i) {
-        VkImageViewCreateInfo image_view_info;
-        image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        image_view_info.pNext = nullptr;
-        image_view_info.flags = 0;
-        image_view_info.image = native_environment->irradiance_image();
-        image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        image_view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-        image_view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        image_view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        image_view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        image_view_info.subresourceRange.baseMipLevel = 0;
-        image_view_info.subresourceRange.levelCount = 1;
-        image_view_info.subresourceRange.baseArrayLayer = i;
-        image_view_info.subresourceRange.layerCount = 1;
-        RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &irradiance_framebuffer_image_views[i]),
-            "Failed to create Vulkan image view");
-
-        VkFramebufferCreateInfo framebuffer_info;
-        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebuffer_info.pNext = nullptr;
-        framebuffer_info.flags = 0;
-        framebuffer_info.renderPass = _irradiance_render_pass;
-        framebuffer_info.attachmentCount = 1;
-        framebuffer_info.pAttachments = &irradiance_framebuffer_image_views[i];
-        framebuffer_info.width = graphics_limits::irradiance_map_size;
-        framebuffer_info.height = graphics_limits::irradiance_map_size;
-        framebuffer_info.layers = 1;
-        RB_VK(vkCreateFramebuffer(_device, &framebuffer_info, nullptr, &irradiance_framebuffers[i]),
-            "Failed to create Vulkan framebuffer");
-    }
-
-    VkBufferCreateInfo irradiance_buffer_info;
-    irradiance_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    irradiance_buffer_info.pNext = nullptr;
-    irradiance_buffer_info.flags = 0;
-    irradiance_buffer_info.size = sizeof(irradiance_data);
-    irradiance_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    irradiance_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    irradiance_buffer_info.queueFamilyIndexCount = 0;
-    irradiance_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo allocation_info{};
-    allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    VkBuffer irradiance_buffer;
-    VmaAllocation irradiance_buffer_allocation;
-    RB_VK(vmaCreateBuffer(_allocator, &irradiance_buffer_info, &allocation_info, &irradiance_buffer, &irradiance_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    VkWriteDescriptorSet write_infos[2];
-
-    VkDescriptorBufferInfo buffer_info;
-    buffer_info.buffer = irradiance_buffer;
-    buffer_info.offset = 0;
-    buffer_info.range = sizeof(irradiance_data);
-
-    VkDescriptorImageInfo image_info;
-    image_info.sampler = native_environment->sampler();
-    image_info.imageView = native_environment->image_view();
-    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    write_infos[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_infos[0].pNext = nullptr;
-    write_infos[0].dstBinding = 0;
-    write_infos[0].dstArrayElement = 0;
-    write_infos[0].descriptorCount = 1;
-    write_infos[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write_infos[0].pBufferInfo = &buffer_info;
-    write_infos[0].pImageInfo = nullptr;
-    write_infos[0].pTexelBufferView = nullptr;
-    write_infos[0].dstSet = _irradiance_descriptor_set;
-
-    write_infos[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_infos[1].pNext = nullptr;
-    write_infos[1].dstBinding = 1;
-    write_infos[1].dstArrayElement = 0;
-    write_infos[1].descriptorCount = 1;
-    write_infos[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    write_infos[1].pBufferInfo = nullptr;
-    write_infos[1].pImageInfo = &image_info;
-    write_infos[1].pTexelBufferView = nullptr;
-    write_infos[1].dstSet = _irradiance_descriptor_set;
-
-    vkUpdateDescriptorSets(_device, 2, write_infos, 0, nullptr);
-
-    irradiance_data data;
-    for (auto i = 0; i < 6; ++i) {
-        // Create temporary buffer
-        VkCommandBufferAllocateInfo allocate_info{};
-        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocate_info.commandPool = _command_pool;
-        allocate_info.commandBufferCount = 1;
-
-        VkCommandBuffer command_buffer;
-        vkAllocateCommandBuffers(_device, &allocate_info, &command_buffer);
-
-        VkCommandBufferBeginInfo begin_info;
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        begin_info.pNext = nullptr;
-        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        begin_info.pInheritanceInfo = nullptr;
-
-        // Begin registering commands
-        vkBeginCommandBuffer(command_buffer, &begin_info);
-
-        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _irradiance_pipeline);
-        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _irradiance_pipeline_layout,
-            0, 1, &_irradiance_descriptor_set, 0, nullptr);
-
-        data.cube_face = i;
-        vkCmdUpdateBuffer(command_buffer, irradiance_buffer, 0, sizeof(irradiance_data), &data);
-
-        VkClearValue clear_values[1]{
-            { 0.0f, 0.0f, 0.0f, 1.0f }
-        };
-
-        VkRenderPassBeginInfo render_pass_begin_info;
-        render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        render_pass_begin_info.pNext = nullptr;
-        render_pass_begin_info.renderPass = _irradiance_render_pass;
-        render_pass_begin_info.framebuffer = irradiance_framebuffers[i];
-        render_pass_begin_info.renderArea.offset = { 0, 0 };
-        render_pass_begin_info.renderArea.extent = { graphics_limits::irradiance_map_size, graphics_limits::irradiance_map_size };
-        render_pass_begin_info.clearValueCount = sizeof(clear_values) / sizeof(*clear_values);
-        render_pass_begin_info.pClearValues = clear_values;
-        vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-        const VkDeviceSize offset{ 0 };
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &_quad_vertex_buffer, &offset);
-        vkCmdBindIndexBuffer(command_buffer, _quad_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-
-        vkCmdDrawIndexed(command_buffer, 6, 1, 0, 0, 0);
-
-        vkCmdEndRenderPass(command_buffer);
-
-        // End registering commands
-        vkEndCommandBuffer(command_buffer);
-
-        VkSubmitInfo submit_info{};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
-
-        vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-        vkQueueWaitIdle(_graphics_queue);
-
-        vkFreeCommandBuffers(_device, _command_pool, 1, &command_buffer);
-    }
-
-    vmaDestroyBuffer(_allocator, irradiance_buffer, irradiance_buffer_allocation);
-
-    for (auto i = 0; i < 6; ++i) {
-        vkDestroyFramebuffer(_device, irradiance_framebuffers[i], nullptr);
-        vkDestroyImageView(_device, irradiance_framebuffer_image_views[i], nullptr);
-    }
-}
-
-void graphics_vulkan::_create_prefilter_pipeline() {
-    VkDescriptorSetLayoutBinding bindings[2];
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[0].pImmutableSamplers = nullptr;
-
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[1].pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info;
-    descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptor_set_layout_info.pNext = nullptr;
-    descriptor_set_layout_info.flags = 0;
-    descriptor_set_layout_info.bindingCount = 2;
-    descriptor_set_layout_info.pBindings = bindings;
-    RB_VK(vkCreateDescriptorSetLayout(_device, &descriptor_set_layout_info, nullptr, &_prefilter_descriptor_set_layout),
-        "Failed to create Vulkan descriptor set layout");
-
-    VkDescriptorPoolSize pool_sizes[2]{
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
-    };
-
-    VkDescriptorPoolCreateInfo descriptor_pool_info;
-    descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptor_pool_info.pNext = nullptr;
-    descriptor_pool_info.flags = 0;
-    descriptor_pool_info.maxSets = 1;
-    descriptor_pool_info.poolSizeCount = 2;
-    descriptor_pool_info.pPoolSizes = pool_sizes;
-    RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_prefilter_descriptor_pool),
-        "Failed to create descriptor pool");
-
-    VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
-    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptor_set_allocate_info.pNext = nullptr;
-    descriptor_set_allocate_info.descriptorPool = _prefilter_descriptor_pool;
-    descriptor_set_allocate_info.descriptorSetCount = 1;
-    descriptor_set_allocate_info.pSetLayouts = &_prefilter_descriptor_set_layout;
-    RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_prefilter_descriptor_set),
-        "Failed to allocatore desctiptor set");
-
-    VkPipelineLayoutCreateInfo pipeline_layout_info;
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.pNext = nullptr;
-    pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &_prefilter_descriptor_set_layout;
-    pipeline_layout_info.pushConstantRangeCount = 0;
-    pipeline_layout_info.pPushConstantRanges = nullptr;
-    RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_prefilter_pipeline_layout),
-        "Failed to create Vulkan pipeline layout");
-
-    VkShaderModuleCreateInfo vertex_shader_module_info;
-    vertex_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vertex_shader_module_info.pNext = nullptr;
-    vertex_shader_module_info.flags = 0;
-    vertex_shader_module_info.codeSize = shaders_vulkan::prefilter_vert().size_bytes();
-    vertex_shader_module_info.pCode = shaders_vulkan::prefilter_vert().data();
-    RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &_prefilter_shader_modules[0]),
-        "Failed to create shader module");
-
-    VkShaderModuleCreateInfo fragment_shader_module_info;
-    fragment_shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fragment_shader_module_info.pNext = nullptr;
-    fragment_shader_module_info.flags = 0;
-    fragment_shader_module_info.codeSize = shaders_vulkan::prefilter_frag().size_bytes();
-    fragment_shader_module_info.pCode = shaders_vulkan::prefilter_frag().data();
-    RB_VK(vkCreateShaderModule(_device, &fragment_shader_module_info, nullptr, &_prefilter_shader_modules[1]),
-        "Failed to create shader module");
-
-    VkAttachmentDescription color_attachment;
-    color_attachment.flags = 0;
-    color_attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
-    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkAttachmentReference color_attachment_reference;
-    color_attachment_reference.attachment = 0;
-    color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass_desc;
-    subpass_desc.flags = 0;
-    subpass_desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass_desc.inputAttachmentCount = 0;
-    subpass_desc.pInputAttachments = nullptr;
-    subpass_desc.colorAttachmentCount = 1;
-    subpass_desc.pColorAttachments = &color_attachment_reference;
-    subpass_desc.pResolveAttachments = nullptr;
-    subpass_desc.pDepthStencilAttachment = nullptr;
-    subpass_desc.preserveAttachmentCount = 0;
-    subpass_desc.pPreserveAttachments = nullptr;
-
-    VkSubpassDependency subpass_dependency;
-    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpass_dependency.dstSubpass = 0;
-    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.srcAccessMask = 0;
-    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dependencyFlags = 0;
-
-    VkRenderPassCreateInfo render_pass_info;
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.pNext = nullptr;
-    render_pass_info.flags = 0;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &color_attachment;
-    render_pass_info.subpassCount = 1;
-    render_pass_info.pSubpasses = &subpass_desc;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &subpass_dependency;
-    RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_prefilter_render_pass),
-        "Failed to create Vulkan render pass.");
-
-    struct prefilter_vertex {
-        vec2f position;
-    };
-
-    VkVertexInputBindingDescription vertex_input_binding_desc;
-    vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(prefilter_vertex);
-    vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription vertex_attribute;
-    vertex_attribute.binding = 0;
-    vertex_attribute.location = 0;
-    vertex_attribute.format = VK_FORMAT_R32G32_SFLOAT;
-    vertex_attribute.offset = 0;
-
-    VkPipelineVertexInputStateCreateInfo vertex_input_info;
-    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.pNext = nullptr;
-    vertex_input_info.flags = 0;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &vertex_input_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount = 1;
-    vertex_input_info.pVertexAttributeDescriptions = &vertex_attribute;
-
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info;
-    input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_info.pNext = nullptr;
-    input_assembly_info.flags = 0;
-    input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly_info.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = graphics_limits::prefilter_map_size;
-    viewport.height = graphics_limits::prefilter_map_size;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset = { 0, 0 };
-    scissor.extent = { graphics_limits::prefilter_map_size, graphics_limits::prefilter_map_size };
-
-    VkPipelineViewportStateCreateInfo viewport_state_info;
-    viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewport_state_info.pNext = nullptr;
-    viewport_state_info.flags = 0;
-    viewport_state_info.viewportCount = 1;
-    viewport_state_info.pViewports = &viewport;
-    viewport_state_info.scissorCount = 1;
-    viewport_state_info.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer_state_info{};
-    rasterizer_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer_state_info.pNext = nullptr;
-    rasterizer_state_info.flags = 0;
-    rasterizer_state_info.depthClampEnable = VK_FALSE;
-    rasterizer_state_info.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer_state_info.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer_state_info.cullMode = VK_CULL_MODE_NONE;
-    rasterizer_state_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer_state_info.depthBiasEnable = VK_FALSE;
-    rasterizer_state_info.depthBiasConstantFactor = 0.0f;
-    rasterizer_state_info.depthBiasClamp = 0.0f;
-    rasterizer_state_info.depthBiasSlopeFactor = 0.0f;
-    rasterizer_state_info.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampling_state_info;
-    multisampling_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling_state_info.pNext = nullptr;
-    multisampling_state_info.flags = 0;
-    multisampling_state_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling_state_info.sampleShadingEnable = VK_FALSE;
-    multisampling_state_info.minSampleShading = 0.0f;
-    multisampling_state_info.pSampleMask = nullptr;
-    multisampling_state_info.alphaToCoverageEnable = VK_FALSE;
-    multisampling_state_info.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_info{};
-    depth_stencil_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_state_info.pNext = nullptr;
-    depth_stencil_state_info.flags = 0;
-    depth_stencil_state_info.depthTestEnable = VK_FALSE;
-    depth_stencil_state_info.depthWriteEnable = VK_FALSE;
-    depth_stencil_state_info.depthCompareOp = VK_COMPARE_OP_LESS;
-    depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
-    depth_stencil_state_info.stencilTestEnable = VK_FALSE;
+    VmaAllocationCreateInfo vertex_allocation_info{};
+    vertex_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    RB_VK(vmaCreateBuffer(_allocator, &vertex_buffer_info, &vertex_allocation_info, &_skybox_vertex_buffer, &_skybox_vertex_allocation, nullptr),
+        "Failed to create Vulkan buffer.");
 
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state_info{};
-    color_blend_attachment_state_info.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment_state_info.blendEnable = VK_FALSE;
+    void* ptr;
+    RB_VK(vmaMapMemory(_allocator, _skybox_vertex_allocation, &ptr), "Failed to map memory");
+    std::memcpy(ptr, vertices, sizeof(vertices));
+    vmaUnmapMemory(_allocator, _skybox_vertex_allocation);
 
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info{};
-    color_blend_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blend_state_info.logicOpEnable = VK_FALSE;
-    color_blend_state_info.logicOp = VK_LOGIC_OP_COPY;
-    color_blend_state_info.attachmentCount = 1;
-    color_blend_state_info.pAttachments = &color_blend_attachment_state_info;
-    color_blend_state_info.blendConstants[0] = 0.0f;
-    color_blend_state_info.blendConstants[1] = 0.0f;
-    color_blend_state_info.blendConstants[2] = 0.0f;
-    color_blend_state_info.blendConstants[3] = 0.0f;
+    VkBufferCreateInfo index_buffer_info;
+    index_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    index_buffer_info.pNext = nullptr;
+    index_buffer_info.flags = 0;
+    index_buffer_info.size = sizeof(indices);
+    index_buffer_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    index_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    index_buffer_info.queueFamilyIndexCount = 0;
+    index_buffer_info.pQueueFamilyIndices = nullptr;
 
-    VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
-    vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = _prefilter_shader_modules[0];
-    vertex_shader_stage_info.pName = "main";
+    VmaAllocationCreateInfo index_allocation_info{};
+    index_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    RB_VK(vmaCreateBuffer(_allocator, &index_buffer_info, &index_allocation_info, &_skybox_index_buffer, &_skybox_index_allocation, nullptr),
+        "Failed to create Vulkan buffer.");
 
-    VkPipelineShaderStageCreateInfo fragment_shader_stage_info{};
-    fragment_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragment_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_shader_stage_info.module = _prefilter_shader_modules[1];
-    fragment_shader_stage_info.pName = "main";
+    RB_VK(vmaMapMemory(_allocator, _skybox_index_allocation, &ptr), "Failed to map memory");
+    std::memcpy(ptr, indices, sizeof(indices));
+    vmaUnmapMemory(_allocator, _skybox_index_allocation);
+}
 
-    VkPipelineShaderStageCreateInfo shader_stages[] = {
-        vertex_shader_stage_info,
-        fragment_shader_stage_info
+void graphics_vulkan::_create_instancing() {
+    VkDescriptorSetLayoutBinding instance_bindings[4]{
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
     };
 
-    VkDynamicState dynamic_state = VK_DYNAMIC_STATE_VIEWPORT;
-
-    VkPipelineDynamicStateCreateInfo dynamic_state_info;
-    dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamic_state_info.flags = 0;
-    dynamic_state_info.pNext = nullptr;
-    dynamic_state_info.dynamicStateCount = 1;
-    dynamic_state_info.pDynamicStates = &dynamic_state;
-
-    VkGraphicsPipelineCreateInfo pipeline_info{};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = shader_stages;
-    pipeline_info.pVertexInputState = &vertex_input_info;
-    pipeline_info.pInputAssemblyState = &input_assembly_info;
-    pipeline_info.pViewportState = &viewport_state_info;
-    pipeline_info.pRasterizationState = &rasterizer_state_info;
-    pipeline_info.pMultisampleState = &multisampling_state_info;
-    pipeline_info.pColorBlendState = &color_blend_state_info;
-    pipeline_info.pDepthStencilState = &depth_stencil_state_info;
-    pipeline_info.layout = _prefilter_pipeline_layout;
-    pipeline_info.renderPass = _prefilter_render_pass;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_prefilter_pipeline),
-        "Failed to create Vulkan graphics pipeline");
-}
-
-void graphics_vulkan::_bake_prefilter(const std::shared_ptr<environment>& environment) {
-    const auto native_environment = std::static_pointer_cast<environment_vulkan>(environment);
-
-    VkImageView prefilter_framebuffer_image_views[6][6];
-    VkFramebuffer prefilter_framebuffers[6][6];
-
-    vec2u resolution{ graphics_limits::prefilter_map_size, graphics_limits::prefilter_map_size };
-    for (auto i = 0; i < 6; ++i) {
-        for (auto j = 0; j < 6; ++j) {
-            VkImageViewCreateInfo image_view_info;
-            image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-            image_view_info.pNext = nullptr;
-            image_view_info.flags = 0;
-            image_view_info.image = native_environment->prefilter_image();
-            image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-            image_view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-            image_view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-            image_view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-            image_view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-            image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-            image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_view_info.subresourceRange.baseMipLevel = i;
-            image_view_info.subresourceRange.levelCount = 1;
-            image_view_info.subresourceRange.baseArrayLayer = j;
-            image_view_info.subresourceRange.layerCount = 1;
-            RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &prefilter_framebuffer_image_views[i][j]),
-                "Failed to create Vulkan image view");
-
-            VkFramebufferCreateInfo framebuffer_info;
-            framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebuffer_info.pNext = nullptr;
-            framebuffer_info.flags = 0;
-            framebuffer_info.renderPass = _prefilter_render_pass;
-            framebuffer_info.attachmentCount = 1;
-            framebuffer_info.pAttachments = &prefilter_framebuffer_image_views[i][j];
-            framebuffer_info.width = resolution.x;
-            framebuffer_info.height = resolution.y;
-            framebuffer_info.layers = 1;
-            RB_VK(vkCreateFramebuffer(_device, &framebuffer_info, nullptr, &prefilter_framebuffers[i][j]),
-                "Failed to create Vulkan framebuffer");
-        }
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info;
+    descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptor_set_layout_info.pNext = nullptr;
+    descriptor_set_layout_info.flags = 0;
+    descriptor_set_layout_info.bindingCount = 4;
+    descriptor_set_layout_info.pBindings = instance_bindings;
+    RB_VK(vkCreateDescriptorSetLayout(_device, &descriptor_set_layout_info, nullptr, &_instance_descriptor_set_layout),
+        "Failed to create Vulkan descriptor set layout");
 
-        resolution.x = resolution.x / 2;
-        resolution.y = resolution.y / 2;
-    }
+    VkDescriptorPoolSize pool_sizes[1]{
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_command_buffers * 4 }
+    };
 
-    VkBufferCreateInfo prefilter_buffer_info;
-    prefilter_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    prefilter_buffer_info.pNext = nullptr;
-    prefilter_buffer_info.flags = 0;
-    prefilter_buffer_info.size = sizeof(prefilter_data);
-    prefilter_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    prefilter_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    prefilter_buffer_info.queueFamilyIndexCount = 0;
-    prefilter_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo prefilter_allocation_info{};
-    prefilter_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    VkBuffer prefilter_buffer;
-    VmaAllocation prefilter_buffer_allocation;
-    RB_VK(vmaCreateBuffer(_allocator, &prefilter_buffer_info, &prefilter_allocation_info, &prefilter_buffer, &prefilter_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
+    VkDescriptorPoolCreateInfo descriptor_pool_info;
+    descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_info.pNext = nullptr;
+    descriptor_pool_info.flags = 0;
+    descriptor_pool_info.maxSets = max_command_buffers;
+    descriptor_pool_info.poolSizeCount = 1;
+    descriptor_pool_info.pPoolSizes = pool_sizes;
+    RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_instance_descriptor_pool),
+        "Failed to create descriptor pool");
 
-    VkWriteDescriptorSet write_infos[2];
-
-    VkDescriptorBufferInfo buffer_info;
-    buffer_info.buffer = prefilter_buffer;
-    buffer_info.offset = 0;
-    buffer_info.range = sizeof(prefilter_data);
-
-    VkDescriptorImageInfo image_info;
-    image_info.sampler = native_environment->sampler();
-    image_info.imageView = native_environment->image_view();
-    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    write_infos[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_infos[0].pNext = nullptr;
-    write_infos[0].dstBinding = 0;
-    write_infos[0].dstArrayElement = 0;
-    write_infos[0].descriptorCount = 1;
-    write_infos[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write_infos[0].pBufferInfo = &buffer_info;
-    write_infos[0].pImageInfo = nullptr;
-    write_infos[0].pTexelBufferView = nullptr;
-    write_infos[0].dstSet = _prefilter_descriptor_set;
-
-    write_infos[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_infos[1].pNext = nullptr;
-    write_infos[1].dstBinding = 1;
-    write_infos[1].dstArrayElement = 0;
-    write_infos[1].descriptorCount = 1;
-    write_infos[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    write_infos[1].pBufferInfo = nullptr;
-    write_infos[1].pImageInfo = &image_info;
-    write_infos[1].pTexelBufferView = nullptr;
-    write_infos[1].dstSet = _prefilter_descriptor_set;
-
-    vkUpdateDescriptorSets(_device, 2, write_infos, 0, nullptr);
-
-    prefilter_data data;
-
-    resolution = { graphics_limits::prefilter_map_size, graphics_limits::prefilter_map_size };
-    for (auto i = 0; i < 6; ++i) {
-        for (auto j = 0; j < 6; ++j) {
-            // Create temporary buffer
-            VkCommandBufferAllocateInfo allocate_info{};
-            allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            allocate_info.commandPool = _command_pool;
-            allocate_info.commandBufferCount = 1;
-
-            VkCommandBuffer command_buffer;
-            vkAllocateCommandBuffers(_device, &allocate_info, &command_buffer);
-
-            VkCommandBufferBeginInfo begin_info;
-            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin_info.pNext = nullptr;
-            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            begin_info.pInheritanceInfo = nullptr;
-
-            // Begin registering commands
-            vkBeginCommandBuffer(command_buffer, &begin_info);
-
-            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _prefilter_pipeline);
-            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _prefilter_pipeline_layout,
-                0, 1, &_prefilter_descriptor_set, 0, nullptr);
-
-            data.cube_face = j;
-            data.roughness = i / 5.0f;
-            vkCmdUpdateBuffer(command_buffer, prefilter_buffer, 0, sizeof(prefilter_data), &data);
-
-            VkClearValue clear_values[1]{
-                { 0.0f, 0.0f, 0.0f, 1.0f }
-            };
-
-            VkViewport viewport;
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(resolution.x);
-            viewport.height = static_cast<float>(resolution.y);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-            VkRenderPassBeginInfo render_pass_begin_info;
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.pNext = nullptr;
-            render_pass_begin_info.renderPass = _prefilter_render_pass;
-            render_pass_begin_info.framebuffer = prefilter_framebuffers[i][j];
-            render_pass_begin_info.renderArea.offset = { 0, 0 };
-            render_pass_begin_info.renderArea.extent = { resolution.x, resolution.y };
-            render_pass_begin_info.clearValueCount = sizeof(clear_values) / sizeof(*clear_values);
-            render_pass_begin_info.pClearValues = clear_values;
-            vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-            const VkDeviceSize offset{ 0 };
-            vkCmdBindVertexBuffers(command_buffer, 0, 1, &_quad_vertex_buffer, &offset);
-            vkCmdBindIndexBuffer(command_buffer, _quad_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-
-            vkCmdDrawIndexed(command_buffer, 6, 1, 0, 0, 0);
-
-            vkCmdEndRenderPass(command_buffer);
-
-            // End registering commands
-            vkEndCommandBuffer(command_buffer);
-
-            VkSubmitInfo submit_info{};
-            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submit_info.commandBufferCount = 1;
-            submit_info.pCommandBuffers = &command_buffer;
-
-            vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-            vkQueueWaitIdle(_graphics_queue);
-
-            vkFreeCommandBuffers(_device, _command_pool, 1, &command_buffer);
-        }
+    // Every command buffer in flight gets its own instance buffer, so CPU never overwrites data that GPU still reads.
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        VkBufferCreateInfo buffer_info;
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.pNext = nullptr;
+        buffer_info.flags = 0;
+        buffer_info.size = graphics_limits::max_instances * sizeof(instance_data);
+        buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        buffer_info.queueFamilyIndexCount = 0;
+        buffer_info.pQueueFamilyIndices = nullptr;
+
+        VmaAllocationCreateInfo allocation_info{};
+        allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &_instance_buffers[i], &_instance_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        void* mapped_data;
+        RB_VK(vmaMapMemory(_allocator, _instance_allocations[i], &mapped_data), "Failed to map instance buffer");
+        _instance_data[i] = static_cast<instance_data*>(mapped_data);
+
+        // Visible instances are reserved per command when batches are culled, clustered batches fall back to lods when out of space.
+        buffer_info.size = graphics_limits::max_instances * graphics_limits::max_mesh_lods * sizeof(std::uint32_t);
+        buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+        allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &_visible_instance_buffers[i], &_visible_instance_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        // Draw commands are written by CPU and instance counts are accumulated by culling shader.
+        buffer_info.size = graphics_limits::max_draw_commands * sizeof(VkDrawIndexedIndirectCommand);
+        buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+        allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &_draw_command_buffers[i], &_draw_command_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        RB_VK(vmaMapMemory(_allocator, _draw_command_allocations[i], &mapped_data), "Failed to map draw command buffer");
+        _draw_commands[i] = static_cast<VkDrawIndexedIndirectCommand*>(mapped_data);
+
+        VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
+        descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptor_set_allocate_info.pNext = nullptr;
+        descriptor_set_allocate_info.descriptorPool = _instance_descriptor_pool;
+        descriptor_set_allocate_info.descriptorSetCount = 1;
+        descriptor_set_allocate_info.pSetLayouts = &_instance_descriptor_set_layout;
+        RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_instance_descriptor_sets[i]),
+            "Failed to allocatore desctiptor set");
+
+        // Clusters are shared by every frame, mesh arena defers their reuse until frames complete.
+        VkDescriptorBufferInfo buffer_infos[4]{
+            { _instance_buffers[i], 0, VK_WHOLE_SIZE },
+            { _visible_instance_buffers[i], 0, VK_WHOLE_SIZE },
+            { _draw_command_buffers[i], 0, VK_WHOLE_SIZE },
+            { _mesh_arena->cluster_buffer(), 0, VK_WHOLE_SIZE },
+        };
 
-        resolution.x = resolution.x / 2;
-        resolution.y = resolution.y / 2;
-    }
+        VkWriteDescriptorSet write_infos[4]{
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _instance_descriptor_sets[i], 0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[0], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _instance_descriptor_sets[i], 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[1], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _instance_descriptor_sets[i], 2, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[2], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _instance_descriptor_sets[i], 3, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[3], nullptr },
+        };
 
-    vmaDestroyBuffer(_allocator, prefilter_buffer, prefilter_buffer_allocation);
-    for (auto i = 0; i < 6; ++i) {
-        for (auto j = 0; j < 6; ++j) {
-            vkDestroyFramebuffer(_device, prefilter_framebuffers[i][j], nullptr);
-            vkDestroyImageView(_device, prefilter_framebuffer_image_views[i][j], nullptr);
-        }
+        vkUpdateDescriptorSets(_device, 4, write_infos, 0, nullptr);
     }
 }
 
@@ -5679,7 +5460,7 @@ void graphics_vulkan::_create_shadow_map() {
     image_info.arrayLayers = graphics_limits::max_shadow_cascades;
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     image_info.queueFamilyIndexCount = 0;
     image_info.pQueueFamilyIndices = 0;
@@ -5824,8 +5605,8 @@ void graphics_vulkan::_create_shadow_map() {
     pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipeline_layout_info.pNext = nullptr;
     pipeline_layout_info.flags = 0;
-    pipeline_layout_info.setLayoutCount = 0;
-    pipeline_layout_info.pSetLayouts = nullptr;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &_instance_descriptor_set_layout;
     pipeline_layout_info.pushConstantRangeCount = 1;
     pipeline_layout_info.pPushConstantRanges = &push_constant_range;
     RB_VK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_shadow_pipeline_layout),
@@ -5840,21 +5621,15 @@ void graphics_vulkan::_create_shadow_map() {
     RB_VK(vkCreateShaderModule(_device, &vertex_shader_module_info, nullptr, &_shadow_shader_module),
         "Failed to create shader module");
 
-    struct forward_vertex {
-        vec3f position;
-        vec2f texcoord;
-        vec3f normal;
-    };
-
     VkVertexInputBindingDescription vertex_input_binding_desc;
     vertex_input_binding_desc.binding = 0;
-    vertex_input_binding_desc.stride = sizeof(forward_vertex);
+    vertex_input_binding_desc.stride = sizeof(packed_vertex);
     vertex_input_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     VkVertexInputAttributeDescription vertex_attributes[3]{
-        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, position) },
-        { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(forward_vertex, texcoord) },
-        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(forward_vertex, normal) }
+        { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(packed_vertex, position) },
+        { 1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(packed_vertex, texcoord) },
+        { 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(packed_vertex, normal) }
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -5920,55 +5695,184 @@ void graphics_vulkan::_create_shadow_map() {
     multisampling_state_info.alphaToCoverageEnable = VK_FALSE;
     multisampling_state_info.alphaToOneEnable = VK_FALSE;
 
-    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_info{};
-    depth_stencil_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_state_info.pNext = nullptr;
-    depth_stencil_state_info.flags = 0;
-    depth_stencil_state_info.depthTestEnable = VK_TRUE;
-    depth_stencil_state_info.depthWriteEnable = VK_TRUE;
-    depth_stencil_state_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-    depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
-    depth_stencil_state_info.stencilTestEnable = VK_FALSE;
-    depth_stencil_state_info.back.compareOp = VK_COMPARE_OP_ALWAYS;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_state_info{};
+    depth_stencil_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil_state_info.pNext = nullptr;
+    depth_stencil_state_info.flags = 0;
+    depth_stencil_state_info.depthTestEnable = VK_TRUE;
+    depth_stencil_state_info.depthWriteEnable = VK_TRUE;
+    depth_stencil_state_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depth_stencil_state_info.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil_state_info.stencilTestEnable = VK_FALSE;
+    depth_stencil_state_info.back.compareOp = VK_COMPARE_OP_ALWAYS;
+
+    VkPipelineColorBlendStateCreateInfo color_blend_state_info{};
+    color_blend_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend_state_info.logicOpEnable = VK_FALSE;
+    color_blend_state_info.logicOp = VK_LOGIC_OP_CLEAR;
+    color_blend_state_info.attachmentCount = 0;
+    color_blend_state_info.pAttachments = nullptr;
+    color_blend_state_info.blendConstants[0] = 0.0f;
+    color_blend_state_info.blendConstants[1] = 0.0f;
+    color_blend_state_info.blendConstants[2] = 0.0f;
+    color_blend_state_info.blendConstants[3] = 0.0f;
+
+    VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
+    vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertex_shader_stage_info.module = _shadow_shader_module;
+    vertex_shader_stage_info.pName = "main";
+
+    VkPipelineShaderStageCreateInfo shader_stages[] = {
+        vertex_shader_stage_info
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 1;
+    pipeline_info.pStages = shader_stages;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly_info;
+    pipeline_info.pViewportState = &viewport_state_info;
+    pipeline_info.pRasterizationState = &rasterizer_state_info;
+    pipeline_info.pMultisampleState = &multisampling_state_info;
+    pipeline_info.pColorBlendState = &color_blend_state_info;
+    pipeline_info.pDepthStencilState = &depth_stencil_state_info;
+    pipeline_info.layout = _shadow_pipeline_layout;
+    pipeline_info.renderPass = _shadow_render_pass;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.pDynamicState = nullptr;
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_shadow_pipeline),
+        "Failed to create Vulkan graphics pipeline");
+}
+
+void graphics_vulkan::_create_shadow_cache() {
+    const auto depth_format = _get_supported_shadow_format();
+
+    VkImageCreateInfo image_info;
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.pNext = nullptr;
+    image_info.flags = 0;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = depth_format;
+    image_info.extent = { graphics_limits::shadow_map_size, graphics_limits::shadow_map_size, 1 };
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = cached_shadow_cascades;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.queueFamilyIndexCount = 0;
+    image_info.pQueueFamilyIndices = 0;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    RB_VK(vmaCreateImage(_allocator, &image_info, &allocation_info, &_shadow_cache_image, &_shadow_cache_allocation, nullptr),
+        "Failed to create Vulkan image.");
+
+    for (auto i = 0u; i < cached_shadow_cascades; ++i) {
+        VkImageViewCreateInfo image_view_info;
+        image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_info.pNext = nullptr;
+        image_view_info.flags = 0;
+        image_view_info.image = _shadow_cache_image;
+        image_view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_info.format = depth_format;
+        image_view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        image_view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        image_view_info.subresourceRange.baseMipLevel = 0;
+        image_view_info.subresourceRange.levelCount = 1;
+        image_view_info.subresourceRange.baseArrayLayer = i;
+        image_view_info.subresourceRange.layerCount = 1;
+        RB_VK(vkCreateImageView(_device, &image_view_info, nullptr, &_shadow_cache_image_views[i]),
+            "Failed to create Vulkan image view");
+    }
+
+    // Both render passes are compatible with shadow render pass, so they share shadow pipeline.
+    VkAttachmentDescription attachment_description{};
+    attachment_description.format = depth_format;
+    attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment_description.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;			// Cached depth is only copied into shadow map
+
+    VkAttachmentReference depth_reference{};
+    depth_reference.attachment = 0;
+    depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depth_reference;
+
+    std::array<VkSubpassDependency, 2> dependencies;
+
+    // Copies recorded by previous frames have to finish before cache is overwritten.
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = 0;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    dependencies[1].dependencyFlags = 0;
 
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info{};
-    color_blend_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    color_blend_state_info.logicOpEnable = VK_FALSE;
-    color_blend_state_info.logicOp = VK_LOGIC_OP_CLEAR;
-    color_blend_state_info.attachmentCount = 0;
-    color_blend_state_info.pAttachments = nullptr;
-    color_blend_state_info.blendConstants[0] = 0.0f;
-    color_blend_state_info.blendConstants[1] = 0.0f;
-    color_blend_state_info.blendConstants[2] = 0.0f;
-    color_blend_state_info.blendConstants[3] = 0.0f;
+    VkRenderPassCreateInfo render_pass_info{};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &attachment_description;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    render_pass_info.pDependencies = dependencies.data();
+    RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_shadow_cache_render_pass),
+        "Failed to create render pass.");
 
-    VkPipelineShaderStageCreateInfo vertex_shader_stage_info{};
-    vertex_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_shader_stage_info.module = _shadow_shader_module;
-    vertex_shader_stage_info.pName = "main";
+    // Composite pass keeps copied static depth and leaves cascade ready for sampling.
+    attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment_description.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    attachment_description.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
-    VkPipelineShaderStageCreateInfo shader_stages[] = {
-        vertex_shader_stage_info
-    };
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-    VkGraphicsPipelineCreateInfo pipeline_info{};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 1;
-    pipeline_info.pStages = shader_stages;
-    pipeline_info.pVertexInputState = &vertex_input_info;
-    pipeline_info.pInputAssemblyState = &input_assembly_info;
-    pipeline_info.pViewportState = &viewport_state_info;
-    pipeline_info.pRasterizationState = &rasterizer_state_info;
-    pipeline_info.pMultisampleState = &multisampling_state_info;
-    pipeline_info.pColorBlendState = &color_blend_state_info;
-    pipeline_info.pDepthStencilState = &depth_stencil_state_info;
-    pipeline_info.layout = _shadow_pipeline_layout;
-    pipeline_info.renderPass = _shadow_render_pass;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_info.pDynamicState = nullptr;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_shadow_pipeline),
-        "Failed to create Vulkan graphics pipeline");
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    RB_VK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_shadow_composite_render_pass),
+        "Failed to create render pass.");
+
+    for (auto i = 0u; i < cached_shadow_cascades; ++i) {
+        VkFramebufferCreateInfo framebuffer_info;
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.pNext = nullptr;
+        framebuffer_info.flags = 0;
+        framebuffer_info.renderPass = _shadow_cache_render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = &_shadow_cache_image_views[i];
+        framebuffer_info.width = graphics_limits::shadow_map_size;
+        framebuffer_info.height = graphics_limits::shadow_map_size;
+        framebuffer_info.layers = 1;
+        RB_VK(vkCreateFramebuffer(_device, &framebuffer_info, nullptr, &_shadow_cache_framebuffers[i]),
+            "Failed to create Vulkan framebuffer");
+    }
 }
 
 void graphics_vulkan::_create_skybox_pipeline() {
@@ -6158,7 +6062,7 @@ void graphics_vulkan::_create_skybox_pipeline() {
     pipeline_info.renderPass = _forward_render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_skybox_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_skybox_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, skybox_shader_modules[1], nullptr);
@@ -6347,7 +6251,7 @@ void graphics_vulkan::_create_present_pipeline() {
     pipeline_info.renderPass = _render_pass;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.pDynamicState = &dynamic_state_info;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_present_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_present_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     layouts[0] = _forward_descriptor_set_layout;
@@ -6358,7 +6262,7 @@ void graphics_vulkan::_create_present_pipeline() {
     pipeline_info.layout = _forward_copy_pipeline_layout;
 
     pipeline_info.renderPass = _postprocess_render_pass;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_forward_copy_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_forward_copy_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     VkPipelineColorBlendAttachmentState attachments[]{
@@ -6372,13 +6276,333 @@ void graphics_vulkan::_create_present_pipeline() {
     pipeline_info.layout = _present_pipeline_layout;
 
     pipeline_info.renderPass = _forward_render_pass;
-    RB_VK(vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &_light_copy_pipeline),
+    RB_VK(vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_info, nullptr, &_light_copy_pipeline),
         "Failed to create Vulkan graphics pipeline");
 
     vkDestroyShaderModule(_device, shader_modules[1], nullptr);
     vkDestroyShaderModule(_device, shader_modules[0], nullptr);
 }
 
+void graphics_vulkan::_sort_instance_draws() {
+    RB_PROFILE_ZONE("graphics_vulkan::_sort_instance_draws");
+
+    // Every pass and cascade records mostly the same keys, so keys keep their ranks and draws are only bucketed by rank.
+    auto dirty = false;
+    _instance_draw_ranks.resize(_instance_draws.size());
+    for (std::size_t i{ 0 }; i < _instance_draws.size(); ++i) {
+        const auto& draw = _instance_draws[i];
+        const auto flags = material_sort_flags(draw.material);
+        const auto index_type = static_cast<const mesh_vulkan*>(draw.mesh)->index_type();
+
+        auto key = hash_bytes(14695981039346656037llu, &draw.mesh, sizeof(draw.mesh));
+        key = hash_bytes(key, &flags, sizeof(flags));
+        key = hash_bytes(key, &index_type, sizeof(index_type));
+        key = hash_bytes(key, &draw.lod_index, sizeof(draw.lod_index));
+
+        auto [it, inserted] = _instance_batch_ranks.try_emplace(key, instance_batch_rank{ draw.mesh, flags, index_type, draw.lod_index, 0, 0 });
+        it->second.frame = _instance_batch_frame;
+        dirty |= inserted;
+        _instance_draw_ranks[i] = &it->second;
+    }
+
+    // Sort by material flags first, because pipeline switches are the most expensive.
+    // Materials themselves are bindless, so draws of different materials can share batch.
+    if (dirty) {
+        std::vector<instance_batch_rank*> order;
+        order.reserve(_instance_batch_ranks.size());
+        for (auto it = _instance_batch_ranks.begin(); it != _instance_batch_ranks.end();) {
+            if (it->second.frame + 1 < _instance_batch_frame) {
+                it = _instance_batch_ranks.erase(it);
+            } else {
+                order.push_back(&it->second);
+                ++it;
+            }
+        }
+
+        std::sort(order.begin(), order.end(), [](const instance_batch_rank* a, const instance_batch_rank* b) {
+            if (a->material_flags != b->material_flags) {
+                return a->material_flags < b->material_flags;
+            }
+            if (a->index_type != b->index_type) {
+                return a->index_type < b->index_type;
+            }
+            if (a->mesh != b->mesh) {
+                return a->mesh < b->mesh;
+            }
+            return a->lod_index < b->lod_index;
+        });
+
+        for (std::size_t i{ 0 }; i < order.size(); ++i) {
+            order[i]->rank = static_cast<std::uint32_t>(i);
+        }
+    }
+
+    _instance_rank_offsets.assign(_instance_batch_ranks.size() + 1, 0);
+    for (const auto rank : _instance_draw_ranks) {
+        ++_instance_rank_offsets[rank->rank + 1];
+    }
+    for (std::size_t i{ 1 }; i < _instance_rank_offsets.size(); ++i) {
+        _instance_rank_offsets[i] += _instance_rank_offsets[i - 1];
+    }
+
+    _sorted_instance_draws.resize(_instance_draws.size());
+    for (std::size_t i{ 0 }; i < _instance_draws.size(); ++i) {
+        _sorted_instance_draws[_instance_rank_offsets[_instance_draw_ranks[i]->rank]++] = _instance_draws[i];
+    }
+    std::swap(_instance_draws, _sorted_instance_draws);
+}
+
+std::size_t graphics_vulkan::_find_instance_batch_end(std::size_t first) const {
+    const auto& draw = _instance_draws[first];
+
+    auto last = first + 1;
+    while (last < _instance_draws.size() &&
+        material_sort_flags(_instance_draws[last].material) == material_sort_flags(draw.material) &&
+        _instance_draws[last].mesh == draw.mesh &&
+        _instance_draws[last].lod_index == draw.lod_index) {
+        ++last;
+    }
+    return last;
+}
+
+void graphics_vulkan::_cull_instance_draws(const mat4f& proj_view, bool fixed_lod, std::vector<indirect_batch>& batches) {
+    RB_PROFILE_ZONE("graphics_vulkan::_cull_instance_draws");
+
+    batches.clear();
+
+    _sort_instance_draws();
+
+    const auto first_instance = _instance_count;
+
+    for (std::size_t first{ 0 }, last{ 0 }; first < _instance_draws.size(); first = last) {
+        last = _find_instance_batch_end(first);
+
+        const auto& draw = _instance_draws[first];
+        const auto native_mesh = static_cast<const mesh_vulkan*>(draw.mesh);
+        if (!native_mesh->resident()) {
+            continue;
+        }
+
+        const auto lods = native_mesh->lods();
+
+        // With fixed lod every batch has single draw command using recorded lod.
+        // Otherwise every lod gets its own command and culling shader picks one per instance.
+        const auto lod_count = static_cast<std::uint32_t>(fixed_lod ? 1 : lods.size());
+        const auto instance_count = static_cast<std::uint32_t>(last - first);
+
+        // Clustered base lod gets command per cluster instead, so culling shader can skip hidden clusters.
+        // Batch falls back to whole lods when clusters would not fit into frame budgets.
+        const auto clusters = native_mesh->clusters();
+        auto cluster_count = fixed_lod ? 0 : native_mesh->cluster_count();
+        if (cluster_count > 0 &&
+            (_draw_command_count + cluster_count + lod_count - 1 > graphics_limits::max_draw_commands ||
+            _visible_instance_count + instance_count * (cluster_count + lod_count - 1) > graphics_limits::max_instances * graphics_limits::max_mesh_lods)) {
+            cluster_count = 0;
+        }
+
+        const auto command_count = cluster_count > 0 ? cluster_count + lod_count - 1 : lod_count;
+
+        // Buffers are bound to descriptor sets of frames in flight, so they cannot grow here.
+        // Remaining draws are dropped and reported once per frame in end.
+        if (_instance_count + instance_count > graphics_limits::max_instances ||
+            _draw_command_count + command_count > graphics_limits::max_draw_commands ||
+            _visible_instance_count + instance_count * command_count > graphics_limits::max_instances * graphics_limits::max_mesh_lods) {
+            _dropped_instance_draws += _instance_draws.size() - first;
+            break;
+        }
+
+        // Every command reserves space for whole batch in visible instance buffer.
+        for (std::uint32_t i{ 0 }; i < command_count; ++i) {
+            auto& command = _draw_commands[_command_index][_draw_command_count + i];
+            if (i < cluster_count) {
+                // Clusters index into base lod.
+                command.indexCount = clusters[i].index_count;
+                command.firstIndex = native_mesh->index_offset() + clusters[i].first_index;
+            } else {
+                const auto& lod = lods[fixed_lod ? draw.lod_index : i - (cluster_count > 0 ? cluster_count - 1 : 0)];
+                command.indexCount = lod.size;
+                command.firstIndex = native_mesh->index_offset() + lod.offset;
+            }
+            command.instanceCount = 0;
+            command.vertexOffset = static_cast<std::int32_t>(native_mesh->vertex_offset());
+            command.firstInstance = _visible_instance_count;
+
+            _visible_instance_count += instance_count;
+        }
+
+        const auto& bsphere = draw.mesh->bsphere();
+        const auto& quantization = draw.mesh->quantization();
+        const auto cone_culling = (material_sort_flags(draw.material) & material_flags::double_sided_bit) == 0;
+        for (auto i = first; i < last; ++i) {
+            auto& instance = _instance_data[_command_index][_instance_count++];
+            instance.world = _instance_draws[i].world;
+            instance.bsphere = { bsphere.position.x, bsphere.position.y, bsphere.position.z, bsphere.radius };
+            instance.command_index = _draw_command_count;
+            instance.lod_count = lod_count;
+            instance.material_index = material_index(_instance_draws[i].material);
+            instance.cluster_count = cluster_count;
+            instance.position_offset = quantization.offset;
+            instance.first_cluster = native_mesh->cluster_offset();
+            instance.position_scale = quantization.scale;
+            instance.cone_culling = cone_culling ? 1 : 0;
+        }
+
+        batches.push_back({ draw.mesh, draw.material, _draw_command_count, command_count });
+        _draw_command_count += command_count;
+    }
+
+    _instance_draws.clear();
+
+    const auto instance_count = _instance_count - first_instance;
+    if (instance_count == 0) {
+        return;
+    }
+
+    cull_data cull_data;
+    for (auto i = 0u; i < 6u; ++i) {
+        const auto plane = frustum_plane(proj_view, static_cast<frustum_plane_index>(i));
+        cull_data.frustum_planes[i] = { plane.normal.x, plane.normal.y, plane.normal.z, plane.d };
+    }
+    cull_data.first_instance = first_instance;
+    cull_data.instance_count = instance_count;
+    cull_data.fixed_lod = fixed_lod ? 1 : 0;
+    cull_data.padding = 0.0f;
+    cull_data.z_near = _camera_z_near;
+    cull_data.z_far = _camera_z_far;
+
+    VkDescriptorSet descriptor_sets[]{
+        _main_descriptor_sets[_command_index],
+        _instance_descriptor_sets[_command_index]
+    };
+
+    vkCmdBindDescriptorSets(_command_buffers[_command_index],
+        VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline_layout, 0, 2, descriptor_sets,
+        0, nullptr);
+
+    vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+
+    vkCmdPushConstants(_command_buffers[_command_index], _cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(cull_data), &cull_data);
+
+    vkCmdDispatch(_command_buffers[_command_index], (instance_count + 63) / 64, 1, 1);
+
+    // Draw commands and visible instances are consumed by indirect draws and vertex shaders.
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(_command_buffers[_command_index],
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void graphics_vulkan::_draw_indirect(const indirect_batch& batch) {
+    const auto stride = static_cast<std::uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+    const auto offset = batch.first_command * sizeof(VkDrawIndexedIndirectCommand);
+
+    // Batches are sorted by index type, so index buffer changes at most once per pipeline.
+    _bind_mesh_indices(static_cast<const mesh_vulkan*>(batch.mesh)->index_type());
+
+    if (_multi_draw_indirect) {
+        vkCmdDrawIndexedIndirect(_command_buffers[_command_index], _draw_command_buffers[_command_index], offset, batch.command_count, stride);
+    } else {
+        for (std::uint32_t i{ 0 }; i < batch.command_count; ++i) {
+            vkCmdDrawIndexedIndirect(_command_buffers[_command_index], _draw_command_buffers[_command_index], offset + i * stride, 1, stride);
+        }
+    }
+}
+
+void graphics_vulkan::_draw_depth_batches(const std::vector<indirect_batch>& batches) {
+    if (batches.empty()) {
+        return;
+    }
+
+    _bind_mesh_arena();
+
+    for (const auto& batch : batches) {
+        _draw_indirect(batch);
+    }
+}
+
+void graphics_vulkan::_draw_forward_batches(const std::shared_ptr<viewport>& viewport, const std::vector<indirect_batch>& batches) {
+    const auto native_viewport = std::static_pointer_cast<viewport_vulkan>(viewport);
+
+    std::uint64_t internal_flags = 0;
+    if (native_viewport->has_shadows()) {
+        internal_flags |= graphics_vulkan_flags::shadow_map_bit;
+    }
+
+    if (batches.empty()) {
+        return;
+    }
+
+    // Skybox binds its own geometry between opaque and translucent batches, so arena is bound per call.
+    _bind_mesh_arena();
+
+    // Every material lives in one descriptor set, so sets are bound once and batches switch only pipelines.
+    VkDescriptorSet descriptor_sets[]{
+        _main_descriptor_sets[_command_index],
+        _material_arena->descriptor_set(),
+        _environment->descriptor_set(),
+        native_viewport->light_descriptor_set(),
+        _instance_descriptor_sets[_command_index]
+    };
+
+    vkCmdBindDescriptorSets(_command_buffers[_command_index],
+        VK_PIPELINE_BIND_POINT_GRAPHICS, _forward_pipeline_layout, 0, 5, descriptor_sets,
+        0, nullptr);
+
+    VkPipeline bound_pipeline{ VK_NULL_HANDLE };
+    for (const auto& batch : batches) {
+        const auto pipeline = _get_forward_pipeline(batch.material, internal_flags);
+        if (pipeline != bound_pipeline) {
+            vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+
+        _draw_indirect(batch);
+    }
+}
+
+void graphics_vulkan::_bind_mesh_arena() {
+    VkDeviceSize offset{ 0 };
+    VkBuffer buffer{ _mesh_arena->vertex_buffer() };
+    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &buffer, &offset);
+
+    // Index buffer depends on drawn meshes, so it is bound lazily.
+    _bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+}
+
+void graphics_vulkan::_bind_mesh_indices(VkIndexType index_type) {
+    if (index_type != _bound_index_type) {
+        vkCmdBindIndexBuffer(_command_buffers[_command_index], _mesh_arena->index_buffer(index_type), 0, index_type);
+        _bound_index_type = index_type;
+    }
+}
+
+void graphics_vulkan::_draw_skybox() {
+    if (!_environment) {
+        return;
+    }
+
+    vkCmdBindPipeline(_command_buffers[_command_index], VK_PIPELINE_BIND_POINT_GRAPHICS, _skybox_pipeline);
+
+    VkDescriptorSet descriptor_sets[]{
+        _main_descriptor_sets[_command_index],
+        _environment->descriptor_set()
+    };
+
+    vkCmdBindDescriptorSets(_command_buffers[_command_index],
+        VK_PIPELINE_BIND_POINT_GRAPHICS, _skybox_pipeline_layout, 0, 2, descriptor_sets,
+        0, nullptr);
+
+    VkDeviceSize offset{ 0 };
+    vkCmdBindVertexBuffers(_command_buffers[_command_index], 0, 1, &_skybox_vertex_buffer, &offset);
+    vkCmdBindIndexBuffer(_command_buffers[_command_index], _skybox_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+    vkCmdDrawIndexed(_command_buffers[_command_index], 36, 1, 0, 0, 0);
+}
+
 void graphics_vulkan::_create_command_buffers() {
     VkCommandBufferAllocateInfo command_buffer_alloc_info;
     command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -6403,8 +6627,18 @@ void graphics_vulkan::_create_command_buffers() {
 VkCommandBuffer graphics_vulkan::_command_begin() {
     _command_index = (_command_index + 1) % max_command_buffers;
 
-    RB_VK(vkWaitForFences(_device, 1, &_fences[_command_index], VK_TRUE, 1000000000),
-        "Failed to wait for render fence");
+    // Sample frames that finished meanwhile, before blocking adds its time to their latency.
+    _update_frame_latency();
+
+    {
+        RB_PROFILE_ZONE("graphics_vulkan::wait_for_fence");
+        RB_VK(vkWaitForFences(_device, 1, &_fences[_command_index], VK_TRUE, 1000000000),
+            "Failed to wait for render fence");
+    }
+
+    _update_frame_latency();
+
+    _collect_readback(_command_index);
 
     RB_VK(vkResetFences(_device, 1, &_fences[_command_index]), "Failed to reset render fence");
 
@@ -6428,20 +6662,164 @@ void graphics_vulkan::_command_end() {
     // Finalize the command buffer (we can no longer add commands, but it can now be executed)
     RB_VK(vkEndCommandBuffer(_command_buffers[_command_index]), "Failed to end command buffer");
 
+    // Only writes to swapchain image wait for acquire, so depth, shadow and culling passes overlap presentation engine.
     VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submit_info;
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submit_info.pNext = nullptr;
-    submit_info.waitSemaphoreCount = 0;
-    submit_info.pWaitSemaphores = nullptr;
-    submit_info.pWaitDstStageMask = nullptr;
+    // Headless frames are neither acquired nor presented, so there is nothing to wait for or signal.
+    submit_info.waitSemaphoreCount = settings::headless ? 0 : 1;
+    submit_info.pWaitSemaphores = &_image_available_semaphores[_command_index];
+    submit_info.pWaitDstStageMask = &wait_stage;
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &_command_buffers[_command_index];
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = nullptr;
+    submit_info.signalSemaphoreCount = settings::headless ? 0 : 1;
+    submit_info.pSignalSemaphores = &_render_finished_semaphores[_command_index];
+
+    // Frame waits for uploads recorded since the previous submission.
+    _transfer->submit_graphics(submit_info, _fences[_command_index]);
+
+    _frame_pending[_command_index] = true;
+    _frame_submitted = true;
+}
+
+void graphics_vulkan::_acquire_next_image() {
+    // Offscreen image of frame slot is free once its fence is waited.
+    if (settings::headless) {
+        _image_index = static_cast<std::uint32_t>(_command_index);
+        return;
+    }
+
+    RB_VK(vkAcquireNextImageKHR(_device, _swapchain, UINT64_MAX, _image_available_semaphores[_command_index], VK_NULL_HANDLE, &_image_index),
+        "Failed to acquire next swapchain image");
+}
+
+void graphics_vulkan::_update_frame_latency() {
+    const auto now = std::chrono::steady_clock::now();
+
+    for (auto i = 0u; i < max_command_buffers; ++i) {
+        if (!_frame_pending[i] || vkGetFenceStatus(_device, _fences[i]) != VK_SUCCESS) {
+            continue;
+        }
+
+        // Fence completion is the closest point to scanout observable without present timing extensions.
+        const auto latency = std::chrono::duration_cast<std::chrono::duration<float>>(now - _frame_input_times[i]).count();
+        _frame_latency = _frame_latency > 0.0f ? _frame_latency + (latency - _frame_latency) * 0.1f : latency;
+        _frame_pending[i] = false;
+    }
+}
+
+void graphics_vulkan::_read_timestamp_queries() {
+    if (_timestamp_period <= 0.0f) {
+        return;
+    }
+
+    auto& pass_names = _gpu_pass_names[_command_index];
+    if (!pass_names.empty()) {
+        std::uint64_t timestamps[max_gpu_passes * 2];
+        const auto query_count = static_cast<std::uint32_t>(pass_names.size() * 2);
+
+        // Fence of this slot is signaled, so results are available without VK_QUERY_RESULT_WAIT_BIT.
+        const auto result = vkGetQueryPoolResults(_device, _timestamp_query_pools[_command_index], 0, query_count,
+            sizeof(timestamps), timestamps, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            // Pass recorded many times in single frame (e.g. blur) is summed into single sample.
+            std::vector<std::pair<const char*, float>> durations;
+            for (std::size_t index{ 0 }; index < pass_names.size(); ++index) {
+                // Difference is masked too, so counter wrapping between both queries still gives elapsed ticks.
+                const auto start_ticks = timestamps[index * 2] & _timestamp_mask;
+                const auto end_ticks = timestamps[index * 2 + 1] & _timestamp_mask;
+                const auto duration = static_cast<float>((end_ticks - start_ticks) & _timestamp_mask) * _timestamp_period * 1e-6f;
+
+                const auto it = std::find_if(durations.begin(), durations.end(), [&](const std::pair<const char*, float>& entry) {
+                    return std::strcmp(entry.first, pass_names[index]) == 0;
+                });
+
+                if (it == durations.end()) {
+                    durations.emplace_back(pass_names[index], duration);
+                } else {
+                    it->second += duration;
+                }
+            }
+
+            for (const auto& duration : durations) {
+                auto samples = std::find_if(_gpu_pass_samples.begin(), _gpu_pass_samples.end(), [&](const gpu_pass_samples& samples) {
+                    return std::strcmp(samples.name, duration.first) == 0;
+                });
+
+                if (samples == _gpu_pass_samples.end()) {
+                    samples = _gpu_pass_samples.insert(_gpu_pass_samples.end(), gpu_pass_samples{ duration.first, {}, 0, 0 });
+                }
+
+                samples->samples[samples->next] = duration.second;
+                samples->next = (samples->next + 1) % gpu_timing_history;
+                samples->count = std::min(samples->count + 1, gpu_timing_history);
+            }
+        }
+
+        pass_names.clear();
+    }
+
+    vkCmdResetQueryPool(_command_buffers[_command_index], _timestamp_query_pools[_command_index], 0, static_cast<std::uint32_t>(max_gpu_passes * 2));
+}
+
+void graphics_vulkan::_begin_gpu_pass(const char* name) {
+    auto& pass_names = _gpu_pass_names[_command_index];
+
+    // Pass without query still occupies stack entry, so ends remain paired with begins.
+    if (_timestamp_period <= 0.0f || pass_names.size() >= max_gpu_passes) {
+        _gpu_pass_stack.push_back(std::numeric_limits<std::uint32_t>::max());
+        return;
+    }
+
+    const auto index = static_cast<std::uint32_t>(pass_names.size());
+    pass_names.push_back(name);
+    _gpu_pass_stack.push_back(index);
+
+    vkCmdWriteTimestamp(_command_buffers[_command_index], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestamp_query_pools[_command_index], index * 2);
+}
+
+void graphics_vulkan::_end_gpu_pass() {
+    RB_ASSERT(!_gpu_pass_stack.empty(), "GPU pass ended without begin");
+
+    const auto index = _gpu_pass_stack.back();
+    _gpu_pass_stack.pop_back();
+
+    if (index != std::numeric_limits<std::uint32_t>::max()) {
+        vkCmdWriteTimestamp(_command_buffers[_command_index], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestamp_query_pools[_command_index], index * 2 + 1);
+    }
+}
+
+void graphics_vulkan::_collect_readback(std::size_t index) {
+    if (!_readback_pending[index]) {
+        return;
+    }
+
+    _readback_pending[index] = false;
+
+    vmaInvalidateAllocation(_allocator, _readback_allocations[index], 0, VK_WHOLE_SIZE);
+
+    // Pixels are copied out, so buffer can be reused while PNG is encoded on worker thread.
+    auto frame = image::from_pixels(static_cast<const color*>(_readback_data[index]), { _swapchain_extent.width, _swapchain_extent.height });
+    auto filename = (std::filesystem::path{ settings::capture_directory } / format("frame_{:05}.png", _readback_frames[index])).string();
 
-    RB_VK(vkQueueSubmit(_graphics_queue, 1, &submit_info, _fences[_command_index]), "Failed to queue submit");
+    _readback_jobs.push_back(std::async(std::launch::async, [frame = std::move(frame), filename = std::move(filename)]() {
+        if (!frame.save_to_file(filename)) {
+            print("graphics: failed to write captured frame {}\n", filename);
+        }
+    }));
+
+    _readback_jobs.erase(std::remove_if(_readback_jobs.begin(), _readback_jobs.end(), [](const std::future<void>& job) {
+        return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), _readback_jobs.end());
+
+    // Slow encoding throttles rendering instead of piling up frames in memory.
+    while (_readback_jobs.size() > max_command_buffers * 2) {
+        _readback_jobs.front().wait();
+        _readback_jobs.erase(_readback_jobs.begin());
+    }
 }
 
 VkFormat graphics_vulkan::_get_supported_depth_format() {
@@ -7,13 +7,19 @@
 #include <rabbit/math/vec3.hpp>
 #include <rabbit/math/vec4.hpp>
 #include <rabbit/math/math.hpp>
+#include <rabbit/collision/plane.hpp>
 
 #include "environment_vulkan.hpp"
+#include "material_arena_vulkan.hpp"
+#include "mesh_arena_vulkan.hpp"
+#include "transfer_vulkan.hpp"
 
 #include <volk.h>
 #include <vk_mem_alloc.h>
 
 #include <vector>
+#include <chrono>
+#include <future>
 #include <unordered_map>
 
 namespace rb {
@@ -23,7 +29,16 @@ namespace rb {
 
 	class graphics_vulkan : public graphics_impl {
 	public:
-		static constexpr std::size_t max_command_buffers{ 3 };
+		static constexpr std::size_t max_command_buffers{ graphics_limits::max_frames_in_flight };
+		static constexpr std::size_t max_gpu_passes{ 64 };
+		static constexpr std::size_t gpu_timing_history{ 120 };
+		static constexpr float max_shadow_distance{ 100.0f }; // cascades cover camera frustum up to this distance
+		static constexpr float shadow_split_lambda{ 0.75f }; // 0 = uniform, 1 = logarithmic cascade splits
+		static constexpr float shadow_caster_distance{ 50.0f }; // casters in front of cascade volume, towards the light
+		static constexpr std::size_t first_cached_shadow_cascade{ 2 }; // farther cascades cache depth of static casters
+		static constexpr std::size_t cached_shadow_cascades{ graphics_limits::max_shadow_cascades - first_cached_shadow_cascade };
+		static constexpr float shadow_cache_margin{ 1.25f }; // cached cascade radius scale, camera can move inside without invalidation
+		static constexpr float shadow_cache_min_direction_dot{ 0.9999f }; // light rotation invalidating cached cascade
 
 		struct alignas(16) camera_data {
 			mat4f projection;
@@ -49,19 +64,45 @@ namespace rb {
 
 		struct alignas(16) local_data {
 			mat4f world;
+			vec4f position_offset; // mesh quantization, .w unused
+			vec4f position_scale;
 		};
 
-		struct alignas(16) irradiance_data {
-			int cube_face;
+		struct alignas(16) instance_data {
+			mat4f world;
+			vec4f bsphere; // local space bounding sphere, .w = radius
+			std::uint32_t command_index; // first draw command of instance batch
+			std::uint32_t lod_count; // number of lods to select from
+			std::uint32_t material_index; // material parameters in material arena
+			std::uint32_t cluster_count; // draw commands of base lod clusters, 0 = base lod drawn as a whole
+			vec3f position_offset; // mesh quantization
+			std::uint32_t first_cluster; // in mesh arena cluster buffer
+			vec3f position_scale;
+			std::uint32_t cone_culling; // back-facing clusters are culled, unless material is double sided
+		};
+
+		struct alignas(16) cull_data {
+			vec4f frustum_planes[6];
+			std::uint32_t first_instance;
+			std::uint32_t instance_count;
+			std::uint32_t fixed_lod;
+			float padding;
+			float z_near;
+			float z_far;
 		};
 
-		struct alignas(16) prefilter_data {
-			int cube_face;
-			float roughness;
+		// Placement of cached cascade and hash of static casters rendered into it.
+		struct shadow_cache {
+			mat4f proj_view;
+			vec3f center;
+			float radius{ 0.0f };
+			vec3f direction;
+			std::uint64_t static_hash{ 0 };
+			bool valid{ false };
 		};
 
 		struct alignas(16) shadow_data {
-			mat4f proj_view_world;
+			mat4f proj_view;
 		};
 
 		struct alignas(16) directional_light_data {
@@ -87,6 +128,41 @@ namespace rb {
 			float strength;
 		};
 
+		// Draw recorded during pass. Draws are sorted and merged into batches culled on GPU when pass is flushed.
+		struct instance_draw {
+			const rb::mesh* mesh;
+			const rb::material* material;
+			std::uint32_t lod_index;
+			mat4f world;
+		};
+
+		// Position of batch key in draw order. Ranks are kept across frames and sorted again only when new key appears.
+		struct instance_batch_rank {
+			const rb::mesh* mesh;
+			std::uint64_t material_flags;
+			VkIndexType index_type;
+			std::uint32_t lod_index;
+			std::uint32_t rank;
+			std::uint64_t frame; // last frame with draw of this key, stale keys are dropped on next sort
+		};
+
+		// Range of indirect draw commands sharing mesh and material flags. Instance count is written by culling shader.
+		// Material is only used to pick pipeline, instances fetch their own materials by index.
+		struct indirect_batch {
+			const rb::mesh* mesh;
+			const rb::material* material;
+			std::uint32_t first_command;
+			std::uint32_t command_count;
+		};
+
+		// Durations of named pass from last frames, in milliseconds.
+		struct gpu_pass_samples {
+			const char* name;
+			float samples[gpu_timing_history];
+			std::size_t count;
+			std::size_t next;
+		};
+
 	public:
 		graphics_vulkan();
 
@@ -108,7 +184,7 @@ namespace rb {
 
 		void begin_depth_pass(const std::shared_ptr<viewport>& viewport) override;
 
-		void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, std::size_t mesh_lod_index) override;
+		void draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) override;
 
 		void end_depth_pass(const std::shared_ptr<viewport>& viewport) override;
 
@@ -176,6 +252,12 @@ namespace rb {
 
 		void flush() override;
 
+		float frame_latency() override;
+
+		std::vector<gpu_pass_timing> gpu_timings() override;
+
+		std::vector<graphics_pass_calls> pass_calls() override;
+
 	private:
 		void _initialize_volk();
 
@@ -189,30 +271,42 @@ namespace rb {
 
 		void _create_allocator();
 
+		void _create_transfer();
+
+		void _create_pipeline_cache();
+
+		void _save_pipeline_cache();
+
 		void _query_surface();
 
 		void _create_swapchain();
 
+		void _create_offscreen_images();
+
+		void _create_framebuffers();
+
 		void _create_command_pool();
 
-		void _create_synchronization_objects();
+		void _create_mesh_arena();
 
-		void _create_quad();
+		void _create_synchronization_objects();
 
-		void _generate_brdf_image();
+		void _create_timestamp_queries();
 
-		void _create_skybox();
+		void _create_readback();
 
-		void _create_irradiance_pipeline();
+		void _create_quad();
 
-		void _bake_irradiance(const std::shared_ptr<environment>& environment);
+		void _create_brdf_image(const std::vector<std::uint8_t>& pixels);
 
-		void _create_prefilter_pipeline();
+		void _create_skybox();
 
-		void _bake_prefilter(const std::shared_ptr<environment>& environment);
+		void _create_instancing();
 
 		void _create_shadow_map();
 
+		void _create_shadow_cache();
+
 		void _create_camera();
 
 		void _create_main();
@@ -225,15 +319,15 @@ namespace rb {
 
 		void _create_light();
 
-		void _create_forward();
+		void _create_instance_culling();
 
-		VkPipelineLayout _create_forward_pipeline_layout(const std::shared_ptr<material>& material);
+		void _create_forward();
 
-		VkPipelineLayout _get_forward_pipeline_layout(const std::shared_ptr<material>& material);
+		VkPipeline _create_forward_pipeline(std::uint64_t flags);
 
-		VkPipeline _create_forward_pipeline(const std::shared_ptr<material>& material, std::uint64_t internal_flags);
+		void _prewarm_forward_pipelines(std::uint64_t material_flags);
 
-		VkPipeline _get_forward_pipeline(const std::shared_ptr<material>& material, std::uint64_t internal_flags);
+		VkPipeline _get_forward_pipeline(const material* material, std::uint64_t internal_flags);
 
 		void _create_postprocess();
 
@@ -255,10 +349,44 @@ namespace rb {
 
 		void _create_present_pipeline();
 
+		void _sort_instance_draws();
+
+		std::size_t _find_instance_batch_end(std::size_t first) const;
+
+		void _cull_instance_draws(const mat4f& proj_view, bool fixed_lod, std::vector<indirect_batch>& batches);
+
+		void _draw_indirect(const indirect_batch& batch);
+
+		void _draw_depth_batches(const std::vector<indirect_batch>& batches);
+
+		void _draw_shadow_batches(VkRenderPass render_pass, VkFramebuffer framebuffer, const std::vector<indirect_batch>& batches);
+
+		void _end_cached_shadow_pass();
+
+		void _draw_forward_batches(const std::shared_ptr<viewport>& viewport, const std::vector<indirect_batch>& batches);
+
+		void _draw_skybox();
+
+		void _bind_mesh_arena();
+
+		void _bind_mesh_indices(VkIndexType index_type);
+
 		void _create_command_buffers();
 
 		VkCommandBuffer _command_begin();
 
+		void _acquire_next_image();
+
+		void _update_frame_latency();
+
+		void _read_timestamp_queries();
+
+		void _begin_gpu_pass(const char* name);
+
+		void _end_gpu_pass();
+
+		void _collect_readback(std::size_t index);
+
 		void _command_end();
 
 		VkFormat _get_supported_depth_format();
@@ -276,8 +404,10 @@ namespace rb {
 
 		std::uint32_t _graphics_family;
 		std::uint32_t _present_family;
+		std::uint32_t _transfer_family;
 		VkQueue _graphics_queue;
 		VkQueue _present_queue;
+		VkQueue _transfer_queue;
 
 		VmaAllocator _allocator;
 		VkSurfaceFormatKHR _surface_format;
@@ -291,6 +421,7 @@ namespace rb {
 		VkImageView _depth_image_view;
 
 		std::vector<VkImage> _images;
+		std::vector<VmaAllocation> _image_allocations; // offscreen images of headless mode
 		std::vector<VkImageView> _image_views;
 		std::vector<VkFramebuffer> _framebuffers;
 
@@ -298,10 +429,35 @@ namespace rb {
 
 		VkCommandPool _command_pool;
 
-		VkSemaphore _render_semaphore;
-		VkSemaphore _present_semaphore;
+		VkPipelineCache _pipeline_cache;
+
+		std::shared_ptr<transfer_vulkan> _transfer;
+		std::shared_ptr<mesh_arena_vulkan> _mesh_arena;
+
+		VkSemaphore _image_available_semaphores[max_command_buffers];
+		VkSemaphore _render_finished_semaphores[max_command_buffers];
 
 		std::uint32_t _image_index{ 0 };
+		bool _frame_submitted{ false };
+
+		std::chrono::steady_clock::time_point _frame_input_times[max_command_buffers];
+		bool _frame_pending[max_command_buffers]{};
+		float _frame_latency{ 0.0f };
+
+		VkBuffer _readback_buffers[max_command_buffers]{};
+		VmaAllocation _readback_allocations[max_command_buffers]{};
+		void* _readback_data[max_command_buffers]{};
+		bool _readback_pending[max_command_buffers]{};
+		std::size_t _readback_frames[max_command_buffers]{};
+		std::size_t _frame_number{ 0 };
+		std::vector<std::future<void>> _readback_jobs;
+
+		VkQueryPool _timestamp_query_pools[max_command_buffers];
+		std::vector<const char*> _gpu_pass_names[max_command_buffers];
+		std::vector<std::uint32_t> _gpu_pass_stack;
+		std::vector<gpu_pass_samples> _gpu_pass_samples;
+		float _timestamp_period{ 0.0f };
+		std::uint64_t _timestamp_mask{ 0 };
 
 		VkBuffer _quad_vertex_buffer;
 		VmaAllocation _quad_vertex_allocation;
@@ -322,21 +478,40 @@ namespace rb {
 		VkBuffer _skybox_index_buffer;
 		VmaAllocation _skybox_index_allocation;
 
-		VkDescriptorPool _irradiance_descriptor_pool;
-		VkDescriptorSet _irradiance_descriptor_set;
-		VkDescriptorSetLayout _irradiance_descriptor_set_layout;
-		VkPipelineLayout _irradiance_pipeline_layout;
-		VkShaderModule _irradiance_shader_modules[2];
-		VkRenderPass _irradiance_render_pass;
-		VkPipeline _irradiance_pipeline;
-
-		VkDescriptorPool _prefilter_descriptor_pool;
-		VkDescriptorSet _prefilter_descriptor_set;
-		VkDescriptorSetLayout _prefilter_descriptor_set_layout;
-		VkPipelineLayout _prefilter_pipeline_layout;
-		VkShaderModule _prefilter_shader_modules[2];
-		VkRenderPass _prefilter_render_pass;
-		VkPipeline _prefilter_pipeline;
+		VkDescriptorSetLayout _instance_descriptor_set_layout;
+		VkDescriptorPool _instance_descriptor_pool;
+		VkDescriptorSet _instance_descriptor_sets[max_command_buffers];
+		VkBuffer _instance_buffers[max_command_buffers];
+		VmaAllocation _instance_allocations[max_command_buffers];
+		instance_data* _instance_data[max_command_buffers];
+		VkBuffer _visible_instance_buffers[max_command_buffers];
+		VmaAllocation _visible_instance_allocations[max_command_buffers];
+		VkBuffer _draw_command_buffers[max_command_buffers];
+		VmaAllocation _draw_command_allocations[max_command_buffers];
+		VkDrawIndexedIndirectCommand* _draw_commands[max_command_buffers];
+		std::uint32_t _instance_count{ 0 };
+		std::uint32_t _visible_instance_count{ 0 };
+		std::uint32_t _draw_command_count{ 0 };
+		std::size_t _dropped_instance_draws{ 0 };
+		std::size_t _reported_dropped_instance_draws{ 0 };
+		std::vector<instance_draw> _instance_draws;
+		std::vector<instance_draw> _sorted_instance_draws;
+		std::unordered_map<std::uint64_t, instance_batch_rank> _instance_batch_ranks;
+		std::vector<const instance_batch_rank*> _instance_draw_ranks;
+		std::vector<std::size_t> _instance_rank_offsets;
+		std::uint64_t _instance_batch_frame{ 0 };
+		std::vector<indirect_batch> _indirect_batches;
+		std::vector<indirect_batch> _opaque_batches;
+		bool _skybox_requested{ false };
+		std::size_t _shadow_cascade{ 0 };
+		planef _shadow_planes[6];
+		bool _multi_draw_indirect{ false };
+		VkIndexType _bound_index_type{ VK_INDEX_TYPE_MAX_ENUM };
+		float _camera_z_near{ 0.0f };
+		float _camera_z_far{ 1.0f };
+
+		VkPipelineLayout _cull_pipeline_layout;
+		VkPipeline _cull_pipeline;
 
 		VkImage _shadow_image;
 		VkImageView _shadow_image_view;
@@ -349,14 +524,27 @@ namespace rb {
 		VkShaderModule _shadow_shader_module;
 		VkPipeline _shadow_pipeline;
 
-		VkBuffer _camera_buffer;
-		VmaAllocation _camera_allocation;
+		VkImage _shadow_cache_image;
+		VmaAllocation _shadow_cache_allocation;
+		VkImageView _shadow_cache_image_views[cached_shadow_cascades];
+		VkRenderPass _shadow_cache_render_pass; // renders static casters, leaves depth ready for copy
+		VkRenderPass _shadow_composite_render_pass; // renders dynamic casters over copied static depth
+		VkFramebuffer _shadow_cache_framebuffers[cached_shadow_cascades];
+		shadow_cache _shadow_caches[cached_shadow_cascades];
+		std::vector<instance_draw> _static_shadow_draws;
+		std::vector<indirect_batch> _static_shadow_batches;
+		std::uint64_t _static_shadow_hash{ 0 };
+
+		VkBuffer _camera_buffers[max_command_buffers];
+		VmaAllocation _camera_allocations[max_command_buffers];
+		camera_data* _mapped_camera_data[max_command_buffers];
 
 		VkDescriptorPool _main_descriptor_pool;
 		VkDescriptorSetLayout _main_descriptor_set_layout;
-		VkDescriptorSet _main_descriptor_set; // main camera, brdf and shadow map information
+		VkDescriptorSet _main_descriptor_sets[max_command_buffers]; // main camera, brdf and shadow map information
 
-		VkDescriptorSetLayout _material_descriptor_set_layout;
+		std::shared_ptr<material_arena_vulkan> _material_arena;
+		std::shared_ptr<texture> _default_texture;
 
 		VkDescriptorSetLayout _environment_descriptor_set_layout;
 
@@ -371,8 +559,11 @@ namespace rb {
 
 		VkDescriptorSetLayout _forward_descriptor_set_layout;
 		VkRenderPass _forward_render_pass;
-		std::unordered_map<std::uint64_t, VkPipelineLayout> _forward_pipeline_layouts;
+		VkPipelineLayout _forward_pipeline_layout;
+		VkShaderModule _forward_shader_modules[2];
 		std::unordered_map<std::uint64_t, VkPipeline> _forward_pipelines;
+		std::unordered_map<std::uint64_t, std::future<VkPipeline>> _forward_pipeline_jobs;
+		std::unordered_map<std::uint64_t, VkPipeline> _forward_fallback_pipelines;
 
 		VkDescriptorSetLayout _postprocess_descriptor_set_layout;
 		VkRenderPass _postprocess_render_pass;
@@ -0,0 +1,228 @@
+#include "material_arena_vulkan.hpp"
+#include "texture_vulkan.hpp"
+#include "utils_vulkan.hpp"
+
+#include <rabbit/core/format.hpp>
+
+using namespace rb;
+
+material_arena_vulkan::material_arena_vulkan(const std::shared_ptr<transfer_vulkan>& transfer,
+    VkDevice device,
+    VmaAllocator allocator,
+    const std::shared_ptr<texture>& default_texture,
+    std::uint32_t texture_capacity,
+    std::uint32_t material_capacity)
+    : _transfer(transfer)
+    , _device(device)
+    , _allocator(allocator)
+    , _texture_capacity(texture_capacity)
+    , _material_capacity(material_capacity)
+    , _default_texture(default_texture)
+    , _material_slots(material_capacity)
+    , _texture_slots(texture_capacity)
+    , _textures(texture_capacity, nullptr)
+    , _texture_references(texture_capacity, 0) {
+    _create_material_buffer();
+    _create_descriptor_set();
+
+    // First slots are taken by defaults, which are never released.
+    material_data_vulkan data;
+    data.base_color = { 1.0f, 1.0f, 1.0f, 1.0f };
+    data.uv_transform = { 1.0f, 1.0f, 0.0f, 0.0f };
+    data.roughness = 0.8f;
+    data.metallic = 0.0f;
+    data.occlusion_strength = 1.0f;
+    for (auto& map : data.maps) {
+        map = acquire_texture(_default_texture);
+    }
+
+    [[maybe_unused]] const auto index = allocate_material(data);
+    RB_ASSERT(index == default_material, "Default material has to take first slot");
+}
+
+material_arena_vulkan::~material_arena_vulkan() {
+    vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(_device, _descriptor_set_layout, nullptr);
+    vmaDestroyBuffer(_allocator, _material_buffer, _material_allocation);
+}
+
+std::uint32_t material_arena_vulkan::acquire_texture(const std::shared_ptr<texture>& texture) {
+    if (const auto it = _texture_indices.find(texture.get()); it != _texture_indices.end()) {
+        _texture_references[it->second]++;
+        return it->second;
+    }
+
+    std::uint32_t index{ 0 };
+    if (!_texture_slots.allocate(1, index)) {
+        print("graphics: material arena is out of texture slots ({} used), default texture is used instead\n", _texture_slots.used());
+        return acquire_texture(_default_texture);
+    }
+
+    _texture_indices.emplace(texture.get(), index);
+    _textures[index] = texture.get();
+    _texture_references[index] = 1;
+
+    // Slot is not used by any frame in flight (partially bound), so it can be written after bind.
+    const auto native_texture = std::static_pointer_cast<texture_vulkan>(texture);
+
+    VkDescriptorImageInfo image_info;
+    image_info.sampler = native_texture->sampler();
+    image_info.imageView = native_texture->image_view();
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write_info;
+    write_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_info.pNext = nullptr;
+    write_info.dstSet = _descriptor_set;
+    write_info.dstBinding = 1;
+    write_info.dstArrayElement = index;
+    write_info.descriptorCount = 1;
+    write_info.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write_info.pImageInfo = &image_info;
+    write_info.pBufferInfo = nullptr;
+    write_info.pTexelBufferView = nullptr;
+    vkUpdateDescriptorSets(_device, 1, &write_info, 0, nullptr);
+
+    return index;
+}
+
+void material_arena_vulkan::release_texture(std::uint32_t index) {
+    RB_ASSERT(_texture_references[index] > 0, "Released texture was never acquired");
+    if (--_texture_references[index] > 0) {
+        return;
+    }
+
+    // Texture may be destroyed right away, so it is unregistered immediately.
+    // Slot itself is reused only after frames in flight complete.
+    _texture_indices.erase(_textures[index]);
+    _textures[index] = nullptr;
+
+    _transfer->defer([this, index]() {
+        _texture_slots.free(index, 1);
+    });
+}
+
+std::uint32_t material_arena_vulkan::allocate_material(const material_data_vulkan& data) {
+    std::uint32_t index{ 0 };
+    if (!_material_slots.allocate(1, index)) {
+        print("graphics: material arena is out of material slots ({} used), default material is used instead\n", _material_slots.used());
+        return default_material;
+    }
+
+    // Buffer is host coherent and slot is not read by frames in flight.
+    _mapped_materials[index] = data;
+    return index;
+}
+
+void material_arena_vulkan::free_material(std::uint32_t index) {
+    // Materials that fell back to default material share its slot.
+    if (index == default_material) {
+        return;
+    }
+
+    _transfer->defer([this, index]() {
+        _material_slots.free(index, 1);
+    });
+}
+
+VkDescriptorSetLayout material_arena_vulkan::descriptor_set_layout() const {
+    return _descriptor_set_layout;
+}
+
+VkDescriptorSet material_arena_vulkan::descriptor_set() const {
+    return _descriptor_set;
+}
+
+void material_arena_vulkan::_create_descriptor_set() {
+    VkDescriptorSetLayoutBinding bindings[2]{
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _texture_capacity, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }
+    };
+
+    // Unused slots stay empty and new textures are written while set is bound.
+    VkDescriptorBindingFlags binding_flags[2]{
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info;
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.pNext = nullptr;
+    binding_flags_info.bindingCount = 2;
+    binding_flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info;
+    descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptor_set_layout_info.pNext = &binding_flags_info;
+    descriptor_set_layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    descriptor_set_layout_info.bindingCount = 2;
+    descriptor_set_layout_info.pBindings = bindings;
+    RB_VK(vkCreateDescriptorSetLayout(_device, &descriptor_set_layout_info, nullptr, &_descriptor_set_layout),
+        "Failed to create Vulkan descriptor set layout");
+
+    VkDescriptorPoolSize pool_sizes[2]{
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _texture_capacity }
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_info;
+    descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_info.pNext = nullptr;
+    descriptor_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptor_pool_info.maxSets = 1;
+    descriptor_pool_info.poolSizeCount = 2;
+    descriptor_pool_info.pPoolSizes = pool_sizes;
+    RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_descriptor_pool),
+        "Failed to create Vulkan descriptor pool");
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.pNext = nullptr;
+    descriptor_set_allocate_info.descriptorPool = _descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts = &_descriptor_set_layout;
+    RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_descriptor_set),
+        "Failed to allocate Vulkan descriptor set");
+
+    VkDescriptorBufferInfo buffer_info;
+    buffer_info.buffer = _material_buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write_info;
+    write_info.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_info.pNext = nullptr;
+    write_info.dstSet = _descriptor_set;
+    write_info.dstBinding = 0;
+    write_info.dstArrayElement = 0;
+    write_info.descriptorCount = 1;
+    write_info.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write_info.pImageInfo = nullptr;
+    write_info.pBufferInfo = &buffer_info;
+    write_info.pTexelBufferView = nullptr;
+    vkUpdateDescriptorSets(_device, 1, &write_info, 0, nullptr);
+}
+
+void material_arena_vulkan::_create_material_buffer() {
+    VkBufferCreateInfo buffer_info;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.flags = 0;
+    buffer_info.size = sizeof(material_data_vulkan) * _material_capacity;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = 0;
+    buffer_info.pQueueFamilyIndices = nullptr;
+
+    // Materials are written rarely and read from fragment shader, so host visible memory is good enough.
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocation_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VmaAllocationInfo allocation_result;
+    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &_material_buffer, &_material_allocation, &allocation_result),
+        "Failed to create Vulkan buffer.");
+
+    _mapped_materials = static_cast<material_data_vulkan*>(allocation_result.pMappedData);
+}
@@ -0,0 +1,90 @@
+#pragma once 
+
+#include <rabbit/graphics/texture.hpp>
+#include <rabbit/math/vec4.hpp>
+
+#include "mesh_arena_vulkan.hpp"
+#include "transfer_vulkan.hpp"
+
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace rb {
+	// Material parameters as seen by shaders. Maps are indices into global texture array.
+	struct alignas(16) material_data_vulkan {
+		vec4f base_color;
+		vec4f uv_transform;
+		float roughness;
+		float metallic;
+		float occlusion_strength;
+		std::uint32_t maps[6]; // albedo, normal, roughness, metallic, emissive, ambient
+	};
+
+	// Single descriptor set shared by all materials: storage buffer with parameters of every material
+	// and array of every texture used by materials (descriptor indexing). Materials are reduced to an index.
+	class material_arena_vulkan {
+	public:
+		material_arena_vulkan(const std::shared_ptr<transfer_vulkan>& transfer,
+			VkDevice device,
+			VmaAllocator allocator,
+			const std::shared_ptr<texture>& default_texture,
+			std::uint32_t texture_capacity,
+			std::uint32_t material_capacity);
+
+		material_arena_vulkan(const material_arena_vulkan&) = delete;
+
+		material_arena_vulkan& operator=(const material_arena_vulkan&) = delete;
+
+		~material_arena_vulkan();
+
+		// Textures are registered once and reference counted, so materials sharing texture share its slot.
+		// When slots run out, default texture is returned instead.
+		std::uint32_t acquire_texture(const std::shared_ptr<texture>& texture);
+
+		void release_texture(std::uint32_t index);
+
+		// When slots run out, default material is returned instead.
+		std::uint32_t allocate_material(const material_data_vulkan& data);
+
+		void free_material(std::uint32_t index);
+
+		// Always valid slot with default parameters and maps, also used by draws without material.
+		static constexpr std::uint32_t default_material{ 0 };
+
+		VkDescriptorSetLayout descriptor_set_layout() const;
+
+		VkDescriptorSet descriptor_set() const;
+
+	private:
+		void _create_descriptor_set();
+
+		void _create_material_buffer();
+
+	private:
+		std::shared_ptr<transfer_vulkan> _transfer;
+		VkDevice _device;
+		VmaAllocator _allocator;
+		const std::uint32_t _texture_capacity;
+		const std::uint32_t _material_capacity;
+		const std::shared_ptr<texture> _default_texture;
+
+		VkDescriptorSetLayout _descriptor_set_layout;
+		VkDescriptorPool _descriptor_pool;
+		VkDescriptorSet _descriptor_set;
+
+		VkBuffer _material_buffer;
+		VmaAllocation _material_allocation;
+		material_data_vulkan* _mapped_materials;
+		range_allocator_vulkan _material_slots;
+
+		range_allocator_vulkan _texture_slots;
+		std::unordered_map<const texture*, std::uint32_t> _texture_indices;
+		std::vector<const texture*> _textures; // slot -> registered texture
+		std::vector<std::uint32_t> _texture_references; // slot -> number of materials using texture
+	};
+}
@@ -2,38 +2,25 @@
 
 #include <rabbit/graphics/material.hpp>
 
-#include <volk.h>
-#include <vk_mem_alloc.h>
+#include "material_arena_vulkan.hpp"
+
+#include <memory>
 
 namespace rb {
 	class material_vulkan : public material {
-		struct data {
-			vec4f base_color;
-			float roughness;
-			float metallic;
-			float occlusion_strength;
-		};
-
 	public:
-		material_vulkan(VkDevice device,
-			VmaAllocator allocator,
+		material_vulkan(const std::shared_ptr<material_arena_vulkan>& arena,
+			const std::shared_ptr<texture>& default_texture,
 			const material_desc& desc);
 
 		~material_vulkan();
 
-		VkDescriptorSetLayout descriptor_set_layout() const;
-
-		VkDescriptorSet descriptor_set() const;
+		// Index of material parameters in arena storage buffer.
+		std::uint32_t index() const;
 
 	private:
-		VkDevice _device;
-		VmaAllocator _allocator;
-
-		VkBuffer _uniform_buffer;
-		VmaAllocation _uniform_buffer_allocation;
-
-		VkDescriptorSetLayout _descriptor_set_layout;
-		VkDescriptorPool _descriptor_pool;
-		VkDescriptorSet _descriptor_set;
+		std::shared_ptr<material_arena_vulkan> _arena;
+		std::uint32_t _maps[6];
+		std::uint32_t _index;
 	};
 }
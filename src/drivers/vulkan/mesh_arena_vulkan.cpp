@@ -0,0 +1,187 @@
+#include "mesh_arena_vulkan.hpp"
+#include "utils_vulkan.hpp"
+
+#include <rabbit/core/format.hpp>
+
+using namespace rb;
+
+range_allocator_vulkan::range_allocator_vulkan(std::uint32_t capacity)
+	: _capacity(capacity) {
+    _free_ranges.emplace(0, capacity);
+}
+
+bool range_allocator_vulkan::allocate(std::uint32_t size, std::uint32_t& offset) {
+    for (auto it = _free_ranges.begin(); it != _free_ranges.end(); ++it) {
+        if (it->second < size) {
+            continue;
+        }
+
+        offset = it->first;
+
+        const auto remaining = it->second - size;
+        _free_ranges.erase(it);
+        if (remaining > 0) {
+            _free_ranges.emplace(offset + size, remaining);
+        }
+
+        _used += size;
+        return true;
+    }
+
+    return false;
+}
+
+void range_allocator_vulkan::free(std::uint32_t offset, std::uint32_t size) {
+    RB_ASSERT(_used >= size, "Freed range was never allocated");
+    _used -= size;
+
+    auto it = _free_ranges.emplace(offset, size).first;
+
+    // Merge with following free range.
+    const auto next = std::next(it);
+    if (next != _free_ranges.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        _free_ranges.erase(next);
+    }
+
+    // Merge with preceding free range.
+    if (it != _free_ranges.begin()) {
+        const auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            _free_ranges.erase(it);
+        }
+    }
+}
+
+std::uint32_t range_allocator_vulkan::capacity() const {
+    return _capacity;
+}
+
+std::uint32_t range_allocator_vulkan::used() const {
+    return _used;
+}
+
+mesh_arena_vulkan::mesh_arena_vulkan(const std::shared_ptr<transfer_vulkan>& transfer,
+    VmaAllocator allocator,
+    std::uint32_t vertex_capacity,
+    std::uint32_t index_capacity,
+    std::uint32_t cluster_capacity)
+	: _transfer(transfer)
+	, _allocator(allocator)
+	, _vertex_ranges(vertex_capacity)
+	, _index_ranges(index_capacity)
+	, _short_index_ranges(index_capacity)
+	, _cluster_ranges(cluster_capacity) {
+    _create_buffer(vertex_capacity * sizeof(packed_vertex),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        _vertex_buffer, _vertex_allocation);
+
+    _create_buffer(index_capacity * sizeof(std::uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        _index_buffer, _index_allocation);
+
+    _create_buffer(index_capacity * sizeof(std::uint16_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        _short_index_buffer, _short_index_allocation);
+
+    _create_buffer(cluster_capacity * sizeof(mesh_cluster),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        _cluster_buffer, _cluster_allocation);
+}
+
+mesh_arena_vulkan::~mesh_arena_vulkan() {
+    vmaDestroyBuffer(_allocator, _cluster_buffer, _cluster_allocation);
+    vmaDestroyBuffer(_allocator, _short_index_buffer, _short_index_allocation);
+    vmaDestroyBuffer(_allocator, _index_buffer, _index_allocation);
+    vmaDestroyBuffer(_allocator, _vertex_buffer, _vertex_allocation);
+}
+
+bool mesh_arena_vulkan::allocate_vertices(const span<const packed_vertex>& vertices, std::uint32_t& offset) {
+    if (!_vertex_ranges.allocate(static_cast<std::uint32_t>(vertices.size()), offset)) {
+        print("graphics: mesh arena is out of vertex memory ({} requested, {}/{} used)\n", vertices.size(), _vertex_ranges.used(), _vertex_ranges.capacity());
+        return false;
+    }
+
+    _transfer->upload(_vertex_buffer, offset * sizeof(packed_vertex), vertices.data(), vertices.size_bytes());
+    return true;
+}
+
+bool mesh_arena_vulkan::allocate_indices(const span<const std::uint32_t>& indices, std::uint32_t& offset) {
+    if (!_index_ranges.allocate(static_cast<std::uint32_t>(indices.size()), offset)) {
+        print("graphics: mesh arena is out of index memory ({} requested, {}/{} used)\n", indices.size(), _index_ranges.used(), _index_ranges.capacity());
+        return false;
+    }
+
+    _transfer->upload(_index_buffer, offset * sizeof(std::uint32_t), indices.data(), indices.size_bytes());
+    return true;
+}
+
+bool mesh_arena_vulkan::allocate_indices(const span<const std::uint16_t>& indices, std::uint32_t& offset) {
+    if (!_short_index_ranges.allocate(static_cast<std::uint32_t>(indices.size()), offset)) {
+        print("graphics: mesh arena is out of index memory ({} requested, {}/{} used)\n", indices.size(), _short_index_ranges.used(), _short_index_ranges.capacity());
+        return false;
+    }
+
+    _transfer->upload(_short_index_buffer, offset * sizeof(std::uint16_t), indices.data(), indices.size_bytes());
+    return true;
+}
+
+bool mesh_arena_vulkan::allocate_clusters(const span<const mesh_cluster>& clusters, std::uint32_t& offset) {
+    if (!_cluster_ranges.allocate(static_cast<std::uint32_t>(clusters.size()), offset)) {
+        print("graphics: mesh arena is out of cluster memory ({} requested, {}/{} used)\n", clusters.size(), _cluster_ranges.used(), _cluster_ranges.capacity());
+        return false;
+    }
+
+    _transfer->upload(_cluster_buffer, offset * sizeof(mesh_cluster), clusters.data(), clusters.size_bytes());
+    return true;
+}
+
+void mesh_arena_vulkan::free_vertices(std::uint32_t offset, std::uint32_t count) {
+    // Frames in flight may still read the range, so it is reused only after they complete.
+    _transfer->defer([this, offset, count]() {
+        _vertex_ranges.free(offset, count);
+    });
+}
+
+void mesh_arena_vulkan::free_indices(VkIndexType index_type, std::uint32_t offset, std::uint32_t count) {
+    auto& ranges = index_type == VK_INDEX_TYPE_UINT16 ? _short_index_ranges : _index_ranges;
+    _transfer->defer([&ranges, offset, count]() {
+        ranges.free(offset, count);
+    });
+}
+
+void mesh_arena_vulkan::free_clusters(std::uint32_t offset, std::uint32_t count) {
+    _transfer->defer([this, offset, count]() {
+        _cluster_ranges.free(offset, count);
+    });
+}
+
+VkBuffer mesh_arena_vulkan::vertex_buffer() const {
+    return _vertex_buffer;
+}
+
+VkBuffer mesh_arena_vulkan::index_buffer(VkIndexType index_type) const {
+    return index_type == VK_INDEX_TYPE_UINT16 ? _short_index_buffer : _index_buffer;
+}
+
+VkBuffer mesh_arena_vulkan::cluster_buffer() const {
+    return _cluster_buffer;
+}
+
+void mesh_arena_vulkan::_create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation) {
+    VkBufferCreateInfo buffer_info;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.flags = 0;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = _transfer->sharing_mode();
+    buffer_info.queueFamilyIndexCount = _transfer->queue_family_count();
+    buffer_info.pQueueFamilyIndices = _transfer->queue_families();
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &buffer, &allocation, nullptr),
+        "Failed to create Vulkan buffer.");
+}
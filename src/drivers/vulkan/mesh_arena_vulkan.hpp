@@ -0,0 +1,97 @@
+#pragma once 
+
+#include <rabbit/graphics/vertex.hpp>
+#include <rabbit/graphics/mesh.hpp>
+#include <rabbit/core/span.hpp>
+
+#include "transfer_vulkan.hpp"
+
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace rb {
+	// First-fit allocator of element ranges. Freed ranges are merged with their neighbours.
+	class range_allocator_vulkan {
+	public:
+		range_allocator_vulkan(std::uint32_t capacity);
+
+		bool allocate(std::uint32_t size, std::uint32_t& offset);
+
+		void free(std::uint32_t offset, std::uint32_t size);
+
+		std::uint32_t capacity() const;
+
+		std::uint32_t used() const;
+
+	private:
+		const std::uint32_t _capacity;
+		std::uint32_t _used{ 0 };
+		std::map<std::uint32_t, std::uint32_t> _free_ranges; // offset -> size
+	};
+
+	// Device-local vertex and index buffers shared by all meshes. Geometry is uploaded through transfer queue.
+	// Meshes small enough for 16-bit indices keep them in separate index buffer.
+	// Clusters of large meshes are kept in storage buffer read by instance culling.
+	class mesh_arena_vulkan {
+	public:
+		mesh_arena_vulkan(const std::shared_ptr<transfer_vulkan>& transfer,
+			VmaAllocator allocator,
+			std::uint32_t vertex_capacity,
+			std::uint32_t index_capacity,
+			std::uint32_t cluster_capacity);
+
+		mesh_arena_vulkan(const mesh_arena_vulkan&) = delete;
+
+		mesh_arena_vulkan& operator=(const mesh_arena_vulkan&) = delete;
+
+		~mesh_arena_vulkan();
+
+		// Allocations report failure when arena is full, so nothing is uploaded over geometry of other meshes.
+		bool allocate_vertices(const span<const packed_vertex>& vertices, std::uint32_t& offset);
+
+		bool allocate_indices(const span<const std::uint32_t>& indices, std::uint32_t& offset);
+
+		bool allocate_indices(const span<const std::uint16_t>& indices, std::uint32_t& offset);
+
+		bool allocate_clusters(const span<const mesh_cluster>& clusters, std::uint32_t& offset);
+
+		void free_vertices(std::uint32_t offset, std::uint32_t count);
+
+		void free_indices(VkIndexType index_type, std::uint32_t offset, std::uint32_t count);
+
+		void free_clusters(std::uint32_t offset, std::uint32_t count);
+
+		VkBuffer vertex_buffer() const;
+
+		VkBuffer index_buffer(VkIndexType index_type) const;
+
+		VkBuffer cluster_buffer() const;
+
+	private:
+		void _create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation);
+
+	private:
+		std::shared_ptr<transfer_vulkan> _transfer;
+		VmaAllocator _allocator;
+
+		VkBuffer _vertex_buffer;
+		VmaAllocation _vertex_allocation;
+		range_allocator_vulkan _vertex_ranges;
+
+		VkBuffer _index_buffer;
+		VmaAllocation _index_allocation;
+		range_allocator_vulkan _index_ranges;
+
+		VkBuffer _short_index_buffer;
+		VmaAllocation _short_index_allocation;
+		range_allocator_vulkan _short_index_ranges;
+
+		VkBuffer _cluster_buffer;
+		VmaAllocation _cluster_allocation;
+		range_allocator_vulkan _cluster_ranges;
+	};
+}
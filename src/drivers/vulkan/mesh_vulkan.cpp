@@ -1,61 +1,79 @@
 #include "mesh_vulkan.hpp"
 #include "utils_vulkan.hpp"
 
+#include <limits>
+#include <vector>
+
 using namespace rb;
 
-mesh_vulkan::mesh_vulkan(VkDevice device, VmaAllocator allocator, const mesh_desc& desc)
+mesh_vulkan::mesh_vulkan(const std::shared_ptr<mesh_arena_vulkan>& arena, const mesh_desc& desc)
 	: mesh(desc)
-	, _device(device)
-	, _allocator(allocator) {
-    VkBufferCreateInfo vertex_buffer_info;
-    vertex_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    vertex_buffer_info.pNext = nullptr;
-    vertex_buffer_info.flags = 0;
-    vertex_buffer_info.size = desc.vertices.size_bytes();
-    vertex_buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    vertex_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    vertex_buffer_info.queueFamilyIndexCount = 0;
-    vertex_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo vertex_allocation_info{};
-    vertex_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-    RB_VK(vmaCreateBuffer(allocator, &vertex_buffer_info, &vertex_allocation_info, &_vertex_buffer, &_vertex_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    void* ptr;
-    RB_VK(vmaMapMemory(_allocator, _vertex_allocation, &ptr), "Failed to map memory");
-    std::memcpy(ptr, desc.vertices.data(), desc.vertices.size_bytes());
-    vmaUnmapMemory(_allocator, _vertex_allocation);
-
-    VkBufferCreateInfo index_buffer_info;
-    index_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    index_buffer_info.pNext = nullptr;
-    index_buffer_info.flags = 0;
-    index_buffer_info.size = desc.indices.size_bytes();
-    index_buffer_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    index_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    index_buffer_info.queueFamilyIndexCount = 0;
-    index_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo index_allocation_info{};
-    index_allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-    RB_VK(vmaCreateBuffer(allocator, &index_buffer_info, &index_allocation_info, &_index_buffer, &_index_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    RB_VK(vmaMapMemory(_allocator, _index_allocation, &ptr), "Failed to map memory");
-    std::memcpy(ptr, desc.indices.data(), desc.indices.size_bytes());
-    vmaUnmapMemory(_allocator, _index_allocation);
+	, _arena(arena) {
+    // Mesh only records where its geometry lives in shared arena.
+    _vertices_resident = _arena->allocate_vertices(packed_vertices(), _vertex_offset);
+
+    // Every vertex of small mesh is addressable with 16-bit index, which halves index memory.
+    if (packed_vertices().size() <= std::numeric_limits<std::uint16_t>::max() + 1u) {
+        const std::vector<std::uint16_t> short_indices{ indices().begin(), indices().end() };
+        _index_type = VK_INDEX_TYPE_UINT16;
+        _indices_resident = _vertices_resident && _arena->allocate_indices(span<const std::uint16_t>{ short_indices }, _index_offset);
+    } else {
+        _index_type = VK_INDEX_TYPE_UINT32;
+        _indices_resident = _vertices_resident && _arena->allocate_indices(indices(), _index_offset);
+    }
+
+    // Vertices are useless without indices, so their range is returned right away.
+    if (_vertices_resident && !_indices_resident) {
+        _arena->free_vertices(_vertex_offset, static_cast<std::uint32_t>(packed_vertices().size()));
+        _vertices_resident = false;
+    }
+
+    // Without room for clusters mesh is still drawn, with base lod as a whole.
+    if (resident() && !clusters().empty() && _arena->allocate_clusters(clusters(), _cluster_offset)) {
+        _cluster_count = static_cast<std::uint32_t>(clusters().size());
+    }
 }
 
 mesh_vulkan::~mesh_vulkan() {
-    vmaDestroyBuffer(_allocator, _vertex_buffer, _vertex_allocation);
-    vmaDestroyBuffer(_allocator, _index_buffer, _index_allocation);
+    if (_cluster_count > 0) {
+        _arena->free_clusters(_cluster_offset, _cluster_count);
+    }
+    if (_indices_resident) {
+        _arena->free_indices(_index_type, _index_offset, static_cast<std::uint32_t>(indices().size()));
+    }
+    if (_vertices_resident) {
+        _arena->free_vertices(_vertex_offset, static_cast<std::uint32_t>(packed_vertices().size()));
+    }
 }
 
 VkBuffer mesh_vulkan::vertex_buffer() const {
-    return _vertex_buffer;
+    return _arena->vertex_buffer();
 }
 
 VkBuffer mesh_vulkan::index_buffer() const {
-    return _index_buffer;
+    return _arena->index_buffer(_index_type);
+}
+
+std::uint32_t mesh_vulkan::vertex_offset() const {
+    return _vertex_offset;
+}
+
+std::uint32_t mesh_vulkan::index_offset() const {
+    return _index_offset;
+}
+
+VkIndexType mesh_vulkan::index_type() const {
+    return _index_type;
+}
+
+std::uint32_t mesh_vulkan::cluster_offset() const {
+    return _cluster_offset;
+}
+
+std::uint32_t mesh_vulkan::cluster_count() const {
+    return _cluster_count;
+}
+
+bool mesh_vulkan::resident() const {
+    return _vertices_resident && _indices_resident;
 }
@@ -2,13 +2,15 @@
 
 #include <rabbit/graphics/mesh.hpp>
 
+#include "mesh_arena_vulkan.hpp"
+
 #include <volk.h>
 #include <vk_mem_alloc.h>
 
 namespace rb {
 	class mesh_vulkan : public mesh {
 	public:
-		mesh_vulkan(VkDevice device, VmaAllocator allocator, const mesh_desc& desc);
+		mesh_vulkan(const std::shared_ptr<mesh_arena_vulkan>& arena, const mesh_desc& desc);
 
 		~mesh_vulkan();
 
@@ -16,14 +18,29 @@ namespace rb {
 
 		VkBuffer index_buffer() const;
 
-	private:
-		VkDevice _device;
-		VmaAllocator _allocator;
+		std::uint32_t vertex_offset() const;
+
+		std::uint32_t index_offset() const;
+
+		VkIndexType index_type() const;
 
-		VkBuffer _vertex_buffer;
-		VmaAllocation _vertex_allocation;
+		std::uint32_t cluster_offset() const;
 
-		VkBuffer _index_buffer;
-		VmaAllocation _index_allocation;
+		// Clusters uploaded to arena, 0 when base lod is drawn as a whole.
+		std::uint32_t cluster_count() const;
+
+		// False when arena had no room for geometry, such mesh is never drawn.
+		bool resident() const;
+
+	private:
+		std::shared_ptr<mesh_arena_vulkan> _arena;
+
+		std::uint32_t _vertex_offset{ 0 };
+		std::uint32_t _index_offset{ 0 };
+		VkIndexType _index_type;
+		std::uint32_t _cluster_offset{ 0 };
+		std::uint32_t _cluster_count{ 0 };
+		bool _vertices_resident{ false };
+		bool _indices_resident{ false };
 	};
 }
@@ -1,18 +1,13 @@
 #include "shaders_vulkan.hpp"
 
 #include <rabbit/generated/shaders/quad.vert.spv.h>
-#include <rabbit/generated/shaders/brdf.frag.spv.h>
-#include <rabbit/generated/shaders/irradiance.vert.spv.h>
-#include <rabbit/generated/shaders/irradiance.frag.spv.h>
-#include <rabbit/generated/shaders/prefilter.vert.spv.h>
-#include <rabbit/generated/shaders/prefilter.frag.spv.h>
 #include <rabbit/generated/shaders/shadowmap.vert.spv.h>
 #include <rabbit/generated/shaders/geometry.vert.spv.h>
 #include <rabbit/generated/shaders/geometry.frag.spv.h>
 #include <rabbit/generated/shaders/geometry_nomaps.frag.spv.h>
 #include <rabbit/generated/shaders/depth.vert.spv.h>
 #include <rabbit/generated/shaders/forward.vert.spv.h>
-#include <rabbit/generated/shaders/forward.frag.glsl.h>
+#include <rabbit/generated/shaders/forward.frag.spv.h>
 #include <rabbit/generated/shaders/skybox.vert.spv.h>
 #include <rabbit/generated/shaders/skybox.frag.spv.h>
 #include <rabbit/generated/shaders/ambient.frag.spv.h>
@@ -29,8 +24,7 @@
 #include <rabbit/generated/shaders/outline.frag.spv.h>
 #include <rabbit/generated/shaders/present.frag.spv.h>
 #include <rabbit/generated/shaders/light_culling.comp.spv.h>
-
-#include <rabbit/graphics/glsl.hpp>
+#include <rabbit/generated/shaders/instance_culling.comp.spv.h>
 
 using namespace rb;
 
@@ -38,26 +32,6 @@ span<const std::uint32_t> shaders_vulkan::quad_vert() {
 	return ::quad_vert;
 }
 
-span<const std::uint32_t> shaders_vulkan::brdf_frag() {
-	return ::brdf_frag;
-}
-
-span<const std::uint32_t> shaders_vulkan::irradiance_vert() {
-	return ::irradiance_vert;
-}
-
-span<const std::uint32_t> shaders_vulkan::irradiance_frag() {
-	return ::irradiance_frag;
-}
-
-span<const std::uint32_t> shaders_vulkan::prefilter_vert() {
-	return ::prefilter_vert;
-}
-
-span<const std::uint32_t> shaders_vulkan::prefilter_frag() {
-	return ::prefilter_frag;
-}
-
 span<const std::uint32_t> shaders_vulkan::geometry_vert() {
 	return ::geometry_vert;
 }
@@ -78,11 +52,8 @@ span<const std::uint32_t> shaders_vulkan::forward_vert() {
 	return ::forward_vert;
 }
 
-std::vector<std::uint32_t> shaders_vulkan::forward_frag(const span<const std::string> definitions) {
-	std::string code;
-	code.resize(sizeof(::forward_frag));
-	std::memcpy(&code[0], ::forward_frag, sizeof(::forward_frag));
-	return glsl::compile(shader_stage::fragment, code, definitions);
+span<const std::uint32_t> shaders_vulkan::forward_frag() {
+	return ::forward_frag;
 }
 
 span<const std::uint32_t> shaders_vulkan::skybox_vert() {
@@ -152,3 +123,7 @@ span<const std::uint32_t> shaders_vulkan::present_frag() {
 span<const std::uint32_t> shaders_vulkan::light_cull_comp() {
 	return ::light_culling_comp;
 }
+
+span<const std::uint32_t> shaders_vulkan::instance_cull_comp() {
+	return ::instance_culling_comp;
+}
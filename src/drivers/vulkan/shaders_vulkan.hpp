@@ -8,17 +8,12 @@ namespace rb {
 	class shaders_vulkan {
 	public:
 		static span<const std::uint32_t> quad_vert();
-		static span<const std::uint32_t> brdf_frag();
-		static span<const std::uint32_t> irradiance_vert();
-		static span<const std::uint32_t> irradiance_frag();
-		static span<const std::uint32_t> prefilter_vert();
-		static span<const std::uint32_t> prefilter_frag();
 		static span<const std::uint32_t> geometry_vert();
 		static span<const std::uint32_t> geometry_frag();
 		static span<const std::uint32_t> geometry_nomaps_frag();
 		static span<const std::uint32_t> depth_vert();
 		static span<const std::uint32_t> forward_vert();
-		static std::vector<std::uint32_t> forward_frag(const span<const std::string> definitions);
+		static span<const std::uint32_t> forward_frag();
 		static span<const std::uint32_t> skybox_vert();
 		static span<const std::uint32_t> skybox_frag();
 		static span<const std::uint32_t> ambient_frag();
@@ -36,5 +31,6 @@ namespace rb {
 		static span<const std::uint32_t> outline_frag();
 		static span<const std::uint32_t> present_frag();
 		static span<const std::uint32_t> light_cull_comp();
+		static span<const std::uint32_t> instance_cull_comp();
 	};
 }
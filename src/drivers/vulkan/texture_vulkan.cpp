@@ -2,6 +2,7 @@
 #include "utils_vulkan.hpp"
 
 #include <map>
+#include <vector>
 #include <algorithm>
 
 using namespace rb; 
@@ -12,6 +13,8 @@ static std::map<texture_format, VkFormat> formats = {
     { texture_format::rgba8, VK_FORMAT_R8G8B8A8_UNORM },
     { texture_format::bc1, VK_FORMAT_BC1_RGBA_UNORM_BLOCK },
     { texture_format::bc3, VK_FORMAT_BC3_UNORM_BLOCK },
+    { texture_format::bc4, VK_FORMAT_BC4_UNORM_BLOCK },
+    { texture_format::bc5, VK_FORMAT_BC5_UNORM_BLOCK },
 };
 
 static std::map<texture_filter, VkFilter> filters = {
@@ -26,20 +29,19 @@ static std::map<texture_wrap, VkSamplerAddressMode> sampler_address_modes = {
 
 texture_vulkan::texture_vulkan(VkDevice device,
     const VkPhysicalDeviceProperties& physical_device_properties,
-    VkQueue graphics_queue,
-    VkCommandPool command_pool,
+    transfer_vulkan& transfer,
     VmaAllocator allocator,
     const texture_desc& desc)
     : texture(desc)
     , _device(device)
     , _allocator(allocator) {
-    _create_image(desc);
+    _create_image(transfer, desc);
 
     if (desc.data) {
-        _update_image(graphics_queue, command_pool, desc);
+        _update_image(transfer, desc);
 
         if (desc.mipmaps == 0) {
-            _generate_mipmaps(graphics_queue, command_pool, desc);
+            _generate_mipmaps(transfer, desc);
         }
     }
 
@@ -65,7 +67,7 @@ VkSampler texture_vulkan::sampler() const {
     return _sampler;
 }
 
-void texture_vulkan::_create_image(const texture_desc& desc) {
+void texture_vulkan::_create_image(transfer_vulkan& transfer, const texture_desc& desc) {
     VkImageCreateInfo image_info;
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.pNext = nullptr;
@@ -78,9 +80,9 @@ void texture_vulkan::_create_image(const texture_desc& desc) {
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.queueFamilyIndexCount = 0;
-    image_info.pQueueFamilyIndices = 0;
+    image_info.sharingMode = transfer.sharing_mode();
+    image_info.queueFamilyIndexCount = transfer.queue_family_count();
+    image_info.pQueueFamilyIndices = transfer.queue_families();
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VmaAllocationCreateInfo allocation_info = {};
@@ -89,45 +91,33 @@ void texture_vulkan::_create_image(const texture_desc& desc) {
         "Failed to create Vulkan image.");
 }
 
-void texture_vulkan::_update_image(VkQueue graphics_queue, VkCommandPool command_pool, const texture_desc& desc) {
-    // Calculate total size.
-    std::uint32_t buffer_size{ 0 };
+void texture_vulkan::_update_image(transfer_vulkan& transfer, const texture_desc& desc) {
+    // Level table already describes where every mipmap is, so it maps directly to copy regions.
+    // Only base level is provided, when mipmaps are generated on GPU.
+    const auto level_count = desc.mipmaps > 0 ? levels().size() : 1;
+    const auto& last_level = levels()[level_count - 1];
+    const auto buffer_size = last_level.offset + last_level.size;
 
-    vec2u mipmap_size{ desc.size };
-    for (auto i = 0u; i < desc.mipmaps; ++i) {
-        buffer_size += mipmap_size.x * mipmap_size.y * bits_per_pixel() / 8;
-        mipmap_size = mipmap_size / 2u;
-    }
-
-    // Create staging buffer.
-    VkBufferCreateInfo buffer_info;
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.pNext = nullptr;
-    buffer_info.flags = 0;
-    buffer_info.size = buffer_size;
-    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    buffer_info.queueFamilyIndexCount = 0;
-    buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo allocation_info = {};
-    allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-    VkBuffer staging_buffer;
-    VmaAllocation staging_buffer_allocation;
-
-    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &staging_buffer, &staging_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer");
-
-    // Transfer pixels into buffer.
-    void* data;
-    RB_VK(vmaMapMemory(_allocator, staging_buffer_allocation, &data), "Failed to map staging buffer memory");
+    // Copy pixels into staging ring before recording, because staging may submit pending uploads.
+    const auto staging = transfer.stage(desc.data, buffer_size);
 
-    std::memcpy(data, desc.data, buffer_info.size);
+    std::vector<VkBufferImageCopy> regions(level_count);
+    for (auto i = 0u; i < regions.size(); ++i) {
+        const auto size = level_size(desc.size, i);
 
-    vmaUnmapMemory(_allocator, staging_buffer_allocation);
+        auto& region = regions[i];
+        region.bufferOffset = staging.offset + levels()[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { size.x, size.y, 1 };
+    }
 
-    auto command_buffer = utils_vulkan::begin_single_time_commands(_device, command_pool);
+    auto command_buffer = transfer.transfer_commands();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -147,25 +137,8 @@ void texture_vulkan::_update_image(VkQueue graphics_queue, VkCommandPool command
     vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-    mipmap_size = desc.size;
-    std::uint32_t buffer_offset{ 0 };
-    for (auto i = 0u; i < desc.mipmaps; ++i) {
-        VkBufferImageCopy region{};
-        region.bufferOffset = buffer_offset;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = i;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = { mipmap_size.x, mipmap_size.y, 1 };
-
-        vkCmdCopyBufferToImage(command_buffer, staging_buffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-   
-        buffer_offset += mipmap_size.x * mipmap_size.y * bits_per_pixel() / 8;
-        mipmap_size = mipmap_size / 2u;
-    }
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<std::uint32_t>(regions.size()), regions.data());
 
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -179,18 +152,15 @@ void texture_vulkan::_update_image(VkQueue graphics_queue, VkCommandPool command
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = transfer.release_access(VK_ACCESS_SHADER_READ_BIT);
 
     vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    utils_vulkan::end_single_time_commands(_device, graphics_queue, command_pool, command_buffer);
-
-    vmaDestroyBuffer(_allocator, staging_buffer, staging_buffer_allocation);
+        transfer.release_stage(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT), 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
-void texture_vulkan::_generate_mipmaps(VkQueue graphics_queue, VkCommandPool command_pool, const texture_desc& desc) {
-    auto command_buffer = utils_vulkan::begin_single_time_commands(_device, command_pool);
+void texture_vulkan::_generate_mipmaps(transfer_vulkan& transfer, const texture_desc& desc) {
+    // Blits require graphics queue. Submission waits for base level upload on transfer queue.
+    auto command_buffer = transfer.begin_graphics();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -294,7 +264,7 @@ void texture_vulkan::_generate_mipmaps(VkQueue graphics_queue, VkCommandPool com
         0, nullptr,
         1, &barrier);
 
-    utils_vulkan::end_single_time_commands(_device, graphics_queue, command_pool, command_buffer);
+    transfer.end_graphics(command_buffer);
 }
 
 void texture_vulkan::_create_image_view(const texture_desc& desc) {
@@ -2,6 +2,8 @@
 
 #include <rabbit/graphics/texture.hpp>
 
+#include "transfer_vulkan.hpp"
+
 #include <volk.h>
 #include <vk_mem_alloc.h>
 
@@ -10,8 +12,7 @@ namespace rb {
 	public:
 		texture_vulkan(VkDevice device,
 			const VkPhysicalDeviceProperties& physical_device_properties,
-			VkQueue graphics_queue,
-			VkCommandPool command_pool,
+			transfer_vulkan& transfer,
 			VmaAllocator allocator,
 			const texture_desc& desc);
 
@@ -24,11 +25,11 @@ namespace rb {
 		VkSampler sampler() const;
 
 	private:
-		void _create_image(const texture_desc& desc);
+		void _create_image(transfer_vulkan& transfer, const texture_desc& desc);
 
-		void _update_image(VkQueue graphics_queue, VkCommandPool command_pool, const texture_desc& desc);
+		void _update_image(transfer_vulkan& transfer, const texture_desc& desc);
 
-		void _generate_mipmaps(VkQueue graphics_queue, VkCommandPool command_pool, const texture_desc& desc);
+		void _generate_mipmaps(transfer_vulkan& transfer, const texture_desc& desc);
 
 		void _create_image_view(const texture_desc& desc);
 
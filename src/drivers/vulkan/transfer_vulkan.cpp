@@ -0,0 +1,455 @@
+#include "transfer_vulkan.hpp"
+#include "utils_vulkan.hpp"
+
+#include <cstring>
+
+using namespace rb;
+
+transfer_vulkan::transfer_vulkan(VkDevice device,
+    VmaAllocator allocator,
+    std::uint32_t graphics_family,
+    VkQueue graphics_queue,
+    std::uint32_t transfer_family,
+    VkQueue transfer_queue,
+    VkDeviceSize ring_size)
+    : _device(device)
+    , _allocator(allocator)
+    , _queue_families{ graphics_family, transfer_family }
+    , _graphics_queue(graphics_queue)
+    , _transfer_queue(transfer_queue) {
+    _graphics_command_pool = _create_command_pool(graphics_family);
+    _transfer_command_pool = _create_command_pool(transfer_family);
+    _create_ring(ring_size);
+}
+
+transfer_vulkan::~transfer_vulkan() {
+    wait(flush());
+
+    for (auto semaphore : _wait_semaphores) {
+        vkDestroySemaphore(_device, semaphore, nullptr);
+    }
+
+    for (auto semaphore : _free_semaphores) {
+        vkDestroySemaphore(_device, semaphore, nullptr);
+    }
+
+    for (auto fence : _free_fences) {
+        vkDestroyFence(_device, fence, nullptr);
+    }
+
+    vmaUnmapMemory(_allocator, _ring_allocation);
+    vmaDestroyBuffer(_allocator, _ring_buffer, _ring_allocation);
+
+    vkDestroyCommandPool(_device, _transfer_command_pool, nullptr);
+    vkDestroyCommandPool(_device, _graphics_command_pool, nullptr);
+}
+
+bool transfer_vulkan::dedicated() const {
+    return _queue_families[0] != _queue_families[1];
+}
+
+VkSharingMode transfer_vulkan::sharing_mode() const {
+    // Concurrent sharing avoids queue family ownership transfers of uploaded resources.
+    return dedicated() ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+}
+
+std::uint32_t transfer_vulkan::queue_family_count() const {
+    return dedicated() ? 2 : 0;
+}
+
+const std::uint32_t* transfer_vulkan::queue_families() const {
+    return dedicated() ? _queue_families : nullptr;
+}
+
+VkPipelineStageFlags transfer_vulkan::release_stage(VkPipelineStageFlags graphics_stage) const {
+    // Transfer queue cannot wait for graphics stages. Graphics submission waits for upload semaphore instead.
+    return dedicated() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : graphics_stage;
+}
+
+VkAccessFlags transfer_vulkan::release_access(VkAccessFlags graphics_access) const {
+    return dedicated() ? 0 : graphics_access;
+}
+
+staging_region transfer_vulkan::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > _ring_size) {
+        // Data does not fit into ring at all, so use temporary buffer released with current batch.
+        VkBufferCreateInfo buffer_info;
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.pNext = nullptr;
+        buffer_info.flags = 0;
+        buffer_info.size = size;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        buffer_info.queueFamilyIndexCount = 0;
+        buffer_info.pQueueFamilyIndices = nullptr;
+
+        VmaAllocationCreateInfo allocation_info{};
+        allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &buffer, &allocation, nullptr),
+            "Failed to create Vulkan buffer");
+
+        void* ptr;
+        RB_VK(vmaMapMemory(_allocator, allocation, &ptr), "Failed to map staging buffer memory");
+        std::memcpy(ptr, data, size);
+        vmaUnmapMemory(_allocator, allocation);
+
+        _batch_callbacks.push_back([allocator = _allocator, buffer, allocation]() {
+            vmaDestroyBuffer(allocator, buffer, allocation);
+        });
+
+        return { buffer, 0 };
+    }
+
+    VkDeviceSize offset{ 0 };
+    while (!_allocate_ring(size, alignment, offset)) {
+        // Ring is full. Submit pending uploads and wait only for the oldest submission.
+        flush();
+
+        RB_ASSERT(!_submissions.empty(), "Staging ring is too small");
+        RB_VK(vkWaitForFences(_device, 1, &_submissions.front().fence, VK_TRUE, UINT64_MAX),
+            "Failed to wait for transfer fence");
+
+        collect();
+    }
+
+    std::memcpy(_ring_data + offset, data, size);
+    return { _ring_buffer, offset };
+}
+
+VkCommandBuffer transfer_vulkan::transfer_commands() {
+    if (_transfer_command_buffer == VK_NULL_HANDLE) {
+        _transfer_command_buffer = _allocate_command_buffer(_transfer_command_pool);
+    }
+    return _transfer_command_buffer;
+}
+
+void transfer_vulkan::upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+
+    // Stage first, because staging may submit current batch when ring is full.
+    const auto region = stage(data, size);
+
+    VkBufferCopy copy;
+    copy.srcOffset = region.offset;
+    copy.dstOffset = offset;
+    copy.size = size;
+    vkCmdCopyBuffer(transfer_commands(), region.buffer, buffer, 1, &copy);
+}
+
+std::uint64_t transfer_vulkan::flush() {
+    if (_transfer_command_buffer == VK_NULL_HANDLE) {
+        return _next_ticket - 1;
+    }
+
+    if (!dedicated()) {
+        // Uploads run on rendering queue, so later submissions only need memory dependency.
+        VkMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(_transfer_command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    RB_VK(vkEndCommandBuffer(_transfer_command_buffer), "Failed to end command buffer");
+
+    submission submission;
+    submission.ticket = _next_ticket++;
+    submission.command_pool = _transfer_command_pool;
+    submission.command_buffer = _transfer_command_buffer;
+    submission.fence = _acquire_fence();
+    submission.ring_head = _ring_head;
+    submission.ring_bytes = _batch_ring_bytes;
+    submission.callbacks = std::move(_batch_callbacks);
+
+    VkSubmitInfo submit_info;
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = nullptr;
+    submit_info.waitSemaphoreCount = 0;
+    submit_info.pWaitSemaphores = nullptr;
+    submit_info.pWaitDstStageMask = nullptr;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &_transfer_command_buffer;
+    submit_info.signalSemaphoreCount = 0;
+    submit_info.pSignalSemaphores = nullptr;
+
+    VkSemaphore semaphore{ VK_NULL_HANDLE };
+    if (dedicated()) {
+        // Next graphics submission waits for this semaphore before using uploaded resources.
+        semaphore = _acquire_semaphore();
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &semaphore;
+        _wait_semaphores.push_back(semaphore);
+    }
+
+    RB_VK(vkQueueSubmit(_transfer_queue, 1, &submit_info, submission.fence), "Failed to queue submit");
+
+    _transfer_command_buffer = VK_NULL_HANDLE;
+    _batch_ring_bytes = 0;
+
+    _submissions.push_back(std::move(submission));
+    return _submissions.back().ticket;
+}
+
+VkCommandBuffer transfer_vulkan::begin_graphics() {
+    return _allocate_command_buffer(_graphics_command_pool);
+}
+
+std::uint64_t transfer_vulkan::end_graphics(VkCommandBuffer command_buffer) {
+    // Graphics commands may consume resources uploaded so far.
+    flush();
+
+    // Make results visible for everything submitted later.
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    RB_VK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+    submission submission;
+    submission.ticket = _next_ticket++;
+    submission.command_pool = _graphics_command_pool;
+    submission.command_buffer = command_buffer;
+    submission.fence = _acquire_fence();
+    submission.ring_head = _ring_head;
+    submission.ring_bytes = 0;
+    submission.semaphores = std::move(_wait_semaphores);
+
+    const std::vector<VkPipelineStageFlags> wait_stages(submission.semaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+    VkSubmitInfo submit_info;
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = nullptr;
+    submit_info.waitSemaphoreCount = static_cast<std::uint32_t>(submission.semaphores.size());
+    submit_info.pWaitSemaphores = submission.semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 0;
+    submit_info.pSignalSemaphores = nullptr;
+
+    RB_VK(vkQueueSubmit(_graphics_queue, 1, &submit_info, submission.fence), "Failed to queue submit");
+
+    _wait_semaphores.clear();
+    _submissions.push_back(std::move(submission));
+    return _submissions.back().ticket;
+}
+
+void transfer_vulkan::submit_graphics(const VkSubmitInfo& submit_info, VkFence fence) {
+    flush();
+
+    std::vector<VkSemaphore> wait_semaphores(submit_info.pWaitSemaphores, submit_info.pWaitSemaphores + submit_info.waitSemaphoreCount);
+    std::vector<VkPipelineStageFlags> wait_stages(submit_info.pWaitDstStageMask, submit_info.pWaitDstStageMask + submit_info.waitSemaphoreCount);
+    for (auto semaphore : _wait_semaphores) {
+        wait_semaphores.push_back(semaphore);
+        wait_stages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
+    auto info = submit_info;
+    info.waitSemaphoreCount = static_cast<std::uint32_t>(wait_semaphores.size());
+    info.pWaitSemaphores = wait_semaphores.data();
+    info.pWaitDstStageMask = wait_stages.data();
+
+    RB_VK(vkQueueSubmit(_graphics_queue, 1, &info, fence), "Failed to queue submit");
+
+    // Caller owns given fence, so completion is tracked by an empty submission with own fence.
+    submission submission;
+    submission.ticket = _next_ticket++;
+    submission.command_pool = VK_NULL_HANDLE;
+    submission.command_buffer = VK_NULL_HANDLE;
+    submission.fence = _acquire_fence();
+    submission.ring_head = _ring_head;
+    submission.ring_bytes = 0;
+    submission.semaphores = std::move(_wait_semaphores);
+
+    RB_VK(vkQueueSubmit(_graphics_queue, 0, nullptr, submission.fence), "Failed to queue submit");
+
+    _wait_semaphores.clear();
+    _submissions.push_back(std::move(submission));
+}
+
+void transfer_vulkan::defer(std::function<void()> callback) {
+    if (_transfer_command_buffer != VK_NULL_HANDLE) {
+        _batch_callbacks.push_back(std::move(callback));
+    } else if (!_submissions.empty()) {
+        // Submissions retire in order, so callback runs after everything submitted so far.
+        _submissions.back().callbacks.push_back(std::move(callback));
+    } else {
+        callback();
+    }
+}
+
+void transfer_vulkan::wait(std::uint64_t ticket) {
+    while (!_submissions.empty() && _submissions.front().ticket <= ticket) {
+        RB_VK(vkWaitForFences(_device, 1, &_submissions.front().fence, VK_TRUE, UINT64_MAX),
+            "Failed to wait for transfer fence");
+
+        _retire(_submissions.front());
+        _submissions.pop_front();
+    }
+}
+
+void transfer_vulkan::collect() {
+    while (!_submissions.empty() && vkGetFenceStatus(_device, _submissions.front().fence) == VK_SUCCESS) {
+        _retire(_submissions.front());
+        _submissions.pop_front();
+    }
+}
+
+void transfer_vulkan::_create_ring(VkDeviceSize ring_size) {
+    VkBufferCreateInfo buffer_info;
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.pNext = nullptr;
+    buffer_info.flags = 0;
+    buffer_info.size = ring_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = 0;
+    buffer_info.pQueueFamilyIndices = nullptr;
+
+    VmaAllocationCreateInfo allocation_info{};
+    allocation_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    RB_VK(vmaCreateBuffer(_allocator, &buffer_info, &allocation_info, &_ring_buffer, &_ring_allocation, nullptr),
+        "Failed to create Vulkan buffer");
+
+    void* ptr;
+    RB_VK(vmaMapMemory(_allocator, _ring_allocation, &ptr), "Failed to map staging ring memory");
+    _ring_data = static_cast<std::uint8_t*>(ptr);
+    _ring_size = ring_size;
+}
+
+VkCommandPool transfer_vulkan::_create_command_pool(std::uint32_t family) {
+    VkCommandPoolCreateInfo pool_info;
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.pNext = nullptr;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = family;
+
+    VkCommandPool command_pool;
+    RB_VK(vkCreateCommandPool(_device, &pool_info, nullptr, &command_pool), "Failed to create command pool.");
+    return command_pool;
+}
+
+VkCommandBuffer transfer_vulkan::_allocate_command_buffer(VkCommandPool command_pool) {
+    VkCommandBufferAllocateInfo allocate_info;
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.pNext = nullptr;
+    allocate_info.commandPool = command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer;
+    RB_VK(vkAllocateCommandBuffers(_device, &allocate_info, &command_buffer), "Failed to allocate command buffer");
+
+    VkCommandBufferBeginInfo begin_info;
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.pNext = nullptr;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = nullptr;
+
+    RB_VK(vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+    return command_buffer;
+}
+
+VkFence transfer_vulkan::_acquire_fence() {
+    if (!_free_fences.empty()) {
+        const auto fence = _free_fences.back();
+        _free_fences.pop_back();
+        return fence;
+    }
+
+    VkFenceCreateInfo fence_info;
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.pNext = nullptr;
+    fence_info.flags = 0;
+
+    VkFence fence;
+    RB_VK(vkCreateFence(_device, &fence_info, nullptr, &fence), "Failed to create Vulkan fence");
+    return fence;
+}
+
+VkSemaphore transfer_vulkan::_acquire_semaphore() {
+    if (!_free_semaphores.empty()) {
+        const auto semaphore = _free_semaphores.back();
+        _free_semaphores.pop_back();
+        return semaphore;
+    }
+
+    VkSemaphoreCreateInfo semaphore_info;
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = nullptr;
+    semaphore_info.flags = 0;
+
+    VkSemaphore semaphore;
+    RB_VK(vkCreateSemaphore(_device, &semaphore_info, nullptr, &semaphore), "Failed to create Vulkan semaphore");
+    return semaphore;
+}
+
+bool transfer_vulkan::_allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    if (_ring_used == 0) {
+        _ring_head = 0;
+        _ring_tail = 0;
+    } else if (_ring_head == _ring_tail) {
+        return false;
+    }
+
+    const auto aligned_head = (_ring_head + alignment - 1) / alignment * alignment;
+
+    if (_ring_head >= _ring_tail) {
+        // Free space is between head and end of ring, and between beginning of ring and tail.
+        if (aligned_head + size <= _ring_size) {
+            offset = aligned_head;
+        } else if (size <= _ring_tail) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (aligned_head + size <= _ring_tail) {
+        offset = aligned_head;
+    } else {
+        return false;
+    }
+
+    // Skipped bytes at the end of ring are released together with this allocation.
+    const auto consumed = offset >= _ring_head ? offset + size - _ring_head : _ring_size - _ring_head + size;
+
+    _ring_head = offset + size;
+    _ring_used += consumed;
+    _batch_ring_bytes += consumed;
+    return true;
+}
+
+void transfer_vulkan::_retire(submission& submission) {
+    for (auto& callback : submission.callbacks) {
+        callback();
+    }
+
+    if (submission.command_buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(_device, submission.command_pool, 1, &submission.command_buffer);
+    }
+
+    RB_VK(vkResetFences(_device, 1, &submission.fence), "Failed to reset fence");
+    _free_fences.push_back(submission.fence);
+
+    // Semaphores were waited by this submission, so they are unsignaled again.
+    for (auto semaphore : submission.semaphores) {
+        _free_semaphores.push_back(semaphore);
+    }
+
+    if (submission.ring_bytes > 0) {
+        _ring_tail = submission.ring_head;
+        _ring_used -= submission.ring_bytes;
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once 
+
+#include <volk.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <functional>
+
+namespace rb {
+	struct staging_region {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+	};
+
+	// Uploads resources through persistent staging ring, using dedicated transfer queue when device has one.
+	// Submissions are tracked with fences, so neither CPU nor GPU waits for queue to become idle.
+	// Every graphics submission waits for uploads recorded before it.
+	class transfer_vulkan {
+	public:
+		transfer_vulkan(VkDevice device,
+			VmaAllocator allocator,
+			std::uint32_t graphics_family,
+			VkQueue graphics_queue,
+			std::uint32_t transfer_family,
+			VkQueue transfer_queue,
+			VkDeviceSize ring_size);
+
+		transfer_vulkan(const transfer_vulkan&) = delete;
+
+		transfer_vulkan& operator=(const transfer_vulkan&) = delete;
+
+		~transfer_vulkan();
+
+		bool dedicated() const;
+
+		VkSharingMode sharing_mode() const;
+
+		std::uint32_t queue_family_count() const;
+
+		const std::uint32_t* queue_families() const;
+
+		VkPipelineStageFlags release_stage(VkPipelineStageFlags graphics_stage) const;
+
+		VkAccessFlags release_access(VkAccessFlags graphics_access) const;
+
+		staging_region stage(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+
+		VkCommandBuffer transfer_commands();
+
+		void upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+		std::uint64_t flush();
+
+		VkCommandBuffer begin_graphics();
+
+		std::uint64_t end_graphics(VkCommandBuffer command_buffer);
+
+		void submit_graphics(const VkSubmitInfo& submit_info, VkFence fence);
+
+		void defer(std::function<void()> callback);
+
+		void wait(std::uint64_t ticket);
+
+		void collect();
+
+	private:
+		struct submission {
+			std::uint64_t ticket;
+			VkCommandPool command_pool;
+			VkCommandBuffer command_buffer;
+			VkFence fence;
+			VkDeviceSize ring_head;
+			VkDeviceSize ring_bytes;
+			std::vector<VkSemaphore> semaphores;
+			std::vector<std::function<void()>> callbacks;
+		};
+
+		void _create_ring(VkDeviceSize ring_size);
+
+		VkCommandPool _create_command_pool(std::uint32_t family);
+
+		VkCommandBuffer _allocate_command_buffer(VkCommandPool command_pool);
+
+		VkFence _acquire_fence();
+
+		VkSemaphore _acquire_semaphore();
+
+		bool _allocate_ring(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+		void _retire(submission& submission);
+
+	private:
+		VkDevice _device;
+		VmaAllocator _allocator;
+
+		std::uint32_t _queue_families[2];
+		VkQueue _graphics_queue;
+		VkQueue _transfer_queue;
+
+		VkCommandPool _graphics_command_pool;
+		VkCommandPool _transfer_command_pool;
+
+		VkBuffer _ring_buffer;
+		VmaAllocation _ring_allocation;
+		std::uint8_t* _ring_data;
+		VkDeviceSize _ring_size;
+		VkDeviceSize _ring_head{ 0 };
+		VkDeviceSize _ring_tail{ 0 };
+		VkDeviceSize _ring_used{ 0 };
+
+		VkCommandBuffer _transfer_command_buffer{ VK_NULL_HANDLE };
+		VkDeviceSize _batch_ring_bytes{ 0 };
+		std::vector<std::function<void()>> _batch_callbacks;
+
+		std::uint64_t _next_ticket{ 1 };
+		std::deque<submission> _submissions;
+		std::vector<VkSemaphore> _wait_semaphores;
+
+		std::vector<VkFence> _free_fences;
+		std::vector<VkSemaphore> _free_semaphores;
+	};
+}
@@ -18,11 +18,3 @@
 #endif
 
 #define RB_VK(expr, msg, ...) RB_CHECK_VULKAN(expr, msg, __VA_ARGS__)
-
-namespace rb {
-	struct utils_vulkan {
-		static VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool command_pool);
-
-		static void end_single_time_commands(VkDevice device, VkQueue graphics_queue, VkCommandPool command_pool, VkCommandBuffer command_buffer);
-	};
-}
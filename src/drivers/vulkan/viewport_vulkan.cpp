@@ -3,6 +3,9 @@
 
 #include <rabbit/graphics/graphics.hpp>
 
+#include <cmath>
+#include <algorithm>
+
 using namespace rb;
 
 viewport_vulkan::viewport_vulkan(VkDevice device,
@@ -54,9 +57,14 @@ viewport_vulkan::~viewport_vulkan() {
         vmaDestroyImage(_allocator, _forward_images[i], _forward_images_allocations[i]);
     }
 
-    vmaDestroyBuffer(_allocator, _light_info_buffer, _light_info_buffer_allocation);
-    vmaDestroyBuffer(_allocator, _visible_light_indices_buffer, _visible_light_indices_buffer_allocation);
-    vmaDestroyBuffer(_allocator, _light_buffer, _light_buffer_allocation);
+    vmaDestroyBuffer(_allocator, _light_cluster_buffer, _light_cluster_buffer_allocation);
+    vmaDestroyBuffer(_allocator, _light_index_buffer, _light_index_buffer_allocation);
+    for (auto i = 0u; i < graphics_limits::max_frames_in_flight; ++i) {
+        vmaUnmapMemory(_allocator, _light_info_buffer_allocations[i]);
+        vmaDestroyBuffer(_allocator, _light_info_buffers[i], _light_info_buffer_allocations[i]);
+        vmaUnmapMemory(_allocator, _light_buffer_allocations[i]);
+        vmaDestroyBuffer(_allocator, _light_buffers[i], _light_buffer_allocations[i]);
+    }
 
     vkDestroyFramebuffer(_device, _depth_framebuffer, nullptr);
     vkDestroyImageView(_device, _depth_image_view, nullptr);
@@ -101,37 +109,44 @@ void viewport_vulkan::end_depth_pass(VkCommandBuffer command_buffer) {
     vkCmdEndRenderPass(command_buffer);
 }
 
-void viewport_vulkan::begin_light_pass(VkCommandBuffer command_buffer) {
-    void* mapped_data;
-    RB_VK(vmaMapMemory(_allocator, _light_buffer_allocation, &mapped_data),
-        "Failed to map light buffer");
-
-    _light_data = static_cast<light_data*>(mapped_data);
+void viewport_vulkan::begin_light_pass(VkCommandBuffer command_buffer, std::size_t frame_index) {
+    // Light buffers of given frame are not read by GPU anymore, because its fence was already waited.
+    _frame_index = frame_index;
     _light_index = 0;
     _has_shadows = false;
 }
 
 void viewport_vulkan::add_point_light(const vec3f& position, float radius, const vec3f& color) {
-    _light_data[_light_index].position_or_direction = { position.x, position.y, position.z, 0.0f };
-    _light_data[_light_index].color_and_radius = { color.x, color.y, color.z, radius };
-    ++_light_index;
+    // Lights above buffer capacity are dropped.
+    const auto light_index = _light_index++;
+    if (light_index < graphics_limits::max_lights) {
+        _light_data[_frame_index][light_index].position_or_direction = { position.x, position.y, position.z, 0.0f };
+        _light_data[_frame_index][light_index].color_and_radius = { color.x, color.y, color.z, radius };
+    }
 }
 
 void viewport_vulkan::add_directional_light(const vec3f& direction, const vec3f& color, bool shadow_enabled) {
-    _light_data[_light_index].position_or_direction = { direction.x, direction.y, direction.z, 1.0f };
-    _light_data[_light_index].color_and_radius = { color.x, color.y, color.z, shadow_enabled ? 1.0f : 0.0f };
-    _has_shadows = _has_shadows || shadow_enabled;
-    ++_light_index;
+    const auto light_index = _light_index++;
+    if (light_index < graphics_limits::max_lights) {
+        _light_data[_frame_index][light_index].position_or_direction = { direction.x, direction.y, direction.z, 1.0f };
+        _light_data[_frame_index][light_index].color_and_radius = { color.x, color.y, color.z, shadow_enabled ? 1.0f : 0.0f };
+        _has_shadows = _has_shadows || shadow_enabled;
+    }
 }
 
-void viewport_vulkan::end_light_pass(VkCommandBuffer command_buffer) {
-    vmaUnmapMemory(_allocator, _light_buffer_allocation);
-    //vkCmdUpdateBuffer(command_buffer, _light_buffer, 0, sizeof(light_data) * _light_index, _light_data.get());
+void viewport_vulkan::end_light_pass(VkCommandBuffer command_buffer, float z_near, float z_far) {
+    // Depth slice of view distance d is log(d) * slice_scale + slice_bias.
+    const auto depth_ratio = std::log(z_far / z_near);
+    const auto slice_count = static_cast<float>(_light_cluster_count.z);
 
-    cull_data cull_data;
-    cull_data.light_count = static_cast<unsigned int>(_light_index);
-    cull_data.number_of_tiles_x = (size().x + (size().x % 16)) / 16;
-    vkCmdUpdateBuffer(command_buffer, _light_info_buffer, 0, sizeof(cull_data), &cull_data);
+    _cull_data[_frame_index]->light_count = static_cast<unsigned int>(std::min<std::size_t>(_light_index, graphics_limits::max_lights));
+    _cull_data[_frame_index]->z_near = z_near;
+    _cull_data[_frame_index]->z_far = z_far;
+    _cull_data[_frame_index]->slice_scale = slice_count / depth_ratio;
+    _cull_data[_frame_index]->slice_bias = -slice_count * std::log(z_near) / depth_ratio;
+
+    vmaFlushAllocation(_allocator, _light_buffer_allocations[_frame_index], 0, VK_WHOLE_SIZE);
+    vmaFlushAllocation(_allocator, _light_info_buffer_allocations[_frame_index], 0, VK_WHOLE_SIZE);
 }
 
 void viewport_vulkan::begin_forward_pass(VkCommandBuffer command_buffer) {
@@ -210,15 +225,23 @@ VkDescriptorSet viewport_vulkan::depth_descriptor_set() const {
 }
 
 VkDescriptorSet viewport_vulkan::light_descriptor_set() const {
-    return _light_descriptor_set;
+    return _light_descriptor_sets[_frame_index];
 }
 
 VkBuffer viewport_vulkan::light_buffer() const {
-    return _light_buffer;
+    return _light_buffers[_frame_index];
+}
+
+VkBuffer viewport_vulkan::light_index_buffer() const {
+    return _light_index_buffer;
+}
+
+VkBuffer viewport_vulkan::light_cluster_buffer() const {
+    return _light_cluster_buffer;
 }
 
-VkBuffer viewport_vulkan::visible_light_indices_buffer() const {
-    return _visible_light_indices_buffer;
+std::uint32_t viewport_vulkan::light_cluster_count() const {
+    return _light_cluster_count.x * _light_cluster_count.y * _light_cluster_count.z;
 }
 
 VkDescriptorSet viewport_vulkan::forward_descriptor_set() const {
@@ -244,15 +267,15 @@ bool viewport_vulkan::has_shadows() const {
 void viewport_vulkan::_create_descriptor_pool(const viewport_desc& desc) {
     VkDescriptorPoolSize pool_sizes[3]{
         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, graphics_limits::max_frames_in_flight },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * graphics_limits::max_frames_in_flight }
     };
 
     VkDescriptorPoolCreateInfo descriptor_pool_info;
     descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptor_pool_info.pNext = nullptr;
     descriptor_pool_info.flags = 0;
-    descriptor_pool_info.maxSets = 7;
+    descriptor_pool_info.maxSets = 6 + graphics_limits::max_frames_in_flight;
     descriptor_pool_info.poolSizeCount = 3;
     descriptor_pool_info.pPoolSizes = pool_sizes;
     RB_VK(vkCreateDescriptorPool(_device, &descriptor_pool_info, nullptr, &_descriptor_pool),
@@ -357,77 +380,114 @@ void viewport_vulkan::_create_depth(const viewport_desc& desc, VkFormat depth_fo
 }
 
 void viewport_vulkan::_create_light(const viewport_desc& desc) {
+    const auto tile_size = static_cast<unsigned int>(graphics_limits::light_cluster_tile_size);
+    _light_cluster_count.x = (size().x + tile_size - 1) / tile_size;
+    _light_cluster_count.y = (size().y + tile_size - 1) / tile_size;
+    _light_cluster_count.z = static_cast<unsigned int>(graphics_limits::light_cluster_slices);
+
+    // Clusters share single index list, so its size depends on average light count per cluster, not on the worst one.
+    const auto max_light_indices = light_cluster_count() * static_cast<unsigned int>(graphics_limits::light_cluster_average_lights);
+
+    // Light indices and clusters are written and read only by GPU, so single buffers guarded by barriers are enough.
+    VkBufferCreateInfo light_index_buffer_info;
+    light_index_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    light_index_buffer_info.pNext = nullptr;
+    light_index_buffer_info.flags = 0;
+    light_index_buffer_info.size = sizeof(unsigned int) + max_light_indices * sizeof(unsigned int); // counter + indices
+    light_index_buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    light_index_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    light_index_buffer_info.queueFamilyIndexCount = 0;
+    light_index_buffer_info.pQueueFamilyIndices = nullptr;
+
+    VkBufferCreateInfo light_cluster_buffer_info;
+    light_cluster_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    light_cluster_buffer_info.pNext = nullptr;
+    light_cluster_buffer_info.flags = 0;
+    light_cluster_buffer_info.size = light_cluster_count() * sizeof(light_cluster);
+    light_cluster_buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    light_cluster_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    light_cluster_buffer_info.queueFamilyIndexCount = 0;
+    light_cluster_buffer_info.pQueueFamilyIndices = nullptr;
+
+    VmaAllocationCreateInfo light_cluster_allocation_info{};
+    light_cluster_allocation_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    RB_VK(vmaCreateBuffer(_allocator, &light_index_buffer_info, &light_cluster_allocation_info, &_light_index_buffer, &_light_index_buffer_allocation, nullptr),
+        "Failed to create Vulkan buffer.");
+
+    RB_VK(vmaCreateBuffer(_allocator, &light_cluster_buffer_info, &light_cluster_allocation_info, &_light_cluster_buffer, &_light_cluster_buffer_allocation, nullptr),
+        "Failed to create Vulkan buffer.");
+
     VkBufferCreateInfo light_buffer_info;
     light_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     light_buffer_info.pNext = nullptr;
     light_buffer_info.flags = 0;
     light_buffer_info.size = graphics_limits::max_lights * sizeof(light_data);
-    light_buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    light_buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
     light_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     light_buffer_info.queueFamilyIndexCount = 0;
     light_buffer_info.pQueueFamilyIndices = nullptr;
 
-    VmaAllocationCreateInfo light_allocation_info{};
-    light_allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    RB_VK(vmaCreateBuffer(_allocator, &light_buffer_info, &light_allocation_info, &_light_buffer, &_light_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    const auto work_groups_x = (size().x + (size().x % 16)) / 16;
-    const auto work_groups_y = (size().y + (size().y % 16)) / 16;
-    const auto number_of_tiles = work_groups_x * work_groups_y;
-
-    VkBufferCreateInfo visible_light_indices_buffer_info;
-    visible_light_indices_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    visible_light_indices_buffer_info.pNext = nullptr;
-    visible_light_indices_buffer_info.flags = 0;
-    visible_light_indices_buffer_info.size = number_of_tiles * sizeof(visible_index) * graphics_limits::max_lights;
-    visible_light_indices_buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    visible_light_indices_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    visible_light_indices_buffer_info.queueFamilyIndexCount = 0;
-    visible_light_indices_buffer_info.pQueueFamilyIndices = nullptr;
-
-    VmaAllocationCreateInfo visible_light_indices_allocation_info{};
-    visible_light_indices_allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    RB_VK(vmaCreateBuffer(_allocator, &visible_light_indices_buffer_info, &visible_light_indices_allocation_info, &_visible_light_indices_buffer, &_visible_light_indices_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
     VkBufferCreateInfo light_info_buffer_info;
     light_info_buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     light_info_buffer_info.pNext = nullptr;
     light_info_buffer_info.flags = 0;
     light_info_buffer_info.size = sizeof(cull_data);
-    light_info_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    light_info_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     light_info_buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     light_info_buffer_info.queueFamilyIndexCount = 0;
     light_info_buffer_info.pQueueFamilyIndices = nullptr;
 
-    VmaAllocationCreateInfo light_info_allocation_info{};
-    light_info_allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-    RB_VK(vmaCreateBuffer(_allocator, &light_info_buffer_info, &light_info_allocation_info, &_light_info_buffer, &_light_info_buffer_allocation, nullptr),
-        "Failed to create Vulkan buffer.");
-
-    VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
-    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptor_set_allocate_info.pNext = nullptr;
-    descriptor_set_allocate_info.descriptorPool = _descriptor_pool;
-    descriptor_set_allocate_info.descriptorSetCount = 1;
-    descriptor_set_allocate_info.pSetLayouts = &_light_descriptor_set_layout;
-    RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_light_descriptor_set),
-        "Failed to allocatore desctiptor set");
-
-    VkDescriptorBufferInfo buffer_infos[3]{
-        { _light_buffer, 0, light_buffer_info.size },
-        { _visible_light_indices_buffer, 0, visible_light_indices_buffer_info.size },
-        { _light_info_buffer, 0, light_info_buffer_info.size },
-    };
-
-    VkWriteDescriptorSet write_infos[3] {
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_set, 0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[0], nullptr },
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_set, 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[1], nullptr },
-        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_set, 2, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, nullptr, &buffer_infos[2], nullptr },
-    };
+    VmaAllocationCreateInfo light_allocation_info{};
+    light_allocation_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
 
-    vkUpdateDescriptorSets(_device, 3, write_infos, 0, nullptr);
+    // Lights are written by CPU every frame, so every frame in flight owns its light buffers.
+    for (auto i = 0u; i < graphics_limits::max_frames_in_flight; ++i) {
+        RB_VK(vmaCreateBuffer(_allocator, &light_buffer_info, &light_allocation_info, &_light_buffers[i], &_light_buffer_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        void* mapped_data;
+        RB_VK(vmaMapMemory(_allocator, _light_buffer_allocations[i], &mapped_data), "Failed to map light buffer");
+        _light_data[i] = static_cast<light_data*>(mapped_data);
+
+        RB_VK(vmaCreateBuffer(_allocator, &light_info_buffer_info, &light_allocation_info, &_light_info_buffers[i], &_light_info_buffer_allocations[i], nullptr),
+            "Failed to create Vulkan buffer.");
+
+        RB_VK(vmaMapMemory(_allocator, _light_info_buffer_allocations[i], &mapped_data), "Failed to map light info buffer");
+        _cull_data[i] = static_cast<cull_data*>(mapped_data);
+        _cull_data[i]->light_count = 0;
+        _cull_data[i]->max_light_indices = max_light_indices;
+        _cull_data[i]->tile_size = tile_size;
+        _cull_data[i]->cluster_count_x = _light_cluster_count.x;
+        _cull_data[i]->cluster_count_y = _light_cluster_count.y;
+        _cull_data[i]->cluster_count_z = _light_cluster_count.z;
+        _cull_data[i]->viewport_width = static_cast<float>(size().x);
+        _cull_data[i]->viewport_height = static_cast<float>(size().y);
+
+        VkDescriptorSetAllocateInfo descriptor_set_allocate_info;
+        descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptor_set_allocate_info.pNext = nullptr;
+        descriptor_set_allocate_info.descriptorPool = _descriptor_pool;
+        descriptor_set_allocate_info.descriptorSetCount = 1;
+        descriptor_set_allocate_info.pSetLayouts = &_light_descriptor_set_layout;
+        RB_VK(vkAllocateDescriptorSets(_device, &descriptor_set_allocate_info, &_light_descriptor_sets[i]),
+            "Failed to allocatore desctiptor set");
+
+        VkDescriptorBufferInfo buffer_infos[4]{
+            { _light_buffers[i], 0, light_buffer_info.size },
+            { _light_index_buffer, 0, light_index_buffer_info.size },
+            { _light_info_buffers[i], 0, light_info_buffer_info.size },
+            { _light_cluster_buffer, 0, light_cluster_buffer_info.size },
+        };
+
+        VkWriteDescriptorSet write_infos[4] {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_sets[i], 0, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[0], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_sets[i], 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[1], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_sets[i], 2, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, nullptr, &buffer_infos[2], nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, _light_descriptor_sets[i], 3, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &buffer_infos[3], nullptr },
+        };
+
+        vkUpdateDescriptorSets(_device, 4, write_infos, 0, nullptr);
+    }
 }
 
 void viewport_vulkan::_create_forward(const viewport_desc& desc) {
@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <rabbit/graphics/viewport.hpp>
+#include <rabbit/graphics/graphics.hpp>
 #include <rabbit/math/vec3.hpp>
 #include <rabbit/math/vec4.hpp>
 
@@ -20,13 +21,24 @@ namespace rb {
             vec4f color_and_radius;
         };
 
-        struct visible_index {
-            int index;
+        struct light_cluster {
+            unsigned int offset;
+            unsigned int count;
         };
 
         struct cull_data {
             unsigned int light_count;
-            unsigned int number_of_tiles_x;
+            unsigned int max_light_indices;
+            unsigned int tile_size;
+            unsigned int cluster_count_x;
+            unsigned int cluster_count_y;
+            unsigned int cluster_count_z;
+            float viewport_width;
+            float viewport_height;
+            float z_near;
+            float z_far;
+            float slice_scale;
+            float slice_bias;
         };
 
     public:
@@ -50,13 +62,13 @@ namespace rb {
 
         void end_depth_pass(VkCommandBuffer command_buffer);
 
-        void begin_light_pass(VkCommandBuffer command_buffer);
+        void begin_light_pass(VkCommandBuffer command_buffer, std::size_t frame_index);
 
         void add_point_light(const vec3f& position, float radius, const vec3f& color);
 
         void add_directional_light(const vec3f& direction, const vec3f& color, bool shadow_enabled);
 
-        void end_light_pass(VkCommandBuffer command_buffer);
+        void end_light_pass(VkCommandBuffer command_buffer, float z_near, float z_far);
 
         void begin_forward_pass(VkCommandBuffer command_buffer);
 
@@ -72,7 +84,11 @@ namespace rb {
 
         VkBuffer light_buffer() const;
 
-        VkBuffer visible_light_indices_buffer() const;
+        VkBuffer light_index_buffer() const;
+
+        VkBuffer light_cluster_buffer() const;
+
+        std::uint32_t light_cluster_count() const;
 
         VkDescriptorSet forward_descriptor_set() const;
 
@@ -120,15 +136,20 @@ namespace rb {
 		VkFramebuffer _depth_framebuffer;
         VkDescriptorSet _depth_descriptor_set;
 
-        VkDescriptorSet _light_descriptor_set;
-        VkBuffer _light_buffer;
-        VmaAllocation _light_buffer_allocation;
-        VkBuffer _visible_light_indices_buffer;
-        VmaAllocation _visible_light_indices_buffer_allocation;
-        VkBuffer _light_info_buffer;
-        VmaAllocation _light_info_buffer_allocation;
-
-        light_data* _light_data;
+        VkDescriptorSet _light_descriptor_sets[graphics_limits::max_frames_in_flight];
+        VkBuffer _light_buffers[graphics_limits::max_frames_in_flight];
+        VmaAllocation _light_buffer_allocations[graphics_limits::max_frames_in_flight];
+        VkBuffer _light_index_buffer;
+        VmaAllocation _light_index_buffer_allocation;
+        VkBuffer _light_cluster_buffer;
+        VmaAllocation _light_cluster_buffer_allocation;
+        vec3u _light_cluster_count;
+        VkBuffer _light_info_buffers[graphics_limits::max_frames_in_flight];
+        VmaAllocation _light_info_buffer_allocations[graphics_limits::max_frames_in_flight];
+
+        light_data* _light_data[graphics_limits::max_frames_in_flight];
+        cull_data* _cull_data[graphics_limits::max_frames_in_flight];
+        std::size_t _frame_index{ 0 };
         std::atomic<std::size_t> _light_index{ 0 };
 
         bool _has_shadows{ false };
@@ -43,6 +43,8 @@ static void retrieve_entries(const std::filesystem::directory_iterator& di, std:
 }
 
 void editor::scan() {
+	RB_PROFILE_ZONE("editor::scan");
+
 	if (!std::filesystem::is_directory("data")) {
 		return;
 	}
@@ -120,6 +122,8 @@ void editor::scan() {
 }
 
 uuid editor::import(const std::string& filename) {
+	RB_PROFILE_ZONE("editor::import");
+
 	const auto package_directory = std::filesystem::current_path() / "package";
 	const auto cache_directory = std::filesystem::current_path() / "cache";
 
@@ -3,9 +3,15 @@
 #include <rabbit/graphics/graphics.hpp>
 #include <rabbit/core/compression.hpp>
 #include <rabbit/graphics/image.hpp>
+#include <rabbit/core/profiler.hpp>
+#include <rabbit/math/vec3.hpp>
+#include <rabbit/math/math.hpp>
 
 #include <array>
+#include <cmath>
+#include <future>
 #include <fstream>
+#include <algorithm>
 
 using namespace rb;
 
@@ -18,6 +24,341 @@ static std::array<const char*, 6> faces = {
     "back"
 };
 
+namespace {
+    // Linear cube map level, faces in layer order: +X, -X, +Y, -Y, +Z, -Z.
+    struct cube_level {
+        std::size_t size;
+        std::vector<vec3f> texels;
+    };
+
+    using sh9 = std::array<vec3f, 9>;
+
+    struct prefilter_sample {
+        vec3f direction; // in tangent space of reflected vector
+        float weight;
+        float lod;
+    };
+
+    // Face coordinates in [-1, 1], with y pointing up the face as sampled by Vulkan.
+    vec3f face_direction(std::size_t face, float x, float y) {
+        switch (face) {
+            case 0: return normalize(vec3f{ 1.0f, y, -x });
+            case 1: return normalize(vec3f{ -1.0f, y, x });
+            case 2: return normalize(vec3f{ x, 1.0f, -y });
+            case 3: return normalize(vec3f{ x, -1.0f, y });
+            case 4: return normalize(vec3f{ x, y, 1.0f });
+            default: return normalize(vec3f{ -x, y, -1.0f });
+        }
+    }
+
+    vec3f texel_direction(std::size_t face, std::size_t x, std::size_t y, std::size_t size) {
+        const auto u = 2.0f * (x + 0.5f) / size - 1.0f;
+        const auto v = 1.0f - 2.0f * (y + 0.5f) / size;
+        return face_direction(face, u, v);
+    }
+
+    void direction_face(const vec3f& direction, std::size_t& face, float& x, float& y) {
+        const auto ax = std::abs(direction.x);
+        const auto ay = std::abs(direction.y);
+        const auto az = std::abs(direction.z);
+
+        if (ax >= ay && ax >= az) {
+            face = direction.x > 0.0f ? 0 : 1;
+            x = (direction.x > 0.0f ? -direction.z : direction.z) / ax;
+            y = direction.y / ax;
+        } else if (ay >= az) {
+            face = direction.y > 0.0f ? 2 : 3;
+            x = direction.x / ay;
+            y = (direction.y > 0.0f ? -direction.z : direction.z) / ay;
+        } else {
+            face = direction.z > 0.0f ? 4 : 5;
+            x = (direction.z > 0.0f ? direction.x : -direction.x) / az;
+            y = direction.y / az;
+        }
+    }
+
+    // Bilinear sample, clamped to edges of face.
+    vec3f sample_level(const cube_level& level, const vec3f& direction) {
+        std::size_t face;
+        float x, y;
+        direction_face(direction, face, x, y);
+
+        const auto size = static_cast<float>(level.size);
+        const auto fx = std::clamp((x + 1.0f) * 0.5f * size - 0.5f, 0.0f, size - 1.0f);
+        const auto fy = std::clamp((1.0f - y) * 0.5f * size - 0.5f, 0.0f, size - 1.0f);
+
+        const auto x0 = static_cast<std::size_t>(fx);
+        const auto y0 = static_cast<std::size_t>(fy);
+        const auto x1 = std::min(x0 + 1, level.size - 1);
+        const auto y1 = std::min(y0 + 1, level.size - 1);
+        const auto tx = fx - x0;
+        const auto ty = fy - y0;
+
+        const auto texels = level.texels.data() + face * level.size * level.size;
+        const auto top = texels[y0 * level.size + x0] * (1.0f - tx) + texels[y0 * level.size + x1] * tx;
+        const auto bottom = texels[y1 * level.size + x0] * (1.0f - tx) + texels[y1 * level.size + x1] * tx;
+        return top * (1.0f - ty) + bottom * ty;
+    }
+
+    vec3f sample_levels(const std::vector<cube_level>& levels, const vec3f& direction, float lod) {
+        lod = std::clamp(lod, 0.0f, static_cast<float>(levels.size() - 1));
+
+        const auto lod0 = static_cast<std::size_t>(lod);
+        const auto lod1 = std::min(lod0 + 1, levels.size() - 1);
+        const auto t = lod - lod0;
+
+        const auto color0 = sample_level(levels[lod0], direction);
+        return t > 0.0f ? color0 * (1.0f - t) + sample_level(levels[lod1], direction) * t : color0;
+    }
+
+    float area_element(float x, float y) {
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+    }
+
+    float texel_solid_angle(std::size_t x, std::size_t y, std::size_t size) {
+        const auto x0 = 2.0f * x / size - 1.0f;
+        const auto y0 = 2.0f * y / size - 1.0f;
+        const auto x1 = 2.0f * (x + 1) / size - 1.0f;
+        const auto y1 = 2.0f * (y + 1) / size - 1.0f;
+        return area_element(x0, y0) - area_element(x0, y1) - area_element(x1, y0) + area_element(x1, y1);
+    }
+
+    std::array<float, 9> sh_basis(const vec3f& n) {
+        return {
+            0.282095f,
+            0.488603f * n.y,
+            0.488603f * n.z,
+            0.488603f * n.x,
+            1.092548f * n.x * n.y,
+            1.092548f * n.y * n.z,
+            0.315392f * (3.0f * n.z * n.z - 1.0f),
+            1.092548f * n.x * n.z,
+            0.546274f * (n.x * n.x - n.y * n.y)
+        };
+    }
+
+    std::vector<cube_level> make_levels(const std::vector<color>& pixels, std::size_t size) {
+        std::vector<cube_level> levels;
+
+        auto& base = levels.emplace_back();
+        base.size = size;
+        base.texels.resize(pixels.size());
+        for (std::size_t index{ 0 }; index < pixels.size(); ++index) {
+            base.texels[index] = vec3f{ pixels[index].r / 255.0f, pixels[index].g / 255.0f, pixels[index].b / 255.0f };
+        }
+
+        // Box filtered chain down to single texel, used by filtered importance sampling.
+        while (levels.back().size > 1) {
+            const auto& source = levels.back();
+
+            cube_level level;
+            level.size = source.size / 2;
+            level.texels.resize(level.size * level.size * 6);
+
+            for (std::size_t face{ 0 }; face < 6; ++face) {
+                const auto src = source.texels.data() + face * source.size * source.size;
+                const auto dst = level.texels.data() + face * level.size * level.size;
+
+                for (std::size_t y{ 0 }; y < level.size; ++y) {
+                    for (std::size_t x{ 0 }; x < level.size; ++x) {
+                        const auto texel = src + (y * 2) * source.size + x * 2;
+                        dst[y * level.size + x] = (texel[0] + texel[1] + texel[source.size] + texel[source.size + 1]) * 0.25f;
+                    }
+                }
+            }
+
+            levels.push_back(std::move(level));
+        }
+
+        return levels;
+    }
+
+    // Radiance projected onto spherical harmonics and convolved with clamped cosine lobe.
+    // Coefficients are divided by PI, so evaluated value matches lambertian irradiance used by shaders.
+    sh9 bake_irradiance(const cube_level& level) {
+        std::array<std::future<sh9>, 6> jobs;
+        for (std::size_t face{ 0 }; face < 6; ++face) {
+            jobs[face] = std::async(std::launch::async, [&level, face]() {
+                sh9 sh;
+                sh.fill(vec3f::zero());
+
+                const auto texels = level.texels.data() + face * level.size * level.size;
+                for (std::size_t y{ 0 }; y < level.size; ++y) {
+                    for (std::size_t x{ 0 }; x < level.size; ++x) {
+                        const auto weight = texel_solid_angle(x, y, level.size);
+                        const auto basis = sh_basis(texel_direction(face, x, y, level.size));
+                        const auto radiance = texels[y * level.size + x] * weight;
+
+                        for (std::size_t index{ 0 }; index < 9; ++index) {
+                            sh[index] = sh[index] + radiance * basis[index];
+                        }
+                    }
+                }
+
+                return sh;
+            });
+        }
+
+        sh9 sh;
+        sh.fill(vec3f::zero());
+
+        for (auto& job : jobs) {
+            const auto face_sh = job.get();
+            for (std::size_t index{ 0 }; index < 9; ++index) {
+                sh[index] = sh[index] + face_sh[index];
+            }
+        }
+
+        constexpr float bands[9]{ 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+        for (std::size_t index{ 0 }; index < 9; ++index) {
+            sh[index] = sh[index] * bands[index];
+        }
+
+        return sh;
+    }
+
+    color to_color(const vec3f& value) {
+        return {
+            static_cast<unsigned char>(std::clamp(value.x, 0.0f, 1.0f) * 255.0f + 0.5f),
+            static_cast<unsigned char>(std::clamp(value.y, 0.0f, 1.0f) * 255.0f + 0.5f),
+            static_cast<unsigned char>(std::clamp(value.z, 0.0f, 1.0f) * 255.0f + 0.5f),
+            255
+        };
+    }
+
+    std::vector<color> expand_irradiance(const sh9& sh) {
+        const auto size = graphics_limits::irradiance_map_size;
+
+        std::vector<color> pixels(size * size * 6);
+        for (std::size_t face{ 0 }; face < 6; ++face) {
+            for (std::size_t y{ 0 }; y < size; ++y) {
+                for (std::size_t x{ 0 }; x < size; ++x) {
+                    const auto basis = sh_basis(texel_direction(face, x, y, size));
+
+                    auto irradiance = vec3f::zero();
+                    for (std::size_t index{ 0 }; index < 9; ++index) {
+                        irradiance = irradiance + sh[index] * basis[index];
+                    }
+
+                    pixels[(face * size + y) * size + x] = to_color(irradiance);
+                }
+            }
+        }
+
+        return pixels;
+    }
+
+    float radical_inverse(std::uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return static_cast<float>(bits) * 2.3283064365386963e-10f;
+    }
+
+    // GGX importance samples with normal and view along reflected vector, so they do not depend on texel.
+    // Lod of every sample is taken from its pdf, to filter source instead of taking thousands of samples.
+    std::vector<prefilter_sample> make_prefilter_samples(float roughness, std::size_t source_size, std::uint32_t sample_count) {
+        const auto a = roughness * roughness;
+        const auto a2 = a * a;
+        const auto texel_solid_angle = 4.0f * pi<float>() / (6.0f * source_size * source_size);
+
+        std::vector<prefilter_sample> samples;
+        for (std::uint32_t index{ 0 }; index < sample_count; ++index) {
+            const auto phi = 2.0f * pi<float>() * index / sample_count;
+            const auto xi = radical_inverse(index);
+            const auto cos_theta = std::sqrt((1.0f - xi) / (1.0f + (a2 - 1.0f) * xi));
+            const auto sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+            const vec3f half{ std::cos(phi) * sin_theta, std::sin(phi) * sin_theta, cos_theta };
+            const vec3f light{ 2.0f * cos_theta * half.x, 2.0f * cos_theta * half.y, 2.0f * cos_theta * cos_theta - 1.0f };
+            if (light.z <= 0.0f) {
+                continue;
+            }
+
+            const auto d = (cos_theta * cos_theta) * (a2 - 1.0f) + 1.0f;
+            const auto pdf = a2 / (pi<float>() * d * d) * 0.25f;
+            const auto sample_solid_angle = 1.0f / (sample_count * pdf + 0.0001f);
+
+            samples.push_back({ light, light.z, 0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f });
+        }
+
+        return samples;
+    }
+
+    void bake_prefilter_face(const std::vector<cube_level>& levels, const std::vector<prefilter_sample>& samples,
+        std::size_t face, std::size_t size, float base_lod, color* pixels) {
+        for (std::size_t y{ 0 }; y < size; ++y) {
+            for (std::size_t x{ 0 }; x < size; ++x) {
+                const auto normal = texel_direction(face, x, y, size);
+
+                if (samples.empty()) {
+                    pixels[y * size + x] = to_color(sample_levels(levels, normal, base_lod));
+                    continue;
+                }
+
+                const auto up = std::abs(normal.z) < 0.999f ? vec3f::z_axis() : vec3f::x_axis();
+                const auto tangent_x = normalize(cross(up, normal));
+                const auto tangent_y = cross(normal, tangent_x);
+
+                auto color = vec3f::zero();
+                auto total_weight = 0.0f;
+
+                for (const auto& sample : samples) {
+                    const auto direction = tangent_x * sample.direction.x + tangent_y * sample.direction.y + normal * sample.direction.z;
+                    color = color + sample_levels(levels, direction, std::max(sample.lod, base_lod)) * sample.weight;
+                    total_weight += sample.weight;
+                }
+
+                pixels[y * size + x] = to_color(color / total_weight);
+            }
+        }
+    }
+
+    // Specular prefiltered chain, mip levels one after another, faces inside levels.
+    std::vector<color> bake_prefilter(const std::vector<cube_level>& levels) {
+        constexpr std::uint32_t sample_count{ 256 };
+
+        std::size_t pixel_count{ 0 };
+        for (std::size_t mip{ 0 }; mip < graphics_limits::prefilter_map_levels; ++mip) {
+            const auto size = graphics_limits::prefilter_map_size >> mip;
+            pixel_count += size * size * 6;
+        }
+
+        std::vector<color> pixels(pixel_count);
+
+        std::vector<std::vector<prefilter_sample>> samples(graphics_limits::prefilter_map_levels);
+        std::vector<std::future<void>> jobs;
+
+        auto offset = pixels.data();
+        for (std::size_t mip{ 0 }; mip < graphics_limits::prefilter_map_levels; ++mip) {
+            const auto size = graphics_limits::prefilter_map_size >> mip;
+            const auto roughness = static_cast<float>(mip) / (graphics_limits::prefilter_map_levels - 1);
+
+            // Mirror-like level is just resampled from source level of matching resolution.
+            const auto base_lod = std::max(0.0f, std::log2(static_cast<float>(levels[0].size) / size));
+            if (mip > 0) {
+                samples[mip] = make_prefilter_samples(roughness, levels[0].size, sample_count);
+            }
+
+            for (std::size_t face{ 0 }; face < 6; ++face) {
+                jobs.push_back(std::async(std::launch::async, [&levels, &samples, mip, face, size, base_lod, offset]() {
+                    bake_prefilter_face(levels, samples[mip], face, size, base_lod, offset + face * size * size);
+                }));
+            }
+
+            offset += size * size * 6;
+        }
+
+        for (auto& job : jobs) {
+            job.get();
+        }
+
+        return pixels;
+    }
+}
+
 std::shared_ptr<environment> environment::load(ibstream& stream) {
     environment_desc desc;
     stream.read(desc.size);
@@ -31,11 +372,33 @@ std::shared_ptr<environment> environment::load(ibstream& stream) {
     const auto uncompressed_pixels = std::make_unique<std::uint8_t[]>(desc.size.x * desc.size.y * 4 * 6);
     compression::uncompress(compressed_pixels.get(), compressed_size, uncompressed_pixels.get(), desc.size.x * desc.size.y * 4 * 6);
 
+    sh9 irradiance;
+    stream.read(irradiance);
+
+    // Expanding 9 coefficients is cheaper than storing or convolving irradiance map.
+    const auto irradiance_pixels = expand_irradiance(irradiance);
+
+    std::uint32_t prefilter_size;
+    stream.read(prefilter_size);
+
+    std::uint32_t prefilter_compressed_size;
+    stream.read(prefilter_compressed_size);
+
+    const auto prefilter_compressed_pixels = std::make_unique<std::uint8_t[]>(prefilter_compressed_size);
+    stream.read(prefilter_compressed_pixels.get(), prefilter_compressed_size);
+
+    const auto prefilter_pixels = std::make_unique<std::uint8_t[]>(prefilter_size);
+    compression::uncompress(prefilter_compressed_pixels.get(), prefilter_compressed_size, prefilter_pixels.get(), prefilter_size);
+
     desc.data = uncompressed_pixels.get();
+    desc.irradiance_data = irradiance_pixels.data();
+    desc.prefilter_data = prefilter_pixels.get();
     return graphics::make_environment(desc);
 }
 
 void environment::import(ibstream& input, obstream& output, const json& metadata) {
+    RB_PROFILE_ZONE("environment::import");
+
     json json;
     input.read(json);
 
@@ -53,17 +416,29 @@ void environment::import(ibstream& input, obstream& output, const json& metadata
         size = images[index].size();
     }
 
+    RB_ASSERT(size.x == size.y && is_power_of_two(size.x), "Environment faces should be square and power of two. Current size: {}, {}.", size.x, size.y);
+
     std::vector<color> buffer(size.x * size.y * 6);
     for (auto& [index, images] : images) {
         std::memcpy(buffer.data() + index * size.x * size.y, images.pixels().data(), size.x * size.y * sizeof(color));
     }
 
     const auto compressed_pixels = compression::compress<color>(buffer);
-    
+
+    // Bake image based lighting offline, so loading environment is just an upload.
+    const auto levels = make_levels(buffer, size.x);
+    const auto irradiance = bake_irradiance(levels[0]);
+    const auto prefilter_pixels = bake_prefilter(levels);
+    const auto prefilter_compressed_pixels = compression::compress<color>(prefilter_pixels);
+
     output.write(environment::magic_number);
     output.write(size);
     output.write<std::uint32_t>(compressed_pixels.size());
     output.write<std::uint8_t>(compressed_pixels);
+    output.write(irradiance);
+    output.write<std::uint32_t>(prefilter_pixels.size() * sizeof(color));
+    output.write<std::uint32_t>(prefilter_compressed_pixels.size());
+    output.write<std::uint8_t>(prefilter_compressed_pixels);
 }
 
 const vec2u& environment::size() const {
@@ -1,4 +1,5 @@
 #include <rabbit/graphics/glsl.hpp>
+#include <rabbit/core/settings.hpp>
 #include <rabbit/core/config.hpp>
 
 #include <SPIRV/GlslangToSpv.h>
@@ -7,6 +8,9 @@
 #include <glslang/Public/ShaderLang.h>
 
 #include <map>
+#include <random>
+#include <fstream>
+#include <filesystem>
 
 using namespace rb;
 
@@ -23,7 +27,100 @@ std::vector<std::uint32_t> glsl::compile(shader_stage stage, const std::string&
     return compile(stage, code, {});
 }
 
+// Bump when anything affecting produced SPIR-V changes (environment, options, resource limits).
+static constexpr std::uint32_t cache_format_version{ 1 };
+
+static std::uint64_t fnv1a64(std::uint64_t hash, const void* data, std::size_t size) {
+    const auto bytes = static_cast<const std::uint8_t*>(data);
+    for (std::size_t index{ 0 }; index < size; ++index) {
+        hash = (hash ^ bytes[index]) * 1099511628211llu;
+    }
+    return hash;
+}
+
+static std::filesystem::path cache_path(shader_stage stage, const std::string& code, const std::string& preamble) {
+    const std::uint32_t versions[]{
+        cache_format_version,
+        static_cast<std::uint32_t>(stage),
+        static_cast<std::uint32_t>(glslang::GetKhronosToolId()),
+        static_cast<std::uint32_t>(glslang::GetSpirvGeneratorVersion())
+    };
+
+    // Preamble is hashed with its size, so it never merges with beginning of source.
+    const auto preamble_size = static_cast<std::uint64_t>(preamble.size());
+
+    auto hash = 14695981039346656037llu;
+    hash = fnv1a64(hash, versions, sizeof(versions));
+    hash = fnv1a64(hash, &preamble_size, sizeof(preamble_size));
+    hash = fnv1a64(hash, preamble.data(), preamble.size());
+    hash = fnv1a64(hash, code.data(), code.size());
+
+    return std::filesystem::path{ settings::cache_directory } / "shaders" / format("{:016x}.spv", hash);
+}
+
+static bool load_cached(const std::filesystem::path& path, std::vector<std::uint32_t>& spirv) {
+    std::ifstream stream{ path, std::ios::binary | std::ios::ate };
+    if (!stream) {
+        return false;
+    }
+
+    const auto size = static_cast<std::size_t>(stream.tellg());
+    if (size < sizeof(std::uint32_t) || size % sizeof(std::uint32_t) != 0) {
+        return false;
+    }
+
+    spirv.resize(size / sizeof(std::uint32_t));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(spirv.data()), size);
+
+    // Reject partially written or foreign files.
+    return stream && spirv[0] == 0x07230203u;
+}
+
+static void store_cached(const std::filesystem::path& path, const std::vector<std::uint32_t>& spirv) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    // Other processes may compile the same shader at once, so every writer uses own temporary file
+    // and publishes it with atomic rename.
+    const auto temporary_path = std::filesystem::path{ path }.concat(format(".{:08x}.tmp", std::random_device{}()));
+    {
+        std::ofstream stream{ temporary_path, std::ios::binary | std::ios::trunc };
+        stream.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(std::uint32_t));
+        if (!stream) {
+            stream.close();
+            std::filesystem::remove(temporary_path, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        std::filesystem::remove(temporary_path, error);
+    }
+}
+
 std::vector<std::uint32_t> glsl::compile(shader_stage stage, const std::string& code, const span<const std::string> definitions) {
+    std::string preamble;
+    for (const auto& definition : definitions) {
+        preamble += format("#define {}\n", definition);
+    }
+
+    const auto path = cache_path(stage, code, preamble);
+
+    std::vector<std::uint32_t> spirv;
+    if (load_cached(path, spirv)) {
+        return spirv;
+    }
+
+    spirv = _compile(stage, code, preamble);
+    if (!spirv.empty()) {
+        store_cached(path, spirv);
+    }
+    return spirv;
+}
+
+std::vector<std::uint32_t> glsl::_compile(shader_stage stage, const std::string& code, const std::string& preamble) {
     static const auto initialized = glslang::InitializeProcess();
     RB_ASSERT(initialized, "GLSLang is not initialized.");
 
@@ -39,10 +136,6 @@ std::vector<std::uint32_t> glsl::compile(shader_stage stage, const std::string&
 
     const auto messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
 
-    std::string preamble;
-    for (const auto& definition : definitions) {
-        preamble += format("#define {}\n", definition);
-    }
     shader.setPreamble(preamble.c_str());
 
     std::string pre_processed_code;
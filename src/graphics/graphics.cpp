@@ -1,5 +1,11 @@
 #include <rabbit/graphics/graphics.hpp>
 #include <rabbit/core/settings.hpp>
+#include <rabbit/core/format.hpp>
+#include <rabbit/core/config.hpp>
+
+#include <fstream>
+
+#include "../drivers/null/graphics_null.hpp"
 
 #if RB_VULKAN
 #	include "../drivers/vulkan/graphics_vulkan.hpp"
@@ -10,6 +16,11 @@ using namespace rb;
 std::shared_ptr<graphics_impl> graphics::_impl;
 
 void graphics::init() {
+	if (settings::graphics_backend == graphics_backend::null) {
+		_impl = std::make_shared<graphics_null>();
+		return;
+	}
+
 #if RB_VULKAN
 	if (settings::graphics_backend == graphics_backend::vulkan) {
 		_impl = std::make_shared<graphics_vulkan>();
@@ -52,9 +63,9 @@ void graphics::begin_depth_pass(const std::shared_ptr<viewport>& viewport) {
 	_impl->begin_depth_pass(viewport);
 }
 
-void graphics::draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, std::size_t mesh_lod_index) {
+void graphics::draw_depth(const std::shared_ptr<viewport>& viewport, const mat4f& world, const std::shared_ptr<mesh>& mesh, const std::shared_ptr<material>& material, std::size_t mesh_lod_index) {
 	if (mesh) {
-		_impl->draw_depth(viewport, world, mesh, mesh_lod_index);
+		_impl->draw_depth(viewport, world, mesh, material, mesh_lod_index);
 	}
 }
 
@@ -195,3 +206,25 @@ void graphics::swap_buffers() {
 void graphics::flush() {
 	_impl->flush();
 }
+
+float graphics::frame_latency() {
+	return _impl->frame_latency();
+}
+
+std::vector<gpu_pass_timing> graphics::gpu_timings() {
+	return _impl->gpu_timings();
+}
+
+void graphics::export_gpu_timings(const std::string& path) {
+	std::ofstream stream{ path, std::ios::trunc };
+	RB_ASSERT(stream.is_open(), "Failed to open GPU timings file");
+
+	stream << "pass,min_ms,avg_ms,max_ms\n";
+	for (const auto& timing : _impl->gpu_timings()) {
+		stream << format("{},{:.4f},{:.4f},{:.4f}\n", timing.name, timing.min, timing.avg, timing.max);
+	}
+}
+
+std::vector<graphics_pass_calls> graphics::pass_calls() {
+	return _impl->pass_calls();
+}
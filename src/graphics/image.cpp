@@ -9,6 +9,9 @@
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include <stb_image_resize.h>
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
 using namespace rb;
 
 image image::load_from_file(const std::string& filename) {
@@ -63,6 +66,10 @@ image image::resize(const image& image, const vec2u& new_size) {
     return { pixels.get(), new_size };
 }
 
+image image::from_pixels(const color* pixels, const vec2u& size) {
+    return { pixels, size };
+}
+
 image::operator bool() const {
     return !_pixels.empty();
 }
@@ -83,6 +90,10 @@ bool image::is_power_of_two() const {
     return rb::is_power_of_two(_size.x) && rb::is_power_of_two(_size.y);
 }
 
+bool image::save_to_file(const std::string& filename) const {
+    return stbi_write_png(filename.c_str(), static_cast<int>(_size.x), static_cast<int>(_size.y), 4, _pixels.data(), static_cast<int>(stride())) != 0;
+}
+
 image::image(const color* pixels, const vec2u& size)
     : _pixels(pixels, pixels + size.x * size.y)
     , _size(size) {
@@ -3,6 +3,7 @@
 #include <rabbit/core/assets.hpp>
 #include <rabbit/core/config.hpp>
 #include <rabbit/core/uuid.hpp>
+#include <rabbit/core/profiler.hpp>
 
 #include <array>
 #include <fstream>
@@ -57,6 +58,7 @@ std::shared_ptr<material> material::load(ibstream& stream) {
     stream.read(desc.roughness);
     stream.read(desc.metallic);
     stream.read(desc.occlusion_strength);
+    stream.read(desc.uv_transform);
     stream.read(desc.translucent);
     stream.read(desc.double_sided);
 
@@ -94,6 +96,8 @@ std::shared_ptr<material> material::load(ibstream& stream) {
 }
 
 void material::import(ibstream& input, obstream& output, const json& metadata) {
+    RB_PROFILE_ZONE("material::import");
+
     json json;
     input.read(json);
 
@@ -101,6 +105,7 @@ void material::import(ibstream& input, obstream& output, const json& metadata) {
     float roughness{ 0.8f };
     float metallic{ 0.0f };
     float occlusion_strength{ 1.0f };
+    vec4f uv_transform{ 1.0f, 1.0f, 0.0f, 0.0f };
     bool translucent{ false };
     bool double_sided{ false };
 
@@ -125,6 +130,11 @@ void material::import(ibstream& input, obstream& output, const json& metadata) {
         occlusion_strength = json["occlusion_strength"];
     }
 
+    if (json.contains("uv_transform")) {
+        auto& transform = json["uv_transform"];
+        uv_transform = { transform[0], transform[1], transform[2], transform[3] };
+    }
+
     if (json.contains("translucent")) {
         translucent = json["translucent"];
     }
@@ -138,6 +148,7 @@ void material::import(ibstream& input, obstream& output, const json& metadata) {
     output.write(roughness);
     output.write(metallic);
     output.write(occlusion_strength);
+    output.write(uv_transform);
     output.write(translucent);
     output.write(double_sided);
     
@@ -190,6 +201,10 @@ float material::metallic() const {
     return _metallic;
 }
 
+const vec4f& material::uv_transform() const {
+    return _uv_transform;
+}
+
 bool material::translucent() const {
     return _translucent;
 }
@@ -234,6 +249,7 @@ material::material(const material_desc& desc)
     : _base_color(desc.base_color)
     , _roughness(desc.roughness)
     , _metallic(desc.metallic)
+    , _uv_transform(desc.uv_transform)
     , _translucent(desc.translucent)
     , _double_sided(desc.double_sided)
     , _wireframe(desc.wireframe)
@@ -3,6 +3,8 @@
 #include <rabbit/graphics/graphics.hpp>
 #include <rabbit/core/bstream.hpp>
 #include <rabbit/math/math.hpp>
+#include <rabbit/core/profiler.hpp>
+#include <rabbit/core/compression.hpp>
 
 #include <meshoptimizer.h>
 #include <QuickHull.hpp>
@@ -10,6 +12,7 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <array>
 
 using namespace rb;
 
@@ -35,14 +38,14 @@ static bspheref calculate_bsphere(const span<const vertex>& vertices) {
 
 static bboxf calculate_bbox(const span<const vertex>& vertices) {
     constexpr auto fmax = std::numeric_limits<float>::max();
-    constexpr auto fmin = std::numeric_limits<float>::min();
+    constexpr auto fmin = std::numeric_limits<float>::lowest();
 
     bboxf bbox{ vec3f{ fmax, fmax, fmax }, vec3f{ fmin, fmin, fmin } };
 
     for (const auto& vertex : vertices) {
         bbox.min.x = std::min(bbox.min.x, vertex.position.x);
         bbox.min.y = std::min(bbox.min.y, vertex.position.y);
-        bbox.min.y = std::min(bbox.min.z, vertex.position.z);
+        bbox.min.z = std::min(bbox.min.z, vertex.position.z);
 
         bbox.max.x = std::max(bbox.max.x, vertex.position.x);
         bbox.max.y = std::max(bbox.max.y, vertex.position.y);
@@ -52,22 +55,200 @@ static bboxf calculate_bbox(const span<const vertex>& vertices) {
     return bbox;
 }
 
+static vertex_quantization calculate_quantization(const bboxf& bbox) {
+    return { bbox.min, bbox.max - bbox.min };
+}
+
+static std::array<std::int16_t, 2> encode_octahedral(const vec3f& normal) {
+    // Project onto octahedron, then fold lower hemisphere over diagonals.
+    const auto sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    auto x = sum > 0.0f ? normal.x / sum : 0.0f;
+    auto y = sum > 0.0f ? normal.y / sum : 0.0f;
+    if (normal.z < 0.0f) {
+        const auto folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const auto folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    return {
+        static_cast<std::int16_t>(meshopt_quantizeSnorm(x, 16)),
+        static_cast<std::int16_t>(meshopt_quantizeSnorm(y, 16))
+    };
+}
+
+static std::vector<packed_vertex> pack_vertices(const span<const vertex>& vertices, const vertex_quantization& quantization) {
+    const auto inverse_scale = [](float scale) {
+        return scale > 0.0f ? 1.0f / scale : 0.0f;
+    };
+
+    const vec3f inverse{ inverse_scale(quantization.scale.x), inverse_scale(quantization.scale.y), inverse_scale(quantization.scale.z) };
+
+    std::vector<packed_vertex> packed_vertices(vertices.size());
+    for (std::size_t i{ 0 }; i < vertices.size(); ++i) {
+        const auto& vertex = vertices[i];
+        const auto normal = encode_octahedral(vertex.normal);
+
+        auto& packed_vertex = packed_vertices[i];
+        packed_vertex.position[0] = static_cast<std::uint16_t>(meshopt_quantizeUnorm((vertex.position.x - quantization.offset.x) * inverse.x, 16));
+        packed_vertex.position[1] = static_cast<std::uint16_t>(meshopt_quantizeUnorm((vertex.position.y - quantization.offset.y) * inverse.y, 16));
+        packed_vertex.position[2] = static_cast<std::uint16_t>(meshopt_quantizeUnorm((vertex.position.z - quantization.offset.z) * inverse.z, 16));
+        packed_vertex.position[3] = 0;
+        packed_vertex.texcoord[0] = meshopt_quantizeHalf(vertex.texcoord.x);
+        packed_vertex.texcoord[1] = meshopt_quantizeHalf(vertex.texcoord.y);
+        packed_vertex.normal[0] = normal[0];
+        packed_vertex.normal[1] = normal[1];
+    }
+
+    return packed_vertices;
+}
+
+// Splits base indices into clusters and reorders them, so triangles of every cluster are contiguous.
+static std::vector<mesh_cluster> build_clusters(const std::vector<vertex>& vertices, std::vector<std::uint32_t>& indices) {
+    const auto max_meshlets = meshopt_buildMeshletsBound(indices.size(), mesh::max_cluster_vertices, mesh::max_cluster_triangles);
+    std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+    std::vector<unsigned int> meshlet_vertices(max_meshlets * mesh::max_cluster_vertices);
+    std::vector<unsigned char> meshlet_triangles(max_meshlets * mesh::max_cluster_triangles * 3);
+
+    // Cone weight favors clusters with narrow normal cones, so more of them are rejected as back-facing.
+    meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(),
+        indices.data(), indices.size(), &vertices[0].position.x, vertices.size(), sizeof(vertex),
+        mesh::max_cluster_vertices, mesh::max_cluster_triangles, 0.25f));
+
+    std::vector<mesh_cluster> clusters;
+    clusters.reserve(meshlets.size());
+
+    std::vector<std::uint32_t> cluster_indices;
+    cluster_indices.reserve(indices.size());
+
+    for (const auto& meshlet : meshlets) {
+        const auto bounds = meshopt_computeMeshletBounds(&meshlet_vertices[meshlet.vertex_offset], &meshlet_triangles[meshlet.triangle_offset],
+            meshlet.triangle_count, &vertices[0].position.x, vertices.size(), sizeof(vertex));
+
+        mesh_cluster cluster{};
+        cluster.center = { bounds.center[0], bounds.center[1], bounds.center[2] };
+        cluster.radius = bounds.radius;
+        cluster.cone_apex = { bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2] };
+        cluster.first_index = static_cast<std::uint32_t>(cluster_indices.size());
+        cluster.cone_axis = { bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2] };
+        cluster.cone_cutoff = bounds.cone_cutoff;
+        cluster.index_count = meshlet.triangle_count * 3;
+        clusters.push_back(cluster);
+
+        for (std::size_t i{ 0 }; i < meshlet.triangle_count * 3; ++i) {
+            cluster_indices.push_back(meshlet_vertices[meshlet.vertex_offset + meshlet_triangles[meshlet.triangle_offset + i]]);
+        }
+    }
+
+    indices = std::move(cluster_indices);
+    return clusters;
+}
+
+struct mesh_payload {
+    std::vector<std::uint8_t> data;
+    std::uint32_t encoded_size; // size before general compression
+    mesh_codec codec;
+};
+
+static mesh_payload compress_payload(std::vector<std::uint8_t> encoded_data, const void* raw_data, std::size_t raw_size) {
+    // Codec should never lose against raw data, but keep raw data just in case.
+    if (encoded_data.empty() || encoded_data.size() >= raw_size) {
+        const auto bytes = static_cast<const std::uint8_t*>(raw_data);
+        return { { bytes, bytes + raw_size }, static_cast<std::uint32_t>(raw_size), mesh_codec::none };
+    }
+
+    // Encoded streams are byte-oriented, so general compressor usually shrinks them further.
+    const auto encoded_size = static_cast<std::uint32_t>(encoded_data.size());
+    auto compressed_data = compression::compress(span<const std::uint8_t>{ encoded_data });
+    if (compressed_data.empty() || compressed_data.size() >= encoded_data.size()) {
+        return { std::move(encoded_data), encoded_size, mesh_codec::meshopt };
+    }
+
+    return { std::move(compressed_data), encoded_size, mesh_codec::meshopt_zlib };
+}
+
+static mesh_payload encode_vertices(const std::vector<packed_vertex>& vertices) {
+    std::vector<std::uint8_t> encoded_data(meshopt_encodeVertexBufferBound(vertices.size(), sizeof(packed_vertex)));
+    encoded_data.resize(meshopt_encodeVertexBuffer(encoded_data.data(), encoded_data.size(), vertices.data(), vertices.size(), sizeof(packed_vertex)));
+    return compress_payload(std::move(encoded_data), vertices.data(), vertices.size() * sizeof(packed_vertex));
+}
+
+static mesh_payload encode_indices(const std::vector<std::uint32_t>& indices, std::size_t vertex_count) {
+    // Lods are triangle lists, so whole index buffer is single triangle list as well.
+    std::vector<std::uint8_t> encoded_data(meshopt_encodeIndexBufferBound(indices.size(), vertex_count));
+    encoded_data.resize(meshopt_encodeIndexBuffer(encoded_data.data(), encoded_data.size(), indices.data(), indices.size()));
+    return compress_payload(std::move(encoded_data), indices.data(), indices.size() * sizeof(std::uint32_t));
+}
+
+static void write_payload(obstream& stream, const mesh_payload& payload) {
+    stream.write(payload.codec);
+    stream.write(payload.encoded_size);
+    stream.write<std::uint32_t>(payload.data.size());
+    stream.write(payload.data.data(), payload.data.size());
+}
+
+// Reads payload and decodes it into destination of given size.
+template<typename Decoder>
+static void read_payload(ibstream& stream, void* destination, std::size_t size, Decoder decoder) {
+    mesh_codec codec;
+    stream.read(codec);
+
+    std::uint32_t encoded_size;
+    stream.read(encoded_size);
+
+    std::uint32_t stored_size;
+    stream.read(stored_size);
+
+    if (codec == mesh_codec::none) {
+        RB_ASSERT(stored_size == size, "Mesh payload has incorrect size.");
+        stream.read(destination, size);
+        return;
+    }
+
+    std::vector<std::uint8_t> stored_data(stored_size);
+    stream.read(stored_data.data(), stored_size);
+
+    if (codec == mesh_codec::meshopt_zlib) {
+        std::vector<std::uint8_t> encoded_data(encoded_size);
+        [[maybe_unused]] const auto uncompressed_size = compression::uncompress(stored_data.data(), stored_data.size(),
+            encoded_data.data(), encoded_data.size());
+        RB_ASSERT(uncompressed_size == encoded_size, "Cannot uncompress mesh payload.");
+        stored_data = std::move(encoded_data);
+    }
+
+    [[maybe_unused]] const auto result = decoder(destination, stored_data.data(), stored_data.size());
+    RB_ASSERT(result == 0, "Cannot decode mesh payload.");
+}
+
 std::shared_ptr<mesh> mesh::load(ibstream& stream) {
+    // Payloads are decoded straight into arrays that back mesh description.
+    vertex_quantization quantization;
+    stream.read(quantization);
+
     std::uint32_t vertex_count;
     stream.read(vertex_count);
-    const auto vertices = std::make_unique<vertex[]>(vertex_count);
-    stream.read(vertices.get(), vertex_count * sizeof(vertex));
+    const auto vertices = std::make_unique<packed_vertex[]>(vertex_count);
+    read_payload(stream, vertices.get(), vertex_count * sizeof(packed_vertex), [vertex_count](void* destination, const std::uint8_t* data, std::size_t size) {
+        return meshopt_decodeVertexBuffer(destination, vertex_count, sizeof(packed_vertex), data, size);
+    });
 
     std::uint32_t total_index_count;
     stream.read(total_index_count);
     const auto indices = std::make_unique<std::uint32_t[]>(total_index_count);
-    stream.read(indices.get(), total_index_count * sizeof(std::uint32_t));
+    read_payload(stream, indices.get(), total_index_count * sizeof(std::uint32_t), [total_index_count](void* destination, const std::uint8_t* data, std::size_t size) {
+        return meshopt_decodeIndexBuffer(destination, total_index_count, sizeof(std::uint32_t), data, size);
+    });
 
     std::uint32_t lod_count;
     stream.read(lod_count);
     const auto lods = std::make_unique<mesh_lod[]>(lod_count);
     stream.read(lods.get(), lod_count * sizeof(mesh_lod));
 
+    std::uint32_t cluster_count;
+    stream.read(cluster_count);
+    const auto clusters = std::make_unique<mesh_cluster[]>(cluster_count);
+    stream.read(clusters.get(), cluster_count * sizeof(mesh_cluster));
+
     std::uint32_t triangle_count;
     stream.read(triangle_count);
     const auto triangles = std::make_unique<trianglef[]>(triangle_count);
@@ -80,9 +261,11 @@ std::shared_ptr<mesh> mesh::load(ibstream& stream) {
     stream.read(bbox);
 
     mesh_desc desc;
-    desc.vertices = { vertices.get(), vertex_count };
+    desc.packed_vertices = { vertices.get(), vertex_count };
+    desc.quantization = quantization;
     desc.indices = { indices.get(), total_index_count };
     desc.lods = { lods.get(), lod_count };
+    desc.clusters = { clusters.get(), cluster_count };
     desc.convex_hull = { triangles.get(), triangle_count };
     desc.bsphere = bsphere;
     desc.bbox = bbox;
@@ -133,6 +316,8 @@ static std::vector<std::uint32_t> simplify(std::vector<vertex>& vertices, const
 }
 
 void mesh::import(ibstream& input, obstream& output, const json& metadata) {
+    RB_PROFILE_ZONE("mesh::import");
+
     std::vector<vertex> vertices;
     std::vector<std::uint32_t> indices;
     std::vector<vec3f> positions;
@@ -149,6 +334,14 @@ void mesh::import(ibstream& input, obstream& output, const json& metadata) {
         simplify(vertices, indices, 0.075f, 0.05f),
     };
 
+    // Large meshes are culled per cluster on GPU, unless stated otherwise in metadata.
+    const auto clustered = metadata.contains("clusters") ? static_cast<bool>(metadata["clusters"]) : indices.size() / 3 >= min_clustered_triangles;
+
+    std::vector<mesh_cluster> clusters;
+    if (clustered) {
+        clusters = build_clusters(vertices, indices);
+    }
+
     quickhull::QuickHull<float> quickhull;
     auto hull = quickhull.getConvexHull(&positions[0].x, positions.size(), true, false);
     auto hull_indices = hull.getIndexBuffer();
@@ -173,14 +366,22 @@ void mesh::import(ibstream& input, obstream& output, const json& metadata) {
 
     output.write(mesh::magic_number);
 
+    // Base indices followed by every lod.
+    std::vector<std::uint32_t> total_indices{ indices };
+    total_indices.reserve(total_index_count);
+    for (const auto& lod : lods) {
+        total_indices.insert(total_indices.end(), lod.begin(), lod.end());
+    }
+
+    // Only packed vertices are stored, positions are quantized in mesh bounds.
+    const auto quantization = calculate_quantization(bbox);
+    output.write(quantization);
+
     output.write<std::uint32_t>(vertices.size());
-    output.write(vertices.data(), vertices.size() * sizeof(vertex));
+    write_payload(output, encode_vertices(pack_vertices(vertices, quantization)));
 
     output.write<std::uint32_t>(total_index_count);
-    output.write(indices.data(), indices.size() * sizeof(std::uint32_t)); // base indices
-    for (const auto& lod : lods) {
-        output.write(lod.data(), lod.size() * sizeof(std::uint32_t));
-    }
+    write_payload(output, encode_indices(total_indices, vertices.size()));
 
     output.write<std::uint32_t>(lods.size() + 1); // including base indices
     output.write(mesh_lod{ 0u, static_cast<std::uint32_t>(indices.size()) });
@@ -192,6 +393,10 @@ void mesh::import(ibstream& input, obstream& output, const json& metadata) {
         offset += size;
     }
 
+    // Clusters index into base indices.
+    output.write<std::uint32_t>(clusters.size());
+    output.write(clusters.data(), clusters.size() * sizeof(mesh_cluster));
+
     output.write<std::uint32_t>(convex_hull.size() / 3); // in triangle count
     output.write(convex_hull.data(), convex_hull.size() * sizeof(vec3f));
     output.write(bsphere);
@@ -332,6 +537,14 @@ span<const vertex> mesh::vertices() const {
 	return _vertices;
 }
 
+span<const packed_vertex> mesh::packed_vertices() const {
+    return _packed_vertices;
+}
+
+const vertex_quantization& mesh::quantization() const {
+    return _quantization;
+}
+
 span<const std::uint32_t> mesh::indices() const {
 	return _indices;
 }
@@ -340,6 +553,10 @@ span<const mesh_lod> mesh::lods() const {
     return _lods;
 }
 
+span<const mesh_cluster> mesh::clusters() const {
+    return _clusters;
+}
+
 span<const trianglef> mesh::convex_hull() const {
     return _convex_hull;
 }
@@ -356,9 +573,13 @@ mesh::mesh(const mesh_desc& desc)
 	: _vertices(desc.vertices.begin(), desc.vertices.end())
 	, _indices(desc.indices.begin(), desc.indices.end())
     , _lods(desc.lods.begin(), desc.lods.end())
+    , _clusters(desc.clusters.begin(), desc.clusters.end())
     , _convex_hull(desc.convex_hull.begin(), desc.convex_hull.end())
     , _bsphere(desc.bsphere ? *desc.bsphere : calculate_bsphere(desc.vertices))
-    , _bbox(desc.bbox ? *desc.bbox : calculate_bbox(desc.vertices)) {
-    RB_ASSERT(!_vertices.empty(), "No vertices has been provided for mesh.");
+    , _bbox(desc.bbox ? *desc.bbox : calculate_bbox(desc.vertices))
+    , _quantization(desc.quantization ? *desc.quantization : calculate_quantization(_bbox))
+    , _packed_vertices(desc.packed_vertices.empty() ? pack_vertices(desc.vertices, _quantization) :
+        std::vector<packed_vertex>{ desc.packed_vertices.begin(), desc.packed_vertices.end() }) {
+    RB_ASSERT(!_packed_vertices.empty(), "No vertices has been provided for mesh.");
     RB_ASSERT(!_indices.empty(), "No indices has been provided for mesh.");
 }
@@ -1,13 +1,20 @@
 #include <rabbit/graphics/model.hpp>
 #include <rabbit/graphics/mesh.hpp>
 #include <rabbit/graphics/material.hpp>
+#include <rabbit/graphics/image.hpp>
+#include <rabbit/graphics/texture_atlas.hpp>
 #include <rabbit/core/format.hpp>
+#include <rabbit/core/config.hpp>
 #include <rabbit/core/prefab.hpp>
 #include <rabbit/math/math.hpp>
 #include <rabbit/math/quat.hpp>
 #include <rabbit/editor/editor.hpp>
+#include <rabbit/core/profiler.hpp>
 
+#include <map>
+#include <array>
 #include <vector>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 
@@ -154,7 +161,298 @@ static json parse_node(const json& gltf_meshes,
     return jentity;
 }
 
+// Layers of material atlases, one per glTF texture of material.
+enum atlas_layer : std::size_t {
+    atlas_albedo,
+    atlas_metallic_roughness,
+    atlas_normal,
+    atlas_occlusion,
+    atlas_emissive,
+    atlas_layer_count
+};
+
+static constexpr vec2u atlas_size{ 2048, 2048 };
+
+// Bigger images gain nothing from sharing page.
+static constexpr std::uint32_t atlas_max_image_size{ 512 };
+
+static const json* find_texture_info(const json& gltf_material, atlas_layer layer) {
+    const json* pbr = gltf_material.contains("pbrMetallicRoughness") ? &gltf_material["pbrMetallicRoughness"] : nullptr;
+
+    switch (layer) {
+        case atlas_albedo: return pbr && pbr->contains("baseColorTexture") ? &(*pbr)["baseColorTexture"] : nullptr;
+        case atlas_metallic_roughness: return pbr && pbr->contains("metallicRoughnessTexture") ? &(*pbr)["metallicRoughnessTexture"] : nullptr;
+        case atlas_normal: return gltf_material.contains("normalTexture") ? &gltf_material["normalTexture"] : nullptr;
+        case atlas_occlusion: return gltf_material.contains("occlusionTexture") ? &gltf_material["occlusionTexture"] : nullptr;
+        case atlas_emissive: return gltf_material.contains("emissiveTexture") ? &gltf_material["emissiveTexture"] : nullptr;
+        default: return nullptr;
+    }
+}
+
+// Checks whether every TEXCOORD_0 of primitives using material stays in [0, 1], so maps can be clamped into atlas region.
+static std::vector<bool> find_unit_texcoord_materials(const json& gltf, const std::vector<std::vector<std::uint8_t>>& buffers) {
+    const auto& gltf_accessors = gltf["accessors"];
+    const auto& gltf_buffer_views = gltf["bufferViews"];
+
+    std::vector<bool> result(gltf["materials"].size(), true);
+
+    for (const auto& gltf_mesh : gltf["meshes"]) {
+        for (const auto& gltf_primitive : gltf_mesh["primitives"]) {
+            if (!gltf_primitive.contains("material") || !gltf_primitive["attributes"].contains("TEXCOORD_0")) {
+                continue;
+            }
+
+            const std::size_t material_index = gltf_primitive["material"];
+            const std::size_t accessor_index = gltf_primitive["attributes"]["TEXCOORD_0"];
+            const auto& gltf_accessor = gltf_accessors[accessor_index];
+
+            // Normalized integer texcoords are always in range.
+            const std::size_t component_type = gltf_accessor["componentType"];
+            if (component_type != 5126) {
+                continue;
+            }
+
+            const std::size_t count = gltf_accessor["count"];
+            const std::size_t byte_offset = gltf_accessor.contains("byteOffset") ?
+                (unsigned int)gltf_accessor["byteOffset"] : 0u;
+
+            const std::size_t buffer_view_index = gltf_accessor["bufferView"];
+            const auto& gltf_buffer_view = gltf_buffer_views[buffer_view_index];
+
+            const std::size_t buffer_index = gltf_buffer_view["buffer"];
+            const std::size_t buffer_offset = gltf_buffer_view.contains("byteOffset") ?
+                (unsigned int)gltf_buffer_view["byteOffset"] : 0u;
+            const std::size_t buffer_stride = gltf_buffer_view.contains("byteStride") ?
+                (unsigned int)gltf_buffer_view["byteStride"] : sizeof(vec2f);
+
+            const std::uint8_t* data = buffers[buffer_index].data() + byte_offset + buffer_offset;
+            for (std::size_t index{ 0 }; index < count; ++index) {
+                const auto& texcoord = *reinterpret_cast<const vec2f*>(data + index * buffer_stride);
+                if (texcoord.x < -0.001f || texcoord.x > 1.001f || texcoord.y < -0.001f || texcoord.y > 1.001f) {
+                    result[material_index] = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Packs small maps of materials with same set of textures into shared atlases.
+// Returns json overriding maps and uv transform of every atlased material, null for others.
+static std::vector<json> pack_material_atlases(const json& gltf,
+    const std::vector<std::vector<std::uint8_t>>& buffers,
+    const std::filesystem::path& directory_path,
+    const std::filesystem::path& data_path) {
+    static constexpr const char* layer_names[atlas_layer_count]{ "albedo", "metallic_roughness", "normal", "occlusion", "emissive" };
+
+    const auto& gltf_materials = gltf["materials"];
+    const auto& gltf_textures = gltf["textures"];
+    const auto& gltf_images = gltf["images"];
+
+    const auto unit_texcoord_materials = find_unit_texcoord_materials(gltf, buffers);
+
+    struct candidate {
+        std::size_t material_index;
+        std::array<std::string, atlas_layer_count> paths;
+        vec2u size;
+    };
+
+    // Materials are grouped by used layers and alpha, so every atlas page has same formats.
+    std::map<std::uint32_t, std::vector<candidate>> groups;
+    std::map<std::string, image> images;
+
+    for (std::size_t material_index{ 0 }; material_index < gltf_materials.size(); ++material_index) {
+        const auto& gltf_material = gltf_materials[material_index];
+        if (!unit_texcoord_materials[material_index]) {
+            continue;
+        }
+
+        candidate candidate{ material_index, {}, { 0, 0 } };
+        std::uint32_t layer_mask{ 0 };
+        bool suitable{ true };
+
+        for (std::size_t layer{ 0 }; layer < atlas_layer_count && suitable; ++layer) {
+            const auto texture_info = find_texture_info(gltf_material, static_cast<atlas_layer>(layer));
+            if (!texture_info) {
+                continue;
+            }
+
+            // Other texcoord sets and texture transforms are not remapped.
+            if ((texture_info->contains("texCoord") && (*texture_info)["texCoord"] != 0) || texture_info->contains("extensions")) {
+                suitable = false;
+                break;
+            }
+
+            const std::size_t texture_index = (*texture_info)["index"];
+            const std::size_t image_index = gltf_textures[texture_index]["source"];
+            const auto& gltf_image = gltf_images[image_index];
+
+            // TODO: Self-contained images support.
+            if (!gltf_image.contains("uri")) {
+                suitable = false;
+                break;
+            }
+
+            const auto image_path = (directory_path / static_cast<std::string>(gltf_image["uri"])).string();
+            if (images.find(image_path) == images.end()) {
+                images.emplace(image_path, image::load_from_file(image_path));
+            }
+
+            const auto& image = images.at(image_path);
+            if (!image || image.size().x > atlas_max_image_size || image.size().y > atlas_max_image_size) {
+                suitable = false;
+                break;
+            }
+
+            candidate.paths[layer] = image_path;
+            candidate.size.x = std::max(candidate.size.x, image.size().x);
+            candidate.size.y = std::max(candidate.size.y, image.size().y);
+            layer_mask |= 1u << layer;
+        }
+
+        if (!suitable || layer_mask == 0) {
+            continue;
+        }
+
+        const auto translucent = gltf_material.contains("alphaMode") && gltf_material["alphaMode"] == "BLEND";
+        groups[layer_mask | (translucent ? 1u << atlas_layer_count : 0u)].push_back(candidate);
+    }
+
+    std::vector<json> result(gltf_materials.size());
+
+    std::size_t group_index{ 0 };
+    for (auto& [key, candidates] : groups) {
+        // Single material would only get extra gutters.
+        if (candidates.size() < 2) {
+            continue;
+        }
+
+        // Bigger first packs tighter.
+        std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+            return a.size.x * a.size.y > b.size.x * b.size.y;
+        });
+
+        struct placement {
+            std::size_t page;
+            vec4u region;
+        };
+
+        std::vector<texture_atlas> pages;
+        std::map<std::array<std::string, atlas_layer_count>, placement> placements;
+
+        for (const auto& candidate : candidates) {
+            // Materials sharing same images share region too.
+            if (placements.find(candidate.paths) == placements.end()) {
+                auto region = pages.empty() ? std::nullopt : pages.back().pack(candidate.size);
+                if (!region) {
+                    pages.emplace_back(atlas_size, atlas_layer_count);
+                    region = pages.back().pack(candidate.size);
+                    RB_ASSERT(region, "Image does not fit into empty atlas page.");
+                }
+
+                auto& page = pages.back();
+                for (std::size_t layer{ 0 }; layer < atlas_layer_count; ++layer) {
+                    if (!candidate.paths[layer].empty()) {
+                        page.copy(layer, *region, images.at(candidate.paths[layer]));
+                    }
+                }
+
+                placements.emplace(candidate.paths, placement{ pages.size() - 1, *region });
+            }
+        }
+
+        // Save every layer of page as regular texture. Materials keep their own maps when any page cannot be saved.
+        bool saved{ true };
+        for (std::size_t page_index{ 0 }; page_index < pages.size() && saved; ++page_index) {
+            for (std::size_t layer{ 0 }; layer < atlas_layer_count && saved; ++layer) {
+                if ((key & (1u << layer)) == 0) {
+                    continue;
+                }
+
+                const auto atlas_filename = format("atlas_{}_{}_{}.png", group_index, page_index, layer_names[layer]);
+                if (!pages[page_index].layer(layer).save_to_file((data_path / atlas_filename).string())) {
+                    print("atlas: cannot save {}, {} materials are not atlased\n", atlas_filename, candidates.size());
+                    saved = false;
+                }
+            }
+        }
+
+        if (!saved) {
+            group_index++;
+            continue;
+        }
+
+        std::vector<std::array<std::string, atlas_layer_count>> page_uuids(pages.size());
+        for (std::size_t page_index{ 0 }; page_index < pages.size(); ++page_index) {
+            for (std::size_t layer{ 0 }; layer < atlas_layer_count; ++layer) {
+                if ((key & (1u << layer)) == 0) {
+                    continue;
+                }
+
+                const auto atlas_filename = format("atlas_{}_{}_{}.png", group_index, page_index, layer_names[layer]);
+                const auto atlas_metadata_path = (data_path / (atlas_filename + ".meta")).string();
+
+                json jatlas_metadata;
+                if (std::filesystem::exists(atlas_metadata_path)) {
+                    std::ifstream{ atlas_metadata_path } >> jatlas_metadata;
+                } else {
+                    jatlas_metadata["uuid"] = uuid::generate().to_string();
+                }
+
+                jatlas_metadata["max_mipmaps"] = texture_atlas::max_mipmaps;
+                jatlas_metadata["normal_map"] = layer == atlas_normal;
+                jatlas_metadata["mask"] = layer == atlas_occlusion;
+                jatlas_metadata["alpha"] = layer == atlas_albedo && (key & (1u << atlas_layer_count)) != 0;
+                std::ofstream{ atlas_metadata_path } << jatlas_metadata;
+
+                editor::import((data_path / atlas_filename).string());
+
+                page_uuids[page_index][layer] = jatlas_metadata["uuid"];
+            }
+        }
+
+        for (const auto& candidate : candidates) {
+            const auto& [page_index, region] = placements.at(candidate.paths);
+            const auto& uuids = page_uuids[page_index];
+            auto& jmaterial = result[candidate.material_index];
+
+            const auto uv_transform = pages[page_index].uv_transform(region);
+            jmaterial["uv_transform"] = { uv_transform.x, uv_transform.y, uv_transform.z, uv_transform.w };
+
+            if (!candidate.paths[atlas_albedo].empty()) {
+                jmaterial["albedo_map"] = uuids[atlas_albedo];
+            }
+
+            if (!candidate.paths[atlas_metallic_roughness].empty()) {
+                jmaterial["metallic_map"] = uuids[atlas_metallic_roughness];
+                jmaterial["roughness_map"] = uuids[atlas_metallic_roughness];
+            }
+
+            if (!candidate.paths[atlas_normal].empty()) {
+                jmaterial["normal_map"] = uuids[atlas_normal];
+            }
+
+            if (!candidate.paths[atlas_occlusion].empty()) {
+                jmaterial["ambient_map"] = uuids[atlas_occlusion];
+            }
+
+            if (!candidate.paths[atlas_emissive].empty()) {
+                jmaterial["emissive_map"] = uuids[atlas_emissive];
+            }
+        }
+
+        print("atlas: {} materials in {} pages\n", candidates.size(), pages.size());
+        group_index++;
+    }
+
+    return result;
+}
+
 void model::import(ibstream& input, obstream& output, const json& metadata) {
+    RB_PROFILE_ZONE("model::import");
+
     // 0. Parse glTF as json.
     const auto gltf = input.read<json>();
 
@@ -188,6 +486,12 @@ void model::import(ibstream& input, obstream& output, const json& metadata) {
         buffers.push_back(buffer);
     }
 
+    // Opt-in, small maps of materials are moved into shared atlases.
+    std::vector<json> material_atlases;
+    if (metadata.contains("atlas") && metadata["atlas"]) {
+        material_atlases = pack_material_atlases(gltf, buffers, directory_path, data_path);
+    }
+
     // 2. Import materials.
     std::vector<std::string> materials;
     std::size_t material_index{ 0 };
@@ -306,6 +610,12 @@ void model::import(ibstream& input, obstream& output, const json& metadata) {
                     json image_metadata;
                     std::ifstream{ image_metadata_path } >> image_metadata;
                     jmaterial["ambient_map"] = image_metadata["uuid"];
+
+                    // Flag texture as single channel mask, unless occlusion is packed with other maps.
+                    if (!jmaterial.contains("metallic_map") || jmaterial["metallic_map"] != image_metadata["uuid"]) {
+                        image_metadata["mask"] = true;
+                        std::ofstream{ image_metadata_path } << image_metadata;
+                    }
                 }
             }
 
@@ -346,6 +656,10 @@ void model::import(ibstream& input, obstream& output, const json& metadata) {
         // TODO: Emissive factor support.
         // TODO: Alpha cutoff support.
 
+        if (material_index < material_atlases.size() && !material_atlases[material_index].is_null()) {
+            jmaterial.update(material_atlases[material_index]);
+        }
+
         const std::string material_name = format("material{}", material_index);
         const auto material_filename = material_name + ".mat";
         const auto material_metadata_filename = material_filename + ".meta";
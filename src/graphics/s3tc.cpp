@@ -5,106 +5,121 @@
 
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <cstring>
+#include <algorithm>
 
 using namespace rb;
 
 static void ensure() {
-	static std::mutex mutex;
+	static std::once_flag flag;
 
-	std::lock_guard<std::mutex> guard{ mutex };
-	rgbcx::init(rgbcx::bc1_approx_mode::cBC1Ideal);
+	std::call_once(flag, [] {
+		rgbcx::init(rgbcx::bc1_approx_mode::cBC1Ideal);
+	});
 }
 
-void s3tc::bc1(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
-	ensure();
-
-	struct block {
-		color colors[2];
-	};
+// Extra encoder threads shared by all concurrent encodes, so parallel imports never oversubscribe cores.
+static std::atomic<std::size_t> spare_workers{ std::max(std::thread::hardware_concurrency(), 1u) - 1 };
 
-	const auto pixels = reinterpret_cast<const color*>(uncompressed_pixels);
-	const auto blocks = reinterpret_cast<block*>(compressed_pixels);
+static std::size_t acquire_workers(std::size_t count) {
+	auto available = spare_workers.load();
+	std::size_t acquired;
+	do {
+		acquired = std::min(available, count);
+	} while (!spare_workers.compare_exchange_weak(available, available - acquired));
+	return acquired;
+}
 
-	color input_block[16];
+static void release_workers(std::size_t count) {
+	spare_workers += count;
+}
 
-	const auto size_x = stride / 4;
-	const auto blocks_x = size_x / 4;
-	const auto size_y = uncompressed_size / stride;
-
-	for (auto y = 0u; y < size_y; y += 4) {
-		for (auto x = 0u; x < size_x; x += 4) {
-			input_block[0] = pixels[y * size_x + x];
-			input_block[1] = pixels[y * size_x + x + 1];
-			input_block[2] = pixels[y * size_x + x + 2];
-			input_block[3] = pixels[y * size_x + x + 3];
-
-			input_block[4] = pixels[(y + 1) * size_x + x];
-			input_block[5] = pixels[(y + 1) * size_x + x + 1];
-			input_block[6] = pixels[(y + 1) * size_x + x + 2];
-			input_block[7] = pixels[(y + 1) * size_x + x + 3];
-
-			input_block[8] = pixels[(y + 2) * size_x + x];
-			input_block[9] = pixels[(y + 2) * size_x + x + 1];
-			input_block[10] = pixels[(y + 2) * size_x + x + 2];
-			input_block[11] = pixels[(y + 3) * size_x + x + 3];
-
-			input_block[12] = pixels[(y + 3) * size_x + x];
-			input_block[13] = pixels[(y + 3) * size_x + x + 1];
-			input_block[14] = pixels[(y + 3) * size_x + x + 2];
-			input_block[15] = pixels[(y + 3) * size_x + x + 3];
-
-			const auto by = y / 4;
-			const auto bx = x / 4;
-
-			rgbcx::encode_bc1(&blocks[by * blocks_x + bx], (const std::uint8_t*)&input_block);
-		}
+// Copies 4x4 block of pixels, one row at a time.
+static void gather_block(const color* pixels, std::size_t size_x, std::size_t x, std::size_t y, color* input_block) {
+	for (auto row = 0u; row < 4; ++row) {
+		std::memcpy(input_block + row * 4, pixels + (y + row) * size_x + x, sizeof(color) * 4);
 	}
 }
 
-void s3tc::bc3(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
+// Encodes every 4x4 block of image. Block rows are split between calling thread and spare worker threads,
+// because blocks are independent and encoders (especially BC1/BC3) are expensive.
+template<typename Encode>
+static void encode_blocks(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride,
+	void* compressed_pixels, std::size_t block_size, Encode encode) {
 	ensure();
 
-	struct block {
-		color colors[4];
-	};
-
 	const auto pixels = reinterpret_cast<const color*>(uncompressed_pixels);
-	const auto blocks = reinterpret_cast<block*>(compressed_pixels);
-
-	color input_block[16];
+	const auto blocks = reinterpret_cast<std::uint8_t*>(compressed_pixels);
 
 	const auto size_x = stride / 4;
 	const auto blocks_x = size_x / 4;
-	const auto size_y = uncompressed_size / stride;
-
-	for (auto y = 0u; y < size_y; y += 4) {
-		for (auto x = 0u; x < size_x; x += 4) {
-			input_block[0] = pixels[y * size_x + x];
-			input_block[1] = pixels[y * size_x + x + 1];
-			input_block[2] = pixels[y * size_x + x + 2];
-			input_block[3] = pixels[y * size_x + x + 3];
-
-			input_block[4] = pixels[(y + 1) * size_x + x];
-			input_block[5] = pixels[(y + 1) * size_x + x + 1];
-			input_block[6] = pixels[(y + 1) * size_x + x + 2];
-			input_block[7] = pixels[(y + 1) * size_x + x + 3];
-
-			input_block[8] = pixels[(y + 2) * size_x + x];
-			input_block[9] = pixels[(y + 2) * size_x + x + 1];
-			input_block[10] = pixels[(y + 2) * size_x + x + 2];
-			input_block[11] = pixels[(y + 3) * size_x + x + 3];
-
-			input_block[12] = pixels[(y + 3) * size_x + x];
-			input_block[13] = pixels[(y + 3) * size_x + x + 1];
-			input_block[14] = pixels[(y + 3) * size_x + x + 2];
-			input_block[15] = pixels[(y + 3) * size_x + x + 3];
-
-			const auto by = y / 4;
-			const auto bx = x / 4;
-
-			rgbcx::encode_bc3(&blocks[by * blocks_x + bx], (const std::uint8_t*)&input_block);
+	const auto blocks_y = uncompressed_size / stride / 4;
+
+	const auto encode_rows = [&](std::size_t first, std::size_t last) {
+		color input_block[16];
+
+		for (auto by = first; by < last; ++by) {
+			for (auto bx = 0u; bx < blocks_x; ++bx) {
+				gather_block(pixels, size_x, bx * 4, by * 4, input_block);
+				encode(blocks + (by * blocks_x + bx) * block_size, reinterpret_cast<const std::uint8_t*>(input_block));
+			}
 		}
+	};
+
+	// Small images (last mipmaps) are not worth spawning threads.
+	const auto extra_workers = blocks_y / 4 > 1 ? acquire_workers(blocks_y / 4 - 1) : 0;
+	if (extra_workers == 0) {
+		encode_rows(0, blocks_y);
+		return;
+	}
+
+	const auto worker_count = extra_workers + 1;
+
+	std::vector<std::future<void>> workers;
+	workers.reserve(extra_workers);
+
+	for (auto index = 1u; index < worker_count; ++index) {
+		const auto first = blocks_y * index / worker_count;
+		const auto last = blocks_y * (index + 1) / worker_count;
+		workers.push_back(std::async(std::launch::async, encode_rows, first, last));
+	}
+
+	encode_rows(0, blocks_y / worker_count);
+
+	for (auto& worker : workers) {
+		worker.get();
 	}
+
+	release_workers(extra_workers);
+}
+
+void s3tc::bc1(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
+	encode_blocks(uncompressed_pixels, uncompressed_size, stride, compressed_pixels, 8, [](void* block, const std::uint8_t* input_block) {
+		rgbcx::encode_bc1(block, input_block);
+	});
+}
+
+void s3tc::bc3(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
+	encode_blocks(uncompressed_pixels, uncompressed_size, stride, compressed_pixels, 16, [](void* block, const std::uint8_t* input_block) {
+		rgbcx::encode_bc3(block, input_block);
+	});
+}
+
+void s3tc::bc4(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
+	encode_blocks(uncompressed_pixels, uncompressed_size, stride, compressed_pixels, 8, [](void* block, const std::uint8_t* input_block) {
+		// Red channel only.
+		rgbcx::encode_bc4(block, input_block, 4);
+	});
+}
+
+void s3tc::bc5(const void* uncompressed_pixels, std::size_t uncompressed_size, std::size_t stride, void* compressed_pixels) {
+	encode_blocks(uncompressed_pixels, uncompressed_size, stride, compressed_pixels, 16, [](void* block, const std::uint8_t* input_block) {
+		// Red and green channels.
+		rgbcx::encode_bc5(block, input_block, 0, 1, 4);
+	});
 }
 
 std::vector<std::uint8_t> s3tc::bc1(const image& image) {
@@ -120,3 +135,17 @@ std::vector<std::uint8_t> s3tc::bc3(const image& image) {
 	bc3(image.pixels().data(), image.pixels().size_bytes(), image.stride(), compressed_pixels.get());
 	return { compressed_pixels.get(), compressed_pixels.get() + compressed_size };
 }
+
+std::vector<std::uint8_t> s3tc::bc4(const image& image) {
+	const auto compressed_size = (image.size().x * image.size().y) / 2;
+	auto compressed_pixels = std::make_unique<std::uint8_t[]>(compressed_size);
+	bc4(image.pixels().data(), image.pixels().size_bytes(), image.stride(), compressed_pixels.get());
+	return { compressed_pixels.get(), compressed_pixels.get() + compressed_size };
+}
+
+std::vector<std::uint8_t> s3tc::bc5(const image& image) {
+	const auto compressed_size = (image.size().x * image.size().y);
+	auto compressed_pixels = std::make_unique<std::uint8_t[]>(compressed_size);
+	bc5(image.pixels().data(), image.pixels().size_bytes(), image.stride(), compressed_pixels.get());
+	return { compressed_pixels.get(), compressed_pixels.get() + compressed_size };
+}
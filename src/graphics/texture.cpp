@@ -2,17 +2,23 @@
 #include <rabbit/core/config.hpp>
 #include <rabbit/graphics/graphics.hpp>
 #include <rabbit/core/compression.hpp>
+#include <rabbit/core/format.hpp>
 #include <rabbit/graphics/image.hpp>
 #include <rabbit/graphics/s3tc.hpp>
+#include <rabbit/core/profiler.hpp>
+
+#include <vector>
+#include <algorithm>
 
 using namespace rb;
 
 inline std::uint32_t calculate_mipmap_levels(const vec2u& texture_size) {
-	vec2u size{ texture_size };
-	std::uint32_t mipmaps{ 0 };
-	while (size.x > 4 && size.y > 4) {
+	// Full chain, down to 1x1.
+	std::uint32_t size{ std::max(texture_size.x, texture_size.y) };
+	std::uint32_t mipmaps{ 1 };
+	while (size > 1) {
 		mipmaps++;
-		size = size / 2u;
+		size /= 2;
 	}
 	return mipmaps;
 }
@@ -24,11 +30,31 @@ inline std::uint32_t calculate_bits_per_pixel(texture_format format) {
 		case texture_format::rgba8: return 32;
 		case texture_format::bc1: return 4;
 		case texture_format::bc3: return 8;
+		case texture_format::bc4: return 4;
+		case texture_format::bc5: return 8;
 	}
 
 	return 0;
 }
 
+inline bool is_block_compressed(texture_format format) {
+	return format == texture_format::bc1 || format == texture_format::bc3 ||
+		format == texture_format::bc4 || format == texture_format::bc5;
+}
+
+// Block encoders work on whole 4x4 blocks, so smallest levels are padded by repeating edge pixels.
+static image pad_to_block(const image& image) {
+	const auto& size = image.size();
+	const vec2u padded_size{ (size.x + 3) / 4 * 4, (size.y + 3) / 4 * 4 };
+	std::vector<color> pixels(padded_size.x * padded_size.y);
+	for (auto y = 0u; y < padded_size.y; ++y) {
+		for (auto x = 0u; x < padded_size.x; ++x) {
+			pixels[y * padded_size.x + x] = image.pixels()[std::min(y, size.y - 1) * size.x + std::min(x, size.x - 1)];
+		}
+	}
+	return image::from_pixels(pixels.data(), padded_size);
+}
+
 std::shared_ptr<texture> texture::load(ibstream& stream) {
 	texture_desc desc;
 	stream.read(desc.size.x);
@@ -38,24 +64,47 @@ std::shared_ptr<texture> texture::load(ibstream& stream) {
 	stream.read(desc.wrap);
 	stream.read(desc.mipmaps);
 
-	std::uint32_t compressed_size;
-	stream.read(compressed_size);
-
-	const auto compressed_pixels = std::make_unique<std::uint8_t[]>(compressed_size);
-	stream.read(compressed_pixels.get(), compressed_size);
-
 	std::uint32_t pixels_size;
 	stream.read(pixels_size);
-	
-	const auto bits_per_pixel = calculate_bits_per_pixel(desc.format);
+
+	// Level table is written upfront, so every level can be decoded on its own.
+	std::vector<texture_level> levels(desc.mipmaps);
+	std::vector<texture_codec> codecs(desc.mipmaps);
+	std::vector<std::uint32_t> stored_sizes(desc.mipmaps);
+	for (auto i = 0u; i < desc.mipmaps; ++i) {
+		stream.read(levels[i].offset);
+		stream.read(levels[i].size);
+		stream.read(codecs[i]);
+		stream.read(stored_sizes[i]);
+	}
+
 	const auto pixels = std::make_unique<std::uint8_t[]>(pixels_size);
-	compression::uncompress(compressed_pixels.get(), compressed_size, pixels.get(), pixels_size);
+	std::vector<std::uint8_t> stored_pixels;
+	for (auto i = 0u; i < desc.mipmaps; ++i) {
+		const auto level_pixels = pixels.get() + levels[i].offset;
+
+		if (codecs[i] == texture_codec::zlib) {
+			stored_pixels.resize(stored_sizes[i]);
+			stream.read(stored_pixels.data(), stored_sizes[i]);
+
+			// Truncated or corrupted level would otherwise be uploaded as garbage.
+			if (compression::uncompress(stored_pixels.data(), stored_sizes[i], level_pixels, levels[i].size) != levels[i].size) {
+				print("texture: cannot uncompress level {}\n", i);
+				return nullptr;
+			}
+		} else {
+			stream.read(level_pixels, levels[i].size);
+		}
+	}
 
 	desc.data = pixels.get();
+	desc.levels = levels.data();
 	return graphics::make_texture(desc);
 }
 
 void texture::import(ibstream& input, obstream& output, const json& metadata) {
+	RB_PROFILE_ZONE("texture::import");
+
 	// 1. Load image from file to RGBA image
 	auto image = image::load_from_stream(input);
 
@@ -70,7 +119,10 @@ void texture::import(ibstream& input, obstream& output, const json& metadata) {
 	// Decide which format to use.
 	texture_format format;
 	if (metadata.contains("normal_map") && metadata["normal_map"]) {
-		format = texture_format::rgba8; // TODO: Use bc4?
+		// Only XY are stored, Z is reconstructed in shaders.
+		format = texture_format::bc5;
+	} else if (metadata.contains("mask") && metadata["mask"]) {
+		format = texture_format::bc4;
 	} else if (metadata.contains("alpha") && metadata["alpha"]) {
 		format = texture_format::bc3;
 	} else {
@@ -80,33 +132,76 @@ void texture::import(ibstream& input, obstream& output, const json& metadata) {
 	// Save base image size
 	const auto base_size = image.size();
 
-	// Calculate mipmap count based on image size
-	const auto mipmap_count = std::min(calculate_mipmap_levels(image.size()), 6u);
+	// Calculate mipmap count based on image size. Atlases limit chain to mipmaps safe from bleeding.
+	auto mipmap_count = calculate_mipmap_levels(base_size);
+	if (metadata.contains("max_mipmaps")) {
+		mipmap_count = std::clamp<std::uint32_t>(metadata["max_mipmaps"], 1u, mipmap_count);
+	}
 
-	mobstream stream;
+	// Build whole mipmap chain first, so every level can be compressed at once.
+	std::vector<rb::image> mipmaps;
+	mipmaps.reserve(mipmap_count);
 	for (auto i = 0u; i < mipmap_count; ++i) {
-		if (format == texture_format::bc3) {
-			// Compress mipmaps pixels to lossy, gpu friendly BC3
-			const auto bc3_pixels = s3tc::bc3(image);
-			RB_ASSERT(!bc3_pixels.empty(), "Cannot compress image.");
-			stream.write(bc3_pixels.data(), bc3_pixels.size());
-		} else if (format == texture_format::bc1) {
-			// Compress mipmaps pixels to lossy, gpu friendly BC1
-			const auto bc1_pixels = s3tc::bc1(image);
-			RB_ASSERT(!bc1_pixels.empty(), "Cannot compress image.");
-			stream.write(bc1_pixels.data(), bc1_pixels.size());
+		if (i + 1 < mipmap_count) {
+			auto next_image = image::resize(image, level_size(base_size, i + 1));
+			mipmaps.push_back(std::move(image));
+			image = std::move(next_image);
 		} else {
-			stream.write(image.pixels().data(), image.pixels().size_bytes());
+			mipmaps.push_back(std::move(image));
 		}
-
-		image = image::resize(image, image.size() / 2u);
 	}
-	const auto pixels = stream.memory();
 
-	// Compress to lossles, storage friendly zlib
-	const auto compressed_pixels = compression::compress(pixels);
+	struct encoded_level {
+		std::vector<std::uint8_t> pixels;
+		std::uint32_t size;
+		texture_codec codec;
+	};
+
+	// Compress mipmaps pixels to lossy, gpu friendly block format and then to lossless, storage friendly zlib.
+	const auto encode_mipmap = [format](const rb::image& mipmap) -> encoded_level {
+		rb::image padded_mipmap;
+		if (is_block_compressed(format) && (mipmap.size().x % 4 != 0 || mipmap.size().y % 4 != 0)) {
+			padded_mipmap = pad_to_block(mipmap);
+		}
+
+		const auto& source = padded_mipmap ? padded_mipmap : mipmap;
 
-	RB_ASSERT(!compressed_pixels.empty(), "Cannot compress image.");
+		std::vector<std::uint8_t> pixels;
+		switch (format) {
+			case texture_format::bc1: pixels = s3tc::bc1(source); break;
+			case texture_format::bc3: pixels = s3tc::bc3(source); break;
+			case texture_format::bc4: pixels = s3tc::bc4(source); break;
+			case texture_format::bc5: pixels = s3tc::bc5(source); break;
+			default: {
+				const auto data = reinterpret_cast<const std::uint8_t*>(mipmap.pixels().data());
+				pixels.assign(data, data + mipmap.pixels().size_bytes());
+				break;
+			}
+		}
+
+		RB_ASSERT(pixels.size() == level_bytes(format, mipmap.size()), "Cannot compress image.");
+
+		// Keep level uncompressed, when zlib does not pay off.
+		auto compressed_pixels = compression::compress(span<const std::uint8_t>{ pixels });
+		if (compressed_pixels.empty() || compressed_pixels.size() >= pixels.size()) {
+			const auto size = static_cast<std::uint32_t>(pixels.size());
+			return { std::move(pixels), size, texture_codec::none };
+		}
+
+		return { std::move(compressed_pixels), static_cast<std::uint32_t>(pixels.size()), texture_codec::zlib };
+	};
+
+	// Levels are encoded one by one, block encoders already spread rows of each level between worker threads.
+	std::vector<encoded_level> levels;
+	levels.reserve(mipmap_count);
+	for (const auto& mipmap : mipmaps) {
+		levels.push_back(encode_mipmap(mipmap));
+	}
+
+	std::uint32_t pixels_size{ 0 };
+	for (const auto& level : levels) {
+		pixels_size += level.size;
+	}
 
 	output.write(texture::magic_number);
 	output.write(base_size);
@@ -114,9 +209,20 @@ void texture::import(ibstream& input, obstream& output, const json& metadata) {
 	output.write(texture_filter::linear);
 	output.write(texture_wrap::repeat);
 	output.write<std::uint32_t>(mipmap_count);
-	output.write<std::uint32_t>(compressed_pixels.size());
-	output.write<std::uint8_t>(compressed_pixels);
-	output.write<std::uint32_t>(pixels.size_bytes());
+	output.write<std::uint32_t>(pixels_size);
+
+	std::uint32_t offset{ 0 };
+	for (const auto& level : levels) {
+		output.write<std::uint32_t>(offset);
+		output.write<std::uint32_t>(level.size);
+		output.write(level.codec);
+		output.write<std::uint32_t>(static_cast<std::uint32_t>(level.pixels.size()));
+		offset += level.size;
+	}
+
+	for (const auto& level : levels) {
+		output.write<std::uint8_t>(level.pixels);
+	}
 }
 
 std::shared_ptr<texture> texture::make_one_color(const color& color, const vec2u& size) {
@@ -159,6 +265,23 @@ std::size_t texture::bits_per_pixel() const {
 	return _bits_per_pixel;
 }
 
+span<const texture_level> texture::levels() const {
+	return _levels;
+}
+
+vec2u texture::level_size(const vec2u& size, std::uint32_t level) {
+	return { std::max(size.x >> level, 1u), std::max(size.y >> level, 1u) };
+}
+
+std::uint32_t texture::level_bytes(texture_format format, const vec2u& size) {
+	const auto bits_per_pixel = calculate_bits_per_pixel(format);
+	if (is_block_compressed(format)) {
+		// Every 4x4 block holds 16 pixels.
+		return ((size.x + 3) / 4) * ((size.y + 3) / 4) * bits_per_pixel * 2;
+	}
+	return size.x * size.y * bits_per_pixel / 8;
+}
+
 texture::texture(const texture_desc& desc)
 	: _size(desc.size)
 	, _format(desc.format)
@@ -168,4 +291,16 @@ texture::texture(const texture_desc& desc)
 	, _bits_per_pixel(calculate_bits_per_pixel(desc.format)) {
 	RB_ASSERT(_size.x > 0 && _size.y > 0, "Size of texture should be greater than 0. Current size: {}, {}.", _size.x, _size.y);
 	RB_ASSERT(_bits_per_pixel > 0, "Incorrect bits per pixel value: {}.", _bits_per_pixel);
+
+	_levels.resize(_mipmaps);
+	if (desc.levels) {
+		std::copy(desc.levels, desc.levels + _mipmaps, _levels.begin());
+	} else {
+		std::uint32_t offset{ 0 };
+		for (auto i = 0u; i < _mipmaps; ++i) {
+			_levels[i].offset = offset;
+			_levels[i].size = level_bytes(_format, level_size(_size, i));
+			offset += _levels[i].size;
+		}
+	}
 }
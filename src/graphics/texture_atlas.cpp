@@ -0,0 +1,66 @@
+#include <rabbit/graphics/texture_atlas.hpp>
+#include <rabbit/core/config.hpp>
+
+#include <algorithm>
+
+using namespace rb;
+
+texture_atlas::texture_atlas(const vec2u& size, std::size_t layer_count)
+    : _size(size)
+    , _packer(size / alignment)
+    , _layers(layer_count, std::vector<color>(size.x * size.y)) {
+    RB_ASSERT(size.x % alignment == 0 && size.y % alignment == 0, "Atlas size has to be multiple of alignment.");
+}
+
+std::optional<vec4u> texture_atlas::pack(const vec2u& size) {
+    // Packer works on alignment grid cells.
+    const vec2u cells{
+        (size.x + 2 * gutter + alignment - 1) / alignment,
+        (size.y + 2 * gutter + alignment - 1) / alignment
+    };
+
+    if (const auto cell = _packer.pack(cells); cell) {
+        return vec4u{ cell->x * alignment + gutter, cell->y * alignment + gutter, size.x, size.y };
+    }
+    return std::nullopt;
+}
+
+void texture_atlas::copy(std::size_t layer, const vec4u& region, const image& source) {
+    const vec2u region_size{ region.z, region.w };
+    const auto same_size = source.size().x == region_size.x && source.size().y == region_size.y;
+    const auto resized = same_size ? image{} : image::resize(source, region_size);
+    const auto& pixels = resized ? resized.pixels() : source.pixels();
+
+    auto& destination = _layers[layer];
+
+    // Gutters repeat edge pixels, same as clamp addressing would.
+    const auto min_x = region.x - gutter;
+    const auto min_y = region.y - gutter;
+    const auto max_x = std::min(region.x + region.z + gutter, _size.x);
+    const auto max_y = std::min(region.y + region.w + gutter, _size.y);
+
+    for (auto y = min_y; y < max_y; ++y) {
+        const auto source_y = std::clamp<int>(static_cast<int>(y) - static_cast<int>(region.y), 0, static_cast<int>(region.w) - 1);
+        for (auto x = min_x; x < max_x; ++x) {
+            const auto source_x = std::clamp<int>(static_cast<int>(x) - static_cast<int>(region.x), 0, static_cast<int>(region.z) - 1);
+            destination[y * _size.x + x] = pixels[source_y * region.z + source_x];
+        }
+    }
+}
+
+image texture_atlas::layer(std::size_t layer) const {
+    return image::from_pixels(_layers[layer].data(), _size);
+}
+
+vec4f texture_atlas::uv_transform(const vec4u& region) const {
+    return {
+        static_cast<float>(region.z) / static_cast<float>(_size.x),
+        static_cast<float>(region.w) / static_cast<float>(_size.y),
+        static_cast<float>(region.x) / static_cast<float>(_size.x),
+        static_cast<float>(region.y) / static_cast<float>(_size.y)
+    };
+}
+
+const vec2u& texture_atlas::size() const {
+    return _size;
+}
@@ -1,4 +1,7 @@
 #include <rabbit/platform/input.hpp>
+#include <rabbit/core/settings.hpp>
+
+#include "../drivers/headless/input_headless.hpp"
 
 #if RB_WINDOWS
 #	include "../drivers/win32/input_win32.hpp"
@@ -7,11 +10,16 @@
 using namespace rb;
 
 std::shared_ptr<input_impl> input::_impl;
+std::chrono::steady_clock::time_point input::_refresh_time;
 
 void input::init() {
 #if RB_WINDOWS
-	_impl = std::make_shared<input_win32>();
+	if (!settings::headless) {
+		_impl = std::make_shared<input_win32>();
+		return;
+	}
 #endif
+	_impl = std::make_shared<input_headless>();
 }
 
 void input::release() {
@@ -20,6 +28,7 @@ void input::release() {
 
 void input::refresh() {
 	_impl->refresh();
+	_refresh_time = std::chrono::steady_clock::now();
 }
 
 bool input::is_key_down(keycode key) {
@@ -61,3 +70,7 @@ bool input::is_mouse_button_pressed(mouse_button button) {
 bool input::is_mouse_button_released(mouse_button button) {
 	return _impl->is_mouse_button_released(button);
 }
+
+std::chrono::steady_clock::time_point input::refresh_time() {
+	return _refresh_time;
+}
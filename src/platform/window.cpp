@@ -1,4 +1,7 @@
 #include <rabbit/platform/window.hpp>
+#include <rabbit/core/settings.hpp>
+
+#include "../drivers/headless/window_headless.hpp"
 
 #if RB_WINDOWS
 #	include "../drivers/win32/window_win32.hpp"
@@ -10,8 +13,12 @@ std::shared_ptr<window_impl> window::_impl;
 
 void window::init() {
 #if RB_WINDOWS
-	_impl = std::make_shared<window_win32>();
+	if (!settings::headless) {
+		_impl = std::make_shared<window_win32>();
+		return;
+	}
 #endif
+	_impl = std::make_shared<window_headless>();
 }
 
 void window::release() {
@@ -68,7 +68,7 @@ void renderer::draw(registry& registry) {
     // TODO: Entities that is not visible from camera perspective should be culled. 
     for (const auto& [entity, transform, geometry, cached_geometry] : registry.view<transform, geometry, cached_geometry>().each()) {
         if (!geometry.material || (!geometry.material->translucent() && !geometry.material->wireframe())) {
-            graphics::draw_depth(_viewport, get_world(registry, entity, transform), geometry.mesh, cached_geometry.lod_index);
+            graphics::draw_depth(_viewport, get_world(registry, entity, transform), geometry.mesh, geometry.material, cached_geometry.lod_index);
         }
     }
 